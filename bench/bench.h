@@ -0,0 +1,98 @@
+#pragma once
+
+/* Shared helpers for the bench_* programs. Include after laz_utils.h. */
+
+#include <stdio.h>
+
+#ifdef LAZ_PERF
+/* Counters of the main thread, opened by the first bench_start */
+static struct perf_counters bench_counters;
+static int bench_counters_opened;
+static int bench_counting;
+#endif
+
+/* Returns the start time to pass to bench_report, and starts the hardware
+ * counters when there are any */
+static u64 bench_start(void)
+{
+#ifdef LAZ_PERF
+	if (!bench_counters_opened) {
+		(void)perf_counters_open(&bench_counters);
+		bench_counters_opened = 1;
+	}
+
+	perf_counters_start(&bench_counters);
+	bench_counting = 1;
+#endif
+	return get_nanoseconds();
+}
+
+#ifdef LAZ_PERF
+/* Appends the counts since bench_start, per operation, for the counters that
+ * work */
+static void bench_report_counters(u64 ops, u64 ns)
+{
+	struct perf_sample s;
+	double per_op = 1.0 / (double)MAX(ops, 1);
+
+	perf_counters_stop(&bench_counters, &s);
+	bench_counting = 0;
+
+	if ((s.available & 1U << PERF_COUNTER_CYCLES) != 0) {
+		printf(" %10.2f cyc/op",
+		       (double)s.values[PERF_COUNTER_CYCLES] * per_op);
+	}
+
+	if ((s.available & 1U << PERF_COUNTER_CYCLES) != 0 &&
+	    (s.available & 1U << PERF_COUNTER_INSTRUCTIONS) != 0) {
+		printf(" %5.2f IPC",
+		       (double)s.values[PERF_COUNTER_INSTRUCTIONS] /
+			       (double)MAX(s.values[PERF_COUNTER_CYCLES], 1));
+	}
+
+	if ((s.available & 1U << PERF_COUNTER_CACHE_MISSES) != 0) {
+		printf(" %8.3f LLC-miss/op",
+		       (double)s.values[PERF_COUNTER_CACHE_MISSES] * per_op);
+	}
+
+	if ((s.available & 1U << PERF_COUNTER_BRANCH_MISSES) != 0) {
+		printf(" %8.3f br-miss/op",
+		       (double)s.values[PERF_COUNTER_BRANCH_MISSES] * per_op);
+	}
+
+	/* Below 100% when waiting on I/O or other threads */
+	if ((s.available & 1U << PERF_COUNTER_TASK_CLOCK) != 0) {
+		printf(" %4.0f%% CPU",
+		       100.0 * (double)s.values[PERF_COUNTER_TASK_CLOCK] /
+			       (double)MAX(ns, 1));
+	}
+}
+#endif
+
+/* Prints one result line: operations per second, time per operation and,
+ * when `bytes` is nonzero, throughput in GB/s. Runs timed from bench_start
+ * also get the hardware counters of the calling thread. */
+static void bench_report(const char *name, u64 ops, u64 bytes, u64 ns)
+{
+	double seconds = (double)ns / 1e9;
+
+	if (ns == 0) {
+		seconds = 1e-9;
+	}
+
+	printf("%-44s %10.2f Mops/s %10.2f ns/op", name,
+	       (double)ops / seconds / 1e6, (double)ns / (double)MAX(ops, 1));
+
+	if (bytes != 0) {
+		printf(" %8.2f GB/s", (double)bytes / seconds / 1e9);
+	}
+
+#ifdef LAZ_PERF
+	if (bench_counting) {
+		bench_report_counters(ops, ns);
+	}
+#endif
+
+	printf("\n");
+	fflush(stdout);
+}
@@ -0,0 +1,104 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "bench.h"
+
+#define TOTAL_BYTES (256 << 20)
+#define FILE_BYTES (64 << 20)
+
+static const char *names[] = { "fnv1a_32_buf", "fnv1a_64_buf", "crc32c_buf",
+			       "fast_hash_64" };
+
+static u64 run_hash(size_t which, const void *buf, size_t len)
+{
+	switch (which) {
+	case 0:
+		return fnv1a_32_buf(buf, len);
+	case 1:
+		return fnv1a_64_buf(buf, len);
+	case 2:
+		return crc32c_buf(buf, len);
+	default:
+		return fast_hash_64(buf, len, 0);
+	}
+}
+
+static void bench_hashes(const unsigned char *buf)
+{
+	size_t sizes[] = { 16, 64, 1024, 1 << 20 };
+	volatile u64 sink = 0;
+
+	for (size_t h = 0; h < ARRAY_LENGTH(names); h++) {
+		for (size_t s = 0; s < ARRAY_LENGTH(sizes); s++) {
+			size_t iterations = TOTAL_BYTES / sizes[s] / 4;
+			char name[64];
+			u64 start = bench_start();
+
+			/* The slower FNV loops get a quarter of the bytes */
+			if (h >= 2) {
+				iterations *= 4;
+			}
+
+			for (size_t i = 0; i < iterations; i++) {
+				sink += run_hash(h, buf + (i & 63), sizes[s]);
+			}
+
+			(void)snprintf(name, sizeof(name), "%s, %zu bytes",
+				       names[h], sizes[s]);
+			bench_report(name, iterations, iterations * sizes[s],
+				     get_nanoseconds() - start);
+		}
+	}
+
+	(void)sink;
+}
+
+static void bench_loading(const unsigned char *buf)
+{
+	char path[] = "/tmp/bench_hash_XXXXXX";
+	int fd = mkstemp(path);
+	struct mapped_file map;
+	char *contents = NULL;
+	long size = 0;
+	u64 start = 0;
+	volatile u64 sink = 0;
+
+	if (fd < 0 || write(fd, buf, FILE_BYTES) != FILE_BYTES) {
+		panicf("Error: unable to write %s\n", path);
+	}
+
+	(void)close(fd);
+
+	start = bench_start();
+	size = load_file(path, NULL);
+	contents = (char *)malloc_try((size_t)size);
+	(void)load_file(path, contents);
+	sink += fast_hash_64(contents, (size_t)size - 1, 0);
+	bench_report("load_file + fast_hash_64, 64 MiB", 1, FILE_BYTES,
+		     get_nanoseconds() - start);
+	free(contents);
+
+	start = bench_start();
+	(void)map_file(path, &map);
+	sink += fast_hash_64(map.data, map.size, 0);
+	unmap_file(&map);
+	bench_report("map_file + fast_hash_64, 64 MiB", 1, FILE_BYTES,
+		     get_nanoseconds() - start);
+
+	(void)remove(path);
+	(void)sink;
+}
+
+int main(void)
+{
+	unsigned char *buf = (unsigned char *)malloc_try(FILE_BYTES + 64);
+
+	for (size_t i = 0; i < FILE_BYTES + 64; i++) {
+		buf[i] = (unsigned char)(i * 2654435761U >> 13);
+	}
+
+	bench_hashes(buf);
+	bench_loading(buf);
+	free(buf);
+
+	return 0;
+}
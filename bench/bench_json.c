@@ -0,0 +1,57 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "bench.h"
+
+#define RECORDS 50000
+#define TOTAL_BYTES (1ULL << 30)
+
+/* An array of event records, like the event files the parser is for */
+static char *make_events(size_t *len)
+{
+	size_t cap = RECORDS * 160;
+	char *text = (char *)malloc_try(cap);
+	u64 state = 1;
+
+	*len = 0;
+	text[(*len)++] = '[';
+
+	for (size_t i = 0; i < RECORDS; i++) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		*len += (size_t)snprintf(
+			text + *len, cap - *len,
+			"%s\n  {\"id\": %zu, \"kind\": \"click\", \"ok\": %s, "
+			"\"score\": %u.%u, \"tags\": [\"a\\\"b\", \"c\"], "
+			"\"user\": {\"name\": \"user %u\"}}",
+			i == 0 ? "" : ",", i, (state >> 63) ? "true" : "false",
+			(unsigned)(state >> 40) & 0xff,
+			(unsigned)(state >> 32) & 0xff,
+			(unsigned)(state >> 48));
+	}
+
+	text[(*len)++] = ']';
+	return text;
+}
+
+int main(void)
+{
+	size_t len = 0;
+	char *text = make_events(&len);
+	size_t iterations = (size_t)(TOTAL_BYTES / len) + 1;
+	struct json_doc doc;
+	u64 nodes = 0;
+	u64 start = bench_start();
+
+	for (size_t i = 0; i < iterations; i++) {
+		if (json_parse(&doc, text, len) != 0) {
+			return 1;
+		}
+
+		nodes += doc.count;
+		json_destroy(&doc);
+	}
+
+	bench_report("json_parse, event records", nodes, iterations * len,
+		     get_nanoseconds() - start);
+	free(text);
+	return 0;
+}
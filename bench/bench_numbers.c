@@ -0,0 +1,136 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "bench.h"
+
+#define VALUES 4096
+#define ROUNDS 512
+
+static double values[VALUES];
+static u64 integers[VALUES];
+static char doubles_text[VALUES][FORMAT_NUMBER_MAX];
+static char integers_text[VALUES][FORMAT_NUMBER_MAX];
+
+/* Doubles with a few digits, like measurements, and integers of every
+ * length */
+static void make_values(void)
+{
+	u64 state = 1;
+
+	for (size_t i = 0; i < VALUES; i++) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		values[i] = (double)(state >> 44) / 1000.0;
+		integers[i] = state >> (state % 64);
+		(void)format_f64(values[i], doubles_text[i]);
+		(void)format_u64(integers[i], integers_text[i]);
+	}
+}
+
+static void bench_parse_f64(int libc)
+{
+	double sum = 0;
+	u64 start = bench_start();
+
+	for (size_t r = 0; r < ROUNDS; r++) {
+		for (size_t i = 0; i < VALUES; i++) {
+			double value = 0;
+
+			if (libc) {
+				value = strtod(doubles_text[i], NULL);
+			} else {
+				(void)parse_f64(str_view_cstr(doubles_text[i]),
+						&value);
+			}
+
+			sum += value;
+		}
+	}
+
+	bench_report(libc ? "strtod" : "parse_f64", (u64)VALUES * ROUNDS, 0,
+		     get_nanoseconds() - start);
+	(void)sum;
+}
+
+static void bench_format_f64(int libc)
+{
+	char text[FORMAT_NUMBER_MAX];
+	u64 bytes = 0;
+	u64 start = bench_start();
+
+	for (size_t r = 0; r < ROUNDS; r++) {
+		for (size_t i = 0; i < VALUES; i++) {
+			if (libc) {
+				bytes += (u64)snprintf(text, sizeof(text), "%.17g",
+						       values[i]);
+			} else {
+				bytes += format_f64(values[i], text);
+			}
+		}
+	}
+
+	bench_report(libc ? "snprintf %.17g" : "format_f64",
+		     (u64)VALUES * ROUNDS, 0, get_nanoseconds() - start);
+	(void)bytes;
+}
+
+static void bench_parse_u64(int libc)
+{
+	u64 sum = 0;
+	u64 start = bench_start();
+
+	for (size_t r = 0; r < ROUNDS; r++) {
+		for (size_t i = 0; i < VALUES; i++) {
+			u64 value = 0;
+
+			if (libc) {
+				value = strtoull(integers_text[i], NULL, 10);
+			} else {
+				(void)parse_u64(str_view_cstr(integers_text[i]),
+						&value);
+			}
+
+			sum += value;
+		}
+	}
+
+	bench_report(libc ? "strtoull" : "parse_u64", (u64)VALUES * ROUNDS, 0,
+		     get_nanoseconds() - start);
+	(void)sum;
+}
+
+static void bench_format_u64(int libc)
+{
+	char text[FORMAT_NUMBER_MAX];
+	u64 bytes = 0;
+	u64 start = bench_start();
+
+	for (size_t r = 0; r < ROUNDS; r++) {
+		for (size_t i = 0; i < VALUES; i++) {
+			if (libc) {
+				bytes += (u64)snprintf(
+					text, sizeof(text), "%llu",
+					(unsigned long long)integers[i]);
+			} else {
+				bytes += format_u64(integers[i], text);
+			}
+		}
+	}
+
+	bench_report(libc ? "snprintf %llu" : "format_u64",
+		     (u64)VALUES * ROUNDS, 0, get_nanoseconds() - start);
+	(void)bytes;
+}
+
+int main(void)
+{
+	make_values();
+
+	bench_parse_f64(1);
+	bench_parse_f64(0);
+	bench_format_f64(1);
+	bench_format_f64(0);
+	bench_parse_u64(1);
+	bench_parse_u64(0);
+	bench_format_u64(1);
+	bench_format_u64(0);
+	return 0;
+}
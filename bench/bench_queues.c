@@ -0,0 +1,217 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "bench.h"
+
+#include <sched.h>
+
+#define ITEMS (1 << 22)
+#define ROUND_TRIPS (1 << 16)
+#define CAPACITY 1024
+#define BATCH 64
+
+struct spsc_bench {
+	struct spsc_ring *ring;
+	struct spsc_ring *reply;
+	size_t batch;
+};
+
+/* Items are the integers 1..ITEMS cast to pointers, so null never shows up */
+static void *spsc_consumer(void *arg)
+{
+	struct spsc_bench *b = (struct spsc_bench *)arg;
+	void *items[BATCH];
+	uintptr_t expected = 1;
+
+	while (expected <= ITEMS) {
+		size_t n = spsc_ring_pop_n(b->ring, items, b->batch);
+
+		if (n == 0) {
+			sched_yield();
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			if ((uintptr_t)items[i] != expected++) {
+				panicf("spsc_ring: out of order item\n");
+			}
+		}
+	}
+
+	return NULL;
+}
+
+static void bench_spsc_throughput(size_t batch)
+{
+	struct spsc_bench b;
+	pthread_t consumer;
+	void *items[BATCH];
+	uintptr_t next = 1;
+	char name[64];
+	u64 start = 0;
+
+	b.ring = spsc_ring_create(CAPACITY);
+	b.batch = batch;
+	start = bench_start();
+	pthread_create(&consumer, NULL, spsc_consumer, &b);
+
+	while (next <= ITEMS) {
+		size_t n = MIN(batch, ITEMS - next + 1);
+		size_t pushed = 0;
+
+		for (size_t i = 0; i < n; i++) {
+			items[i] = (void *)(next + i);
+		}
+
+		pushed = spsc_ring_push_n(b.ring, items, n);
+		if (pushed == 0) {
+			sched_yield();
+		}
+
+		next += pushed;
+	}
+
+	pthread_join(consumer, NULL);
+	(void)snprintf(name, sizeof(name), "spsc_ring throughput, batch %zu",
+		       batch);
+	bench_report(name, ITEMS, 0, get_nanoseconds() - start);
+	spsc_ring_destroy(b.ring);
+}
+
+static void *spsc_echo(void *arg)
+{
+	struct spsc_bench *b = (struct spsc_bench *)arg;
+	void *item = NULL;
+
+	for (size_t i = 0; i < ROUND_TRIPS; i++) {
+		while (spsc_ring_pop(b->ring, &item) != 0) {
+			sched_yield();
+		}
+
+		while (spsc_ring_push(b->reply, item) != 0) {
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+static void bench_spsc_latency(void)
+{
+	struct spsc_bench b;
+	pthread_t echo;
+	void *item = NULL;
+	u64 start = 0;
+
+	b.ring = spsc_ring_create(CAPACITY);
+	b.reply = spsc_ring_create(CAPACITY);
+	pthread_create(&echo, NULL, spsc_echo, &b);
+	start = bench_start();
+
+	for (size_t i = 0; i < ROUND_TRIPS; i++) {
+		while (spsc_ring_push(b.ring, &b) != 0) {
+			sched_yield();
+		}
+
+		while (spsc_ring_pop(b.reply, &item) != 0) {
+			sched_yield();
+		}
+	}
+
+	/* Two hops per round trip */
+	bench_report("spsc_ring one-way latency", 2 * ROUND_TRIPS, 0,
+		     get_nanoseconds() - start);
+	pthread_join(echo, NULL);
+	spsc_ring_destroy(b.reply);
+	spsc_ring_destroy(b.ring);
+}
+
+struct mpmc_bench {
+	struct mpmc_queue *queue;
+	size_t items;
+	uintptr_t sum;
+};
+
+static void *mpmc_producer(void *arg)
+{
+	struct mpmc_bench *b = (struct mpmc_bench *)arg;
+
+	for (uintptr_t i = 1; i <= b->items; i++) {
+		while (mpmc_queue_push(b->queue, (void *)i) != 0) {
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+static void *mpmc_consumer(void *arg)
+{
+	struct mpmc_bench *b = (struct mpmc_bench *)arg;
+	void *item = NULL;
+
+	for (size_t i = 0; i < b->items; i++) {
+		while (mpmc_queue_pop(b->queue, &item) != 0) {
+			sched_yield();
+		}
+
+		b->sum += (uintptr_t)item;
+	}
+
+	return NULL;
+}
+
+static void bench_mpmc(size_t threads)
+{
+	struct mpmc_bench producers[8];
+	struct mpmc_bench consumers[8];
+	pthread_t ids[16];
+	struct mpmc_queue *queue = mpmc_queue_create(CAPACITY);
+	size_t per_thread = ITEMS / threads;
+	uintptr_t sum = 0;
+	char name[64];
+	u64 start = bench_start();
+
+	for (size_t i = 0; i < threads; i++) {
+		producers[i].queue = queue;
+		producers[i].items = per_thread;
+		consumers[i].queue = queue;
+		consumers[i].items = per_thread;
+		consumers[i].sum = 0;
+		pthread_create(&ids[i], NULL, mpmc_producer, &producers[i]);
+		pthread_create(&ids[threads + i], NULL, mpmc_consumer,
+			       &consumers[i]);
+	}
+
+	for (size_t i = 0; i < 2 * threads; i++) {
+		pthread_join(ids[i], NULL);
+	}
+
+	for (size_t i = 0; i < threads; i++) {
+		sum += consumers[i].sum;
+	}
+
+	if (sum != threads * (per_thread * (per_thread + 1) / 2)) {
+		panicf("mpmc_queue: lost or duplicated items\n");
+	}
+
+	(void)snprintf(name, sizeof(name),
+		       "mpmc_queue throughput, %zu producers/consumers",
+		       threads);
+	bench_report(name, per_thread * threads, 0,
+		     get_nanoseconds() - start);
+	mpmc_queue_destroy(queue);
+}
+
+int main(void)
+{
+	size_t threads[] = { 1, 2, 4, 8 };
+
+	bench_spsc_throughput(1);
+	bench_spsc_throughput(BATCH);
+	bench_spsc_latency();
+
+	for (size_t i = 0; i < ARRAY_LENGTH(threads); i++) {
+		bench_mpmc(threads[i]);
+	}
+
+	return 0;
+}
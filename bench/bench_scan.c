@@ -0,0 +1,126 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "bench.h"
+
+#define BUF_BYTES (1 << 20)
+#define TOTAL_BYTES (1ULL << 30)
+
+/* Text with a newline every 80 bytes on average and a terminator at the end,
+ * like a file from load_file */
+static char *make_text(void)
+{
+	char *text = (char *)malloc_try(BUF_BYTES + 1);
+	u64 state = 1;
+
+	for (size_t i = 0; i < BUF_BYTES; i++) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		text[i] = (state >> 57) < 2 ? '\n' : (char)('a' + (state >> 59));
+	}
+
+	text[BUF_BYTES] = '\0';
+	return text;
+}
+
+static void bench_lines(const char *text, int libc)
+{
+	size_t iterations = TOTAL_BYTES / BUF_BYTES;
+	u64 lines = 0;
+	u64 start = bench_start();
+
+	for (size_t i = 0; i < iterations; i++) {
+		size_t offset = 0;
+
+		while (offset < BUF_BYTES) {
+			const char *hit = NULL;
+
+			if (libc) {
+				hit = (const char *)memchr(text + offset, '\n',
+							   BUF_BYTES - offset);
+				offset = hit != NULL ? (size_t)(hit - text) :
+						       BUF_BYTES;
+			} else {
+				offset += scan_byte(text + offset,
+						    BUF_BYTES - offset, '\n');
+			}
+
+			offset++;
+			lines++;
+		}
+	}
+
+	bench_report(libc ? "memchr, line by line" : "scan_byte, line by line",
+		     lines, TOTAL_BYTES, get_nanoseconds() - start);
+}
+
+static void bench_line_iter(const char *text)
+{
+	size_t iterations = TOTAL_BYTES / BUF_BYTES;
+	u64 lines = 0;
+	u64 start = bench_start();
+
+	for (size_t i = 0; i < iterations; i++) {
+		struct line_iter iter;
+		struct str_view line;
+
+		line_iter_init(&iter, text, BUF_BYTES);
+
+		while (line_iter_next(&iter, &line)) {
+			lines++;
+		}
+	}
+
+	bench_report("line_iter", lines, TOTAL_BYTES,
+		     get_nanoseconds() - start);
+}
+
+static void bench_whole(const char *text)
+{
+	size_t iterations = TOTAL_BYTES / BUF_BYTES;
+	volatile size_t sink = 0;
+	u64 start = bench_start();
+
+	for (size_t i = 0; i < iterations; i++) {
+		sink += count_byte(text + (i & 15), BUF_BYTES - 16, '\n');
+	}
+
+	bench_report("count_byte", iterations, TOTAL_BYTES,
+		     get_nanoseconds() - start);
+	start = bench_start();
+
+	for (size_t i = 0; i < iterations; i++) {
+		sink += scan_any(text + (i & 15), BUF_BYTES - 16, "\"\\,:;=",
+				 6);
+	}
+
+	bench_report("scan_any, 6 bytes", iterations, TOTAL_BYTES,
+		     get_nanoseconds() - start);
+	start = bench_start();
+
+	for (size_t i = 0; i < iterations; i++) {
+		sink += scan_strlen(text + (i & 15));
+	}
+
+	bench_report("scan_strlen", iterations, TOTAL_BYTES,
+		     get_nanoseconds() - start);
+	start = bench_start();
+
+	for (size_t i = 0; i < iterations; i++) {
+		sink += strlen(text + (i & 15));
+	}
+
+	bench_report("strlen", iterations, TOTAL_BYTES,
+		     get_nanoseconds() - start);
+	(void)sink;
+}
+
+int main(void)
+{
+	char *text = make_text();
+
+	bench_lines(text, 0);
+	bench_lines(text, 1);
+	bench_line_iter(text);
+	bench_whole(text);
+	free(text);
+	return 0;
+}
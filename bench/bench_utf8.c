@@ -0,0 +1,124 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "bench.h"
+
+#define BUF_BYTES (1 << 20)
+#define TOTAL_BYTES (1ULL << 30)
+
+/* ASCII text, text where one character in four is from Greek, CJK or the
+ * emoji, so every sequence length shows up, or Greek words between spaces */
+static char *make_text(int kind, size_t *len)
+{
+	char *text = (char *)malloc_try(BUF_BYTES + 4);
+	u64 state = 1;
+	size_t n = 0;
+
+	while (n < BUF_BYTES) {
+		u32 cp = 0;
+
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		cp = 'a' + (u32)(state >> 60);
+
+		if (kind == 2) {
+			cp = 0x3b1 + (u32)(state >> 59);
+
+			if ((state >> 56 & 7) == 0) {
+				cp = ' ';
+			}
+		} else if (kind == 1) {
+			switch (state >> 56 & 15) {
+			case 0:
+			case 1:
+				cp = 0x3b1 + (u32)(state >> 59);
+				break;
+			case 2:
+				cp = 0x4e00 + (u32)(state >> 50);
+				break;
+			case 3:
+				cp = 0x1f600 + (u32)(state >> 59);
+				break;
+			default:
+				break;
+			}
+		}
+
+		n += utf32_to_utf8(&cp, 1, text + n);
+	}
+
+	*len = n;
+	return text;
+}
+
+static void bench_validate(const char *name, const char *text, size_t len,
+			   int copy)
+{
+	/* Called through a volatile pointer so the copy is not elided */
+	void *(*volatile copy_bytes)(void *, const void *, size_t) = memcpy;
+	char *dst = (char *)malloc_try(len);
+	size_t iterations = TOTAL_BYTES / len;
+	int result = 0;
+	u64 start = bench_start();
+
+	for (size_t i = 0; i < iterations; i++) {
+		if (copy) {
+			(void)copy_bytes(dst, text, len);
+		} else {
+			result |= utf8_validate(text, len);
+		}
+	}
+
+	bench_report(name, iterations, (u64)iterations * len,
+		     get_nanoseconds() - start);
+	(void)result;
+	free(dst);
+}
+
+static void bench_transcode(const char *name, const char *text, size_t len)
+{
+	u16 *utf16 = (u16 *)malloc_try(utf16_length_from_utf8(text, len) *
+				       sizeof(u16));
+	char *back = (char *)malloc_try(len);
+	size_t iterations = TOTAL_BYTES / len / 8;
+	size_t units = 0;
+	u64 start = bench_start();
+
+	for (size_t i = 0; i < iterations; i++) {
+		units = utf8_to_utf16(text, len, utf16);
+	}
+
+	bench_report(name, iterations, (u64)iterations * len,
+		     get_nanoseconds() - start);
+
+	start = bench_start();
+
+	for (size_t i = 0; i < iterations; i++) {
+		(void)utf16_to_utf8(utf16, units, back);
+	}
+
+	bench_report("  and back", iterations, (u64)iterations * len,
+		     get_nanoseconds() - start);
+	free(back);
+	free(utf16);
+}
+
+int main(void)
+{
+	size_t ascii_len = 0;
+	size_t mixed_len = 0;
+	size_t greek_len = 0;
+	char *ascii = make_text(0, &ascii_len);
+	char *mixed = make_text(1, &mixed_len);
+	char *greek = make_text(2, &greek_len);
+
+	bench_validate("memcpy ascii", ascii, ascii_len, 1);
+	bench_validate("utf8_validate ascii", ascii, ascii_len, 0);
+	bench_validate("utf8_validate mixed", mixed, mixed_len, 0);
+	bench_transcode("utf8_to_utf16 ascii", ascii, ascii_len);
+	bench_transcode("utf8_to_utf16 mixed", mixed, mixed_len);
+	bench_transcode("utf8_to_utf16 greek", greek, greek_len);
+
+	free(greek);
+	free(mixed);
+	free(ascii);
+	return 0;
+}
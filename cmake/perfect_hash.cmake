@@ -0,0 +1,21 @@
+# add_perfect_hash(<target> <name> <keys file>)
+#
+# Generates <name>.h for <target> from a file of keys, one per line, with a
+# minimal perfect hash over them and a function
+#   long <name>_lookup(const char *key, size_t len)
+# returning the position of a key in the file, or -1 for other keys.
+function(add_perfect_hash target name keys)
+  get_filename_component(keys "${keys}" ABSOLUTE)
+  set(output "${CMAKE_CURRENT_BINARY_DIR}/${name}.h")
+
+  add_custom_command(
+    OUTPUT "${output}"
+    COMMAND mphf_gen "${name}" "${keys}" "${output}"
+    DEPENDS mphf_gen "${keys}"
+    COMMENT "Generating perfect hash ${name}.h"
+    VERBATIM
+  )
+
+  target_sources(${target} PRIVATE "${output}")
+  target_include_directories(${target} PRIVATE "${CMAKE_CURRENT_BINARY_DIR}")
+endfunction()
@@ -0,0 +1,72 @@
+# Profile-guided optimization with GCC or Clang, selected by LAZ_PGO:
+#   GENERATE  instrument the build to write profiles to LAZ_PGO_DIR
+#   USE       optimize with the profiles found there
+#
+# The `pgo` target runs the whole pipeline in <build>/pgo: an instrumented
+# Release build, with LTO if LAZ_LTO is on, training on the benchmarks and on
+# the hashing tool over the source tree, then a rebuild with the profiles.
+# GCC matches profiles to object files by path, hence one build directory for
+# both stages. Building the bench target there afterwards measures the result.
+set(LAZ_PGO OFF CACHE STRING "Profile-guided optimization: OFF, GENERATE or USE")
+set_property(CACHE LAZ_PGO PROPERTY STRINGS OFF GENERATE USE)
+set(LAZ_PGO_DIR "${CMAKE_BINARY_DIR}/pgo-profiles" CACHE PATH
+  "Where profiles are written and read")
+
+function(enable_pgo)
+  if(LAZ_PGO STREQUAL "OFF")
+    return()
+  endif()
+
+  if(NOT CMAKE_C_COMPILER_ID MATCHES "GNU|Clang")
+    message(WARNING "Profile-guided optimization needs GCC or Clang")
+    return()
+  endif()
+
+  if(LAZ_PGO STREQUAL "GENERATE")
+    # Atomic updates keep the counts of the worker threads exact
+    set(flags "-fprofile-generate=${LAZ_PGO_DIR} -fprofile-update=atomic")
+  elseif(LAZ_PGO STREQUAL "USE")
+    if(CMAKE_C_COMPILER_ID STREQUAL "GNU")
+      set(flags "-fprofile-use=${LAZ_PGO_DIR} -fprofile-correction -Wno-missing-profile")
+    else()
+      set(flags "-fprofile-use=${LAZ_PGO_DIR}/merged.profdata -Wno-profile-instr-unprofiled")
+    endif()
+  else()
+    message(FATAL_ERROR "LAZ_PGO must be OFF, GENERATE or USE")
+  endif()
+
+  message(STATUS "Profile-guided optimization: ${LAZ_PGO} in ${LAZ_PGO_DIR}")
+  set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} ${flags}" PARENT_SCOPE)
+endfunction()
+
+function(add_pgo_target)
+  set(dir "${CMAKE_BINARY_DIR}/pgo")
+  set(profiles "${dir}/profiles")
+  set(configure ${CMAKE_COMMAND} -S "${CMAKE_SOURCE_DIR}" -B "${dir}"
+    -DCMAKE_BUILD_TYPE=Release -DLAZ_LTO=${LAZ_LTO} -DLAZ_PGO_DIR=${profiles})
+  set(merge "")
+
+  if(CMAKE_C_COMPILER_ID STREQUAL "Clang")
+    find_program(LLVM_PROFDATA NAMES llvm-profdata)
+    if(NOT LLVM_PROFDATA)
+      message(STATUS "llvm-profdata not found, no pgo target")
+      return()
+    endif()
+    set(merge COMMAND sh -c
+      "\"${LLVM_PROFDATA}\" merge -o \"${profiles}/merged.profdata\" \"${profiles}\"/*.profraw")
+  endif()
+
+  add_custom_target(pgo
+    COMMAND ${CMAKE_COMMAND} -E remove_directory "${profiles}"
+    COMMAND ${configure} -DLAZ_PGO=GENERATE
+    COMMAND ${CMAKE_COMMAND} --build "${dir}"
+    COMMAND ${CMAKE_COMMAND} --build "${dir}" --target bench
+    COMMAND sh -c "\"${dir}/${PROJECT_NAME}\" -q \"${CMAKE_SOURCE_DIR}\" > /dev/null"
+    COMMAND sh -c "\"${dir}/${PROJECT_NAME}\" -q -d \"${CMAKE_SOURCE_DIR}\" > /dev/null"
+    ${merge}
+    COMMAND ${configure} -DLAZ_PGO=USE
+    COMMAND ${CMAKE_COMMAND} --build "${dir}"
+    COMMENT "Building with profile-guided optimization in ${dir}"
+    VERBATIM
+  )
+endfunction()
@@ -1,6 +1,8 @@
 # TODO: turn into expression generators
 # Use /RTCcsu on MSVC
 
+# Sanitizers only instrument the Debug configuration, so that Release and the
+# other optimized builds run at full speed
 function(enable_sanitizers)
   include(CheckCSourceCompiles)
 
@@ -11,19 +13,19 @@ function(enable_sanitizers)
   check_c_source_compiles("int main() { return 0; }" HAVE_LIBUBSAN)
 
   if(HAVE_LIBASAN)
-    set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -fsanitize=address")
-    message(STATUS "AddressSanitizer enabled")
+    set(CMAKE_C_FLAGS_DEBUG "${CMAKE_C_FLAGS_DEBUG} -fsanitize=address")
+    message(STATUS "AddressSanitizer enabled in Debug builds")
   else()
     message(WARNING "AddressSanitizer not available")
   endif()
 
   if(HAVE_LIBUBSAN)
-    set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -fsanitize=undefined")
-    message(STATUS "UndefinedBehaviorSanitizer enabled")
+    set(CMAKE_C_FLAGS_DEBUG "${CMAKE_C_FLAGS_DEBUG} -fsanitize=undefined")
+    message(STATUS "UndefinedBehaviorSanitizer enabled in Debug builds")
   else()
     message(WARNING "UndefinedBehaviorSanitizer not available")
   endif()
 
   # Now update parent with the accumulated flags
-  set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS}" PARENT_SCOPE)
+  set(CMAKE_C_FLAGS_DEBUG "${CMAKE_C_FLAGS_DEBUG}" PARENT_SCOPE)
 endfunction()
@@ -12,8 +12,27 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+/* POSIX.1-2008 functionality: threads, file descriptors, memory mapping */
+#if (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L) || \
+	defined(__APPLE__)
+#define LAZ_POSIX
+#include <pthread.h>
+#include <sys/types.h>
+#endif
+
+/* Lock-free structures use <stdatomic.h> in C11 and <atomic> in C++11 */
+#if defined(__cplusplus) || \
+	(__STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__))
+#define LAZ_ATOMICS
+#endif
+
 #define ARRAY_LENGTH(x) (sizeof(x) / sizeof((x)[0]))
 
 /* WARNING: these macros evaluate their input twice, so if you call
@@ -22,6 +41,10 @@
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 #define CLAMP(n, min, max) ((n) < (min) ? (min) : (n) > (max) ? (max) : (n))
 
+/* Assumed size of a cache line, used to keep data written by different threads
+ * apart */
+#define LAZ_CACHE_LINE 64
+
 #if defined(__GNUC__) || defined(__clang__)
 #define unlikely(expr) __builtin_expect(!!(expr), 0)
 #define likely(expr) __builtin_expect(!!(expr), 1)
@@ -78,6 +101,15 @@ u32 fnv1a_32_buf(const void *buf, size_t len);
 u32 fnv1a_32_str(const char *str);
 u64 fnv1a_64_buf(const void *buf, size_t len);
 u64 fnv1a_64_str(const char *str);
+/* CRC-32C (Castagnoli), using the SSE4.2 or ARMv8 CRC instructions when the
+ * CPU has them. `crc32c_update` continues from a previous result, starting
+ * from 0. */
+u32 crc32c_buf(const void *buf, size_t len);
+u32 crc32c_update(u32 crc, const void *buf, size_t len);
+/* Non-cryptographic 64-bit hash in the style of wyhash, several times faster
+ * than FNV-1a on anything but tiny keys. Output is the same on every
+ * platform. */
+u64 fast_hash_64(const void *buf, size_t len, u64 seed);
 /* These functions will perror and EXIT_FAILURE if no memory is returned */
 void *malloc_try(size_t size);
 void *calloc_try(size_t n, size_t size);
@@ -86,8 +118,786 @@ void *realloc_try(void *ptr, size_t size);
 void *reallocarray_try(void *ptr, size_t n, size_t size);
 #endif
 
+/* Byte scanning with SSE2, AVX2 or NEON, picked at runtime where needed. The
+ * scan functions return the offset of the first match, or `len` if none. */
+size_t scan_byte(const void *buf, size_t len, unsigned char byte);
+/* First byte that is any of the `set_len` bytes of `set`. Sets of up to 16
+ * bytes are scanned with SIMD, larger ones byte by byte. */
+size_t scan_any(const void *buf, size_t len, const void *set, size_t set_len);
+size_t count_byte(const void *buf, size_t len, unsigned char byte);
+/* Same as strlen. Reads whole aligned blocks, which may go past the
+ * terminator but never into another page. */
+size_t scan_strlen(const char *str);
+
+/* Borrowed bytes, not null-terminated. Views never own their data and stay
+ * valid only as long as the buffer they point into. */
+struct str_view {
+	const char *data;
+	size_t len;
+};
+
+struct str_view str_view_from(const char *data, size_t len);
+struct str_view str_view_cstr(const char *str);
+int str_view_eq(struct str_view a, struct str_view b);
+int str_view_eq_cstr(struct str_view a, const char *str);
+
+/* Longest contents kept inside the string itself, without allocating */
+#define STR_INLINE_MAX 22
+
+/* Owned, null-terminated bytes that may contain nulls. Contents up to
+ * STR_INLINE_MAX bytes are stored inline; longer ones on the heap, whose
+ * capacity at least doubles as they grow. A string holds no pointer into
+ * itself, so it can be moved with memcpy or by assignment, but not copied:
+ * the copies would share the heap buffer. Fields are private. */
+struct str {
+	/* FNV-1a 64 of the contents, valid while flagged in the last byte */
+	u64 hash;
+	union {
+		/* The capacity is stored in front of `data` */
+		struct {
+			char *data;
+			size_t len;
+		} heap;
+		/* The last byte holds the flags, and the length while inline */
+		char bytes[STR_INLINE_MAX + 2];
+	} u;
+};
+
+void str_init(struct str *s, const char *data, size_t len);
+void str_init_cstr(struct str *s, const char *str);
+void str_destroy(struct str *s);
+/* Always null-terminated. Invalidated by anything that changes `s`. */
+const char *str_data(const struct str *s);
+size_t str_len(const struct str *s);
+/* Length `s` can reach without allocating */
+size_t str_capacity(const struct str *s);
+struct str_view str_as_view(const struct str *s);
+/* Makes room for `len` bytes of contents without further allocation */
+void str_reserve(struct str *s, size_t len);
+/* Empties `s` but keeps its heap buffer for reuse */
+void str_clear(struct str *s);
+void str_append(struct str *s, const char *data, size_t len);
+void str_append_cstr(struct str *s, const char *str);
+void str_append_char(struct str *s, char c);
+/* Hash computed on first use and kept until `s` changes */
+u64 str_hash(struct str *s);
+/* Compares cached hashes first, when both strings have one */
+int str_eq(const struct str *a, const struct str *b);
+
+/* Lines of a buffer, without their "\n" or "\r\n". A last line without a
+ * newline is still returned, but a trailing newline does not add an empty
+ * line. The buffer is never written to. */
+struct line_iter {
+	const char *pos;
+	const char *end;
+};
+
+void line_iter_init(struct line_iter *iter, const void *buf, size_t len);
+/* Returns 1 and sets `line`, or 0 once all lines are read */
+int line_iter_next(struct line_iter *iter, struct str_view *line);
+
+/* Fields of a view separated by any of up to 16 delimiter bytes. Empty fields
+ * are kept, so `n` delimiters always give `n + 1` fields. */
+struct field_iter {
+	const char *pos;
+	const char *end;
+	unsigned char delims[16];
+	size_t delim_count;
+	int done;
+};
+
+/* Returns 0 on success and -1 if `delim_count` is 0 or over 16 */
+int field_iter_init(struct field_iter *iter, struct str_view str,
+		    const char *delims, size_t delim_count);
+/* Returns 1 and sets `field`, or 0 once all fields are read */
+int field_iter_next(struct field_iter *iter, struct str_view *field);
+
+/* Locale-free numbers. The parsers read the whole view and return 0 on
+ * success, or -1 if it is not a number or does not fit the type. Integers are
+ * an optional sign and decimal digits. Doubles also take a fraction, an
+ * exponent, "inf", "infinity" and "nan", like strtod in the C locale without
+ * hex or leading spaces, and are always correctly rounded. */
+int parse_u64(struct str_view text, u64 *out);
+int parse_u32(struct str_view text, u32 *out);
+int parse_u16(struct str_view text, u16 *out);
+int parse_u8(struct str_view text, u8 *out);
+int parse_i64(struct str_view text, i64 *out);
+int parse_i32(struct str_view text, i32 *out);
+int parse_i16(struct str_view text, i16 *out);
+int parse_i8(struct str_view text, i8 *out);
+int parse_f64(struct str_view text, double *out);
+
+/* Room for any formatted number and its terminator */
+#define FORMAT_NUMBER_MAX 32
+
+/* Write `value` and a terminator to `out`, which needs FORMAT_NUMBER_MAX
+ * bytes, and return the length. Smaller integer types convert implicitly.
+ * Doubles get the fewest digits that parse back to the same value, closest
+ * to it on ties, in plain notation for exponents from -6 to 20 and
+ * scientific ("1e+21") otherwise. */
+size_t format_u64(u64 value, char *out);
+size_t format_i64(i64 value, char *out);
+size_t format_f64(double value, char *out);
+
+/* Growable output bytes, for log lines and data alike. Numbers are formatted
+ * straight into the buffer, and printf-style text with vsnprintf into its
+ * free space, so neither goes through a temporary or a locked FILE. */
+struct out_buf {
+	char *data;
+	size_t len;
+	size_t cap;
+};
+
+void out_buf_init(struct out_buf *buf, size_t cap);
+void out_buf_destroy(struct out_buf *buf);
+/* Returns room for `len` more bytes at the end, to be counted by the caller
+ * in `buf->len` once written */
+char *out_buf_reserve(struct out_buf *buf, size_t len);
+void out_buf_append(struct out_buf *buf, const void *data, size_t len);
+void out_buf_append_cstr(struct out_buf *buf, const char *str);
+void out_buf_append_char(struct out_buf *buf, char c);
+void out_buf_append_u64(struct out_buf *buf, u64 value);
+void out_buf_append_i64(struct out_buf *buf, i64 value);
+void out_buf_append_f64(struct out_buf *buf, double value);
+/* Lowercase hex, zero-padded to at least `width` digits */
+void out_buf_append_hex(struct out_buf *buf, u64 value, unsigned width);
+/* Same formats as printf. Returns the length appended, or -1 on a format
+ * error, which leaves `buf` unchanged. */
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((format(printf, 2, 3)))
+#endif
+int out_buf_printf(struct out_buf *buf, const char *LAZ_RESTRICT format, ...);
+int out_buf_vprintf(struct out_buf *buf, const char *LAZ_RESTRICT format,
+		    va_list args);
+#ifdef LAZ_POSIX
+/* Writes the contents of `count` buffers to `fd`, in order, with as few
+ * writev calls as partial writes allow, and empties them. Returns 0 on
+ * success, or -1 with errno set and only the bytes not written left in the
+ * buffers. */
+int out_buf_flush(int fd, struct out_buf *bufs, size_t count);
+#endif
+
+/* UTF-8 is valid without overlong forms, surrogates or code points past
+ * U+10FFFF. UTF-16 and UTF-32 are in native byte order. */
+#define UTF_INVALID ((size_t)-1)
+
+/* Returns 0 if `buf` is valid UTF-8 and -1 otherwise. AVX2 and NEON check
+ * 32 or 16 bytes at a time with the lookup tables of Keiser and Lemire. */
+int utf8_validate(const void *buf, size_t len);
+/* Code units the transcoders below write for valid input, counted without
+ * decoding. Buffers of that size are enough for any input. */
+size_t utf16_length_from_utf8(const void *buf, size_t len);
+size_t utf32_length_from_utf8(const void *buf, size_t len);
+size_t utf8_length_from_utf16(const u16 *in, size_t len);
+size_t utf8_length_from_utf32(const u32 *in, size_t len);
+/* Return the code units written, or UTF_INVALID on invalid input, lone
+ * surrogates included, leaving `out` partly written */
+size_t utf8_to_utf16(const void *buf, size_t len, u16 *out);
+size_t utf8_to_utf32(const void *buf, size_t len, u32 *out);
+size_t utf16_to_utf8(const u16 *in, size_t len, char *out);
+size_t utf32_to_utf8(const u32 *in, size_t len, char *out);
+
+/* JSON parsed in two stages: a SIMD pass indexes the structural bytes, with
+ * quotes and escapes resolved 64 bytes at a time, then a pass over the index
+ * builds a flat DOM of nodes in document order. Nodes refer to the parsed
+ * bytes, which must outlive the document, and are named by their index, the
+ * root being 0. Documents are limited to 4 GiB. */
+enum json_type {
+	JSON_NULL,
+	JSON_FALSE,
+	JSON_TRUE,
+	JSON_NUMBER,
+	JSON_STRING,
+	JSON_ARRAY,
+	JSON_OBJECT
+};
+
+#define JSON_NONE ((size_t)-1)
+
+struct json_node {
+	u32 type;
+	/* Strings span their contents without the quotes, still escaped.
+	 * Containers span their brackets. */
+	u32 offset;
+	u32 len;
+	/* Elements of an array or members of an object. The children of an
+	 * object alternate between key and value. */
+	u32 count;
+	/* The node after this one and its children */
+	u32 next;
+};
+
+struct json_doc {
+	const char *data;
+	struct json_node *nodes;
+	size_t count;
+	size_t cap;
+};
+
+/* Returns 0 on success and -1 on malformed JSON. String contents are only
+ * checked by json_unescape. */
+int json_parse(struct json_doc *doc, const char *data, size_t len);
+void json_destroy(struct json_doc *doc);
+struct str_view json_text(const struct json_doc *doc, size_t node);
+/* Value of the member of `object` whose key is `key`, compared without
+ * unescaping, or JSON_NONE */
+size_t json_find(const struct json_doc *doc, size_t object, const char *key);
+/* Element `i` of `array`, found in O(i), or JSON_NONE */
+size_t json_at(const struct json_doc *doc, size_t array, size_t i);
+/* Return 0 on success and -1 if the node is not a number that fits */
+int json_i64(const struct json_doc *doc, size_t node, i64 *out);
+int json_f64(const struct json_doc *doc, size_t node, double *out);
+/* Writes the UTF-8 contents of the escaped string `raw` to `out`, which needs
+ * `raw.len` bytes. Returns the length written, or JSON_NONE on invalid
+ * escapes and control characters. */
+size_t json_unescape(struct str_view raw, char *out);
+
+/* Number of online processors, at least 1 */
+size_t cpu_count(void);
+
+/* Instruction set extensions the scanning, JSON, UTF-8 and CRC-32C kernels
+ * can use. They are detected once at startup, with cpuid on x86 and the
+ * auxiliary vector on Linux AArch64, and each kernel is then called through
+ * a function pointer set for the best of them. */
+enum cpu_feature {
+	CPU_FEATURE_SSE2 = 1 << 0,
+	CPU_FEATURE_SSE4_2 = 1 << 1,
+	/* Only when the OS also saves the AVX registers */
+	CPU_FEATURE_AVX2 = 1 << 2,
+	CPU_FEATURE_NEON = 1 << 3,
+	/* ARMv8 CRC32 instructions */
+	CPU_FEATURE_CRC32 = 1 << 4
+};
+
+/* Features the kernels use: those detected, less any left out by
+ * `cpu_features_limit` or by the LAZ_CPU environment variable. LAZ_CPU is a
+ * comma-separated list of the features to keep, such as "sse2,sse4.2", or
+ * "none" for the portable code. */
+unsigned cpu_features(void);
+/* Makes the kernels act as if the CPU had only the features in `mask`, to
+ * test or compare the slower paths, and returns the features used before.
+ * LAZ_CPU still applies, so `~0U` restores all the features it allows. Not
+ * safe while other threads run the kernels. */
+unsigned cpu_features_limit(unsigned mask);
+
+#ifdef LAZ_POSIX
+/* Read-only memory mapping of a whole file. Empty files map to a zero `size`
+ * with a valid `data`. */
+struct mapped_file {
+	const char *data;
+	size_t size;
+};
+
+/* Returns 0 on success and -1 on failure */
+int map_file(const char *path, struct mapped_file *out);
+void unmap_file(struct mapped_file *file);
+/* Calls `fn` for every regular file under `root`, or for `root` itself when it
+ * is a regular file. Symbolic links are not followed. Unreadable entries are
+ * reported and skipped without stopping the walk. Returns the first nonzero
+ * value returned by `fn`, which stops the walk, otherwise -1 if `root` or any
+ * entry under it could not be read, otherwise 0. */
+int walk_dir(const char *root,
+	     int (*fn)(const char *path, u64 size, void *ctx), void *ctx);
+
+/* Sequential reader over a window of a file, for files too large to load.
+ * `data` points to the `len` unconsumed bytes starting at file offset
+ * `offset`. Fields are read-only to users. */
+struct file_stream {
+	const char *data;
+	size_t len;
+	u64 offset;
+	int fd;
+	int eof;
+	char *buf;
+	size_t cap;
+};
+
+/* `capacity` bounds how many bytes a fill can make available. Returns 0 on
+ * success and -1 on failure. */
+int file_stream_open(struct file_stream *stream, const char *path,
+		     size_t capacity);
+void file_stream_close(struct file_stream *stream);
+/* Reads until at least `want` bytes are available, `want` being capped to the
+ * capacity, or until the end of the file. Returns the bytes available, which
+ * is 0 only at the end, or -1 on a read error. */
+long file_stream_fill(struct file_stream *stream, size_t want);
+/* Marks `n` available bytes as used */
+void file_stream_consume(struct file_stream *stream, size_t n);
+
+/* Write to a temporary file next to the target, synced and renamed over it on
+ * close, so that readers and crashes see the old contents or all of the new */
+#define FILE_WRITER_ATOMIC 1
+
+/* Blocks of this size unless the writer is opened with another */
+#define FILE_WRITER_BLOCK (1 << 20)
+
+/* Buffered output to a new or truncated file. Writes are gathered into a
+ * page-aligned block, and whatever does not fit goes out with the block in a
+ * single writev. Fields are private. */
+struct file_writer {
+	int fd;
+	int flags;
+	/* Set by the first failed write, after which writes do nothing */
+	int error;
+	char *block;
+	size_t len;
+	size_t cap;
+	/* Bytes written to `fd` */
+	u64 offset;
+	/* Bytes preallocated, the unused part released on close */
+	u64 reserved;
+	char *path;
+	char *tmp_path;
+	void *mem;
+};
+
+/* `block_size` of 0 means FILE_WRITER_BLOCK. A nonzero `size_hint` reserves
+ * that much disk space upfront, which keeps the file contiguous and reports a
+ * full disk early, at no cost where the file system cannot. New files get
+ * mode 0644 when atomic, an existing target keeping its own. Returns 0 on
+ * success and -1 on failure. */
+int file_writer_open(struct file_writer *w, const char *path, int flags,
+		     size_t block_size, u64 size_hint);
+/* Returns 0, or -1 if this or an earlier write failed */
+int file_writer_write(struct file_writer *w, const void *data, size_t len);
+/* Writes what is buffered, then syncs and renames an atomic writer's file.
+ * Returns 0 if all of it succeeded, otherwise -1, and an atomic writer's
+ * target is left as it was. Releases the writer either way. */
+int file_writer_close(struct file_writer *w);
+/* Releases the writer without finishing, removing an atomic writer's
+ * temporary file */
+void file_writer_abort(struct file_writer *w);
+/* Atomically replaces `path` with `len` bytes of `data`. Returns 0 on success
+ * and -1 on failure. */
+int save_file(const char *path, const void *data, size_t len);
+
+/* Contents of a file held by a file_cache. Files of 64 KiB and over are
+ * mapped, smaller ones read into memory and null-terminated. */
+struct cached_file {
+	const char *data;
+	size_t size;
+};
+
+/* Files kept in memory by path, the path being hashed with FNV-1a and stored
+ * once per entry. A lookup revalidates its entry with stat, comparing size,
+ * inode and change times, unless the entry was checked less than `check_ns`
+ * nanoseconds ago. Contents are kept within `budget` bytes by evicting the
+ * least recently used files, except that files still held stay in memory
+ * until released. Safe to use from several threads. */
+struct file_cache;
+
+struct file_cache *file_cache_create(size_t budget, u64 check_ns);
+/* Every file obtained must have been released */
+void file_cache_destroy(struct file_cache *cache);
+/* Returns the current contents of `path`, loading them on a miss or a
+ * change, or null if the file cannot be read. The contents stay valid until
+ * passed to file_cache_release, even if the file changes or is evicted
+ * meanwhile. */
+const struct cached_file *file_cache_get(struct file_cache *cache,
+					 const char *path);
+void file_cache_release(struct file_cache *cache,
+			const struct cached_file *file);
+#endif
+
+/* Content-defined chunking (FastCDC): chunk boundaries depend on the bytes
+ * around them rather than on offsets, so an insertion only changes the chunks
+ * near it. In cdc_init, an `avg_size` of 0 selects 8 KiB and a `min_size` or
+ * `max_size` of 0 a quarter or eight times the average. The average is rounded
+ * to a power of two, the minimum is at most half of it and the maximum at least
+ * twice. */
+struct cdc {
+	size_t min_size;
+	size_t avg_size;
+	size_t max_size;
+	/* Boundary masks before and after the average size */
+	u64 mask_small;
+	u64 mask_large;
+	u64 gear[256];
+};
+
+struct cdc_chunk {
+	u64 offset;
+	size_t len;
+	/* fast_hash_64 of the chunk */
+	u64 hash;
+};
+
+void cdc_init(struct cdc *cdc, size_t min_size, size_t avg_size,
+	      size_t max_size);
+/* Length of the chunk starting at `data`. Only call with `len` under
+ * `max_size` at the end of the input. */
+size_t cdc_next(const struct cdc *cdc, const void *data, size_t len);
+/* Calls `fn` for every chunk, in order, and stops early when it returns
+ * nonzero. Returns that value, or 0. */
+int cdc_buf(const struct cdc *cdc, const void *data, size_t len,
+	    int (*fn)(const struct cdc_chunk *chunk, void *ctx), void *ctx);
+#ifdef LAZ_POSIX
+/* Same as cdc_buf over a file read with a file_stream, -1 on read errors */
+int cdc_file(const struct cdc *cdc, const char *path,
+	     int (*fn)(const struct cdc_chunk *chunk, void *ctx), void *ctx);
+#endif
+
+/* Blocked Bloom filter: every probe of a key falls in the same 64-byte block,
+ * so a lookup touches a single cache line. Probes come from fnv1a_64_buf by
+ * double hashing. Adding is not thread-safe, lookups are. */
+struct bloom;
+/* Bits needed to hold `n` keys at a false positive rate of `fp_rate`, and the
+ * number of probes that minimizes it. Blocking makes a filter somewhat worse
+ * than a classic one of the same size, which both account for. */
+u64 bloom_bits_for(u64 n, double fp_rate);
+unsigned bloom_hashes_for(u64 bits, u64 n);
+/* Expected false positive rate once `n` keys are added */
+double bloom_fp_rate(u64 bits, unsigned hashes, u64 n);
+struct bloom *bloom_create(u64 n, double fp_rate);
+void bloom_destroy(struct bloom *bloom);
+u64 bloom_bits(const struct bloom *bloom);
+unsigned bloom_hashes(const struct bloom *bloom);
+void bloom_add(struct bloom *bloom, const void *key, size_t len);
+/* 1 if the key may have been added, 0 if it certainly was not */
+int bloom_contains(const struct bloom *bloom, const void *key, size_t len);
+/* Same as above for keys that already are 64-bit hashes, such as digests */
+void bloom_add_hash(struct bloom *bloom, u64 hash);
+int bloom_contains_hash(const struct bloom *bloom, u64 hash);
+/* The file holds a 64-byte header then the blocks, in native byte order.
+ * Returns 0 on success and -1 on failure. */
+int bloom_save(const struct bloom *bloom, const char *path);
+#ifdef LAZ_POSIX
+/* Maps a file written by bloom_save, null on failure. The filter is read-only:
+ * adding to it is undefined. */
+struct bloom *bloom_load(const char *path);
+#endif
+
+/* HyperLogLog distinct counter with 2^`precision` registers, a standard error
+ * of 1.04 / sqrt(2^precision) and a footprint of as many bytes. It starts
+ * as a sparse list of registers and turns dense once that would be smaller.
+ * Sketches of the same precision merge, so each thread can fill its own. */
+struct hll;
+/* `precision` is clamped to [4, 18], 0 selects 14 (16 KiB, 0.81%) */
+struct hll *hll_create(unsigned precision);
+void hll_destroy(struct hll *hll);
+unsigned hll_precision(const struct hll *hll);
+/* Keys are hashed with fast_hash_64, hll_add_hash takes any 64-bit hash */
+void hll_add(struct hll *hll, const void *key, size_t len);
+void hll_add_hash(struct hll *hll, u64 hash);
+/* Adds the keys of `src` to `dst`. Returns -1 if their precisions differ. */
+int hll_merge(struct hll *dst, const struct hll *src);
+/* Estimated number of distinct keys. May compact a sparse sketch. */
+u64 hll_count(struct hll *hll);
+
+/* Count-Min sketch with conservative update: estimates never undercount, and
+ * overcount by at most 2.72 * total / `width` with probability
+ * 1 - 2.72^-`depth`. `width` is rounded to a power of two, 0 selects 2048,
+ * and `depth` is clamped to [1, 16], 0 selecting 4. Each thread can count into
+ * its own sketch and merge it into a shared one later. */
+struct cms;
+struct cms *cms_create(size_t width, unsigned depth);
+void cms_destroy(struct cms *cms);
+void cms_add(struct cms *cms, const void *key, size_t len, u64 count);
+u64 cms_estimate(const struct cms *cms, const void *key, size_t len);
+/* Keys are hashed with fnv1a_64_buf, these take that hash directly */
+void cms_add_hash(struct cms *cms, u64 hash, u64 count);
+u64 cms_estimate_hash(const struct cms *cms, u64 hash);
+/* Sum of all counts added */
+u64 cms_total(const struct cms *cms);
+/* Returns -1 if the sketches differ in width or depth */
+int cms_merge(struct cms *dst, const struct cms *src);
+
+/* Space-Saving top-K: tracks the `k` most frequent keys in fixed memory. A
+ * key's true count lies in [count - error, count]. Keys longer than
+ * TOP_K_KEY_SIZE are told apart by their full hash but stored truncated. */
+#define TOP_K_KEY_SIZE 48
+
+struct top_k_item {
+	u64 count;
+	u64 error;
+	/* fnv1a_64_buf of the whole key */
+	u64 hash;
+	size_t len;
+	char key[TOP_K_KEY_SIZE];
+};
+
+struct top_k;
+struct top_k *top_k_create(size_t k);
+void top_k_destroy(struct top_k *top);
+void top_k_add(struct top_k *top, const void *key, size_t len, u64 count);
+/* Merges the summary of another thread, which must not be modified
+ * meanwhile */
+void top_k_merge(struct top_k *dst, const struct top_k *src);
+/* Writes up to `k` items to `out`, most frequent first, and returns how
+ * many */
+size_t top_k_list(const struct top_k *top, struct top_k_item *out);
+
+/* Consistent hashing: when the number of buckets or nodes changes, only the
+ * keys that must move do, about 1 / n of them. Keys are 64-bit hashes, such as
+ * fnv1a_64_str of a key. */
+/* Jump consistent hash (Lamping and Veach), the bucket of `key` among
+ * `buckets` numbered ones, in O(log buckets) and no memory. Buckets can only
+ * be added or removed at the end. */
+u32 jump_hash(u64 key, u32 buckets);
+/* Rendezvous (highest random weight) hashing: the index of the node of `key`
+ * among `count` node ids, in O(count). Any node can be removed. */
+size_t rendezvous_hash(u64 key, const u64 *nodes, size_t count);
+
+/* Hash ring with `vnodes` points per node, 0 selecting 128, and O(log n)
+ * lookups. Any node can be added or removed. */
+struct hash_ring;
+struct hash_ring *hash_ring_create(size_t vnodes);
+void hash_ring_destroy(struct hash_ring *ring);
+/* Nodes are ids chosen by the caller. Adding a present node does nothing. */
+void hash_ring_add(struct hash_ring *ring, u64 node);
+void hash_ring_remove(struct hash_ring *ring, u64 node);
+size_t hash_ring_size(const struct hash_ring *ring);
+/* Writes the node of `key` to `node`. Returns -1 if the ring is empty. */
+int hash_ring_lookup(const struct hash_ring *ring, u64 key, u64 *node);
+
+/* Minimal perfect hash (PTHash style) over a fixed set of keys: maps each of
+ * the `count` keys to its own index in [0, count) with one hash and no
+ * probing. Other keys map to an arbitrary index, so lookups compare the key
+ * stored there. Keys are hashed with a seeded fnv1a_64_buf. Tables built at
+ * compile time come from tools/mphf_gen, see cmake/perfect_hash.cmake. */
+struct mphf {
+	u64 seed;
+	size_t count;
+	size_t bucket_count;
+	/* Slightly above `count`, slots past it are remapped below it */
+	size_t table_size;
+	const u32 *pilots;
+	const u32 *remap;
+};
+
+/* Returns 0 on success and -1 if keys repeat */
+int mphf_build(struct mphf *mphf, const char *const *keys,
+	       const size_t *lens, size_t count);
+void mphf_destroy(struct mphf *mphf);
+/* Only call on sets of at least one key */
+size_t mphf_index(const struct mphf *mphf, const void *key, size_t len);
+
+#ifdef LAZ_POSIX
+/* Fixed set of worker threads running submitted tasks in FIFO order. A
+ * `threads` of 0 starts cpu_count() workers. */
+struct thread_pool;
+struct thread_pool *thread_pool_create(size_t threads);
+/* Finishes every queued task, then joins the workers */
+void thread_pool_destroy(struct thread_pool *pool);
+size_t thread_pool_size(const struct thread_pool *pool);
+void thread_pool_submit(struct thread_pool *pool, void (*fn)(void *arg),
+			void *arg);
+/* Blocks until every submitted task has finished */
+void thread_pool_wait(struct thread_pool *pool);
+
+/* Calls `fn` on disjoint [begin, end) subranges covering [0, n) from the
+ * pool's workers and the calling thread, and returns once all have run. A
+ * `grain` of 0 picks the subrange length from `n` and the pool size. A null
+ * pool, or a call from one of the pool's own tasks, runs on the calling thread
+ * only. */
+void parallel_for(struct thread_pool *pool, size_t n, size_t grain,
+		  void (*fn)(size_t begin, size_t end, void *ctx), void *ctx);
+
+/* Combine partial results in subrange order, with subranges that depend only
+ * on `n` and `grain`: the result is identical for any pool size. */
+#define PARALLEL_DETERMINISTIC 0x1
+
+/* `result` points to `result_size` bytes holding the identity on entry and the
+ * reduction on return. Every partial result starts as a copy of the identity,
+ * is accumulated by `map` over subranges, then folded into `result` with
+ * `combine`. Without PARALLEL_DETERMINISTIC there is one partial per thread,
+ * so non-associative reductions such as floating point sums may differ from
+ * run to run. */
+void parallel_reduce(struct thread_pool *pool, size_t n, size_t grain,
+		     void *result, size_t result_size,
+		     void (*map)(size_t begin, size_t end, void *partial,
+				 void *ctx),
+		     void (*combine)(void *dst, const void *src, void *ctx),
+		     void *ctx, int flags);
+
+/* RFC 4180 CSV: rows end with "\n" or "\r\n" and fields may be quoted, with
+ * quotes inside doubled. Quoted fields may hold delimiters and newlines, and a
+ * quote anywhere else is an error. Empty lines are skipped. Every row must
+ * have as many fields as the first. Cells are views into the parsed bytes,
+ * without the surrounding quotes but still with doubled quotes inside. */
+struct csv_table {
+	size_t rows;
+	size_t columns;
+	/* Column-major: the cell at `row` and `column` is
+	 * `cells[column * rows + row]` */
+	struct str_view *cells;
+};
+
+/* Splits `data` into chunks at row boundaries found with a quote-aware scan,
+ * then parses the chunks on `pool`, which may be null. `data` must outlive
+ * the table. Returns 0 on success and -1 on malformed input. */
+int csv_parse(struct csv_table *table, const char *data, size_t len,
+	      char delim, struct thread_pool *pool);
+void csv_destroy(struct csv_table *table);
+struct str_view csv_cell(const struct csv_table *table, size_t row,
+			 size_t column);
+/* Writes `field` with doubled quotes collapsed to `out`, which needs
+ * `field.len` bytes, and returns the length written */
+size_t csv_unescape(struct str_view field, char *out);
+/* Convert a whole column to `table->rows` numbers, in parallel on `pool`.
+ * Return 0 on success and -1 if any cell is not a number. */
+int csv_column_i64(const struct csv_table *table, size_t column, i64 *out,
+		   struct thread_pool *pool);
+int csv_column_f64(const struct csv_table *table, size_t column, double *out,
+		   struct thread_pool *pool);
+/* Parses a file of any size through a file_stream, `window` bytes at a time,
+ * and calls `fn` with each batch of whole rows. Cells only stay valid during
+ * the call. A row longer than `window` is an error. Returns 0 at the end of
+ * the file, -1 on errors, or the first nonzero value returned by `fn`, which
+ * stops the parse. */
+int csv_file(const char *path, char delim, size_t window,
+	     struct thread_pool *pool,
+	     int (*fn)(const struct csv_table *batch, void *ctx), void *ctx);
+
+/* Profiling zones and counters, recorded as 24-byte events into buffers of
+ * the thread recording them and written as Chrome trace JSON, which
+ * chrome://tracing and Perfetto open. Names are kept by pointer and must
+ * outlive the profile, like string literals. Record through the PROFILE_*
+ * macros, which compile to nothing unless LAZ_PROFILE is defined before this
+ * header is included. */
+void profile_begin(const char *name);
+/* Ends the innermost zone of the calling thread */
+void profile_end(void);
+void profile_counter(const char *name, i64 value);
+/* Names the calling thread in the trace */
+void profile_thread_name(const char *name);
+/* Writes every event recorded so far, returns 0 on success and -1 on failure.
+ * No other thread may be recording meanwhile. */
+int profile_write(const char *path);
+/* Calls profile_write(`path`) at exit. `path` must outlive the process. */
+void profile_write_at_exit(const char *path);
+/* Begin and end the zones of PROFILE_SCOPE */
+int laz_profile_scope_begin(const char *name);
+void laz_profile_scope_end(int *scope);
+#endif
+
+#if defined(LAZ_PROFILE) && defined(LAZ_POSIX)
+#define PROFILE_BEGIN(name) profile_begin(name)
+#define PROFILE_END() profile_end()
+#define PROFILE_COUNTER(name, value) profile_counter((name), (i64)(value))
+#define PROFILE_THREAD_NAME(name) profile_thread_name(name)
+#define PROFILE_WRITE_AT_EXIT(path) profile_write_at_exit(path)
+/* A zone from here to the end of the enclosing block, with the cleanup
+ * attribute of GCC and clang */
+#define PROFILE_SCOPE(name)                                             \
+	__attribute__((cleanup(laz_profile_scope_end))) int LAZ_PROFILE_ID( \
+		laz_profile_scope_, __LINE__) = laz_profile_scope_begin(name)
+#define LAZ_PROFILE_ID(prefix, line) LAZ_PROFILE_ID2(prefix, line)
+#define LAZ_PROFILE_ID2(prefix, line) prefix##line
+#else
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END() ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_WRITE_AT_EXIT(path) ((void)0)
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
+
+/* Hardware counters of the calling thread through perf_event_open, opened as
+ * one group so they count over the same instructions. Counters the kernel or
+ * the CPU refuses, as in most VMs and containers, are left out. They are read
+ * in user space with rdpmc when the kernel allows it, and with a system call
+ * otherwise. */
+#if defined(LAZ_POSIX) && defined(__linux__) && \
+	(defined(_DEFAULT_SOURCE) || defined(_GNU_SOURCE))
+#define LAZ_PERF
+
+enum perf_counter {
+	PERF_COUNTER_CYCLES,
+	PERF_COUNTER_INSTRUCTIONS,
+	/* Last-level cache misses */
+	PERF_COUNTER_CACHE_MISSES,
+	PERF_COUNTER_BRANCH_MISSES,
+	/* Nanoseconds on a CPU, a software counter available almost anywhere */
+	PERF_COUNTER_TASK_CLOCK,
+	PERF_COUNTER_COUNT
+};
+
+struct perf_sample {
+	u64 values[PERF_COUNTER_COUNT];
+	/* Bit `1 << counter` is set for the counters that work */
+	unsigned available;
+};
+
+struct perf_counters {
+	/* -1 for unavailable counters */
+	int fds[PERF_COUNTER_COUNT];
+	/* Page of each counter mapped for rdpmc, or null */
+	void *pages[PERF_COUNTER_COUNT];
+	/* Position of each counter in a read of the group */
+	unsigned slots[PERF_COUNTER_COUNT];
+	unsigned available;
+	struct perf_sample start;
+};
+
+/* Returns 0 if at least one counter opened, and -1 if none did, in which case
+ * samples are empty */
+int perf_counters_open(struct perf_counters *pc);
+void perf_counters_close(struct perf_counters *pc);
+/* Counts since the counters were opened */
+void perf_counters_read(const struct perf_counters *pc,
+			struct perf_sample *out);
+/* Counts over the region between the two calls */
+void perf_counters_start(struct perf_counters *pc);
+void perf_counters_stop(struct perf_counters *pc, struct perf_sample *out);
+#endif
+
+#ifdef LAZ_ATOMICS
+/* Bounded lock-free queues of pointers. Capacities are rounded up to a power
+ * of two. Push returns -1 when full and pop returns -1 when empty, without
+ * blocking. */
+
+/* Single producer, single consumer ring. The batch functions move as many of
+ * the `n` items as fit or are available and return that count. */
+struct spsc_ring;
+struct spsc_ring *spsc_ring_create(size_t capacity);
+void spsc_ring_destroy(struct spsc_ring *ring);
+size_t spsc_ring_capacity(const struct spsc_ring *ring);
+int spsc_ring_push(struct spsc_ring *ring, void *item);
+int spsc_ring_pop(struct spsc_ring *ring, void **item);
+size_t spsc_ring_push_n(struct spsc_ring *ring, void *const *items, size_t n);
+size_t spsc_ring_pop_n(struct spsc_ring *ring, void **items, size_t n);
+
+/* Multiple producer, multiple consumer queue (Dmitry Vyukov's design) */
+struct mpmc_queue;
+struct mpmc_queue *mpmc_queue_create(size_t capacity);
+void mpmc_queue_destroy(struct mpmc_queue *queue);
+size_t mpmc_queue_capacity(const struct mpmc_queue *queue);
+int mpmc_queue_push(struct mpmc_queue *queue, void *item);
+int mpmc_queue_pop(struct mpmc_queue *queue, void **item);
+#endif
+
 #ifdef LAZ_UTILS_IMPLEMENTATION
 
+#include <float.h>
+
+#ifdef LAZ_POSIX
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef LAZ_PERF
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
 #if __STDC_VERSION__ >= 201112L /* >=C11 */
 u64 get_nanoseconds(void) {
 	struct timespec ts = LAZ_INIT;
@@ -216,18 +1026,8 @@ u32 fnv1a_32_buf(const void *buf, size_t len)
 
 u32 fnv1a_32_str(const char *str)
 {
-	const unsigned char *s = (const unsigned char *)str;
-	u32 hval = FNV1A_32_INITIAL_VAL;
-
-	for (; s[0] != '\0'; s++) {
-		hval ^= (u32)s[0];
-		hval *= FNV1A_32_PRIME;
-		/* Force 32-bit behavior for if you plan to replace uint32_t
-		 * with unsigned long for c89 compatibility */
-		/* hval &= 0xFFFFFFFFUL; */
-	}
-
-	return hval;
+	/* Finding the terminator first keeps the hashing loop free of it */
+	return fnv1a_32_buf(str, scan_strlen(str));
 }
 
 u64 fnv1a_64_buf(const void *buf, size_t len)
@@ -246,66 +1046,9380 @@ u64 fnv1a_64_buf(const void *buf, size_t len)
 
 u64 fnv1a_64_str(const char *str)
 {
-	const unsigned char *s = (const unsigned char *)str;
-	u64 hval = FNV1A_64_INITIAL_VAL;
+	return fnv1a_64_buf(str, scan_strlen(str));
+}
 
-	for (; s[0] != '\0'; s++) {
-		hval ^= (u64)s[0];
-		hval *= FNV1A_64_PRIME;
+static unsigned laz_clz64(u64 x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return x == 0 ? 64 : (unsigned)__builtin_clzll(x);
+#else
+	unsigned n = 0;
+
+	for (; n < 64 && (x >> (63 - n) & 1) == 0; n++) {
 	}
 
-	return hval;
+	return n;
+#endif
 }
 
-void *malloc_try(size_t size)
+static unsigned laz_ctz64(u64 x)
 {
-	void *mem = malloc(size);
+#if defined(__GNUC__) || defined(__clang__)
+	return x == 0 ? 64 : (unsigned)__builtin_ctzll(x);
+#else
+	unsigned n = 0;
 
-	if (mem == NULL) {
-		perror("malloc");
-		exit(EXIT_FAILURE);
+	for (; n < 64 && (x >> n & 1) == 0; n++) {
 	}
 
-	return mem;
+	return n;
+#endif
 }
 
-void *calloc_try(size_t n, size_t size)
+/* Aligned block reads past a terminator stay within its page, but are out of
+ * bounds to AddressSanitizer */
+#if defined(__GNUC__) || defined(__clang__)
+#define LAZ_NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+#define LAZ_NO_SANITIZE_ADDRESS
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LAZ_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define LAZ_ALWAYS_INLINE inline
+#endif
+
+static size_t laz_scan_any_sw(const unsigned char *p, size_t len,
+			      const unsigned char *set, size_t set_len)
 {
-	void *mem = calloc(n, size);
+	unsigned char table[256];
 
-	if (mem == NULL) {
-		perror("calloc");
-		exit(EXIT_FAILURE);
+	memset(table, 0, sizeof(table));
+
+	for (size_t i = 0; i < set_len; i++) {
+		table[set[i]] = 1;
 	}
 
-	return mem;
+	for (size_t i = 0; i < len; i++) {
+		if (table[p[i]]) {
+			return i;
+		}
+	}
+
+	return len;
 }
 
-void *realloc_try(void *ptr, size_t size)
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define LAZ_SCAN_SSE2
+
+/* SSE2 is part of x86-64, so these need no runtime check */
+static size_t laz_scan_byte_sse2(const unsigned char *p, size_t len,
+				 unsigned char byte)
 {
-	void *mem = realloc(ptr, size);
+	__m128i needle = _mm_set1_epi8((char)byte);
+	size_t i = 0;
+	u32 mask = 0;
 
-	if (mem == NULL) {
-		perror("realloc");
-		exit(EXIT_FAILURE);
+	if (len < 16) {
+		for (; i < len && p[i] != byte; i++) {
+		}
+
+		return i;
 	}
 
-	return mem;
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+
+		mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+
+		if (mask != 0) {
+			return i + laz_ctz64(mask);
+		}
+	}
+
+	if (i == len) {
+		return len;
+	}
+
+	/* The last 16 bytes, overlapping the ones already scanned */
+	mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(
+		       _mm_loadu_si128((const __m128i *)(p + len - 16)),
+		       needle)) >>
+	       (i - (len - 16));
+	return mask != 0 ? i + laz_ctz64(mask) : len;
 }
 
-#if defined(_DEFAULT_SOURCE) || defined(_GNU_SOURCE)
-void *reallocarray_try(void *ptr, size_t n, size_t size)
+static size_t laz_scan_any_sse2(const unsigned char *p, size_t len,
+				const unsigned char *set, size_t set_len)
 {
-	void *mem = reallocarray(ptr, n, size);
+	__m128i needles[16];
+	size_t i = 0;
 
-	if (mem == NULL) {
-		perror("reallocarray");
-		exit(EXIT_FAILURE);
+	for (size_t j = 0; j < set_len; j++) {
+		needles[j] = _mm_set1_epi8((char)set[j]);
 	}
 
-	return mem;
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		__m128i hits = _mm_cmpeq_epi8(v, needles[0]);
+		u32 mask = 0;
+
+		for (size_t j = 1; j < set_len; j++) {
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(v, needles[j]));
+		}
+
+		mask = (u32)_mm_movemask_epi8(hits);
+
+		if (mask != 0) {
+			return i + laz_ctz64(mask);
+		}
+	}
+
+	return i + laz_scan_any_sw(p + i, len - i, set, set_len);
 }
-#endif
+
+static size_t laz_count_byte_sse2(const unsigned char *p, size_t len,
+				  unsigned char byte)
+{
+	__m128i needle = _mm_set1_epi8((char)byte);
+	__m128i zero = _mm_setzero_si128();
+	__m128i total = zero;
+	size_t count = 0;
+	size_t i = 0;
+
+	while (i + 16 <= len) {
+		__m128i counts = zero;
+		/* Byte counters overflow after 255 blocks */
+		size_t end = i + 255 * 16 < len ? i + 255 * 16 : len;
+
+		for (; i + 16 <= end; i += 16) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+
+			/* Matches are -1, so subtracting counts them */
+			counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(v, needle));
+		}
+
+		total = _mm_add_epi64(total, _mm_sad_epu8(counts, zero));
+	}
+
+	count = (size_t)_mm_cvtsi128_si64(total) +
+		(size_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total));
+
+	for (; i < len; i++) {
+		count += p[i] == byte;
+	}
+
+	return count;
+}
+
+static LAZ_NO_SANITIZE_ADDRESS size_t laz_strlen_sse2(const char *str)
+{
+	size_t misalign = (uintptr_t)str & 15;
+	const __m128i *p = (const __m128i *)(const void *)(str - misalign);
+	__m128i zero = _mm_setzero_si128();
+	u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(p),
+							 zero)) >>
+		   misalign;
+
+	if (mask != 0) {
+		return laz_ctz64(mask);
+	}
+
+	for (;;) {
+		mask = (u32)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_load_si128(++p), zero));
+
+		if (mask != 0) {
+			return (size_t)((const char *)p - str) + laz_ctz64(mask);
+		}
+	}
+}
+
+#define LAZ_SCAN_AVX2
+
+__attribute__((target("avx2"))) static size_t
+laz_scan_byte_avx2(const unsigned char *p, size_t len, unsigned char byte)
+{
+	__m256i needle = _mm256_set1_epi8((char)byte);
+	size_t i = 0;
+	u32 mask = 0;
+
+	if (len < 32) {
+		return laz_scan_byte_sse2(p, len, byte);
+	}
+
+	/* Two vectors per iteration, tested together */
+	for (; i + 64 <= len; i += 64) {
+		__m256i a = _mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *)(p + i)), needle);
+		__m256i b = _mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *)(p + i + 32)),
+			needle);
+
+		if (!_mm256_testz_si256(_mm256_or_si256(a, b),
+					_mm256_or_si256(a, b))) {
+			u64 both = (u32)_mm256_movemask_epi8(a) |
+				   (u64)(u32)_mm256_movemask_epi8(b) << 32;
+
+			return i + laz_ctz64(both);
+		}
+	}
+
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+
+		mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle));
+
+		if (mask != 0) {
+			return i + laz_ctz64(mask);
+		}
+	}
+
+	if (i == len) {
+		return len;
+	}
+
+	mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+		       _mm256_loadu_si256((const __m256i *)(p + len - 32)),
+		       needle)) >>
+	       (i - (len - 32));
+	return mask != 0 ? i + laz_ctz64(mask) : len;
+}
+
+__attribute__((target("avx2"))) static size_t
+laz_scan_any_avx2_eq(const unsigned char *p, size_t len,
+		     const unsigned char *set, size_t set_len)
+{
+	__m256i needles[16];
+	size_t i = 0;
+
+	for (size_t j = 0; j < set_len; j++) {
+		needles[j] = _mm256_set1_epi8((char)set[j]);
+	}
+
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		__m256i hits = _mm256_cmpeq_epi8(v, needles[0]);
+		u32 mask = 0;
+
+		for (size_t j = 1; j < set_len; j++) {
+			hits = _mm256_or_si256(hits,
+					       _mm256_cmpeq_epi8(v, needles[j]));
+		}
+
+		mask = (u32)_mm256_movemask_epi8(hits);
+
+		if (mask != 0) {
+			return i + laz_ctz64(mask);
+		}
+	}
+
+	return i + laz_scan_any_sse2(p + i, len - i, set, set_len);
+}
+
+/* Classifies bytes with two table lookups instead of one comparison per set
+ * byte. Set bytes sharing a high nibble share a bucket bit, which works for
+ * sets spanning up to 8 high nibbles. */
+__attribute__((target("avx2"))) static size_t
+laz_scan_any_avx2(const unsigned char *p, size_t len,
+		  const unsigned char *set, size_t set_len)
+{
+	unsigned char low[16];
+	unsigned char high[16];
+	unsigned buckets = 0;
+	__m256i low_table;
+	__m256i high_table;
+	__m256i nibble = _mm256_set1_epi8(0x0f);
+	__m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+
+	memset(low, 0, sizeof(low));
+	memset(high, 0, sizeof(high));
+
+	for (size_t j = 0; j < set_len; j++) {
+		unsigned h = set[j] >> 4;
+
+		if (high[h] == 0) {
+			if (buckets == 8) {
+				return laz_scan_any_avx2_eq(p, len, set,
+							    set_len);
+			}
+
+			high[h] = (unsigned char)(1U << buckets++);
+		}
+
+		low[set[j] & 15] |= high[h];
+	}
+
+	low_table = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)(const void *)low));
+	high_table = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)(const void *)high));
+
+	for (; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		__m256i l = _mm256_shuffle_epi8(low_table,
+						_mm256_and_si256(v, nibble));
+		__m256i h = _mm256_shuffle_epi8(
+			high_table,
+			_mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+		u32 mask = ~(u32)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(_mm256_and_si256(l, h), zero));
+
+		if (mask != 0) {
+			return i + laz_ctz64(mask);
+		}
+	}
+
+	return i + laz_scan_any_sse2(p + i, len - i, set, set_len);
+}
+
+__attribute__((target("avx2"))) static LAZ_NO_SANITIZE_ADDRESS size_t
+laz_strlen_avx2(const char *str)
+{
+	size_t misalign = (uintptr_t)str & 31;
+	const char *p = str - misalign;
+	__m256i zero = _mm256_setzero_si256();
+	u32 mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+			   _mm256_load_si256((const __m256i *)(const void *)p),
+			   zero)) >>
+		   misalign;
+
+	if (mask != 0) {
+		return laz_ctz64(mask);
+	}
+
+	/* One more vector reaches a 64-byte boundary, after which pairs of
+	 * vectors never straddle a page */
+	if (((uintptr_t)p & 32) == 0) {
+		p += 32;
+		mask = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+			_mm256_load_si256((const __m256i *)(const void *)p),
+			zero));
+
+		if (mask != 0) {
+			return (size_t)(p - str) + laz_ctz64(mask);
+		}
+	}
+
+	for (p += 32;; p += 64) {
+		__m256i a = _mm256_cmpeq_epi8(
+			_mm256_load_si256((const __m256i *)(const void *)p),
+			zero);
+		__m256i b = _mm256_cmpeq_epi8(
+			_mm256_load_si256((const __m256i *)(const void *)(p + 32)),
+			zero);
+
+		if (!_mm256_testz_si256(_mm256_or_si256(a, b),
+					_mm256_or_si256(a, b))) {
+			u64 both = (u32)_mm256_movemask_epi8(a) |
+				   (u64)(u32)_mm256_movemask_epi8(b) << 32;
+
+			return (size_t)(p - str) + laz_ctz64(both);
+		}
+	}
+}
+
+__attribute__((target("avx2"))) static size_t
+laz_count_byte_avx2(const unsigned char *p, size_t len, unsigned char byte)
+{
+	__m256i needle = _mm256_set1_epi8((char)byte);
+	__m256i zero = _mm256_setzero_si256();
+	__m256i total = zero;
+	size_t i = 0;
+
+	while (i + 32 <= len) {
+		__m256i counts = zero;
+		size_t end = i + 255 * 32 < len ? i + 255 * 32 : len;
+
+		for (; i + 32 <= end; i += 32) {
+			__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+
+			counts = _mm256_sub_epi8(counts,
+						 _mm256_cmpeq_epi8(v, needle));
+		}
+
+		total = _mm256_add_epi64(total, _mm256_sad_epu8(counts, zero));
+	}
+
+	return (size_t)_mm256_extract_epi64(total, 0) +
+	       (size_t)_mm256_extract_epi64(total, 1) +
+	       (size_t)_mm256_extract_epi64(total, 2) +
+	       (size_t)_mm256_extract_epi64(total, 3) +
+	       laz_count_byte_sse2(p + i, len - i, byte);
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define LAZ_SCAN_NEON
+
+/* Four bits per byte of a comparison result, NEON having no movemask */
+static u64 laz_neon_mask(uint8x16_t eq)
+{
+	uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+
+	return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+static size_t laz_scan_byte_neon(const unsigned char *p, size_t len,
+				 unsigned char byte)
+{
+	uint8x16_t needle = vdupq_n_u8(byte);
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		u64 mask = laz_neon_mask(vceqq_u8(vld1q_u8(p + i), needle));
+
+		if (mask != 0) {
+			return i + laz_ctz64(mask) / 4;
+		}
+	}
+
+	for (; i < len; i++) {
+		if (p[i] == byte) {
+			return i;
+		}
+	}
+
+	return len;
+}
+
+static size_t laz_scan_any_neon(const unsigned char *p, size_t len,
+				const unsigned char *set, size_t set_len)
+{
+	uint8x16_t needles[16];
+	size_t i = 0;
+
+	for (size_t j = 0; j < set_len; j++) {
+		needles[j] = vdupq_n_u8(set[j]);
+	}
+
+	for (; i + 16 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8(p + i);
+		uint8x16_t hits = vceqq_u8(v, needles[0]);
+		u64 mask = 0;
+
+		for (size_t j = 1; j < set_len; j++) {
+			hits = vorrq_u8(hits, vceqq_u8(v, needles[j]));
+		}
+
+		mask = laz_neon_mask(hits);
+
+		if (mask != 0) {
+			return i + laz_ctz64(mask) / 4;
+		}
+	}
+
+	return i + laz_scan_any_sw(p + i, len - i, set, set_len);
+}
+
+static size_t laz_count_byte_neon(const unsigned char *p, size_t len,
+				  unsigned char byte)
+{
+	uint8x16_t needle = vdupq_n_u8(byte);
+	size_t count = 0;
+	size_t i = 0;
+
+	while (i + 16 <= len) {
+		uint8x16_t counts = vdupq_n_u8(0);
+		size_t end = i + 255 * 16 < len ? i + 255 * 16 : len;
+
+		for (; i + 16 <= end; i += 16) {
+			counts = vsubq_u8(counts,
+					  vceqq_u8(vld1q_u8(p + i), needle));
+		}
+
+		count += vaddlvq_u8(counts);
+	}
+
+	for (; i < len; i++) {
+		count += p[i] == byte;
+	}
+
+	return count;
+}
+
+static LAZ_NO_SANITIZE_ADDRESS size_t laz_strlen_neon(const char *str)
+{
+	size_t misalign = (uintptr_t)str & 15;
+	const unsigned char *p = (const unsigned char *)str - misalign;
+	u64 mask = laz_neon_mask(vceqq_u8(vld1q_u8(p), vdupq_n_u8(0))) >>
+		   (4 * misalign);
+
+	if (mask != 0) {
+		return laz_ctz64(mask) / 4;
+	}
+
+	for (;;) {
+		p += 16;
+		mask = laz_neon_mask(vceqq_u8(vld1q_u8(p), vdupq_n_u8(0)));
+
+		if (mask != 0) {
+			return (size_t)((const char *)p - str) +
+			       laz_ctz64(mask) / 4;
+		}
+	}
+}
+#endif
+
+static size_t laz_scan_byte_sw(const unsigned char *p, size_t len,
+			       unsigned char byte)
+{
+	const unsigned char *hit = (const unsigned char *)memchr(p, byte, len);
+
+	return hit != NULL ? (size_t)(hit - p) : len;
+}
+
+static size_t laz_count_byte_sw(const unsigned char *p, size_t len,
+				unsigned char byte)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		count += p[i] == byte;
+	}
+
+	return count;
+}
+
+static size_t laz_strlen_sw(const char *str)
+{
+	return strlen(str);
+}
+
+/* Kernels start as the ones the target always has, for calls made before
+ * laz_cpu_dispatch picks the best at startup */
+#if defined(LAZ_SCAN_SSE2)
+#define LAZ_SCAN_BASELINE(kernel) laz_##kernel##_sse2
+#elif defined(LAZ_SCAN_NEON)
+#define LAZ_SCAN_BASELINE(kernel) laz_##kernel##_neon
+#else
+#define LAZ_SCAN_BASELINE(kernel) laz_##kernel##_sw
+#endif
+
+static size_t (*laz_scan_byte_kernel)(const unsigned char *, size_t,
+				      unsigned char) =
+	LAZ_SCAN_BASELINE(scan_byte);
+static size_t (*laz_scan_any_kernel)(const unsigned char *, size_t,
+				     const unsigned char *, size_t) =
+	LAZ_SCAN_BASELINE(scan_any);
+static size_t (*laz_count_byte_kernel)(const unsigned char *, size_t,
+				       unsigned char) =
+	LAZ_SCAN_BASELINE(count_byte);
+static size_t (*laz_strlen_kernel)(const char *) = LAZ_SCAN_BASELINE(strlen);
+
+size_t scan_byte(const void *buf, size_t len, unsigned char byte)
+{
+	return laz_scan_byte_kernel((const unsigned char *)buf, len, byte);
+}
+
+size_t scan_any(const void *buf, size_t len, const void *set, size_t set_len)
+{
+	const unsigned char *p = (const unsigned char *)buf;
+	const unsigned char *s = (const unsigned char *)set;
+
+	if (set_len == 0 || set_len > 16) {
+		return laz_scan_any_sw(p, len, s, set_len);
+	}
+
+	return laz_scan_any_kernel(p, len, s, set_len);
+}
+
+size_t count_byte(const void *buf, size_t len, unsigned char byte)
+{
+	return laz_count_byte_kernel((const unsigned char *)buf, len, byte);
+}
+
+size_t scan_strlen(const char *str)
+{
+	return laz_strlen_kernel(str);
+}
+
+struct str_view str_view_from(const char *data, size_t len)
+{
+	struct str_view view;
+
+	view.data = data;
+	view.len = len;
+	return view;
+}
+
+struct str_view str_view_cstr(const char *str)
+{
+	return str_view_from(str, scan_strlen(str));
+}
+
+int str_view_eq(struct str_view a, struct str_view b)
+{
+	return a.len == b.len && (a.len == 0 || memcmp(a.data, b.data, a.len) == 0);
+}
+
+int str_view_eq_cstr(struct str_view a, const char *str)
+{
+	return str_view_eq(a, str_view_cstr(str));
+}
+
+/* Flags in the last byte of a string, whose low bits hold the length of
+ * inline contents */
+#define LAZ_STR_HEAP 0x80U
+#define LAZ_STR_HASHED 0x40U
+#define LAZ_STR_LEN_MASK 0x3fU
+
+static unsigned laz_str_tag(const struct str *s)
+{
+	return (unsigned char)s->u.bytes[STR_INLINE_MAX + 1];
+}
+
+static void laz_str_set_tag(struct str *s, unsigned tag)
+{
+	s->u.bytes[STR_INLINE_MAX + 1] = (char)tag;
+}
+
+static int laz_str_on_heap(const struct str *s)
+{
+	return (laz_str_tag(s) & LAZ_STR_HEAP) != 0;
+}
+
+/* Start of the heap allocation, which begins with the capacity */
+static size_t *laz_str_block(const struct str *s)
+{
+	return (size_t *)(void *)(s->u.heap.data - sizeof(size_t));
+}
+
+static char *laz_str_bytes(struct str *s)
+{
+	return laz_str_on_heap(s) ? s->u.heap.data : s->u.bytes;
+}
+
+/* Also drops the cached hash, since the contents changed */
+static void laz_str_set_len(struct str *s, size_t len)
+{
+	if (laz_str_on_heap(s)) {
+		s->u.heap.len = len;
+		laz_str_set_tag(s, LAZ_STR_HEAP);
+	} else {
+		laz_str_set_tag(s, (unsigned)len);
+	}
+}
+
+void str_init(struct str *s, const char *data, size_t len)
+{
+	memset(s, 0, sizeof(*s));
+	str_append(s, data, len);
+}
+
+void str_init_cstr(struct str *s, const char *str)
+{
+	str_init(s, str, scan_strlen(str));
+}
+
+void str_destroy(struct str *s)
+{
+	if (laz_str_on_heap(s)) {
+		free(laz_str_block(s));
+	}
+
+	memset(s, 0, sizeof(*s));
+}
+
+const char *str_data(const struct str *s)
+{
+	return laz_str_on_heap(s) ? s->u.heap.data : s->u.bytes;
+}
+
+size_t str_len(const struct str *s)
+{
+	return laz_str_on_heap(s) ? s->u.heap.len
+				  : laz_str_tag(s) & LAZ_STR_LEN_MASK;
+}
+
+size_t str_capacity(const struct str *s)
+{
+	return laz_str_on_heap(s) ? *laz_str_block(s) : STR_INLINE_MAX;
+}
+
+struct str_view str_as_view(const struct str *s)
+{
+	return str_view_from(str_data(s), str_len(s));
+}
+
+void str_reserve(struct str *s, size_t len)
+{
+	size_t *block = NULL;
+	size_t size = str_len(s);
+	size_t cap = str_capacity(s);
+
+	if (len <= cap) {
+		return;
+	}
+
+	if (laz_str_on_heap(s)) {
+		cap = MAX(len, cap * 2);
+		block = (size_t *)realloc_try(laz_str_block(s),
+					      sizeof(size_t) + cap + 1);
+	} else {
+		cap = len;
+		block = (size_t *)malloc_try(sizeof(size_t) + cap + 1);
+		memcpy(block + 1, s->u.bytes, size + 1);
+		/* The contents stay the same, so does their hash */
+		laz_str_set_tag(s, LAZ_STR_HEAP |
+					   (laz_str_tag(s) & LAZ_STR_HASHED));
+	}
+
+	*block = cap;
+	s->u.heap.data = (char *)(block + 1);
+	s->u.heap.len = size;
+}
+
+void str_clear(struct str *s)
+{
+	laz_str_set_len(s, 0);
+	laz_str_bytes(s)[0] = '\0';
+}
+
+void str_append(struct str *s, const char *data, size_t len)
+{
+	size_t size = str_len(s);
+	char *bytes = laz_str_bytes(s);
+
+	/* Doubling from the inline size on the first spill too */
+	if (size + len > str_capacity(s)) {
+		/* Appending part of `s` to itself reads from the new buffer.
+		 * Unrelated pointers are only comparable as integers. */
+		uintptr_t from = (uintptr_t)data;
+		uintptr_t begin = (uintptr_t)bytes;
+		int own = from >= begin && from < begin + size;
+		size_t offset = own ? (size_t)(from - begin) : 0;
+
+		str_reserve(s, MAX(size + len, 2 * (STR_INLINE_MAX + 2)));
+		bytes = laz_str_bytes(s);
+
+		if (own) {
+			data = bytes + offset;
+		}
+	}
+
+	if (len > 0) {
+		memmove(bytes + size, data, len);
+	}
+
+	bytes[size + len] = '\0';
+	laz_str_set_len(s, size + len);
+}
+
+void str_append_cstr(struct str *s, const char *str)
+{
+	str_append(s, str, scan_strlen(str));
+}
+
+void str_append_char(struct str *s, char c)
+{
+	str_append(s, &c, 1);
+}
+
+u64 str_hash(struct str *s)
+{
+	if ((laz_str_tag(s) & LAZ_STR_HASHED) == 0) {
+		s->hash = fnv1a_64_buf(str_data(s), str_len(s));
+		laz_str_set_tag(s, laz_str_tag(s) | LAZ_STR_HASHED);
+	}
+
+	return s->hash;
+}
+
+int str_eq(const struct str *a, const struct str *b)
+{
+	if ((laz_str_tag(a) & laz_str_tag(b) & LAZ_STR_HASHED) != 0 &&
+	    a->hash != b->hash) {
+		return 0;
+	}
+
+	return str_view_eq(str_as_view(a), str_as_view(b));
+}
+
+void line_iter_init(struct line_iter *iter, const void *buf, size_t len)
+{
+	iter->pos = (const char *)buf;
+	iter->end = iter->pos + len;
+}
+
+int line_iter_next(struct line_iter *iter, struct str_view *line)
+{
+	size_t left = (size_t)(iter->end - iter->pos);
+	size_t len = 0;
+
+	if (left == 0) {
+		return 0;
+	}
+
+	len = scan_byte(iter->pos, left, '\n');
+	line->data = iter->pos;
+	line->len = len;
+	iter->pos += len + (len < left);
+
+	if (len > 0 && line->data[len - 1] == '\r' && len < left) {
+		line->len--;
+	}
+
+	return 1;
+}
+
+int field_iter_init(struct field_iter *iter, struct str_view str,
+		    const char *delims, size_t delim_count)
+{
+	if (delim_count == 0 || delim_count > sizeof(iter->delims)) {
+		return -1;
+	}
+
+	iter->pos = str.data;
+	iter->end = str.data + str.len;
+	memcpy(iter->delims, delims, delim_count);
+	iter->delim_count = delim_count;
+	iter->done = 0;
+	return 0;
+}
+
+int field_iter_next(struct field_iter *iter, struct str_view *field)
+{
+	size_t left = (size_t)(iter->end - iter->pos);
+	size_t len = 0;
+
+	if (iter->done) {
+		return 0;
+	}
+
+	if (iter->delim_count == 1) {
+		len = scan_byte(iter->pos, left, iter->delims[0]);
+	} else {
+		len = scan_any(iter->pos, left, iter->delims,
+			       iter->delim_count);
+	}
+
+	field->data = iter->pos;
+	field->len = len;
+
+	/* The field after the last delimiter ends the iteration, even empty */
+	if (len == left) {
+		iter->done = 1;
+		iter->pos = iter->end;
+	} else {
+		iter->pos += len + 1;
+	}
+
+	return 1;
+}
+
+/* Bit masks of the 64 bytes of a block, bit i for byte i */
+struct laz_json_block {
+	u64 quote;
+	u64 backslash;
+	/* {}[]:, */
+	u64 op;
+	u64 space;
+};
+
+static void laz_json_classify_sw(const unsigned char *p,
+				 struct laz_json_block *block)
+{
+	memset(block, 0, sizeof(*block));
+
+	for (unsigned i = 0; i < 64; i++) {
+		u64 bit = (u64)1 << i;
+
+		switch (p[i]) {
+		case '"':
+			block->quote |= bit;
+			break;
+		case '\\':
+			block->backslash |= bit;
+			break;
+		case '{':
+		case '}':
+		case '[':
+		case ']':
+		case ':':
+		case ',':
+			block->op |= bit;
+			break;
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+			block->space |= bit;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+#if defined(LAZ_SCAN_SSE2)
+/* '[' and ']' differ from '{' and '}' only by 0x20 */
+static void laz_json_classify_sse2(const unsigned char *p,
+				   struct laz_json_block *block)
+{
+	memset(block, 0, sizeof(*block));
+
+	for (unsigned i = 0; i < 4; i++) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+		__m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		__m128i op = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+				     _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')),
+				     _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+		__m128i space = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+				     _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+				     _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+
+		block->quote |= (u64)(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(
+					v, _mm_set1_epi8('"')))
+				<< (16 * i);
+		block->backslash |= (u64)(u32)_mm_movemask_epi8(_mm_cmpeq_epi8(
+					    v, _mm_set1_epi8('\\')))
+				    << (16 * i);
+		block->op |= (u64)(u32)_mm_movemask_epi8(op) << (16 * i);
+		block->space |= (u64)(u32)_mm_movemask_epi8(space) << (16 * i);
+	}
+}
+
+/* Looks bytes up by their low nibble, so a byte is whitespace or an operator
+ * when it equals its entry. Operators are compared with 0x20 set, which folds
+ * '[' and ']' onto '{' and '}', and lets a few control characters through
+ * that are invalid outside strings anyway. */
+static const u8 laz_json_space_table[16] = { ' ',  0xff, 0xff, 0xff,
+					     0xff, 0xff, 0xff, 0xff,
+					     0xff, '\t', '\n', 0xff,
+					     0xff, '\r', 0xff, 0xff };
+static const u8 laz_json_op_table[16] = { 0, 0, 0,   0,	  0,   0, 0, 0,
+					  0, 0, ':', '{', ',', '}', 0, 0 };
+
+__attribute__((target("avx2"))) static void
+laz_json_classify_avx2(const unsigned char *p, struct laz_json_block *block)
+{
+	__m256i space_table = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)(const void *)
+					laz_json_space_table));
+	__m256i op_table = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+		(const __m128i *)(const void *)laz_json_op_table));
+	u64 masks[4][2];
+
+	for (unsigned i = 0; i < 2; i++) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + 32 * i));
+		__m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+
+		masks[0][i] = (u32)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+		masks[1][i] = (u32)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+		masks[2][i] = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+			folded, _mm256_shuffle_epi8(op_table, v)));
+		masks[3][i] = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+			v, _mm256_shuffle_epi8(space_table, v)));
+	}
+
+	block->quote = masks[0][0] | masks[0][1] << 32;
+	block->backslash = masks[1][0] | masks[1][1] << 32;
+	block->op = masks[2][0] | masks[2][1] << 32;
+	block->space = masks[3][0] | masks[3][1] << 32;
+}
+#elif defined(LAZ_SCAN_NEON)
+/* One bit per byte of four comparison results */
+static u64 laz_neon_mask64(uint8x16_t a, uint8x16_t b, uint8x16_t c,
+			   uint8x16_t d)
+{
+	static const u8 weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128,
+					1, 2, 4, 8, 16, 32, 64, 128 };
+	uint8x16_t w = vld1q_u8(weights);
+	uint8x16_t ab = vpaddq_u8(vandq_u8(a, w), vandq_u8(b, w));
+	uint8x16_t cd = vpaddq_u8(vandq_u8(c, w), vandq_u8(d, w));
+	uint8x16_t sum = vpaddq_u8(ab, cd);
+
+	sum = vpaddq_u8(sum, sum);
+	return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+}
+
+static void laz_json_classify_neon(const unsigned char *p,
+				   struct laz_json_block *block)
+{
+	uint8x16_t quote[4];
+	uint8x16_t backslash[4];
+	uint8x16_t op[4];
+	uint8x16_t space[4];
+
+	for (unsigned i = 0; i < 4; i++) {
+		uint8x16_t v = vld1q_u8(p + 16 * i);
+		uint8x16_t folded = vorrq_u8(v, vdupq_n_u8(0x20));
+
+		quote[i] = vceqq_u8(v, vdupq_n_u8('"'));
+		backslash[i] = vceqq_u8(v, vdupq_n_u8('\\'));
+		op[i] = vorrq_u8(vorrq_u8(vceqq_u8(folded, vdupq_n_u8('{')),
+					  vceqq_u8(folded, vdupq_n_u8('}'))),
+				 vorrq_u8(vceqq_u8(v, vdupq_n_u8(':')),
+					  vceqq_u8(v, vdupq_n_u8(','))));
+		space[i] = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')),
+					     vceqq_u8(v, vdupq_n_u8('\t'))),
+				    vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')),
+					     vceqq_u8(v, vdupq_n_u8('\r'))));
+	}
+
+	block->quote = laz_neon_mask64(quote[0], quote[1], quote[2], quote[3]);
+	block->backslash = laz_neon_mask64(backslash[0], backslash[1],
+					   backslash[2], backslash[3]);
+	block->op = laz_neon_mask64(op[0], op[1], op[2], op[3]);
+	block->space = laz_neon_mask64(space[0], space[1], space[2], space[3]);
+}
+#endif
+
+/* Bytes escaped by an odd run of backslashes. `carry` is 1 when the previous
+ * block ended in such a run. */
+static u64 laz_json_escaped(u64 backslash, u64 *carry)
+{
+	const u64 even = 0x5555555555555555ULL;
+	u64 starts = backslash & ~(backslash << 1);
+	u64 even_start_mask = even ^ *carry;
+	u64 even_starts = starts & even_start_mask;
+	u64 odd_starts = starts & ~even_start_mask;
+	u64 even_carries = backslash + even_starts;
+	u64 odd_carries = backslash + odd_starts;
+	u64 ends_odd = odd_carries < backslash;
+	u64 odd_ends = 0;
+
+	odd_carries |= *carry;
+	*carry = ends_odd;
+	even_carries &= ~backslash;
+	odd_carries &= ~backslash;
+	odd_ends = (even_carries & ~even) | (odd_carries & even);
+	return odd_ends;
+}
+
+/* Bit i is the parity of the set bits up to i */
+static u64 laz_prefix_xor(u64 x)
+{
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
+
+static unsigned laz_popcount64(u64 x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (unsigned)__builtin_popcountll(x);
+#else
+	unsigned n = 0;
+
+	for (; x != 0; x &= x - 1) {
+		n++;
+	}
+
+	return n;
+#endif
+}
+
+/* Entries of the structural index held at once. Stage one refills them as
+ * stage two consumes them, so the index stays in cache. */
+#define LAZ_JSON_INDEX_WINDOW 4096
+
+/* Stage one, resumable between windows. It indexes brackets, colons and
+ * commas outside strings, both quotes of every string and the first byte of
+ * every other value. */
+struct laz_json_indexer {
+	const unsigned char *data;
+	size_t len;
+	size_t base;
+	u64 escape_carry;
+	u64 string_carry;
+	u64 boundary_carry;
+};
+
+static void laz_json_indexer_init(struct laz_json_indexer *ix,
+				  const char *data, size_t len)
+{
+	ix->data = (const unsigned char *)data;
+	ix->len = len;
+	ix->base = 0;
+	ix->escape_carry = 0;
+	ix->string_carry = 0;
+	/* The start of the document separates values like a space */
+	ix->boundary_carry = 1;
+}
+
+/* Appends the offsets of whole blocks while `cap` has room for a full one,
+ * and returns how many were written. Each kernel below inlines it with its
+ * own classifier, so blocks cost no indirect call. */
+static LAZ_ALWAYS_INLINE size_t
+laz_json_index_blocks(struct laz_json_indexer *ix, u32 *out, size_t cap,
+		      void (*classify)(const unsigned char *,
+				       struct laz_json_block *))
+{
+	unsigned char tail[64];
+	size_t count = 0;
+
+	/* Offsets are written eight at a time, past the count */
+	for (; ix->base < ix->len && count + 64 + 8 <= cap; ix->base += 64) {
+		const unsigned char *p = ix->data + ix->base;
+		struct laz_json_block block;
+		u64 quote = 0;
+		u64 in_string = 0;
+		u64 boundary = 0;
+		u64 structural = 0;
+		u32 base = (u32)ix->base;
+		u32 *o = out + count;
+
+		if (ix->len - ix->base < 64) {
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, p, ix->len - ix->base);
+			p = tail;
+		}
+
+		classify(p, &block);
+		quote = block.quote & ~laz_json_escaped(block.backslash,
+							&ix->escape_carry);
+		/* Opening quotes and string contents, but not closing quotes */
+		in_string = laz_prefix_xor(quote) ^ ix->string_carry;
+		ix->string_carry = 0 - (in_string >> 63);
+		boundary = block.op | block.space | quote;
+		structural = (block.op & ~in_string) | quote |
+			     (~(boundary | in_string) &
+			      (boundary << 1 | ix->boundary_carry));
+		ix->boundary_carry = boundary >> 63;
+		count += laz_popcount64(structural);
+
+		/* The top bit keeps the writes past the last offset branch-free */
+		while (structural != 0) {
+			for (unsigned i = 0; i < 8; i++) {
+				o[i] = base + laz_ctz64(structural |
+							(u64)1 << 63);
+				structural &= structural - 1;
+			}
+
+			o += 8;
+		}
+	}
+
+	return count;
+}
+
+static size_t laz_json_index_sw(struct laz_json_indexer *ix, u32 *out,
+				size_t cap)
+{
+	return laz_json_index_blocks(ix, out, cap, laz_json_classify_sw);
+}
+
+#if defined(LAZ_SCAN_SSE2)
+static size_t laz_json_index_sse2(struct laz_json_indexer *ix, u32 *out,
+				  size_t cap)
+{
+	return laz_json_index_blocks(ix, out, cap, laz_json_classify_sse2);
+}
+
+__attribute__((target("avx2"))) static size_t
+laz_json_index_avx2(struct laz_json_indexer *ix, u32 *out, size_t cap)
+{
+	return laz_json_index_blocks(ix, out, cap, laz_json_classify_avx2);
+}
+#elif defined(LAZ_SCAN_NEON)
+static size_t laz_json_index_neon(struct laz_json_indexer *ix, u32 *out,
+				  size_t cap)
+{
+	return laz_json_index_blocks(ix, out, cap, laz_json_classify_neon);
+}
+#endif
+
+static size_t (*laz_json_index_kernel)(struct laz_json_indexer *, u32 *,
+				       size_t) = LAZ_SCAN_BASELINE(json_index);
+
+static size_t laz_json_index_more(struct laz_json_indexer *ix, u32 *out,
+				  size_t cap)
+{
+	return laz_json_index_kernel(ix, out, cap);
+}
+
+/* Returns the length of the number at the start of `p`, or 0 if none */
+static size_t laz_json_number(const char *p, size_t len)
+{
+	size_t i = p[0] == '-';
+	size_t digits = 0;
+
+	if (i < len && p[i] == '0') {
+		i++;
+	} else {
+		for (digits = i; i < len && p[i] >= '0' && p[i] <= '9'; i++) {
+		}
+
+		if (i == digits) {
+			return 0;
+		}
+	}
+
+	if (i < len && p[i] == '.') {
+		for (digits = ++i; i < len && p[i] >= '0' && p[i] <= '9'; i++) {
+		}
+
+		if (i == digits) {
+			return 0;
+		}
+	}
+
+	if (i < len && (p[i] | 0x20) == 'e') {
+		i++;
+		i += i < len && (p[i] == '+' || p[i] == '-');
+
+		for (digits = i; i < len && p[i] >= '0' && p[i] <= '9'; i++) {
+		}
+
+		if (i == digits) {
+			return 0;
+		}
+	}
+
+	return i;
+}
+
+/* Space is reserved when the index is refilled */
+static LAZ_ALWAYS_INLINE void laz_json_add(struct json_doc *doc, u32 type, size_t offset,
+			 size_t len)
+{
+	struct json_node *node = &doc->nodes[doc->count];
+
+	node->type = type;
+	node->offset = (u32)offset;
+	node->len = (u32)len;
+	node->count = 0;
+	node->next = (u32)++doc->count;
+}
+
+/* Stage two's view of the structural index */
+struct laz_json_cursor {
+	struct laz_json_indexer ix;
+	u32 index[LAZ_JSON_INDEX_WINDOW];
+	size_t k;
+	size_t n;
+};
+
+/* Refills the window once at most one structural is left, which is all that
+ * has to move. Every node uses up at least one structural, so reserving one
+ * per structural here spares laz_json_add a check per node. */
+static void laz_json_refill(struct json_doc *doc, struct laz_json_cursor *cur)
+{
+	size_t cap = doc->cap;
+
+	if (cur->k < cur->n) {
+		cur->index[0] = cur->index[cur->k];
+	}
+
+	cur->n -= cur->k;
+	cur->k = 0;
+	cur->n += laz_json_index_more(&cur->ix, cur->index + cur->n,
+				      LAZ_JSON_INDEX_WINDOW - cur->n);
+
+	while (cap - doc->count < cur->n) {
+		cap *= 2;
+	}
+
+	if (cap != doc->cap) {
+		doc->cap = cap;
+		doc->nodes = (struct json_node *)realloc_try(
+			doc->nodes, doc->cap * sizeof(*doc->nodes));
+	}
+}
+
+/* Makes the current and next structurals available, unless the document
+ * ends first. Returns 0 once there is no current one. */
+static LAZ_ALWAYS_INLINE int laz_json_advance(struct json_doc *doc,
+					     struct laz_json_cursor *cur)
+{
+	if (unlikely(cur->k + 1 >= cur->n && cur->ix.base < cur->ix.len)) {
+		laz_json_refill(doc, cur);
+	}
+
+	return cur->k < cur->n;
+}
+
+/* Adds the scalar at the current structural and moves past it, including the
+ * closing quote of strings. Returns -1 if invalid. */
+static LAZ_ALWAYS_INLINE int laz_json_scalar(struct json_doc *doc,
+					     struct laz_json_cursor *cur)
+{
+	size_t start = cur->index[cur->k];
+	size_t end = cur->k + 1 < cur->n ? cur->index[cur->k + 1] : cur->ix.len;
+	const char *p = doc->data + start;
+	size_t n = end - start;
+	size_t used = 0;
+	u32 type = JSON_NUMBER;
+
+	if (*p == '"') {
+		laz_json_add(doc, JSON_STRING, start + 1, n - 1);
+		cur->k += 2;
+		return 0;
+	}
+
+	if (n >= 4 && memcmp(p, "true", 4) == 0) {
+		type = JSON_TRUE;
+		used = 4;
+	} else if (n >= 5 && memcmp(p, "false", 5) == 0) {
+		type = JSON_FALSE;
+		used = 5;
+	} else if (n >= 4 && memcmp(p, "null", 4) == 0) {
+		type = JSON_NULL;
+		used = 4;
+	} else {
+		used = laz_json_number(p, n);
+	}
+
+	/* Only whitespace may come before the next structural, which usually
+	 * follows straight away */
+	for (size_t i = used; i < n; i++) {
+		if (p[i] != ' ' && p[i] != '\t' && p[i] != '\n' && p[i] != '\r') {
+			return -1;
+		}
+	}
+
+	if (used == 0) {
+		return -1;
+	}
+
+	laz_json_add(doc, type, start, used);
+	cur->k++;
+	return 0;
+}
+
+/* The current structural byte. Callers check laz_json_advance first. */
+#define LAZ_JSON_CHAR(doc, cur) ((doc)->data[(cur)->index[(cur)->k]])
+
+/* The innermost open container. Nodes move as the array grows, so it is
+ * found again every time. */
+#define LAZ_JSON_PARENT(doc, stack, depth) ((doc)->nodes[(stack)[(depth) - 1]])
+
+/* Stage two is a pushdown automaton whose states are the labels below */
+int json_parse(struct json_doc *doc, const char *data, size_t len)
+{
+	struct laz_json_cursor *cur =
+		(struct laz_json_cursor *)malloc_try(sizeof(*cur));
+	u32 *stack = NULL;
+	size_t depth = 0;
+	size_t stack_cap = 16;
+	int ret = -1;
+
+	memset(doc, 0, sizeof(*doc));
+	doc->data = data;
+
+	if (len >= UINT32_MAX) {
+		(void)errorf("Error: JSON documents are limited to 4 GiB\n");
+		free(cur);
+		return -1;
+	}
+
+	laz_json_indexer_init(&cur->ix, data, len);
+	cur->k = 0;
+	cur->n = 0;
+	/* Typical documents have a node every 8 to 16 bytes */
+	doc->cap = len / 16 + 16;
+	doc->nodes = (struct json_node *)malloc_try(doc->cap *
+						    sizeof(*doc->nodes));
+	stack = (u32 *)malloc_try(stack_cap * sizeof(*stack));
+
+	if (!laz_json_advance(doc, cur)) {
+		goto out;
+	}
+
+value:
+	switch (LAZ_JSON_CHAR(doc, cur)) {
+	case '{':
+	case '[':
+		if (depth == stack_cap) {
+			stack_cap *= 2;
+			stack = (u32 *)realloc_try(stack,
+						   stack_cap * sizeof(*stack));
+		}
+
+		stack[depth++] = (u32)doc->count;
+		laz_json_add(doc,
+			     LAZ_JSON_CHAR(doc, cur) == '{' ? JSON_OBJECT :
+							      JSON_ARRAY,
+			     cur->index[cur->k], 1);
+		cur->k++;
+
+		if (!laz_json_advance(doc, cur)) {
+			goto out;
+		}
+
+		if (LAZ_JSON_PARENT(doc, stack, depth).type == JSON_OBJECT) {
+			if (LAZ_JSON_CHAR(doc, cur) == '}') {
+				goto close;
+			}
+
+			goto key;
+		}
+
+		if (LAZ_JSON_CHAR(doc, cur) == ']') {
+			goto close;
+		}
+
+		LAZ_JSON_PARENT(doc, stack, depth).count++;
+		goto value;
+	case '}':
+	case ']':
+	case ':':
+	case ',':
+		goto out;
+	default:
+		if (laz_json_scalar(doc, cur) != 0) {
+			goto out;
+		}
+
+		goto after_value;
+	}
+
+key:
+	if (LAZ_JSON_CHAR(doc, cur) != '"') {
+		goto out;
+	}
+
+	LAZ_JSON_PARENT(doc, stack, depth).count++;
+	(void)laz_json_scalar(doc, cur);
+
+	if (!laz_json_advance(doc, cur) || LAZ_JSON_CHAR(doc, cur) != ':') {
+		goto out;
+	}
+
+	cur->k++;
+
+	if (!laz_json_advance(doc, cur)) {
+		goto out;
+	}
+
+	goto value;
+
+after_value:
+	if (depth == 0) {
+		/* Anything left after the root is an error */
+		ret = laz_json_advance(doc, cur) ? -1 : 0;
+		goto out;
+	}
+
+	if (!laz_json_advance(doc, cur)) {
+		goto out;
+	}
+
+	if (LAZ_JSON_CHAR(doc, cur) == ',') {
+		cur->k++;
+
+		if (!laz_json_advance(doc, cur)) {
+			goto out;
+		}
+
+		if (LAZ_JSON_PARENT(doc, stack, depth).type == JSON_OBJECT) {
+			goto key;
+		}
+
+		LAZ_JSON_PARENT(doc, stack, depth).count++;
+		goto value;
+	}
+
+	if (LAZ_JSON_CHAR(doc, cur) !=
+	    (LAZ_JSON_PARENT(doc, stack, depth).type == JSON_OBJECT ? '}' : ']')) {
+		goto out;
+	}
+
+close:
+	LAZ_JSON_PARENT(doc, stack, depth).len =
+		cur->index[cur->k] - LAZ_JSON_PARENT(doc, stack, depth).offset +
+		1;
+	LAZ_JSON_PARENT(doc, stack, depth).next = (u32)doc->count;
+	cur->k++;
+	depth--;
+	goto after_value;
+
+out:
+	if (cur->ix.string_carry != 0) {
+		(void)errorf("Error: unterminated JSON string\n");
+		ret = -1;
+	} else if (ret != 0) {
+		(void)errorf("Error: invalid JSON at byte %zu\n",
+			     cur->k < cur->n ? (size_t)cur->index[cur->k] : len);
+	}
+
+	if (ret != 0) {
+		json_destroy(doc);
+	}
+
+	free(stack);
+	free(cur);
+	return ret;
+}
+
+void json_destroy(struct json_doc *doc)
+{
+	free(doc->nodes);
+	memset(doc, 0, sizeof(*doc));
+}
+
+struct str_view json_text(const struct json_doc *doc, size_t node)
+{
+	return str_view_from(doc->data + doc->nodes[node].offset,
+			     doc->nodes[node].len);
+}
+
+size_t json_find(const struct json_doc *doc, size_t object, const char *key)
+{
+	struct str_view wanted = str_view_cstr(key);
+	size_t child = object + 1;
+
+	if (doc->nodes[object].type != JSON_OBJECT) {
+		return JSON_NONE;
+	}
+
+	for (u32 i = 0; i < doc->nodes[object].count; i++) {
+		if (str_view_eq(json_text(doc, child), wanted)) {
+			return child + 1;
+		}
+
+		child = doc->nodes[child + 1].next;
+	}
+
+	return JSON_NONE;
+}
+
+size_t json_at(const struct json_doc *doc, size_t array, size_t i)
+{
+	size_t child = array + 1;
+
+	if (doc->nodes[array].type != JSON_ARRAY ||
+	    i >= doc->nodes[array].count) {
+		return JSON_NONE;
+	}
+
+	for (; i > 0; i--) {
+		child = doc->nodes[child].next;
+	}
+
+	return child;
+}
+
+int json_i64(const struct json_doc *doc, size_t node, i64 *out)
+{
+	if (doc->nodes[node].type != JSON_NUMBER) {
+		return -1;
+	}
+
+	return parse_i64(json_text(doc, node), out);
+}
+
+int json_f64(const struct json_doc *doc, size_t node, double *out)
+{
+	if (doc->nodes[node].type != JSON_NUMBER) {
+		return -1;
+	}
+
+	return parse_f64(json_text(doc, node), out);
+}
+
+static int laz_json_hex4(const char *p, u32 *out)
+{
+	*out = 0;
+
+	for (unsigned i = 0; i < 4; i++) {
+		unsigned c = (unsigned char)p[i];
+		unsigned digit = c - '0';
+
+		if (digit > 9) {
+			digit = (c | 0x20) - 'a' + 10;
+
+			if (digit < 10 || digit > 15) {
+				return -1;
+			}
+		}
+
+		*out = *out << 4 | digit;
+	}
+
+	return 0;
+}
+
+static size_t laz_utf8_encode(u32 cp, char *out)
+{
+	if (cp < 0x80) {
+		out[0] = (char)cp;
+		return 1;
+	}
+
+	if (cp < 0x800) {
+		out[0] = (char)(0xc0 | cp >> 6);
+		out[1] = (char)(0x80 | (cp & 0x3f));
+		return 2;
+	}
+
+	if (cp < 0x10000) {
+		out[0] = (char)(0xe0 | cp >> 12);
+		out[1] = (char)(0x80 | (cp >> 6 & 0x3f));
+		out[2] = (char)(0x80 | (cp & 0x3f));
+		return 3;
+	}
+
+	out[0] = (char)(0xf0 | cp >> 18);
+	out[1] = (char)(0x80 | (cp >> 12 & 0x3f));
+	out[2] = (char)(0x80 | (cp >> 6 & 0x3f));
+	out[3] = (char)(0x80 | (cp & 0x3f));
+	return 4;
+}
+
+size_t json_unescape(struct str_view raw, char *out)
+{
+	const char *p = raw.data;
+	const char *end = raw.data + raw.len;
+	size_t len = 0;
+
+	while (p < end) {
+		unsigned char c = (unsigned char)*p++;
+		u32 cp = 0;
+		u32 low = 0;
+
+		if (c < 0x20 || (c == '\\' && p == end)) {
+			return JSON_NONE;
+		}
+
+		if (c != '\\') {
+			out[len++] = (char)c;
+			continue;
+		}
+
+		switch (*p++) {
+		case '"':
+			out[len++] = '"';
+			break;
+		case '\\':
+			out[len++] = '\\';
+			break;
+		case '/':
+			out[len++] = '/';
+			break;
+		case 'b':
+			out[len++] = '\b';
+			break;
+		case 'f':
+			out[len++] = '\f';
+			break;
+		case 'n':
+			out[len++] = '\n';
+			break;
+		case 'r':
+			out[len++] = '\r';
+			break;
+		case 't':
+			out[len++] = '\t';
+			break;
+		case 'u':
+			if (end - p < 4 || laz_json_hex4(p, &cp) != 0 ||
+			    (cp >= 0xdc00 && cp < 0xe000)) {
+				return JSON_NONE;
+			}
+
+			p += 4;
+
+			/* High surrogates pair with an escaped low one */
+			if (cp >= 0xd800 && cp < 0xdc00) {
+				if (end - p < 6 || p[0] != '\\' || p[1] != 'u' ||
+				    laz_json_hex4(p + 2, &low) != 0 ||
+				    low < 0xdc00 || low >= 0xe000) {
+					return JSON_NONE;
+				}
+
+				cp = 0x10000 + ((cp - 0xd800) << 10) +
+				     (low - 0xdc00);
+				p += 6;
+			}
+
+			len += laz_utf8_encode(cp, out + len);
+			break;
+		default:
+			return JSON_NONE;
+		}
+	}
+
+	return len;
+}
+
+/* The code point of the sequence at `p`, with `left` bytes available.
+ * Returns its length, or 0 if it is invalid. */
+static size_t laz_utf8_decode(const unsigned char *p, size_t left, u32 *cp)
+{
+	u32 c = p[0];
+
+	if (c < 0x80) {
+		*cp = c;
+		return 1;
+	}
+
+	if (c < 0xc2 || c > 0xf4) {
+		return 0;
+	}
+
+	if (c < 0xe0) {
+		if (left < 2 || (p[1] & 0xc0) != 0x80) {
+			return 0;
+		}
+
+		*cp = (c & 0x1f) << 6 | (u32)(p[1] & 0x3f);
+		return 2;
+	}
+
+	if (c < 0xf0) {
+		if (left < 3 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80) {
+			return 0;
+		}
+
+		*cp = (c & 0x0f) << 12 | (u32)(p[1] & 0x3f) << 6 |
+		      (u32)(p[2] & 0x3f);
+		return *cp >= 0x800 && (*cp < 0xd800 || *cp >= 0xe000) ? 3 : 0;
+	}
+
+	if (left < 4 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80 ||
+	    (p[3] & 0xc0) != 0x80) {
+		return 0;
+	}
+
+	*cp = (c & 0x07) << 18 | (u32)(p[1] & 0x3f) << 12 |
+	      (u32)(p[2] & 0x3f) << 6 | (u32)(p[3] & 0x3f);
+	return *cp >= 0x10000 && *cp <= 0x10ffff ? 4 : 0;
+}
+
+/* Length of the ASCII run at the start of `p`, counted in whole words of
+ * eight bytes. The loop bound keeps every read within `len`. */
+static size_t laz_utf8_ascii_words(const unsigned char *p, size_t len)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		u64 v = 0;
+
+		memcpy(&v, p + i, sizeof(v));
+
+		if ((v & 0x8080808080808080ULL) != 0) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+static int laz_utf8_validate_bytes(const unsigned char *p, size_t len)
+{
+	size_t i = 0;
+
+	while (i < len) {
+		u32 cp = 0;
+		size_t n = laz_utf8_decode(p + i, len - i, &cp);
+
+		if (n == 0) {
+			return -1;
+		}
+
+		i += n;
+	}
+
+	return 0;
+}
+
+static int laz_utf8_validate_sw(const unsigned char *p, size_t len)
+{
+	size_t i = 0;
+
+	while (i < len) {
+		u32 cp = 0;
+		size_t n = laz_utf8_ascii_words(p + i, len - i);
+
+		if (n > 0) {
+			i += n;
+			continue;
+		}
+
+		n = laz_utf8_decode(p + i, len - i, &cp);
+
+		if (n == 0) {
+			return -1;
+		}
+
+		i += n;
+	}
+
+	return 0;
+}
+
+#if defined(LAZ_SCAN_AVX2) || defined(LAZ_SCAN_NEON)
+/* Keiser and Lemire's lookup: each error a pair of bytes can show has a bit,
+ * set in three tables indexed by the high and low nibbles of the first byte
+ * and the high nibble of the second. The pair is invalid where all three
+ * agree. Bytes two and three after a three- or four-byte lead must be
+ * continuations, which the TWO_CONTS bit is flipped for. */
+#define LAZ_UTF8_TOO_SHORT (1 << 0)
+#define LAZ_UTF8_TOO_LONG (1 << 1)
+#define LAZ_UTF8_OVERLONG_3 (1 << 2)
+#define LAZ_UTF8_TOO_LARGE (1 << 3)
+#define LAZ_UTF8_SURROGATE (1 << 4)
+#define LAZ_UTF8_OVERLONG_2 (1 << 5)
+#define LAZ_UTF8_TOO_LARGE_1000 (1 << 6)
+#define LAZ_UTF8_OVERLONG_4 (1 << 6)
+#define LAZ_UTF8_TWO_CONTS (1 << 7)
+#define LAZ_UTF8_CARRY \
+	(LAZ_UTF8_TOO_SHORT | LAZ_UTF8_TOO_LONG | LAZ_UTF8_TWO_CONTS)
+#define LAZ_UTF8_HIGH_LOW \
+	(LAZ_UTF8_CARRY | LAZ_UTF8_TOO_LARGE | LAZ_UTF8_TOO_LARGE_1000)
+#define LAZ_UTF8_CONT \
+	(LAZ_UTF8_TOO_LONG | LAZ_UTF8_OVERLONG_2 | LAZ_UTF8_TWO_CONTS)
+
+static const unsigned char laz_utf8_byte1_high[16] = {
+	LAZ_UTF8_TOO_LONG, LAZ_UTF8_TOO_LONG, LAZ_UTF8_TOO_LONG,
+	LAZ_UTF8_TOO_LONG, LAZ_UTF8_TOO_LONG, LAZ_UTF8_TOO_LONG,
+	LAZ_UTF8_TOO_LONG, LAZ_UTF8_TOO_LONG, LAZ_UTF8_TWO_CONTS,
+	LAZ_UTF8_TWO_CONTS, LAZ_UTF8_TWO_CONTS, LAZ_UTF8_TWO_CONTS,
+	LAZ_UTF8_TOO_SHORT | LAZ_UTF8_OVERLONG_2, LAZ_UTF8_TOO_SHORT,
+	LAZ_UTF8_TOO_SHORT | LAZ_UTF8_OVERLONG_3 | LAZ_UTF8_SURROGATE,
+	LAZ_UTF8_TOO_SHORT | LAZ_UTF8_TOO_LARGE | LAZ_UTF8_TOO_LARGE_1000 |
+		LAZ_UTF8_OVERLONG_4
+};
+
+static const unsigned char laz_utf8_byte1_low[16] = {
+	LAZ_UTF8_CARRY | LAZ_UTF8_OVERLONG_3 | LAZ_UTF8_OVERLONG_2 |
+		LAZ_UTF8_OVERLONG_4,
+	LAZ_UTF8_CARRY | LAZ_UTF8_OVERLONG_2, LAZ_UTF8_CARRY, LAZ_UTF8_CARRY,
+	LAZ_UTF8_CARRY | LAZ_UTF8_TOO_LARGE, LAZ_UTF8_HIGH_LOW,
+	LAZ_UTF8_HIGH_LOW, LAZ_UTF8_HIGH_LOW, LAZ_UTF8_HIGH_LOW,
+	LAZ_UTF8_HIGH_LOW, LAZ_UTF8_HIGH_LOW, LAZ_UTF8_HIGH_LOW,
+	LAZ_UTF8_HIGH_LOW, LAZ_UTF8_HIGH_LOW | LAZ_UTF8_SURROGATE,
+	LAZ_UTF8_HIGH_LOW, LAZ_UTF8_HIGH_LOW
+};
+
+static const unsigned char laz_utf8_byte2_high[16] = {
+	LAZ_UTF8_TOO_SHORT, LAZ_UTF8_TOO_SHORT, LAZ_UTF8_TOO_SHORT,
+	LAZ_UTF8_TOO_SHORT, LAZ_UTF8_TOO_SHORT, LAZ_UTF8_TOO_SHORT,
+	LAZ_UTF8_TOO_SHORT, LAZ_UTF8_TOO_SHORT,
+	LAZ_UTF8_CONT | LAZ_UTF8_OVERLONG_3 | LAZ_UTF8_TOO_LARGE_1000 |
+		LAZ_UTF8_OVERLONG_4,
+	LAZ_UTF8_CONT | LAZ_UTF8_OVERLONG_3 | LAZ_UTF8_TOO_LARGE,
+	LAZ_UTF8_CONT | LAZ_UTF8_SURROGATE | LAZ_UTF8_TOO_LARGE,
+	LAZ_UTF8_CONT | LAZ_UTF8_SURROGATE | LAZ_UTF8_TOO_LARGE,
+	LAZ_UTF8_TOO_SHORT, LAZ_UTF8_TOO_SHORT, LAZ_UTF8_TOO_SHORT,
+	LAZ_UTF8_TOO_SHORT
+};
+
+/* Compared with saturation against the last three bytes of input, these
+ * leave something only where a sequence is cut short */
+static const unsigned char laz_utf8_incomplete[32] = {
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 0xf0 - 1, 0xe0 - 1, 0xc0 - 1
+};
+#endif
+
+#if defined(LAZ_SCAN_AVX2)
+/* The 32 bytes ending `n` before the end of `input`, `prev` coming before */
+#define LAZ_UTF8_PREV_AVX2(input, prev, n) \
+	_mm256_alignr_epi8(                \
+		(input), _mm256_permute2x128_si256((prev), (input), 0x21), 16 - (n))
+
+__attribute__((target("avx2"))) static __m256i
+laz_utf8_check_avx2(__m256i input, __m256i prev)
+{
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	const __m256i byte1_high = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)laz_utf8_byte1_high));
+	const __m256i byte1_low = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)laz_utf8_byte1_low));
+	const __m256i byte2_high = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)laz_utf8_byte2_high));
+	__m256i prev1 = LAZ_UTF8_PREV_AVX2(input, prev, 1);
+	__m256i prev2 = LAZ_UTF8_PREV_AVX2(input, prev, 2);
+	__m256i prev3 = LAZ_UTF8_PREV_AVX2(input, prev, 3);
+	__m256i special = _mm256_and_si256(
+		_mm256_and_si256(
+			_mm256_shuffle_epi8(
+				byte1_high,
+				_mm256_and_si256(_mm256_srli_epi16(prev1, 4),
+						 nibble)),
+			_mm256_shuffle_epi8(byte1_low,
+					    _mm256_and_si256(prev1, nibble))),
+		_mm256_shuffle_epi8(
+			byte2_high,
+			_mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+	__m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80));
+	__m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xf0 - 0x80));
+	__m256i must_continue =
+		_mm256_and_si256(_mm256_or_si256(third, fourth),
+				 _mm256_set1_epi8((char)0x80));
+
+	return _mm256_xor_si256(must_continue, special);
+}
+
+__attribute__((target("avx2"))) static int
+laz_utf8_validate_avx2(const unsigned char *p, size_t len)
+{
+	const __m256i max =
+		_mm256_loadu_si256((const __m256i *)laz_utf8_incomplete);
+	__m256i error = _mm256_setzero_si256();
+	__m256i prev = _mm256_setzero_si256();
+	__m256i incomplete = _mm256_setzero_si256();
+	__m256i input;
+	unsigned char tail[32];
+	size_t i = 0;
+
+	for (; i < len; i += 32) {
+		if (len - i >= 32) {
+			input = _mm256_loadu_si256((const __m256i *)(p + i));
+		} else {
+			/* Zeros end any sequence in the tail as too short */
+			memset(tail, 0, sizeof(tail));
+			memcpy(tail, p + i, len - i);
+			input = _mm256_loadu_si256((const __m256i *)tail);
+		}
+
+		/* ASCII can only be wrong after an unfinished sequence */
+		if (_mm256_movemask_epi8(input) == 0) {
+			error = _mm256_or_si256(error, incomplete);
+			incomplete = _mm256_setzero_si256();
+		} else {
+			error = _mm256_or_si256(error,
+						laz_utf8_check_avx2(input, prev));
+			incomplete = _mm256_subs_epu8(input, max);
+		}
+
+		prev = input;
+	}
+
+	error = _mm256_or_si256(error, incomplete);
+	return _mm256_testz_si256(error, error) ? 0 : -1;
+}
+#elif defined(LAZ_SCAN_NEON)
+static uint8x16_t laz_utf8_check_neon(uint8x16_t input, uint8x16_t prev)
+{
+	uint8x16_t prev1 = vextq_u8(prev, input, 15);
+	uint8x16_t prev2 = vextq_u8(prev, input, 14);
+	uint8x16_t prev3 = vextq_u8(prev, input, 13);
+	uint8x16_t special = vandq_u8(
+		vandq_u8(vqtbl1q_u8(vld1q_u8(laz_utf8_byte1_high),
+				    vshrq_n_u8(prev1, 4)),
+			 vqtbl1q_u8(vld1q_u8(laz_utf8_byte1_low),
+				    vandq_u8(prev1, vdupq_n_u8(0x0f)))),
+		vqtbl1q_u8(vld1q_u8(laz_utf8_byte2_high), vshrq_n_u8(input, 4)));
+	uint8x16_t third = vqsubq_u8(prev2, vdupq_n_u8(0xe0 - 0x80));
+	uint8x16_t fourth = vqsubq_u8(prev3, vdupq_n_u8(0xf0 - 0x80));
+	uint8x16_t must_continue =
+		vandq_u8(vorrq_u8(third, fourth), vdupq_n_u8(0x80));
+
+	return veorq_u8(must_continue, special);
+}
+
+static int laz_utf8_validate_neon(const unsigned char *p, size_t len)
+{
+	const uint8x16_t max = vld1q_u8(laz_utf8_incomplete + 16);
+	uint8x16_t error = vdupq_n_u8(0);
+	uint8x16_t prev = vdupq_n_u8(0);
+	uint8x16_t incomplete = vdupq_n_u8(0);
+	uint8x16_t input;
+	unsigned char tail[16];
+	size_t i = 0;
+
+	for (; i < len; i += 16) {
+		if (len - i >= 16) {
+			input = vld1q_u8(p + i);
+		} else {
+			/* Zeros end any sequence in the tail as too short */
+			memset(tail, 0, sizeof(tail));
+			memcpy(tail, p + i, len - i);
+			input = vld1q_u8(tail);
+		}
+
+		/* ASCII can only be wrong after an unfinished sequence */
+		if (vmaxvq_u8(input) < 0x80) {
+			error = vorrq_u8(error, incomplete);
+			incomplete = vdupq_n_u8(0);
+		} else {
+			error = vorrq_u8(error, laz_utf8_check_neon(input, prev));
+			incomplete = vqsubq_u8(input, max);
+		}
+
+		prev = input;
+	}
+
+	error = vorrq_u8(error, incomplete);
+	return vmaxvq_u8(error) == 0 ? 0 : -1;
+}
+#endif
+
+#if defined(LAZ_SCAN_NEON)
+static int (*laz_utf8_validate_kernel)(const unsigned char *, size_t) =
+	laz_utf8_validate_neon;
+#else
+static int (*laz_utf8_validate_kernel)(const unsigned char *, size_t) =
+	laz_utf8_validate_sw;
+#endif
+
+int utf8_validate(const void *buf, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)buf;
+
+	/* Short strings, like keys, are quicker without vectors or words */
+	if (len < 16) {
+		return laz_utf8_validate_bytes(p, len);
+	}
+
+	return laz_utf8_validate_kernel(p, len);
+}
+
+/* Bytes of `p` that start a sequence, plus those that start a four-byte one
+ * if `pairs` is set, as those become surrogate pairs. Eight bytes go at a
+ * time, counted in byte lanes. */
+static size_t laz_utf8_count(const unsigned char *p, size_t len, int pairs)
+{
+	const u64 high = 0x8080808080808080ULL;
+	size_t count = 0;
+	size_t i = 0;
+
+	while (i + 8 <= len) {
+		size_t end = i + 127 * 8 < len ? i + 127 * 8 : len;
+		u64 lanes = 0;
+
+		for (; i + 8 <= end; i += 8) {
+			u64 v = 0;
+
+			memcpy(&v, p + i, sizeof(v));
+			/* Anything but 10xxxxxx, and 1111xxxx */
+			lanes += ((~v | v << 1) & high) >> 7;
+
+			if (pairs) {
+				lanes += (v & v << 1 & v << 2 & v << 3 & high) >>
+					 7;
+			}
+		}
+
+		/* Lanes hold at most 254, summed in pairs before they would
+		 * overflow the top one */
+		lanes = (lanes & 0x00ff00ff00ff00ffULL) +
+			(lanes >> 8 & 0x00ff00ff00ff00ffULL);
+		count += (size_t)((lanes * 0x0001000100010001ULL) >> 48);
+	}
+
+	for (; i < len; i++) {
+		count += (p[i] & 0xc0) != 0x80;
+
+		if (pairs) {
+			count += p[i] >= 0xf0;
+		}
+	}
+
+	return count;
+}
+
+size_t utf16_length_from_utf8(const void *buf, size_t len)
+{
+	return laz_utf8_count((const unsigned char *)buf, len, 1);
+}
+
+size_t utf32_length_from_utf8(const void *buf, size_t len)
+{
+	return laz_utf8_count((const unsigned char *)buf, len, 0);
+}
+
+size_t utf8_length_from_utf16(const u16 *in, size_t len)
+{
+	size_t count = 0;
+
+	/* Surrogates come in pairs worth four bytes */
+	for (size_t i = 0; i < len; i++) {
+		count += 1 + (in[i] >= 0x80) + (in[i] >= 0x800) -
+			 (in[i] >= 0xd800 && in[i] < 0xe000);
+	}
+
+	return count;
+}
+
+size_t utf8_length_from_utf32(const u32 *in, size_t len)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		count += 1 + (in[i] >= 0x80) + (in[i] >= 0x800) +
+			 (in[i] >= 0x10000);
+	}
+
+	return count;
+}
+
+/* Decodes the sequence at `p`, which must be valid, without a branch on its
+ * length. Four bytes are read whatever the length, big-endian, with the bits
+ * of the sequence kept by the lead's high nibble. Two steps then close the
+ * gaps between byte pairs and between halves. */
+static LAZ_ALWAYS_INLINE u32 laz_utf8_decode_valid(const unsigned char *p)
+{
+	static const u32 keep[16] = {
+		0x7f000000, 0x7f000000, 0x7f000000, 0x7f000000,
+		0x7f000000, 0x7f000000, 0x7f000000, 0x7f000000,
+		0,	    0,		0,	    0,
+		0x1f3f0000, 0x1f3f0000, 0x0f3f3f00, 0x073f3f3f
+	};
+	static const u8 shift[16] = { 18, 18, 18, 18, 18, 18, 18, 18,
+				      0,  0,  0,  0,  12, 12, 6,  0 };
+	u32 w = (u32)p[0] << 24 | (u32)p[1] << 16 | (u32)p[2] << 8 | p[3];
+
+	w &= keep[p[0] >> 4];
+	w = (w & 0x00ff00ff) | (w & 0xff00ff00) >> 2;
+	w = (w & 0x0000ffff) | (w & 0xffff0000) >> 4;
+	return w >> shift[p[0] >> 4];
+}
+
+/* Writes `cp` as UTF-16 and returns the units it takes. Two are stored
+ * either way, so there must be room for a second. */
+static LAZ_ALWAYS_INLINE size_t laz_utf16_put(u32 cp, u16 *out)
+{
+	u32 pair = cp - 0x10000;
+	int wide = cp >= 0x10000;
+
+	out[0] = (u16)(wide ? 0xd800 | pair >> 10 : cp);
+	out[1] = (u16)(0xdc00 | (pair & 0x3ff));
+	return 1 + (size_t)wide;
+}
+
+/* Transcodes the valid sequences starting at the bytes of `p` set in
+ * `starts`, bit i << `shift` for byte i. Their positions come from the mask,
+ * so unlike a scan none waits for the length of the one before. */
+static LAZ_ALWAYS_INLINE size_t
+laz_utf8_to_utf16_starts(const unsigned char *p, u64 starts, unsigned shift,
+			 u16 *out, size_t n)
+{
+	for (; starts != 0; starts &= starts - 1) {
+		n += laz_utf16_put(
+			laz_utf8_decode_valid(p + (laz_ctz64(starts) >> shift)),
+			out + n);
+	}
+
+	return n;
+}
+
+static LAZ_ALWAYS_INLINE size_t
+laz_utf8_to_utf32_starts(const unsigned char *p, u64 starts, unsigned shift,
+			 u32 *out, size_t n)
+{
+	for (; starts != 0; starts &= starts - 1) {
+		out[n++] = laz_utf8_decode_valid(
+			p + (laz_ctz64(starts) >> shift));
+	}
+
+	return n;
+}
+
+/* The valid input left from `i`, which may be inside a sequence the kernel
+ * already wrote */
+static size_t laz_utf8_to_utf16_tail(const unsigned char *p, size_t i,
+				     size_t len, u16 *out, size_t n)
+{
+	for (; i < len && (p[i] & 0xc0) == 0x80; i++) {
+	}
+
+	while (i < len) {
+		u32 cp = 0;
+
+		i += laz_utf8_decode(p + i, len - i, &cp);
+
+		if (cp >= 0x10000) {
+			cp -= 0x10000;
+			out[n++] = (u16)(0xd800 | cp >> 10);
+			out[n++] = (u16)(0xdc00 | (cp & 0x3ff));
+		} else {
+			out[n++] = (u16)cp;
+		}
+	}
+
+	return n;
+}
+
+static size_t laz_utf8_to_utf32_tail(const unsigned char *p, size_t i,
+				     size_t len, u32 *out, size_t n)
+{
+	for (; i < len && (p[i] & 0xc0) == 0x80; i++) {
+	}
+
+	while (i < len) {
+		i += laz_utf8_decode(p + i, len - i, &out[n++]);
+	}
+
+	return n;
+}
+
+/* The kernels below take valid UTF-8 and return the units written. They
+ * stop a block short of the end, so that every sequence they decode can be
+ * read as four bytes and has another after it. */
+
+/* Bit 7 of each byte of the word at `p` that starts a sequence, which is
+ * every byte but 10xxxxxx */
+static u64 laz_utf8_starts_word(const unsigned char *p)
+{
+	u64 v = 0;
+
+	memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return (~v | v << 1) & 0x8080808080808080ULL;
+}
+
+static size_t laz_utf8_to_utf16_sw(const unsigned char *p, size_t len,
+				   u16 *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	for (; i + 16 <= len; i += 8) {
+		if (laz_utf8_ascii_words(p + i, 8) > 0) {
+			for (size_t k = 0; k < 8; k++) {
+				out[n + k] = p[i + k];
+			}
+
+			n += 8;
+			continue;
+		}
+
+		n = laz_utf8_to_utf16_starts(p + i, laz_utf8_starts_word(p + i),
+					     3, out, n);
+	}
+
+	return laz_utf8_to_utf16_tail(p, i, len, out, n);
+}
+
+static size_t laz_utf8_to_utf32_sw(const unsigned char *p, size_t len,
+				   u32 *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	for (; i + 16 <= len; i += 8) {
+		if (laz_utf8_ascii_words(p + i, 8) > 0) {
+			for (size_t k = 0; k < 8; k++) {
+				out[n + k] = p[i + k];
+			}
+
+			n += 8;
+			continue;
+		}
+
+		n = laz_utf8_to_utf32_starts(p + i, laz_utf8_starts_word(p + i),
+					     3, out, n);
+	}
+
+	return laz_utf8_to_utf32_tail(p, i, len, out, n);
+}
+
+#if defined(LAZ_SCAN_SSE2)
+/* Continuation bytes, 0x80 to 0xbf, are the ones below 0xc0 as signed */
+static u32 laz_utf8_starts_sse2(__m128i v)
+{
+	return ~(u32)_mm_movemask_epi8(
+		       _mm_cmplt_epi8(v, _mm_set1_epi8((char)0xc0))) &
+	       0xffff;
+}
+
+static size_t laz_utf8_to_utf16_sse2(const unsigned char *p, size_t len,
+				     u16 *out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	size_t n = 0;
+
+	for (; i + 32 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+
+		if (_mm_movemask_epi8(v) == 0) {
+			_mm_storeu_si128((__m128i *)(out + n),
+					 _mm_unpacklo_epi8(v, zero));
+			_mm_storeu_si128((__m128i *)(out + n + 8),
+					 _mm_unpackhi_epi8(v, zero));
+			n += 16;
+			continue;
+		}
+
+		n = laz_utf8_to_utf16_starts(p + i, laz_utf8_starts_sse2(v), 0,
+					     out, n);
+	}
+
+	return laz_utf8_to_utf16_tail(p, i, len, out, n);
+}
+
+static size_t laz_utf8_to_utf32_sse2(const unsigned char *p, size_t len,
+				     u32 *out)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	size_t n = 0;
+
+	for (; i + 32 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+
+		if (_mm_movemask_epi8(v) == 0) {
+			__m128i low = _mm_unpacklo_epi8(v, zero);
+			__m128i top = _mm_unpackhi_epi8(v, zero);
+
+			_mm_storeu_si128((__m128i *)(out + n),
+					 _mm_unpacklo_epi16(low, zero));
+			_mm_storeu_si128((__m128i *)(out + n + 4),
+					 _mm_unpackhi_epi16(low, zero));
+			_mm_storeu_si128((__m128i *)(out + n + 8),
+					 _mm_unpacklo_epi16(top, zero));
+			_mm_storeu_si128((__m128i *)(out + n + 12),
+					 _mm_unpackhi_epi16(top, zero));
+			n += 16;
+			continue;
+		}
+
+		n = laz_utf8_to_utf32_starts(p + i, laz_utf8_starts_sse2(v), 0,
+					     out, n);
+	}
+
+	return laz_utf8_to_utf32_tail(p, i, len, out, n);
+}
+
+/* Byte shuffles that move the 16-bit lanes set in the index to the front,
+ * in order. Filled in when AVX2 is picked. */
+static u8 laz_utf16_pack[256][16];
+/* Shuffles that take the first byte of each 16-bit lane, and the second
+ * where the mask has the lane's bit */
+static u8 laz_utf8_pack[256][16];
+
+static void laz_utf_pack_init(void)
+{
+	for (unsigned mask = 0; mask < 256; mask++) {
+		unsigned k = 0;
+		unsigned b = 0;
+
+		memset(laz_utf16_pack[mask], 0x80, 16);
+		memset(laz_utf8_pack[mask], 0x80, 16);
+
+		for (unsigned lane = 0; lane < 8; lane++) {
+			laz_utf8_pack[mask][b++] = (u8)(2 * lane);
+
+			if (mask >> lane & 1) {
+				laz_utf16_pack[mask][k++] = (u8)(2 * lane);
+				laz_utf16_pack[mask][k++] = (u8)(2 * lane + 1);
+				laz_utf8_pack[mask][b++] = (u8)(2 * lane + 1);
+			}
+		}
+	}
+}
+
+/* Bytes of `v` of at least `min` */
+__attribute__((target("avx2"))) static LAZ_ALWAYS_INLINE u32
+laz_utf8_at_least_avx2(__m128i v, unsigned char min)
+{
+	return (u32)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8((char)min)), v));
+}
+
+/* Decodes a block to UTF-16 packed at the front of each half, `starts`
+ * marking the bytes that begin a sequence. Each lane decodes the sequence
+ * its byte would start, and the lane after a four-byte lead holds the low
+ * surrogate. Leading continuations belong to a sequence already written,
+ * and one cut off at the end is left for the next block. Returns the bytes
+ * used and the units of each half. */
+__attribute__((target("avx2"))) static LAZ_ALWAYS_INLINE size_t
+laz_utf8_pack_avx2(__m128i v, u32 starts, __m256i *units, unsigned counts[2])
+{
+	__m256i first = _mm256_cvtepu8_epi16(v);
+	__m256i second = _mm256_cvtepu8_epi16(_mm_srli_si128(v, 1));
+	__m256i low6 = _mm256_set1_epi16(0x3f);
+	__m256i decoded = _mm256_blendv_epi8(
+		first,
+		_mm256_or_si256(
+			_mm256_slli_epi16(
+				_mm256_and_si256(first, _mm256_set1_epi16(0x1f)),
+				6),
+			_mm256_and_si256(second, low6)),
+		_mm256_cmpgt_epi16(first, _mm256_set1_epi16(0x7f)));
+	u32 leads = (u32)_mm_movemask_epi8(v) & starts;
+	u32 wide = laz_utf8_at_least_avx2(v, 0xe0);
+	u32 four = 0;
+	u32 cut = 0;
+	u32 used = 0;
+	u32 keep = 0;
+	__m256i shuffle;
+
+	/* Text of one and two bytes skips the longer sequences */
+	if (wide != 0) {
+		__m256i third = _mm256_cvtepu8_epi16(_mm_srli_si128(v, 2));
+		__m256i before = _mm256_cvtepu8_epi16(_mm_slli_si128(v, 1));
+		/* The shift out of 16 bits drops the lead's length bits */
+		__m256i three = _mm256_or_si256(
+			_mm256_or_si256(_mm256_slli_epi16(first, 12),
+					_mm256_slli_epi16(
+						_mm256_and_si256(second, low6),
+						6)),
+			_mm256_and_si256(third, low6));
+		/* Bits 10 to 20 of the code point, less 0x10000, and bits
+		 * 0 to 9 */
+		__m256i high = _mm256_add_epi16(
+			_mm256_or_si256(
+				_mm256_or_si256(
+					_mm256_slli_epi16(
+						_mm256_and_si256(
+							first,
+							_mm256_set1_epi16(7)),
+						8),
+					_mm256_slli_epi16(
+						_mm256_and_si256(second, low6),
+						2)),
+				_mm256_srli_epi16(
+					_mm256_and_si256(third, low6), 4)),
+			_mm256_set1_epi16((short)(0xd800 - 0x40)));
+		__m256i low = _mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_slli_epi16(
+					_mm256_and_si256(
+						second, _mm256_set1_epi16(0xf)),
+					6),
+				_mm256_and_si256(third, low6)),
+			_mm256_set1_epi16((short)0xdc00));
+
+		four = laz_utf8_at_least_avx2(v, 0xf0);
+		decoded = _mm256_blendv_epi8(
+			decoded, three,
+			_mm256_cmpgt_epi16(first, _mm256_set1_epi16(0xdf)));
+		decoded = _mm256_blendv_epi8(
+			decoded, high,
+			_mm256_cmpgt_epi16(first, _mm256_set1_epi16(0xef)));
+		decoded = _mm256_blendv_epi8(
+			decoded, low,
+			_mm256_cmpgt_epi16(before, _mm256_set1_epi16(0xef)));
+	}
+
+	/* Sequences that end past the block */
+	cut = (leads & 0x8000) | (wide & 0xc000) | (four & 0xe000);
+	used = cut != 0 ? laz_ctz64(cut) : 16;
+	keep = (starts | four << 1) & ((1U << used) - 1);
+	shuffle = _mm256_inserti128_si256(
+		_mm256_castsi128_si256(_mm_loadu_si128(
+			(const __m128i *)laz_utf16_pack[keep & 0xff])),
+		_mm_loadu_si128((const __m128i *)laz_utf16_pack[keep >> 8]), 1);
+	*units = _mm256_shuffle_epi8(decoded, shuffle);
+	counts[0] = laz_popcount64(keep & 0xff);
+	counts[1] = laz_popcount64(keep >> 8);
+	return used;
+}
+
+/* Blocks stop 48 bytes short of the end. The valid input left makes at
+ * least 12 more units, more than a packed block stores past its last. */
+__attribute__((target("avx2"))) static size_t
+laz_utf8_to_utf16_avx2(const unsigned char *p, size_t len, u16 *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	while (i + 64 <= len) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		u32 starts = laz_utf8_starts_sse2(v);
+		__m256i units;
+		unsigned counts[2];
+
+		if (_mm_movemask_epi8(v) == 0) {
+			_mm256_storeu_si256((__m256i *)(out + n),
+					    _mm256_cvtepu8_epi16(v));
+			i += 16;
+			n += 16;
+		} else {
+			i += laz_utf8_pack_avx2(v, starts, &units, counts);
+			_mm_storeu_si128((__m128i *)(out + n),
+					 _mm256_castsi256_si128(units));
+			_mm_storeu_si128((__m128i *)(out + n + counts[0]),
+					 _mm256_extracti128_si256(units, 1));
+			n += counts[0] + counts[1];
+		}
+	}
+
+	return laz_utf8_to_utf16_tail(p, i, len, out, n);
+}
+
+__attribute__((target("avx2"))) static size_t
+laz_utf8_to_utf32_avx2(const unsigned char *p, size_t len, u32 *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	while (i + 64 <= len) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		u32 starts = laz_utf8_starts_sse2(v);
+		__m256i units;
+		unsigned counts[2];
+
+		if (_mm_movemask_epi8(v) == 0) {
+			_mm256_storeu_si256((__m256i *)(out + n),
+					    _mm256_cvtepu8_epi32(v));
+			_mm256_storeu_si256(
+				(__m256i *)(out + n + 8),
+				_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+			i += 16;
+			n += 16;
+		} else if (laz_utf8_at_least_avx2(v, 0xf0) == 0) {
+			/* Code points past 16 bits need the scalar path */
+			i += laz_utf8_pack_avx2(v, starts, &units, counts);
+			_mm256_storeu_si256(
+				(__m256i *)(out + n),
+				_mm256_cvtepu16_epi32(
+					_mm256_castsi256_si128(units)));
+			_mm256_storeu_si256(
+				(__m256i *)(out + n + counts[0]),
+				_mm256_cvtepu16_epi32(
+					_mm256_extracti128_si256(units, 1)));
+			n += counts[0] + counts[1];
+		} else {
+			n = laz_utf8_to_utf32_starts(p + i, starts, 0, out, n);
+			i += 16;
+		}
+	}
+
+	return laz_utf8_to_utf32_tail(p, i, len, out, n);
+}
+#elif defined(LAZ_SCAN_NEON)
+/* Four bits per byte, as laz_neon_mask gives them */
+static u64 laz_utf8_starts_neon(uint8x16_t v)
+{
+	uint8x16_t lead = vcgeq_s8(vreinterpretq_s8_u8(v), vdupq_n_s8(-64));
+
+	return laz_neon_mask(lead) & 0x1111111111111111ULL;
+}
+
+static size_t laz_utf8_to_utf16_neon(const unsigned char *p, size_t len,
+				     u16 *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	for (; i + 32 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8(p + i);
+
+		if (vmaxvq_u8(v) < 0x80) {
+			vst1q_u16(out + n, vmovl_u8(vget_low_u8(v)));
+			vst1q_u16(out + n + 8, vmovl_high_u8(v));
+			n += 16;
+			continue;
+		}
+
+		n = laz_utf8_to_utf16_starts(p + i, laz_utf8_starts_neon(v), 2,
+					     out, n);
+	}
+
+	return laz_utf8_to_utf16_tail(p, i, len, out, n);
+}
+
+static size_t laz_utf8_to_utf32_neon(const unsigned char *p, size_t len,
+				     u32 *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	for (; i + 32 <= len; i += 16) {
+		uint8x16_t v = vld1q_u8(p + i);
+
+		if (vmaxvq_u8(v) < 0x80) {
+			uint16x8_t low = vmovl_u8(vget_low_u8(v));
+			uint16x8_t top = vmovl_high_u8(v);
+
+			vst1q_u32(out + n, vmovl_u16(vget_low_u16(low)));
+			vst1q_u32(out + n + 4, vmovl_high_u16(low));
+			vst1q_u32(out + n + 8, vmovl_u16(vget_low_u16(top)));
+			vst1q_u32(out + n + 12, vmovl_high_u16(top));
+			n += 16;
+			continue;
+		}
+
+		n = laz_utf8_to_utf32_starts(p + i, laz_utf8_starts_neon(v), 2,
+					     out, n);
+	}
+
+	return laz_utf8_to_utf32_tail(p, i, len, out, n);
+}
+#endif
+
+static size_t (*laz_utf8_to_utf16_kernel)(const unsigned char *, size_t,
+					  u16 *) =
+	LAZ_SCAN_BASELINE(utf8_to_utf16);
+static size_t (*laz_utf8_to_utf32_kernel)(const unsigned char *, size_t,
+					  u32 *) =
+	LAZ_SCAN_BASELINE(utf8_to_utf32);
+
+/* Validating first, at the validator's speed, lets the kernels decode
+ * without checks */
+size_t utf8_to_utf16(const void *buf, size_t len, u16 *out)
+{
+	const unsigned char *p = (const unsigned char *)buf;
+
+	if (utf8_validate(p, len) != 0) {
+		return UTF_INVALID;
+	}
+
+	return laz_utf8_to_utf16_kernel(p, len, out);
+}
+
+size_t utf8_to_utf32(const void *buf, size_t len, u32 *out)
+{
+	const unsigned char *p = (const unsigned char *)buf;
+
+	if (utf8_validate(p, len) != 0) {
+		return UTF_INVALID;
+	}
+
+	return laz_utf8_to_utf32_kernel(p, len, out);
+}
+
+/* Appends the encoding of `len` units to out + n and returns the new
+ * length */
+static LAZ_ALWAYS_INLINE size_t
+laz_utf16_to_utf8_run(const u16 *in, size_t len, char *out, size_t n)
+{
+	for (size_t i = 0; i < len; i++) {
+		u32 cp = in[i];
+
+		if (cp < 0x80) {
+			out[n++] = (char)cp;
+			continue;
+		}
+
+		if (cp >= 0xd800 && cp < 0xe000) {
+			if (cp >= 0xdc00 || i + 1 == len || in[i + 1] < 0xdc00 ||
+			    in[i + 1] >= 0xe000) {
+				return UTF_INVALID;
+			}
+
+			cp = 0x10000 + ((cp - 0xd800) << 10) +
+			     ((u32)in[++i] - 0xdc00);
+		}
+
+		n += laz_utf8_encode(cp, out + n);
+	}
+
+	return n;
+}
+
+static LAZ_ALWAYS_INLINE size_t
+laz_utf32_to_utf8_run(const u32 *in, size_t len, char *out, size_t n)
+{
+	for (size_t i = 0; i < len; i++) {
+		u32 cp = in[i];
+
+		if (cp > 0x10ffff || (cp >= 0xd800 && cp < 0xe000)) {
+			return UTF_INVALID;
+		}
+
+		n += laz_utf8_encode(cp, out + n);
+	}
+
+	return n;
+}
+
+static size_t laz_utf16_to_utf8_sw(const u16 *in, size_t len, char *out)
+{
+	return laz_utf16_to_utf8_run(in, len, out, 0);
+}
+
+static size_t laz_utf32_to_utf8_sw(const u32 *in, size_t len, char *out)
+{
+	return laz_utf32_to_utf8_run(in, len, out, 0);
+}
+
+/* Units from `i` for the scalar path once a block misses the SIMD ones.
+ * Mixed text misses most, so the run goes on past the block, and takes
+ * the low half of a pair it would cut. */
+static LAZ_ALWAYS_INLINE size_t laz_utf16_scalar_units(const u16 *in,
+							size_t i, size_t len)
+{
+	size_t k = len - i < 32 ? len - i : 32;
+
+	return k + (in[i + k - 1] >= 0xd800 && in[i + k - 1] < 0xdc00 &&
+		    i + k < len);
+}
+
+/* The SIMD kernels take eight units at a time when all are ASCII or all
+ * encode to two bytes, neither of which can be a surrogate or out of
+ * range, and encode any other block one code point at a time. */
+#if defined(LAZ_SCAN_SSE2)
+/* Units from 0x80 to 0x7ff as a lead byte and a continuation each */
+static LAZ_ALWAYS_INLINE __m128i laz_utf8_encode_two_sse2(__m128i v)
+{
+	__m128i low = _mm_and_si128(v, _mm_set1_epi16(0x3f));
+
+	return _mm_or_si128(
+		_mm_or_si128(_mm_srli_epi16(v, 6), _mm_slli_epi16(low, 8)),
+		_mm_set1_epi16((short)0x80c0));
+}
+
+/* Encodes eight units below 0x800, or returns 0 to leave them to the
+ * scalar path */
+static LAZ_ALWAYS_INLINE size_t laz_utf8_encode_block_sse2(__m128i v,
+							    char *out)
+{
+	__m128i zero = _mm_setzero_si128();
+
+	if (_mm_movemask_epi8(_mm_cmpeq_epi16(
+		    _mm_and_si128(v, _mm_set1_epi16((short)0xff80)),
+		    zero)) == 0xffff) {
+		_mm_storel_epi64((__m128i *)out, _mm_packus_epi16(v, v));
+		return 8;
+	}
+
+	if (_mm_movemask_epi8(_mm_cmpeq_epi16(
+		    _mm_and_si128(v, _mm_set1_epi16((short)0xf800)),
+		    zero)) == 0xffff &&
+	    _mm_movemask_epi8(_mm_cmplt_epi16(v, _mm_set1_epi16(0x80))) == 0) {
+		_mm_storeu_si128((__m128i *)out, laz_utf8_encode_two_sse2(v));
+		return 16;
+	}
+
+	return 0;
+}
+
+static size_t laz_utf16_to_utf8_sse2(const u16 *in, size_t len, char *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	while (i + 8 <= len) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+		size_t k = laz_utf8_encode_block_sse2(v, out + n);
+
+		if (k != 0) {
+			i += 8;
+			n += k;
+			continue;
+		}
+
+		k = laz_utf16_scalar_units(in, i, len);
+		n = laz_utf16_to_utf8_run(in + i, k, out, n);
+		i += k;
+
+		if (n == UTF_INVALID) {
+			return UTF_INVALID;
+		}
+	}
+
+	return laz_utf16_to_utf8_run(in + i, len - i, out, n);
+}
+
+static size_t laz_utf32_to_utf8_sse2(const u32 *in, size_t len, char *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	while (i + 8 <= len) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(in + i + 4));
+		/* Saturating keeps units past 16 bits out of both blocks */
+		size_t k = laz_utf8_encode_block_sse2(_mm_packs_epi32(a, b),
+						      out + n);
+
+		if (k != 0) {
+			i += 8;
+			n += k;
+			continue;
+		}
+
+		k = len - i < 32 ? len - i : 32;
+		n = laz_utf32_to_utf8_run(in + i, k, out, n);
+		i += k;
+
+		if (n == UTF_INVALID) {
+			return UTF_INVALID;
+		}
+	}
+
+	return laz_utf32_to_utf8_run(in + i, len - i, out, n);
+}
+
+#if defined(LAZ_SCAN_AVX2)
+/* Encodes 16 units below 0x800, or returns 0 to leave them to the scalar
+ * path. Text mixing one and two bytes packs through laz_utf8_pack, with
+ * stores up to 8 bytes past the end. */
+__attribute__((target("avx2"))) static LAZ_ALWAYS_INLINE size_t
+laz_utf8_encode_block_avx2(__m256i v, char *out)
+{
+	__m256i wide = _mm256_cmpgt_epi16(v, _mm256_set1_epi16(0x7f));
+	__m256i bytes;
+	__m256i shuffle;
+	u32 mask = 0;
+	size_t first = 0;
+
+	if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(
+		    _mm256_and_si256(v, _mm256_set1_epi16((short)0xf800)),
+		    _mm256_setzero_si256())) != -1) {
+		return 0;
+	}
+
+	mask = (u32)_mm256_movemask_epi8(
+		_mm256_packs_epi16(wide, _mm256_setzero_si256()));
+
+	if (mask == 0) {
+		bytes = _mm256_packus_epi16(v, v);
+		bytes = _mm256_permute4x64_epi64(bytes, 0x08);
+		_mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(bytes));
+		return 16;
+	}
+
+	/* Lead bytes, or ASCII, then continuations in the upper halves */
+	bytes = _mm256_or_si256(
+		_mm256_blendv_epi8(v,
+				   _mm256_or_si256(_mm256_srli_epi16(v, 6),
+						   _mm256_set1_epi16(0xc0)),
+				   wide),
+		_mm256_slli_epi16(
+			_mm256_or_si256(
+				_mm256_and_si256(v, _mm256_set1_epi16(0x3f)),
+				_mm256_set1_epi16(0x80)),
+			8));
+	shuffle = _mm256_inserti128_si256(
+		_mm256_castsi128_si256(_mm_loadu_si128(
+			(const __m128i *)laz_utf8_pack[mask & 0xff])),
+		_mm_loadu_si128((const __m128i *)laz_utf8_pack[mask >> 16]), 1);
+	bytes = _mm256_shuffle_epi8(bytes, shuffle);
+	first = 8 + laz_popcount64(mask & 0xff);
+	_mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(bytes));
+	_mm_storeu_si128((__m128i *)(out + first),
+			 _mm256_extracti128_si256(bytes, 1));
+	return first + 8 + laz_popcount64(mask >> 16);
+}
+
+/* Blocks stop 8 units short of the end, whose bytes cover a block's
+ * overrun */
+__attribute__((target("avx2"))) static size_t
+laz_utf16_to_utf8_avx2(const u16 *in, size_t len, char *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	while (i + 24 <= len) {
+		size_t k = laz_utf8_encode_block_avx2(
+			_mm256_loadu_si256((const __m256i *)(in + i)), out + n);
+
+		if (k != 0) {
+			i += 16;
+			n += k;
+			continue;
+		}
+
+		k = laz_utf16_scalar_units(in, i, len);
+		n = laz_utf16_to_utf8_run(in + i, k, out, n);
+		i += k;
+
+		if (n == UTF_INVALID) {
+			return UTF_INVALID;
+		}
+	}
+
+	return laz_utf16_to_utf8_run(in + i, len - i, out, n);
+}
+
+__attribute__((target("avx2"))) static size_t
+laz_utf32_to_utf8_avx2(const u32 *in, size_t len, char *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	while (i + 24 <= len) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(in + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(in + i + 8));
+		/* Saturating keeps units past 16 bits out of both blocks */
+		__m256i v = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b),
+						     0xd8);
+		size_t k = laz_utf8_encode_block_avx2(v, out + n);
+
+		if (k != 0) {
+			i += 16;
+			n += k;
+			continue;
+		}
+
+		k = len - i < 32 ? len - i : 32;
+		n = laz_utf32_to_utf8_run(in + i, k, out, n);
+		i += k;
+
+		if (n == UTF_INVALID) {
+			return UTF_INVALID;
+		}
+	}
+
+	return laz_utf32_to_utf8_run(in + i, len - i, out, n);
+}
+#endif
+#elif defined(LAZ_SCAN_NEON)
+/* Encodes eight units, or returns 0 to leave them to the scalar path */
+static LAZ_ALWAYS_INLINE size_t laz_utf8_encode_block_neon(uint16x8_t v,
+							    char *out)
+{
+	u16 top = vmaxvq_u16(v);
+
+	if (top < 0x80) {
+		vst1_u8((uint8_t *)out, vmovn_u16(v));
+		return 8;
+	}
+
+	if (top < 0x800 && vminvq_u16(v) >= 0x80) {
+		uint16x8_t two = vorrq_u16(
+			vorrq_u16(vshrq_n_u16(v, 6),
+				  vshlq_n_u16(vandq_u16(v, vdupq_n_u16(0x3f)),
+					      8)),
+			vdupq_n_u16(0x80c0));
+
+		vst1q_u8((uint8_t *)out, vreinterpretq_u8_u16(two));
+		return 16;
+	}
+
+	return 0;
+}
+
+static size_t laz_utf16_to_utf8_neon(const u16 *in, size_t len, char *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	while (i + 8 <= len) {
+		size_t k =
+			laz_utf8_encode_block_neon(vld1q_u16(in + i), out + n);
+
+		if (k != 0) {
+			i += 8;
+			n += k;
+			continue;
+		}
+
+		k = laz_utf16_scalar_units(in, i, len);
+		n = laz_utf16_to_utf8_run(in + i, k, out, n);
+		i += k;
+
+		if (n == UTF_INVALID) {
+			return UTF_INVALID;
+		}
+	}
+
+	return laz_utf16_to_utf8_run(in + i, len - i, out, n);
+}
+
+static size_t laz_utf32_to_utf8_neon(const u32 *in, size_t len, char *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	while (i + 8 <= len) {
+		uint32x4_t a = vld1q_u32(in + i);
+		uint32x4_t b = vld1q_u32(in + i + 4);
+		size_t k = 0;
+
+		if (vmaxvq_u32(vmaxq_u32(a, b)) < 0x800) {
+			uint16x8_t v = vcombine_u16(vmovn_u32(a), vmovn_u32(b));
+
+			k = laz_utf8_encode_block_neon(v, out + n);
+		}
+
+		if (k != 0) {
+			i += 8;
+			n += k;
+			continue;
+		}
+
+		k = len - i < 32 ? len - i : 32;
+		n = laz_utf32_to_utf8_run(in + i, k, out, n);
+		i += k;
+
+		if (n == UTF_INVALID) {
+			return UTF_INVALID;
+		}
+	}
+
+	return laz_utf32_to_utf8_run(in + i, len - i, out, n);
+}
+#endif
+
+static size_t (*laz_utf16_to_utf8_kernel)(const u16 *, size_t, char *) =
+	LAZ_SCAN_BASELINE(utf16_to_utf8);
+static size_t (*laz_utf32_to_utf8_kernel)(const u32 *, size_t, char *) =
+	LAZ_SCAN_BASELINE(utf32_to_utf8);
+
+size_t utf16_to_utf8(const u16 *in, size_t len, char *out)
+{
+	return laz_utf16_to_utf8_kernel(in, len, out);
+}
+
+size_t utf32_to_utf8(const u32 *in, size_t len, char *out)
+{
+	return laz_utf32_to_utf8_kernel(in, len, out);
+}
+
+static const u32 laz_crc32c_table[256] = {
+	0x00000000U, 0xf26b8303U, 0xe13b70f7U, 0x1350f3f4U, 0xc79a971fU, 0x35f1141cU,
+	0x26a1e7e8U, 0xd4ca64ebU, 0x8ad958cfU, 0x78b2dbccU, 0x6be22838U, 0x9989ab3bU,
+	0x4d43cfd0U, 0xbf284cd3U, 0xac78bf27U, 0x5e133c24U, 0x105ec76fU, 0xe235446cU,
+	0xf165b798U, 0x030e349bU, 0xd7c45070U, 0x25afd373U, 0x36ff2087U, 0xc494a384U,
+	0x9a879fa0U, 0x68ec1ca3U, 0x7bbcef57U, 0x89d76c54U, 0x5d1d08bfU, 0xaf768bbcU,
+	0xbc267848U, 0x4e4dfb4bU, 0x20bd8edeU, 0xd2d60dddU, 0xc186fe29U, 0x33ed7d2aU,
+	0xe72719c1U, 0x154c9ac2U, 0x061c6936U, 0xf477ea35U, 0xaa64d611U, 0x580f5512U,
+	0x4b5fa6e6U, 0xb93425e5U, 0x6dfe410eU, 0x9f95c20dU, 0x8cc531f9U, 0x7eaeb2faU,
+	0x30e349b1U, 0xc288cab2U, 0xd1d83946U, 0x23b3ba45U, 0xf779deaeU, 0x05125dadU,
+	0x1642ae59U, 0xe4292d5aU, 0xba3a117eU, 0x4851927dU, 0x5b016189U, 0xa96ae28aU,
+	0x7da08661U, 0x8fcb0562U, 0x9c9bf696U, 0x6ef07595U, 0x417b1dbcU, 0xb3109ebfU,
+	0xa0406d4bU, 0x522bee48U, 0x86e18aa3U, 0x748a09a0U, 0x67dafa54U, 0x95b17957U,
+	0xcba24573U, 0x39c9c670U, 0x2a993584U, 0xd8f2b687U, 0x0c38d26cU, 0xfe53516fU,
+	0xed03a29bU, 0x1f682198U, 0x5125dad3U, 0xa34e59d0U, 0xb01eaa24U, 0x42752927U,
+	0x96bf4dccU, 0x64d4cecfU, 0x77843d3bU, 0x85efbe38U, 0xdbfc821cU, 0x2997011fU,
+	0x3ac7f2ebU, 0xc8ac71e8U, 0x1c661503U, 0xee0d9600U, 0xfd5d65f4U, 0x0f36e6f7U,
+	0x61c69362U, 0x93ad1061U, 0x80fde395U, 0x72966096U, 0xa65c047dU, 0x5437877eU,
+	0x4767748aU, 0xb50cf789U, 0xeb1fcbadU, 0x197448aeU, 0x0a24bb5aU, 0xf84f3859U,
+	0x2c855cb2U, 0xdeeedfb1U, 0xcdbe2c45U, 0x3fd5af46U, 0x7198540dU, 0x83f3d70eU,
+	0x90a324faU, 0x62c8a7f9U, 0xb602c312U, 0x44694011U, 0x5739b3e5U, 0xa55230e6U,
+	0xfb410cc2U, 0x092a8fc1U, 0x1a7a7c35U, 0xe811ff36U, 0x3cdb9bddU, 0xceb018deU,
+	0xdde0eb2aU, 0x2f8b6829U, 0x82f63b78U, 0x709db87bU, 0x63cd4b8fU, 0x91a6c88cU,
+	0x456cac67U, 0xb7072f64U, 0xa457dc90U, 0x563c5f93U, 0x082f63b7U, 0xfa44e0b4U,
+	0xe9141340U, 0x1b7f9043U, 0xcfb5f4a8U, 0x3dde77abU, 0x2e8e845fU, 0xdce5075cU,
+	0x92a8fc17U, 0x60c37f14U, 0x73938ce0U, 0x81f80fe3U, 0x55326b08U, 0xa759e80bU,
+	0xb4091bffU, 0x466298fcU, 0x1871a4d8U, 0xea1a27dbU, 0xf94ad42fU, 0x0b21572cU,
+	0xdfeb33c7U, 0x2d80b0c4U, 0x3ed04330U, 0xccbbc033U, 0xa24bb5a6U, 0x502036a5U,
+	0x4370c551U, 0xb11b4652U, 0x65d122b9U, 0x97baa1baU, 0x84ea524eU, 0x7681d14dU,
+	0x2892ed69U, 0xdaf96e6aU, 0xc9a99d9eU, 0x3bc21e9dU, 0xef087a76U, 0x1d63f975U,
+	0x0e330a81U, 0xfc588982U, 0xb21572c9U, 0x407ef1caU, 0x532e023eU, 0xa145813dU,
+	0x758fe5d6U, 0x87e466d5U, 0x94b49521U, 0x66df1622U, 0x38cc2a06U, 0xcaa7a905U,
+	0xd9f75af1U, 0x2b9cd9f2U, 0xff56bd19U, 0x0d3d3e1aU, 0x1e6dcdeeU, 0xec064eedU,
+	0xc38d26c4U, 0x31e6a5c7U, 0x22b65633U, 0xd0ddd530U, 0x0417b1dbU, 0xf67c32d8U,
+	0xe52cc12cU, 0x1747422fU, 0x49547e0bU, 0xbb3ffd08U, 0xa86f0efcU, 0x5a048dffU,
+	0x8ecee914U, 0x7ca56a17U, 0x6ff599e3U, 0x9d9e1ae0U, 0xd3d3e1abU, 0x21b862a8U,
+	0x32e8915cU, 0xc083125fU, 0x144976b4U, 0xe622f5b7U, 0xf5720643U, 0x07198540U,
+	0x590ab964U, 0xab613a67U, 0xb831c993U, 0x4a5a4a90U, 0x9e902e7bU, 0x6cfbad78U,
+	0x7fab5e8cU, 0x8dc0dd8fU, 0xe330a81aU, 0x115b2b19U, 0x020bd8edU, 0xf0605beeU,
+	0x24aa3f05U, 0xd6c1bc06U, 0xc5914ff2U, 0x37faccf1U, 0x69e9f0d5U, 0x9b8273d6U,
+	0x88d28022U, 0x7ab90321U, 0xae7367caU, 0x5c18e4c9U, 0x4f48173dU, 0xbd23943eU,
+	0xf36e6f75U, 0x0105ec76U, 0x12551f82U, 0xe03e9c81U, 0x34f4f86aU, 0xc69f7b69U,
+	0xd5cf889dU, 0x27a40b9eU, 0x79b737baU, 0x8bdcb4b9U, 0x988c474dU, 0x6ae7c44eU,
+	0xbe2da0a5U, 0x4c4623a6U, 0x5f16d052U, 0xad7d5351U,
+};
+
+static u32 laz_crc32c_sw(u32 crc, const unsigned char *p, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		crc = laz_crc32c_table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+	}
+
+	return crc;
+}
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define LAZ_CRC32C_SSE42
+
+__attribute__((target("sse4.2"))) static u32
+laz_crc32c_sse42(u32 crc, const unsigned char *p, size_t len)
+{
+	u64 crc64 = crc;
+
+	for (; len >= 8; len -= 8, p += 8) {
+		u64 word = 0;
+
+		memcpy(&word, p, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+	}
+
+	crc = (u32)crc64;
+
+	for (; len > 0; len--, p++) {
+		crc = _mm_crc32_u8(crc, *p);
+	}
+
+	return crc;
+}
+#elif ((defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)) || \
+	defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define LAZ_CRC32C_ARM
+
+/* The CRC32 instructions are optional before ARMv8.1, so on AArch64 they are
+ * compiled in regardless of the target and only used when detected */
+#if defined(__ARM_FEATURE_CRC32)
+#define LAZ_TARGET_CRC
+#else
+#define LAZ_TARGET_CRC __attribute__((target("+crc")))
+#endif
+
+LAZ_TARGET_CRC static u32 laz_crc32c_arm(u32 crc, const unsigned char *p,
+					 size_t len)
+{
+	for (; len >= 8; len -= 8, p += 8) {
+		u64 word = 0;
+
+		memcpy(&word, p, sizeof(word));
+		crc = __crc32cd(crc, word);
+	}
+
+	for (; len > 0; len--, p++) {
+		crc = __crc32cb(crc, *p);
+	}
+
+	return crc;
+}
+#endif
+
+#if defined(LAZ_CRC32C_ARM) && defined(__ARM_FEATURE_CRC32)
+static u32 (*laz_crc32c_kernel)(u32, const unsigned char *, size_t) =
+	laz_crc32c_arm;
+#else
+static u32 (*laz_crc32c_kernel)(u32, const unsigned char *, size_t) =
+	laz_crc32c_sw;
+#endif
+
+u32 crc32c_update(u32 crc, const void *buf, size_t len)
+{
+	return ~laz_crc32c_kernel(~crc, (const unsigned char *)buf, len);
+}
+
+u32 crc32c_buf(const void *buf, size_t len)
+{
+	return crc32c_update(0, buf, len);
+}
+
+#if defined(LAZ_SCAN_SSE2)
+static unsigned laz_cpu_detect(void)
+{
+	unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+	/* SSE2 is part of x86-64 */
+	unsigned features = CPU_FEATURE_SSE2;
+	u32 xcr0 = 0;
+
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+		return features;
+	}
+
+	if (ecx & bit_SSE4_2) {
+		features |= CPU_FEATURE_SSE4_2;
+	}
+
+	/* AVX code faults unless the OS saves the upper halves of the
+	 * registers, which it reports in XCR0 */
+	if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX)) {
+		u32 high = 0;
+
+		__asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(high) : "c"(0));
+	}
+
+	if ((xcr0 & 6) == 6 && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) &&
+	    (ebx & bit_AVX2)) {
+		features |= CPU_FEATURE_AVX2;
+	}
+
+	return features;
+}
+#elif defined(__aarch64__)
+#if defined(__linux__) && !defined(HWCAP_CRC32)
+#define HWCAP_CRC32 (1 << 7)
+#endif
+
+static unsigned laz_cpu_detect(void)
+{
+	/* Advanced SIMD is part of AArch64 */
+	unsigned features = CPU_FEATURE_NEON;
+
+#if defined(__linux__)
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+		features |= CPU_FEATURE_CRC32;
+	}
+#elif defined(__ARM_FEATURE_CRC32)
+	features |= CPU_FEATURE_CRC32;
+#endif
+	return features;
+}
+#else
+static unsigned laz_cpu_detect(void)
+{
+#if defined(__ARM_FEATURE_CRC32)
+	return CPU_FEATURE_CRC32;
+#else
+	return 0;
+#endif
+}
+#endif
+
+/* Points every kernel at the best version for `features`. Versions this
+ * build did not compile in are simply never picked. */
+static void laz_cpu_dispatch(unsigned features)
+{
+	laz_scan_byte_kernel = laz_scan_byte_sw;
+	laz_scan_any_kernel = laz_scan_any_sw;
+	laz_count_byte_kernel = laz_count_byte_sw;
+	laz_strlen_kernel = laz_strlen_sw;
+	laz_json_index_kernel = laz_json_index_sw;
+	laz_utf8_validate_kernel = laz_utf8_validate_sw;
+	laz_utf8_to_utf16_kernel = laz_utf8_to_utf16_sw;
+	laz_utf8_to_utf32_kernel = laz_utf8_to_utf32_sw;
+	laz_utf16_to_utf8_kernel = laz_utf16_to_utf8_sw;
+	laz_utf32_to_utf8_kernel = laz_utf32_to_utf8_sw;
+	laz_crc32c_kernel = laz_crc32c_sw;
+
+#if defined(LAZ_SCAN_SSE2)
+	if (features & CPU_FEATURE_SSE2) {
+		laz_scan_byte_kernel = laz_scan_byte_sse2;
+		laz_scan_any_kernel = laz_scan_any_sse2;
+		laz_count_byte_kernel = laz_count_byte_sse2;
+		laz_strlen_kernel = laz_strlen_sse2;
+		laz_json_index_kernel = laz_json_index_sse2;
+		laz_utf8_to_utf16_kernel = laz_utf8_to_utf16_sse2;
+		laz_utf8_to_utf32_kernel = laz_utf8_to_utf32_sse2;
+		laz_utf16_to_utf8_kernel = laz_utf16_to_utf8_sse2;
+		laz_utf32_to_utf8_kernel = laz_utf32_to_utf8_sse2;
+	}
+
+	if (features & CPU_FEATURE_AVX2) {
+		laz_scan_byte_kernel = laz_scan_byte_avx2;
+		laz_scan_any_kernel = laz_scan_any_avx2;
+		laz_count_byte_kernel = laz_count_byte_avx2;
+		laz_strlen_kernel = laz_strlen_avx2;
+		laz_json_index_kernel = laz_json_index_avx2;
+		laz_utf8_validate_kernel = laz_utf8_validate_avx2;
+		laz_utf_pack_init();
+		laz_utf8_to_utf16_kernel = laz_utf8_to_utf16_avx2;
+		laz_utf8_to_utf32_kernel = laz_utf8_to_utf32_avx2;
+		laz_utf16_to_utf8_kernel = laz_utf16_to_utf8_avx2;
+		laz_utf32_to_utf8_kernel = laz_utf32_to_utf8_avx2;
+	}
+#elif defined(LAZ_SCAN_NEON)
+	if (features & CPU_FEATURE_NEON) {
+		laz_scan_byte_kernel = laz_scan_byte_neon;
+		laz_scan_any_kernel = laz_scan_any_neon;
+		laz_count_byte_kernel = laz_count_byte_neon;
+		laz_strlen_kernel = laz_strlen_neon;
+		laz_json_index_kernel = laz_json_index_neon;
+		laz_utf8_validate_kernel = laz_utf8_validate_neon;
+		laz_utf8_to_utf16_kernel = laz_utf8_to_utf16_neon;
+		laz_utf8_to_utf32_kernel = laz_utf8_to_utf32_neon;
+		laz_utf16_to_utf8_kernel = laz_utf16_to_utf8_neon;
+		laz_utf32_to_utf8_kernel = laz_utf32_to_utf8_neon;
+	}
+#endif
+
+#if defined(LAZ_CRC32C_SSE42)
+	if (features & CPU_FEATURE_SSE4_2) {
+		laz_crc32c_kernel = laz_crc32c_sse42;
+	}
+#elif defined(LAZ_CRC32C_ARM)
+	if (features & CPU_FEATURE_CRC32) {
+		laz_crc32c_kernel = laz_crc32c_arm;
+	}
+#endif
+}
+
+static const struct {
+	const char *name;
+	unsigned feature;
+} laz_cpu_feature_names[] = {
+	{ "sse2", CPU_FEATURE_SSE2 },	{ "sse4.2", CPU_FEATURE_SSE4_2 },
+	{ "avx2", CPU_FEATURE_AVX2 },	{ "neon", CPU_FEATURE_NEON },
+	{ "crc32", CPU_FEATURE_CRC32 }, { "none", 0 },
+};
+
+/* Features named in LAZ_CPU, or all of them when it is unset */
+static unsigned laz_cpu_env_mask(void)
+{
+	const char *env = getenv("LAZ_CPU");
+	unsigned mask = 0;
+
+	if (env == NULL) {
+		return ~0U;
+	}
+
+	while (*env != '\0') {
+		size_t len = strcspn(env, ",");
+		size_t i = 0;
+
+		for (i = 0; i < ARRAY_LENGTH(laz_cpu_feature_names); i++) {
+			const char *name = laz_cpu_feature_names[i].name;
+
+			if (strlen(name) == len && memcmp(name, env, len) == 0) {
+				mask |= laz_cpu_feature_names[i].feature;
+				break;
+			}
+		}
+
+		if (i == ARRAY_LENGTH(laz_cpu_feature_names)) {
+			(void)errorf("Error: unknown CPU feature %.*s in LAZ_CPU\n",
+				     (int)len, env);
+		}
+
+		env += len + (env[len] == ',');
+	}
+
+	return mask;
+}
+
+/* Detected and allowed by LAZ_CPU */
+static unsigned laz_cpu_allowed;
+static unsigned laz_cpu_enabled;
+static int laz_cpu_ready;
+
+static void laz_cpu_init(void)
+{
+	if (laz_cpu_ready) {
+		return;
+	}
+
+	laz_cpu_allowed = laz_cpu_detect() & laz_cpu_env_mask();
+	laz_cpu_enabled = laz_cpu_allowed;
+	laz_cpu_dispatch(laz_cpu_enabled);
+	laz_cpu_ready = 1;
+}
+
+/* Resolved before main, while there is a single thread, so the kernel
+ * pointers never change under a running kernel */
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((constructor)) static void laz_cpu_startup(void)
+{
+	laz_cpu_init();
+}
+#endif
+
+unsigned cpu_features(void)
+{
+	laz_cpu_init();
+	return laz_cpu_enabled;
+}
+
+unsigned cpu_features_limit(unsigned mask)
+{
+	unsigned previous = cpu_features();
+
+	laz_cpu_enabled = laz_cpu_allowed & mask;
+	laz_cpu_dispatch(laz_cpu_enabled);
+	return previous;
+}
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 laz_u128;
+#endif
+
+/* 64x64 -> 128-bit multiplication, low half in `a` and high half in `b` */
+static void laz_mul128(u64 *a, u64 *b)
+{
+#if defined(__SIZEOF_INT128__)
+	laz_u128 r = (laz_u128)*a * *b;
+
+	*a = (u64)r;
+	*b = (u64)(r >> 64);
+#else
+	u64 ha = *a >> 32, hb = *b >> 32;
+	u64 la = (u32)*a, lb = (u32)*b;
+	u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	u64 t = rl + (rm0 << 32);
+	u64 c = t < rl;
+	u64 lo = t + (rm1 << 32);
+
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static u64 laz_mix128(u64 a, u64 b)
+{
+	laz_mul128(&a, &b);
+	return a ^ b;
+}
+
+/* Little-endian loads, so hashes match across platforms */
+static u64 laz_read64(const unsigned char *p)
+{
+	u64 v = 0;
+
+	memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static u64 laz_read32(const unsigned char *p)
+{
+	u32 v = 0;
+
+	memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+static const u64 laz_fast_hash_secret[4] = {
+	0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+u64 fast_hash_64(const void *buf, size_t len, u64 seed)
+{
+	const unsigned char *p = (const unsigned char *)buf;
+	const u64 *secret = laz_fast_hash_secret;
+	u64 a = 0;
+	u64 b = 0;
+
+	seed ^= laz_mix128(seed ^ secret[0], secret[1]);
+
+	if (likely(len <= 16)) {
+		if (likely(len >= 4)) {
+			size_t mid = (len >> 3) << 2;
+
+			a = (laz_read32(p) << 32) | laz_read32(p + mid);
+			b = (laz_read32(p + len - 4) << 32) |
+			    laz_read32(p + len - 4 - mid);
+		} else if (likely(len > 0)) {
+			a = ((u64)p[0] << 16) | ((u64)p[len >> 1] << 8) |
+			    p[len - 1];
+		}
+	} else {
+		size_t i = len;
+
+		if (unlikely(i >= 48)) {
+			/* Three independent lanes hide multiplier latency */
+			u64 see1 = seed;
+			u64 see2 = seed;
+
+			do {
+				seed = laz_mix128(laz_read64(p) ^ secret[1],
+						  laz_read64(p + 8) ^ seed);
+				see1 = laz_mix128(laz_read64(p + 16) ^ secret[2],
+						  laz_read64(p + 24) ^ see1);
+				see2 = laz_mix128(laz_read64(p + 32) ^ secret[3],
+						  laz_read64(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while (likely(i >= 48));
+
+			seed ^= see1 ^ see2;
+		}
+
+		while (unlikely(i > 16)) {
+			seed = laz_mix128(laz_read64(p) ^ secret[1],
+					  laz_read64(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+
+		/* The last 16 bytes, overlapping already hashed ones */
+		a = laz_read64(p + i - 16);
+		b = laz_read64(p + i - 8);
+	}
+
+	a ^= secret[1];
+	b ^= seed;
+	laz_mul128(&a, &b);
+	return laz_mix128(a ^ secret[0] ^ (u64)len, b ^ secret[1]);
+}
+
+/* Eight ASCII digits in one little-endian word. Returns 1 if they all are. */
+static int laz_is_digits8(u64 v)
+{
+	return ((v & 0xf0f0f0f0f0f0f0f0ULL) |
+		(((v + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4)) ==
+	       0x3333333333333333ULL;
+}
+
+/* Value of eight ASCII digits, the first in the low byte: pairs, then
+ * quads, then the whole in three multiplications */
+static u64 laz_digits8(u64 v)
+{
+	v -= 0x3030303030303030ULL;
+	v = v * 10 + (v >> 8);
+	return (((v & 0x000000ff000000ffULL) * 0x000f424000000064ULL) +
+		(((v >> 16) & 0x000000ff000000ffULL) * 0x0000271000000001ULL)) >>
+	       32;
+}
+
+/* At least one decimal digit, then nothing else, from `p` to `end` */
+static int laz_parse_digits(const char *p, const char *end, u64 *out)
+{
+	const char *start = NULL;
+	u64 value = 0;
+
+	if (p == end) {
+		return -1;
+	}
+
+	while (p < end && *p == '0') {
+		p++;
+	}
+
+	/* Sixteen digits cannot overflow, so those go eight at a time */
+	for (start = p; end - p >= 8 && p - start < 16; p += 8) {
+		u64 v = laz_read64((const unsigned char *)p);
+
+		if (!laz_is_digits8(v)) {
+			break;
+		}
+
+		value = value * 100000000 + laz_digits8(v);
+	}
+
+	for (; p < end; p++) {
+		unsigned digit = (unsigned)(unsigned char)*p - '0';
+
+		if (digit > 9 || value > (UINT64_MAX - digit) / 10) {
+			return -1;
+		}
+
+		value = value * 10 + digit;
+	}
+
+	*out = value;
+	return 0;
+}
+
+int parse_u64(struct str_view text, u64 *out)
+{
+	if (text.len == 0) {
+		return -1;
+	}
+
+	if (text.data[0] == '+') {
+		text.data++;
+		text.len--;
+	}
+
+	return laz_parse_digits(text.data, text.data + text.len, out);
+}
+
+int parse_u32(struct str_view text, u32 *out)
+{
+	u64 value = 0;
+
+	if (parse_u64(text, &value) != 0 || value > UINT32_MAX) {
+		return -1;
+	}
+
+	*out = (u32)value;
+	return 0;
+}
+
+int parse_u16(struct str_view text, u16 *out)
+{
+	u64 value = 0;
+
+	if (parse_u64(text, &value) != 0 || value > UINT16_MAX) {
+		return -1;
+	}
+
+	*out = (u16)value;
+	return 0;
+}
+
+int parse_u8(struct str_view text, u8 *out)
+{
+	u64 value = 0;
+
+	if (parse_u64(text, &value) != 0 || value > UINT8_MAX) {
+		return -1;
+	}
+
+	*out = (u8)value;
+	return 0;
+}
+
+int parse_i64(struct str_view text, i64 *out)
+{
+	int negative = 0;
+	u64 value = 0;
+
+	if (text.len == 0) {
+		return -1;
+	}
+
+	if (text.data[0] == '-' || text.data[0] == '+') {
+		negative = text.data[0] == '-';
+		text.data++;
+		text.len--;
+	}
+
+	if (laz_parse_digits(text.data, text.data + text.len, &value) != 0 ||
+	    value > (u64)INT64_MAX + (u64)negative) {
+		return -1;
+	}
+
+	*out = negative && value > 0 ? -(i64)(value - 1) - 1 : (i64)value;
+	return 0;
+}
+
+int parse_i32(struct str_view text, i32 *out)
+{
+	i64 value = 0;
+
+	if (parse_i64(text, &value) != 0 || value < INT32_MIN ||
+	    value > INT32_MAX) {
+		return -1;
+	}
+
+	*out = (i32)value;
+	return 0;
+}
+
+int parse_i16(struct str_view text, i16 *out)
+{
+	i64 value = 0;
+
+	if (parse_i64(text, &value) != 0 || value < INT16_MIN ||
+	    value > INT16_MAX) {
+		return -1;
+	}
+
+	*out = (i16)value;
+	return 0;
+}
+
+int parse_i8(struct str_view text, i8 *out)
+{
+	i64 value = 0;
+
+	if (parse_i64(text, &value) != 0 || value < INT8_MIN ||
+	    value > INT8_MAX) {
+		return -1;
+	}
+
+	*out = (i8)value;
+	return 0;
+}
+
+#define LAZ_POW10_MIN (-342)
+#define LAZ_POW10_MAX 324
+#define LAZ_F64_FRACTION_MASK (((u64)1 << 52) - 1)
+#define LAZ_F64_INF 0x7ff0000000000000ULL
+#define LAZ_F64_NAN 0x7ff8000000000000ULL
+
+/* 10^q for q from -342 to 324 as 128-bit significands, high word first,
+ * rounded down and scaled into [2^127, 2^128). Their binary exponent is
+ * floor(q log2(10)) - 127. */
+static const u64 laz_pow10_128[] = {
+	0xeef453d6923bd65aULL, 0x113faa2906a13b3fULL,
+	0x9558b4661b6565f8ULL, 0x4ac7ca59a424c507ULL,
+	0xbaaee17fa23ebf76ULL, 0x5d79bcf00d2df649ULL,
+	0xe95a99df8ace6f53ULL, 0xf4d82c2c107973dcULL,
+	0x91d8a02bb6c10594ULL, 0x79071b9b8a4be869ULL,
+	0xb64ec836a47146f9ULL, 0x9748e2826cdee284ULL,
+	0xe3e27a444d8d98b7ULL, 0xfd1b1b2308169b25ULL,
+	0x8e6d8c6ab0787f72ULL, 0xfe30f0f5e50e20f7ULL,
+	0xb208ef855c969f4fULL, 0xbdbd2d335e51a935ULL,
+	0xde8b2b66b3bc4723ULL, 0xad2c788035e61382ULL,
+	0x8b16fb203055ac76ULL, 0x4c3bcb5021afcc31ULL,
+	0xaddcb9e83c6b1793ULL, 0xdf4abe242a1bbf3dULL,
+	0xd953e8624b85dd78ULL, 0xd71d6dad34a2af0dULL,
+	0x87d4713d6f33aa6bULL, 0x8672648c40e5ad68ULL,
+	0xa9c98d8ccb009506ULL, 0x680efdaf511f18c2ULL,
+	0xd43bf0effdc0ba48ULL, 0x0212bd1b2566def2ULL,
+	0x84a57695fe98746dULL, 0x014bb630f7604b57ULL,
+	0xa5ced43b7e3e9188ULL, 0x419ea3bd35385e2dULL,
+	0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL,
+	0x818995ce7aa0e1b2ULL, 0x7343efebd1940993ULL,
+	0xa1ebfb4219491a1fULL, 0x1014ebe6c5f90bf8ULL,
+	0xca66fa129f9b60a6ULL, 0xd41a26e077774ef6ULL,
+	0xfd00b897478238d0ULL, 0x8920b098955522b4ULL,
+	0x9e20735e8cb16382ULL, 0x55b46e5f5d5535b0ULL,
+	0xc5a890362fddbc62ULL, 0xeb2189f734aa831dULL,
+	0xf712b443bbd52b7bULL, 0xa5e9ec7501d523e4ULL,
+	0x9a6bb0aa55653b2dULL, 0x47b233c92125366eULL,
+	0xc1069cd4eabe89f8ULL, 0x999ec0bb696e840aULL,
+	0xf148440a256e2c76ULL, 0xc00670ea43ca250dULL,
+	0x96cd2a865764dbcaULL, 0x380406926a5e5728ULL,
+	0xbc807527ed3e12bcULL, 0xc605083704f5ecf2ULL,
+	0xeba09271e88d976bULL, 0xf7864a44c633682eULL,
+	0x93445b8731587ea3ULL, 0x7ab3ee6afbe0211dULL,
+	0xb8157268fdae9e4cULL, 0x5960ea05bad82964ULL,
+	0xe61acf033d1a45dfULL, 0x6fb92487298e33bdULL,
+	0x8fd0c16206306babULL, 0xa5d3b6d479f8e056ULL,
+	0xb3c4f1ba87bc8696ULL, 0x8f48a4899877186cULL,
+	0xe0b62e2929aba83cULL, 0x331acdabfe94de87ULL,
+	0x8c71dcd9ba0b4925ULL, 0x9ff0c08b7f1d0b14ULL,
+	0xaf8e5410288e1b6fULL, 0x07ecf0ae5ee44dd9ULL,
+	0xdb71e91432b1a24aULL, 0xc9e82cd9f69d6150ULL,
+	0x892731ac9faf056eULL, 0xbe311c083a225cd2ULL,
+	0xab70fe17c79ac6caULL, 0x6dbd630a48aaf406ULL,
+	0xd64d3d9db981787dULL, 0x092cbbccdad5b108ULL,
+	0x85f0468293f0eb4eULL, 0x25bbf56008c58ea5ULL,
+	0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL,
+	0xd1476e2c07286faaULL, 0x1af5af660db4aee1ULL,
+	0x82cca4db847945caULL, 0x50d98d9fc890ed4dULL,
+	0xa37fce126597973cULL, 0xe50ff107bab528a0ULL,
+	0xcc5fc196fefd7d0cULL, 0x1e53ed49a96272c8ULL,
+	0xff77b1fcbebcdc4fULL, 0x25e8e89c13bb0f7aULL,
+	0x9faacf3df73609b1ULL, 0x77b191618c54e9acULL,
+	0xc795830d75038c1dULL, 0xd59df5b9ef6a2417ULL,
+	0xf97ae3d0d2446f25ULL, 0x4b0573286b44ad1dULL,
+	0x9becce62836ac577ULL, 0x4ee367f9430aec32ULL,
+	0xc2e801fb244576d5ULL, 0x229c41f793cda73fULL,
+	0xf3a20279ed56d48aULL, 0x6b43527578c1110fULL,
+	0x9845418c345644d6ULL, 0x830a13896b78aaa9ULL,
+	0xbe5691ef416bd60cULL, 0x23cc986bc656d553ULL,
+	0xedec366b11c6cb8fULL, 0x2cbfbe86b7ec8aa8ULL,
+	0x94b3a202eb1c3f39ULL, 0x7bf7d71432f3d6a9ULL,
+	0xb9e08a83a5e34f07ULL, 0xdaf5ccd93fb0cc53ULL,
+	0xe858ad248f5c22c9ULL, 0xd1b3400f8f9cff68ULL,
+	0x91376c36d99995beULL, 0x23100809b9c21fa1ULL,
+	0xb58547448ffffb2dULL, 0xabd40a0c2832a78aULL,
+	0xe2e69915b3fff9f9ULL, 0x16c90c8f323f516cULL,
+	0x8dd01fad907ffc3bULL, 0xae3da7d97f6792e3ULL,
+	0xb1442798f49ffb4aULL, 0x99cd11cfdf41779cULL,
+	0xdd95317f31c7fa1dULL, 0x40405643d711d583ULL,
+	0x8a7d3eef7f1cfc52ULL, 0x482835ea666b2572ULL,
+	0xad1c8eab5ee43b66ULL, 0xda3243650005eecfULL,
+	0xd863b256369d4a40ULL, 0x90bed43e40076a82ULL,
+	0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL,
+	0xa90de3535aaae202ULL, 0x711515d0a205cb36ULL,
+	0xd3515c2831559a83ULL, 0x0d5a5b44ca873e03ULL,
+	0x8412d9991ed58091ULL, 0xe858790afe9486c2ULL,
+	0xa5178fff668ae0b6ULL, 0x626e974dbe39a872ULL,
+	0xce5d73ff402d98e3ULL, 0xfb0a3d212dc8128fULL,
+	0x80fa687f881c7f8eULL, 0x7ce66634bc9d0b99ULL,
+	0xa139029f6a239f72ULL, 0x1c1fffc1ebc44e80ULL,
+	0xc987434744ac874eULL, 0xa327ffb266b56220ULL,
+	0xfbe9141915d7a922ULL, 0x4bf1ff9f0062baa8ULL,
+	0x9d71ac8fada6c9b5ULL, 0x6f773fc3603db4a9ULL,
+	0xc4ce17b399107c22ULL, 0xcb550fb4384d21d3ULL,
+	0xf6019da07f549b2bULL, 0x7e2a53a146606a48ULL,
+	0x99c102844f94e0fbULL, 0x2eda7444cbfc426dULL,
+	0xc0314325637a1939ULL, 0xfa911155fefb5308ULL,
+	0xf03d93eebc589f88ULL, 0x793555ab7eba27caULL,
+	0x96267c7535b763b5ULL, 0x4bc1558b2f3458deULL,
+	0xbbb01b9283253ca2ULL, 0x9eb1aaedfb016f16ULL,
+	0xea9c227723ee8bcbULL, 0x465e15a979c1cadcULL,
+	0x92a1958a7675175fULL, 0x0bfacd89ec191ec9ULL,
+	0xb749faed14125d36ULL, 0xcef980ec671f667bULL,
+	0xe51c79a85916f484ULL, 0x82b7e12780e7401aULL,
+	0x8f31cc0937ae58d2ULL, 0xd1b2ecb8b0908810ULL,
+	0xb2fe3f0b8599ef07ULL, 0x861fa7e6dcb4aa15ULL,
+	0xdfbdcece67006ac9ULL, 0x67a791e093e1d49aULL,
+	0x8bd6a141006042bdULL, 0xe0c8bb2c5c6d24e0ULL,
+	0xaecc49914078536dULL, 0x58fae9f773886e18ULL,
+	0xda7f5bf590966848ULL, 0xaf39a475506a899eULL,
+	0x888f99797a5e012dULL, 0x6d8406c952429603ULL,
+	0xaab37fd7d8f58178ULL, 0xc8e5087ba6d33b83ULL,
+	0xd5605fcdcf32e1d6ULL, 0xfb1e4a9a90880a64ULL,
+	0x855c3be0a17fcd26ULL, 0x5cf2eea09a55067fULL,
+	0xa6b34ad8c9dfc06fULL, 0xf42faa48c0ea481eULL,
+	0xd0601d8efc57b08bULL, 0xf13b94daf124da26ULL,
+	0x823c12795db6ce57ULL, 0x76c53d08d6b70858ULL,
+	0xa2cb1717b52481edULL, 0x54768c4b0c64ca6eULL,
+	0xcb7ddcdda26da268ULL, 0xa9942f5dcf7dfd09ULL,
+	0xfe5d54150b090b02ULL, 0xd3f93b35435d7c4cULL,
+	0x9efa548d26e5a6e1ULL, 0xc47bc5014a1a6dafULL,
+	0xc6b8e9b0709f109aULL, 0x359ab6419ca1091bULL,
+	0xf867241c8cc6d4c0ULL, 0xc30163d203c94b62ULL,
+	0x9b407691d7fc44f8ULL, 0x79e0de63425dcf1dULL,
+	0xc21094364dfb5636ULL, 0x985915fc12f542e4ULL,
+	0xf294b943e17a2bc4ULL, 0x3e6f5b7b17b2939dULL,
+	0x979cf3ca6cec5b5aULL, 0xa705992ceecf9c42ULL,
+	0xbd8430bd08277231ULL, 0x50c6ff782a838353ULL,
+	0xece53cec4a314ebdULL, 0xa4f8bf5635246428ULL,
+	0x940f4613ae5ed136ULL, 0x871b7795e136be99ULL,
+	0xb913179899f68584ULL, 0x28e2557b59846e3fULL,
+	0xe757dd7ec07426e5ULL, 0x331aeada2fe589cfULL,
+	0x9096ea6f3848984fULL, 0x3ff0d2c85def7621ULL,
+	0xb4bca50b065abe63ULL, 0x0fed077a756b53a9ULL,
+	0xe1ebce4dc7f16dfbULL, 0xd3e8495912c62894ULL,
+	0x8d3360f09cf6e4bdULL, 0x64712dd7abbbd95cULL,
+	0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL,
+	0xdca04777f541c567ULL, 0xecf0d7a0fc5583a0ULL,
+	0x89e42caaf9491b60ULL, 0xf41686c49db57244ULL,
+	0xac5d37d5b79b6239ULL, 0x311c2875c522ced5ULL,
+	0xd77485cb25823ac7ULL, 0x7d633293366b828bULL,
+	0x86a8d39ef77164bcULL, 0xae5dff9c02033197ULL,
+	0xa8530886b54dbdebULL, 0xd9f57f830283fdfcULL,
+	0xd267caa862a12d66ULL, 0xd072df63c324fd7bULL,
+	0x8380dea93da4bc60ULL, 0x4247cb9e59f71e6dULL,
+	0xa46116538d0deb78ULL, 0x52d9be85f074e608ULL,
+	0xcd795be870516656ULL, 0x67902e276c921f8bULL,
+	0x806bd9714632dff6ULL, 0x00ba1cd8a3db53b6ULL,
+	0xa086cfcd97bf97f3ULL, 0x80e8a40eccd228a4ULL,
+	0xc8a883c0fdaf7df0ULL, 0x6122cd128006b2cdULL,
+	0xfad2a4b13d1b5d6cULL, 0x796b805720085f81ULL,
+	0x9cc3a6eec6311a63ULL, 0xcbe3303674053bb0ULL,
+	0xc3f490aa77bd60fcULL, 0xbedbfc4411068a9cULL,
+	0xf4f1b4d515acb93bULL, 0xee92fb5515482d44ULL,
+	0x991711052d8bf3c5ULL, 0x751bdd152d4d1c4aULL,
+	0xbf5cd54678eef0b6ULL, 0xd262d45a78a0635dULL,
+	0xef340a98172aace4ULL, 0x86fb897116c87c34ULL,
+	0x9580869f0e7aac0eULL, 0xd45d35e6ae3d4da0ULL,
+	0xbae0a846d2195712ULL, 0x8974836059cca109ULL,
+	0xe998d258869facd7ULL, 0x2bd1a438703fc94bULL,
+	0x91ff83775423cc06ULL, 0x7b6306a34627ddcfULL,
+	0xb67f6455292cbf08ULL, 0x1a3bc84c17b1d542ULL,
+	0xe41f3d6a7377eecaULL, 0x20caba5f1d9e4a93ULL,
+	0x8e938662882af53eULL, 0x547eb47b7282ee9cULL,
+	0xb23867fb2a35b28dULL, 0xe99e619a4f23aa43ULL,
+	0xdec681f9f4c31f31ULL, 0x6405fa00e2ec94d4ULL,
+	0x8b3c113c38f9f37eULL, 0xde83bc408dd3dd04ULL,
+	0xae0b158b4738705eULL, 0x9624ab50b148d445ULL,
+	0xd98ddaee19068c76ULL, 0x3badd624dd9b0957ULL,
+	0x87f8a8d4cfa417c9ULL, 0xe54ca5d70a80e5d6ULL,
+	0xa9f6d30a038d1dbcULL, 0x5e9fcf4ccd211f4cULL,
+	0xd47487cc8470652bULL, 0x7647c3200069671fULL,
+	0x84c8d4dfd2c63f3bULL, 0x29ecd9f40041e073ULL,
+	0xa5fb0a17c777cf09ULL, 0xf468107100525890ULL,
+	0xcf79cc9db955c2ccULL, 0x7182148d4066eeb4ULL,
+	0x81ac1fe293d599bfULL, 0xc6f14cd848405530ULL,
+	0xa21727db38cb002fULL, 0xb8ada00e5a506a7cULL,
+	0xca9cf1d206fdc03bULL, 0xa6d90811f0e4851cULL,
+	0xfd442e4688bd304aULL, 0x908f4a166d1da663ULL,
+	0x9e4a9cec15763e2eULL, 0x9a598e4e043287feULL,
+	0xc5dd44271ad3cdbaULL, 0x40eff1e1853f29fdULL,
+	0xf7549530e188c128ULL, 0xd12bee59e68ef47cULL,
+	0x9a94dd3e8cf578b9ULL, 0x82bb74f8301958ceULL,
+	0xc13a148e3032d6e7ULL, 0xe36a52363c1faf01ULL,
+	0xf18899b1bc3f8ca1ULL, 0xdc44e6c3cb279ac1ULL,
+	0x96f5600f15a7b7e5ULL, 0x29ab103a5ef8c0b9ULL,
+	0xbcb2b812db11a5deULL, 0x7415d448f6b6f0e7ULL,
+	0xebdf661791d60f56ULL, 0x111b495b3464ad21ULL,
+	0x936b9fcebb25c995ULL, 0xcab10dd900beec34ULL,
+	0xb84687c269ef3bfbULL, 0x3d5d514f40eea742ULL,
+	0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL,
+	0x8ff71a0fe2c2e6dcULL, 0x47f0e785eaba72abULL,
+	0xb3f4e093db73a093ULL, 0x59ed216765690f56ULL,
+	0xe0f218b8d25088b8ULL, 0x306869c13ec3532cULL,
+	0x8c974f7383725573ULL, 0x1e414218c73a13fbULL,
+	0xafbd2350644eeacfULL, 0xe5d1929ef90898faULL,
+	0xdbac6c247d62a583ULL, 0xdf45f746b74abf39ULL,
+	0x894bc396ce5da772ULL, 0x6b8bba8c328eb783ULL,
+	0xab9eb47c81f5114fULL, 0x066ea92f3f326564ULL,
+	0xd686619ba27255a2ULL, 0xc80a537b0efefebdULL,
+	0x8613fd0145877585ULL, 0xbd06742ce95f5f36ULL,
+	0xa798fc4196e952e7ULL, 0x2c48113823b73704ULL,
+	0xd17f3b51fca3a7a0ULL, 0xf75a15862ca504c5ULL,
+	0x82ef85133de648c4ULL, 0x9a984d73dbe722fbULL,
+	0xa3ab66580d5fdaf5ULL, 0xc13e60d0d2e0ebbaULL,
+	0xcc963fee10b7d1b3ULL, 0x318df905079926a8ULL,
+	0xffbbcfe994e5c61fULL, 0xfdf17746497f7052ULL,
+	0x9fd561f1fd0f9bd3ULL, 0xfeb6ea8bedefa633ULL,
+	0xc7caba6e7c5382c8ULL, 0xfe64a52ee96b8fc0ULL,
+	0xf9bd690a1b68637bULL, 0x3dfdce7aa3c673b0ULL,
+	0x9c1661a651213e2dULL, 0x06bea10ca65c084eULL,
+	0xc31bfa0fe5698db8ULL, 0x486e494fcff30a62ULL,
+	0xf3e2f893dec3f126ULL, 0x5a89dba3c3efccfaULL,
+	0x986ddb5c6b3a76b7ULL, 0xf89629465a75e01cULL,
+	0xbe89523386091465ULL, 0xf6bbb397f1135823ULL,
+	0xee2ba6c0678b597fULL, 0x746aa07ded582e2cULL,
+	0x94db483840b717efULL, 0xa8c2a44eb4571cdcULL,
+	0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL,
+	0xe896a0d7e51e1566ULL, 0x77b020baf9c81d17ULL,
+	0x915e2486ef32cd60ULL, 0x0ace1474dc1d122eULL,
+	0xb5b5ada8aaff80b8ULL, 0x0d819992132456baULL,
+	0xe3231912d5bf60e6ULL, 0x10e1fff697ed6c69ULL,
+	0x8df5efabc5979c8fULL, 0xca8d3ffa1ef463c1ULL,
+	0xb1736b96b6fd83b3ULL, 0xbd308ff8a6b17cb2ULL,
+	0xddd0467c64bce4a0ULL, 0xac7cb3f6d05ddbdeULL,
+	0x8aa22c0dbef60ee4ULL, 0x6bcdf07a423aa96bULL,
+	0xad4ab7112eb3929dULL, 0x86c16c98d2c953c6ULL,
+	0xd89d64d57a607744ULL, 0xe871c7bf077ba8b7ULL,
+	0x87625f056c7c4a8bULL, 0x11471cd764ad4972ULL,
+	0xa93af6c6c79b5d2dULL, 0xd598e40d3dd89bcfULL,
+	0xd389b47879823479ULL, 0x4aff1d108d4ec2c3ULL,
+	0x843610cb4bf160cbULL, 0xcedf722a585139baULL,
+	0xa54394fe1eedb8feULL, 0xc2974eb4ee658828ULL,
+	0xce947a3da6a9273eULL, 0x733d226229feea32ULL,
+	0x811ccc668829b887ULL, 0x0806357d5a3f525fULL,
+	0xa163ff802a3426a8ULL, 0xca07c2dcb0cf26f7ULL,
+	0xc9bcff6034c13052ULL, 0xfc89b393dd02f0b5ULL,
+	0xfc2c3f3841f17c67ULL, 0xbbac2078d443ace2ULL,
+	0x9d9ba7832936edc0ULL, 0xd54b944b84aa4c0dULL,
+	0xc5029163f384a931ULL, 0x0a9e795e65d4df11ULL,
+	0xf64335bcf065d37dULL, 0x4d4617b5ff4a16d5ULL,
+	0x99ea0196163fa42eULL, 0x504bced1bf8e4e45ULL,
+	0xc06481fb9bcf8d39ULL, 0xe45ec2862f71e1d6ULL,
+	0xf07da27a82c37088ULL, 0x5d767327bb4e5a4cULL,
+	0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL,
+	0xbbe226efb628afeaULL, 0x890489f70a55368bULL,
+	0xeadab0aba3b2dbe5ULL, 0x2b45ac74ccea842eULL,
+	0x92c8ae6b464fc96fULL, 0x3b0b8bc90012929dULL,
+	0xb77ada0617e3bbcbULL, 0x09ce6ebb40173744ULL,
+	0xe55990879ddcaabdULL, 0xcc420a6a101d0515ULL,
+	0x8f57fa54c2a9eab6ULL, 0x9fa946824a12232dULL,
+	0xb32df8e9f3546564ULL, 0x47939822dc96abf9ULL,
+	0xdff9772470297ebdULL, 0x59787e2b93bc56f7ULL,
+	0x8bfbea76c619ef36ULL, 0x57eb4edb3c55b65aULL,
+	0xaefae51477a06b03ULL, 0xede622920b6b23f1ULL,
+	0xdab99e59958885c4ULL, 0xe95fab368e45ecedULL,
+	0x88b402f7fd75539bULL, 0x11dbcb0218ebb414ULL,
+	0xaae103b5fcd2a881ULL, 0xd652bdc29f26a119ULL,
+	0xd59944a37c0752a2ULL, 0x4be76d3346f0495fULL,
+	0x857fcae62d8493a5ULL, 0x6f70a4400c562ddbULL,
+	0xa6dfbd9fb8e5b88eULL, 0xcb4ccd500f6bb952ULL,
+	0xd097ad07a71f26b2ULL, 0x7e2000a41346a7a7ULL,
+	0x825ecc24c873782fULL, 0x8ed400668c0c28c8ULL,
+	0xa2f67f2dfa90563bULL, 0x728900802f0f32faULL,
+	0xcbb41ef979346bcaULL, 0x4f2b40a03ad2ffb9ULL,
+	0xfea126b7d78186bcULL, 0xe2f610c84987bfa8ULL,
+	0x9f24b832e6b0f436ULL, 0x0dd9ca7d2df4d7c9ULL,
+	0xc6ede63fa05d3143ULL, 0x91503d1c79720dbbULL,
+	0xf8a95fcf88747d94ULL, 0x75a44c6397ce912aULL,
+	0x9b69dbe1b548ce7cULL, 0xc986afbe3ee11abaULL,
+	0xc24452da229b021bULL, 0xfbe85badce996168ULL,
+	0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL,
+	0x97c560ba6b0919a5ULL, 0xdccd879fc967d41aULL,
+	0xbdb6b8e905cb600fULL, 0x5400e987bbc1c920ULL,
+	0xed246723473e3813ULL, 0x290123e9aab23b68ULL,
+	0x9436c0760c86e30bULL, 0xf9a0b6720aaf6521ULL,
+	0xb94470938fa89bceULL, 0xf808e40e8d5b3e69ULL,
+	0xe7958cb87392c2c2ULL, 0xb60b1d1230b20e04ULL,
+	0x90bd77f3483bb9b9ULL, 0xb1c6f22b5e6f48c2ULL,
+	0xb4ecd5f01a4aa828ULL, 0x1e38aeb6360b1af3ULL,
+	0xe2280b6c20dd5232ULL, 0x25c6da63c38de1b0ULL,
+	0x8d590723948a535fULL, 0x579c487e5a38ad0eULL,
+	0xb0af48ec79ace837ULL, 0x2d835a9df0c6d851ULL,
+	0xdcdb1b2798182244ULL, 0xf8e431456cf88e65ULL,
+	0x8a08f0f8bf0f156bULL, 0x1b8e9ecb641b58ffULL,
+	0xac8b2d36eed2dac5ULL, 0xe272467e3d222f3fULL,
+	0xd7adf884aa879177ULL, 0x5b0ed81dcc6abb0fULL,
+	0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL,
+	0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL,
+	0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL,
+	0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL,
+	0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL,
+	0xcdb02555653131b6ULL, 0x3792f412cb06794dULL,
+	0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL,
+	0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL,
+	0xc8de047564d20a8bULL, 0xf245825a5a445275ULL,
+	0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL,
+	0x9ced737bb6c4183dULL, 0x55464dd69685606bULL,
+	0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL,
+	0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL,
+	0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL,
+	0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL,
+	0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL,
+	0x95a8637627989aadULL, 0xdde7001379a44aa8ULL,
+	0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL,
+	0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL,
+	0x9226712162ab070dULL, 0xcab3961304ca70e8ULL,
+	0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL,
+	0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL,
+	0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL,
+	0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL,
+	0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL,
+	0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL,
+	0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL,
+	0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL,
+	0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL,
+	0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL,
+	0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL,
+	0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL,
+	0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL,
+	0xcfb11ead453994baULL, 0x67de18eda5814af2ULL,
+	0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL,
+	0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL,
+	0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL,
+	0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL,
+	0x9e74d1b791e07e48ULL, 0x775ea264cf55347dULL,
+	0xc612062576589ddaULL, 0x95364afe032a819dULL,
+	0xf79687aed3eec551ULL, 0x3a83ddbd83f52204ULL,
+	0x9abe14cd44753b52ULL, 0xc4926a9672793542ULL,
+	0xc16d9a0095928a27ULL, 0x75b7053c0f178293ULL,
+	0xf1c90080baf72cb1ULL, 0x5324c68b12dd6338ULL,
+	0x971da05074da7beeULL, 0xd3f6fc16ebca5e03ULL,
+	0xbce5086492111aeaULL, 0x88f4bb1ca6bcf584ULL,
+	0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e5ULL,
+	0x9392ee8e921d5d07ULL, 0x3aff322e62439fcfULL,
+	0xb877aa3236a4b449ULL, 0x09befeb9fad487c2ULL,
+	0xe69594bec44de15bULL, 0x4c2ebe687989a9b3ULL,
+	0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a10ULL,
+	0xb424dc35095cd80fULL, 0x538484c19ef38c94ULL,
+	0xe12e13424bb40e13ULL, 0x2865a5f206b06fb9ULL,
+	0x8cbccc096f5088cbULL, 0xf93f87b7442e45d3ULL,
+	0xafebff0bcb24aafeULL, 0xf78f69a51539d748ULL,
+	0xdbe6fecebdedd5beULL, 0xb573440e5a884d1bULL,
+	0x89705f4136b4a597ULL, 0x31680a88f8953030ULL,
+	0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3dULL,
+	0xd6bf94d5e57a42bcULL, 0x3d32907604691b4cULL,
+	0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b10fULL,
+	0xa7c5ac471b478423ULL, 0x0fcf80dc33721d53ULL,
+	0xd1b71758e219652bULL, 0xd3c36113404ea4a8ULL,
+	0x83126e978d4fdf3bULL, 0x645a1cac083126e9ULL,
+	0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a3ULL,
+	0xccccccccccccccccULL, 0xccccccccccccccccULL,
+	0x8000000000000000ULL, 0x0000000000000000ULL,
+	0xa000000000000000ULL, 0x0000000000000000ULL,
+	0xc800000000000000ULL, 0x0000000000000000ULL,
+	0xfa00000000000000ULL, 0x0000000000000000ULL,
+	0x9c40000000000000ULL, 0x0000000000000000ULL,
+	0xc350000000000000ULL, 0x0000000000000000ULL,
+	0xf424000000000000ULL, 0x0000000000000000ULL,
+	0x9896800000000000ULL, 0x0000000000000000ULL,
+	0xbebc200000000000ULL, 0x0000000000000000ULL,
+	0xee6b280000000000ULL, 0x0000000000000000ULL,
+	0x9502f90000000000ULL, 0x0000000000000000ULL,
+	0xba43b74000000000ULL, 0x0000000000000000ULL,
+	0xe8d4a51000000000ULL, 0x0000000000000000ULL,
+	0x9184e72a00000000ULL, 0x0000000000000000ULL,
+	0xb5e620f480000000ULL, 0x0000000000000000ULL,
+	0xe35fa931a0000000ULL, 0x0000000000000000ULL,
+	0x8e1bc9bf04000000ULL, 0x0000000000000000ULL,
+	0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL,
+	0xde0b6b3a76400000ULL, 0x0000000000000000ULL,
+	0x8ac7230489e80000ULL, 0x0000000000000000ULL,
+	0xad78ebc5ac620000ULL, 0x0000000000000000ULL,
+	0xd8d726b7177a8000ULL, 0x0000000000000000ULL,
+	0x878678326eac9000ULL, 0x0000000000000000ULL,
+	0xa968163f0a57b400ULL, 0x0000000000000000ULL,
+	0xd3c21bcecceda100ULL, 0x0000000000000000ULL,
+	0x84595161401484a0ULL, 0x0000000000000000ULL,
+	0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL,
+	0xcecb8f27f4200f3aULL, 0x0000000000000000ULL,
+	0x813f3978f8940984ULL, 0x4000000000000000ULL,
+	0xa18f07d736b90be5ULL, 0x5000000000000000ULL,
+	0xc9f2c9cd04674edeULL, 0xa400000000000000ULL,
+	0xfc6f7c4045812296ULL, 0x4d00000000000000ULL,
+	0x9dc5ada82b70b59dULL, 0xf020000000000000ULL,
+	0xc5371912364ce305ULL, 0x6c28000000000000ULL,
+	0xf684df56c3e01bc6ULL, 0xc732000000000000ULL,
+	0x9a130b963a6c115cULL, 0x3c7f400000000000ULL,
+	0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL,
+	0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL,
+	0x96769950b50d88f4ULL, 0x1314448000000000ULL,
+	0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL,
+	0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL,
+	0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL,
+	0xb7abc627050305adULL, 0xf14a3d9e40000000ULL,
+	0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL,
+	0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL,
+	0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL,
+	0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL,
+	0x8c213d9da502de45ULL, 0x4526f422cc340000ULL,
+	0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL,
+	0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL,
+	0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL,
+	0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL,
+	0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL,
+	0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL,
+	0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL,
+	0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL,
+	0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL,
+	0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL,
+	0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL,
+	0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL,
+	0x9f4f2726179a2245ULL, 0x01d762422c946590ULL,
+	0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL,
+	0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL,
+	0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL,
+	0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL,
+	0xf316271c7fc3908aULL, 0x8bef464e3945ef7aULL,
+	0x97edd871cfda3a56ULL, 0x97758bf0e3cbb5acULL,
+	0xbde94e8e43d0c8ecULL, 0x3d52eeed1cbea317ULL,
+	0xed63a231d4c4fb27ULL, 0x4ca7aaa863ee4bddULL,
+	0x945e455f24fb1cf8ULL, 0x8fe8caa93e74ef6aULL,
+	0xb975d6b6ee39e436ULL, 0xb3e2fd538e122b44ULL,
+	0xe7d34c64a9c85d44ULL, 0x60dbbca87196b616ULL,
+	0x90e40fbeea1d3a4aULL, 0xbc8955e946fe31cdULL,
+	0xb51d13aea4a488ddULL, 0x6babab6398bdbe41ULL,
+	0xe264589a4dcdab14ULL, 0xc696963c7eed2dd1ULL,
+	0x8d7eb76070a08aecULL, 0xfc1e1de5cf543ca2ULL,
+	0xb0de65388cc8ada8ULL, 0x3b25a55f43294bcbULL,
+	0xdd15fe86affad912ULL, 0x49ef0eb713f39ebeULL,
+	0x8a2dbf142dfcc7abULL, 0x6e3569326c784337ULL,
+	0xacb92ed9397bf996ULL, 0x49c2c37f07965404ULL,
+	0xd7e77a8f87daf7fbULL, 0xdc33745ec97be906ULL,
+	0x86f0ac99b4e8dafdULL, 0x69a028bb3ded71a3ULL,
+	0xa8acd7c0222311bcULL, 0xc40832ea0d68ce0cULL,
+	0xd2d80db02aabd62bULL, 0xf50a3fa490c30190ULL,
+	0x83c7088e1aab65dbULL, 0x792667c6da79e0faULL,
+	0xa4b8cab1a1563f52ULL, 0x577001b891185938ULL,
+	0xcde6fd5e09abcf26ULL, 0xed4c0226b55e6f86ULL,
+	0x80b05e5ac60b6178ULL, 0x544f8158315b05b4ULL,
+	0xa0dc75f1778e39d6ULL, 0x696361ae3db1c721ULL,
+	0xc913936dd571c84cULL, 0x03bc3a19cd1e38e9ULL,
+	0xfb5878494ace3a5fULL, 0x04ab48a04065c723ULL,
+	0x9d174b2dcec0e47bULL, 0x62eb0d64283f9c76ULL,
+	0xc45d1df942711d9aULL, 0x3ba5d0bd324f8394ULL,
+	0xf5746577930d6500ULL, 0xca8f44ec7ee36479ULL,
+	0x9968bf6abbe85f20ULL, 0x7e998b13cf4e1ecbULL,
+	0xbfc2ef456ae276e8ULL, 0x9e3fedd8c321a67eULL,
+	0xefb3ab16c59b14a2ULL, 0xc5cfe94ef3ea101eULL,
+	0x95d04aee3b80ece5ULL, 0xbba1f1d158724a12ULL,
+	0xbb445da9ca61281fULL, 0x2a8a6e45ae8edc97ULL,
+	0xea1575143cf97226ULL, 0xf52d09d71a3293bdULL,
+	0x924d692ca61be758ULL, 0x593c2626705f9c56ULL,
+	0xb6e0c377cfa2e12eULL, 0x6f8b2fb00c77836cULL,
+	0xe498f455c38b997aULL, 0x0b6dfb9c0f956447ULL,
+	0x8edf98b59a373fecULL, 0x4724bd4189bd5eacULL,
+	0xb2977ee300c50fe7ULL, 0x58edec91ec2cb657ULL,
+	0xdf3d5e9bc0f653e1ULL, 0x2f2967b66737e3edULL,
+	0x8b865b215899f46cULL, 0xbd79e0d20082ee74ULL,
+	0xae67f1e9aec07187ULL, 0xecd8590680a3aa11ULL,
+	0xda01ee641a708de9ULL, 0xe80e6f4820cc9495ULL,
+	0x884134fe908658b2ULL, 0x3109058d147fdcddULL,
+	0xaa51823e34a7eedeULL, 0xbd4b46f0599fd415ULL,
+	0xd4e5e2cdc1d1ea96ULL, 0x6c9e18ac7007c91aULL,
+	0x850fadc09923329eULL, 0x03e2cf6bc604ddb0ULL,
+	0xa6539930bf6bff45ULL, 0x84db8346b786151cULL,
+	0xcfe87f7cef46ff16ULL, 0xe612641865679a63ULL,
+	0x81f14fae158c5f6eULL, 0x4fcb7e8f3f60c07eULL,
+	0xa26da3999aef7749ULL, 0xe3be5e330f38f09dULL,
+	0xcb090c8001ab551cULL, 0x5cadf5bfd3072cc5ULL,
+	0xfdcb4fa002162a63ULL, 0x73d9732fc7c8f7f6ULL,
+	0x9e9f11c4014dda7eULL, 0x2867e7fddcdd9afaULL,
+	0xc646d63501a1511dULL, 0xb281e1fd541501b8ULL,
+	0xf7d88bc24209a565ULL, 0x1f225a7ca91a4226ULL,
+	0x9ae757596946075fULL, 0x3375788de9b06958ULL,
+	0xc1a12d2fc3978937ULL, 0x0052d6b1641c83aeULL,
+	0xf209787bb47d6b84ULL, 0xc0678c5dbd23a49aULL,
+	0x9745eb4d50ce6332ULL, 0xf840b7ba963646e0ULL,
+	0xbd176620a501fbffULL, 0xb650e5a93bc3d898ULL,
+	0xec5d3fa8ce427affULL, 0xa3e51f138ab4cebeULL,
+	0x93ba47c980e98cdfULL, 0xc66f336c36b10137ULL,
+	0xb8a8d9bbe123f017ULL, 0xb80b0047445d4184ULL,
+	0xe6d3102ad96cec1dULL, 0xa60dc059157491e5ULL,
+	0x9043ea1ac7e41392ULL, 0x87c89837ad68db2fULL,
+	0xb454e4a179dd1877ULL, 0x29babe4598c311fbULL,
+	0xe16a1dc9d8545e94ULL, 0xf4296dd6fef3d67aULL,
+	0x8ce2529e2734bb1dULL, 0x1899e4a65f58660cULL,
+	0xb01ae745b101e9e4ULL, 0x5ec05dcff72e7f8fULL,
+	0xdc21a1171d42645dULL, 0x76707543f4fa1f73ULL,
+	0x899504ae72497ebaULL, 0x6a06494a791c53a8ULL,
+	0xabfa45da0edbde69ULL, 0x0487db9d17636892ULL,
+	0xd6f8d7509292d603ULL, 0x45a9d2845d3c42b6ULL,
+	0x865b86925b9bc5c2ULL, 0x0b8a2392ba45a9b2ULL,
+	0xa7f26836f282b732ULL, 0x8e6cac7768d7141eULL,
+	0xd1ef0244af2364ffULL, 0x3207d795430cd926ULL,
+	0x8335616aed761f1fULL, 0x7f44e6bd49e807b8ULL,
+	0xa402b9c5a8d3a6e7ULL, 0x5f16206c9c6209a6ULL,
+	0xcd036837130890a1ULL, 0x36dba887c37a8c0fULL,
+	0x802221226be55a64ULL, 0xc2494954da2c9789ULL,
+	0xa02aa96b06deb0fdULL, 0xf2db9baa10b7bd6cULL,
+	0xc83553c5c8965d3dULL, 0x6f92829494e5acc7ULL,
+	0xfa42a8b73abbf48cULL, 0xcb772339ba1f17f9ULL,
+	0x9c69a97284b578d7ULL, 0xff2a760414536efbULL,
+	0xc38413cf25e2d70dULL, 0xfef5138519684abaULL,
+	0xf46518c2ef5b8cd1ULL, 0x7eb258665fc25d69ULL,
+	0x98bf2f79d5993802ULL, 0xef2f773ffbd97a61ULL,
+	0xbeeefb584aff8603ULL, 0xaafb550ffacfd8faULL,
+	0xeeaaba2e5dbf6784ULL, 0x95ba2a53f983cf38ULL,
+	0x952ab45cfa97a0b2ULL, 0xdd945a747bf26183ULL,
+	0xba756174393d88dfULL, 0x94f971119aeef9e4ULL,
+	0xe912b9d1478ceb17ULL, 0x7a37cd5601aab85dULL,
+	0x91abb422ccb812eeULL, 0xac62e055c10ab33aULL,
+	0xb616a12b7fe617aaULL, 0x577b986b314d6009ULL,
+	0xe39c49765fdf9d94ULL, 0xed5a7e85fda0b80bULL,
+	0x8e41ade9fbebc27dULL, 0x14588f13be847307ULL,
+	0xb1d219647ae6b31cULL, 0x596eb2d8ae258fc8ULL,
+	0xde469fbd99a05fe3ULL, 0x6fca5f8ed9aef3bbULL,
+	0x8aec23d680043beeULL, 0x25de7bb9480d5854ULL,
+	0xada72ccc20054ae9ULL, 0xaf561aa79a10ae6aULL,
+	0xd910f7ff28069da4ULL, 0x1b2ba1518094da04ULL,
+	0x87aa9aff79042286ULL, 0x90fb44d2f05d0842ULL,
+	0xa99541bf57452b28ULL, 0x353a1607ac744a53ULL,
+	0xd3fa922f2d1675f2ULL, 0x42889b8997915ce8ULL,
+	0x847c9b5d7c2e09b7ULL, 0x69956135febada11ULL,
+	0xa59bc234db398c25ULL, 0x43fab9837e699095ULL,
+	0xcf02b2c21207ef2eULL, 0x94f967e45e03f4bbULL,
+	0x8161afb94b44f57dULL, 0x1d1be0eebac278f5ULL,
+	0xa1ba1ba79e1632dcULL, 0x6462d92a69731732ULL,
+	0xca28a291859bbf93ULL, 0x7d7b8f7503cfdcfeULL,
+	0xfcb2cb35e702af78ULL, 0x5cda735244c3d43eULL,
+	0x9defbf01b061adabULL, 0x3a0888136afa64a7ULL,
+	0xc56baec21c7a1916ULL, 0x088aaa1845b8fdd0ULL,
+	0xf6c69a72a3989f5bULL, 0x8aad549e57273d45ULL,
+	0x9a3c2087a63f6399ULL, 0x36ac54e2f678864bULL,
+	0xc0cb28a98fcf3c7fULL, 0x84576a1bb416a7ddULL,
+	0xf0fdf2d3f3c30b9fULL, 0x656d44a2a11c51d5ULL,
+	0x969eb7c47859e743ULL, 0x9f644ae5a4b1b325ULL,
+	0xbc4665b596706114ULL, 0x873d5d9f0dde1feeULL,
+	0xeb57ff22fc0c7959ULL, 0xa90cb506d155a7eaULL,
+	0x9316ff75dd87cbd8ULL, 0x09a7f12442d588f2ULL,
+	0xb7dcbf5354e9beceULL, 0x0c11ed6d538aeb2fULL,
+	0xe5d3ef282a242e81ULL, 0x8f1668c8a86da5faULL,
+	0x8fa475791a569d10ULL, 0xf96e017d694487bcULL,
+	0xb38d92d760ec4455ULL, 0x37c981dcc395a9acULL,
+	0xe070f78d3927556aULL, 0x85bbe253f47b1417ULL,
+	0x8c469ab843b89562ULL, 0x93956d7478ccec8eULL,
+	0xaf58416654a6babbULL, 0x387ac8d1970027b2ULL,
+	0xdb2e51bfe9d0696aULL, 0x06997b05fcc0319eULL,
+	0x88fcf317f22241e2ULL, 0x441fece3bdf81f03ULL,
+	0xab3c2fddeeaad25aULL, 0xd527e81cad7626c3ULL,
+	0xd60b3bd56a5586f1ULL, 0x8a71e223d8d3b074ULL,
+	0x85c7056562757456ULL, 0xf6872d5667844e49ULL,
+	0xa738c6bebb12d16cULL, 0xb428f8ac016561dbULL,
+	0xd106f86e69d785c7ULL, 0xe13336d701beba52ULL,
+	0x82a45b450226b39cULL, 0xecc0024661173473ULL,
+	0xa34d721642b06084ULL, 0x27f002d7f95d0190ULL,
+	0xcc20ce9bd35c78a5ULL, 0x31ec038df7b441f4ULL,
+	0xff290242c83396ceULL, 0x7e67047175a15271ULL,
+	0x9f79a169bd203e41ULL, 0x0f0062c6e984d386ULL,
+	0xc75809c42c684dd1ULL, 0x52c07b78a3e60868ULL,
+	0xf92e0c3537826145ULL, 0xa7709a56ccdf8a82ULL,
+	0x9bbcc7a142b17ccbULL, 0x88a66076400bb691ULL,
+	0xc2abf989935ddbfeULL, 0x6acff893d00ea435ULL,
+	0xf356f7ebf83552feULL, 0x0583f6b8c4124d43ULL,
+	0x98165af37b2153deULL, 0xc3727a337a8b704aULL,
+	0xbe1bf1b059e9a8d6ULL, 0x744f18c0592e4c5cULL,
+	0xeda2ee1c7064130cULL, 0x1162def06f79df73ULL,
+	0x9485d4d1c63e8be7ULL, 0x8addcb5645ac2ba8ULL,
+	0xb9a74a0637ce2ee1ULL, 0x6d953e2bd7173692ULL,
+	0xe8111c87c5c1ba99ULL, 0xc8fa8db6ccdd0437ULL,
+	0x910ab1d4db9914a0ULL, 0x1d9c9892400a22a2ULL,
+	0xb54d5e4a127f59c8ULL, 0x2503beb6d00cab4bULL,
+	0xe2a0b5dc971f303aULL, 0x2e44ae64840fd61dULL,
+	0x8da471a9de737e24ULL, 0x5ceaecfed289e5d2ULL,
+	0xb10d8e1456105dadULL, 0x7425a83e872c5f47ULL,
+	0xdd50f1996b947518ULL, 0xd12f124e28f77719ULL,
+	0x8a5296ffe33cc92fULL, 0x82bd6b70d99aaa6fULL,
+	0xace73cbfdc0bfb7bULL, 0x636cc64d1001550bULL,
+	0xd8210befd30efa5aULL, 0x3c47f7e05401aa4eULL,
+	0x8714a775e3e95c78ULL, 0x65acfaec34810a71ULL,
+	0xa8d9d1535ce3b396ULL, 0x7f1839a741a14d0dULL,
+	0xd31045a8341ca07cULL, 0x1ede48111209a050ULL,
+	0x83ea2b892091e44dULL, 0x934aed0aab460432ULL,
+	0xa4e4b66b68b65d60ULL, 0xf81da84d5617853fULL,
+	0xce1de40642e3f4b9ULL, 0x36251260ab9d668eULL,
+	0x80d2ae83e9ce78f3ULL, 0xc1d72b7c6b426019ULL,
+	0xa1075a24e4421730ULL, 0xb24cf65b8612f81fULL,
+	0xc94930ae1d529cfcULL, 0xdee033f26797b627ULL,
+	0xfb9b7cd9a4a7443cULL, 0x169840ef017da3b1ULL,
+	0x9d412e0806e88aa5ULL, 0x8e1f289560ee864eULL,
+	0xc491798a08a2ad4eULL, 0xf1a6f2bab92a27e2ULL,
+	0xf5b5d7ec8acb58a2ULL, 0xae10af696774b1dbULL,
+	0x9991a6f3d6bf1765ULL, 0xacca6da1e0a8ef29ULL,
+	0xbff610b0cc6edd3fULL, 0x17fd090a58d32af3ULL,
+	0xeff394dcff8a948eULL, 0xddfc4b4cef07f5b0ULL,
+	0x95f83d0a1fb69cd9ULL, 0x4abdaf101564f98eULL,
+	0xbb764c4ca7a4440fULL, 0x9d6d1ad41abe37f1ULL,
+	0xea53df5fd18d5513ULL, 0x84c86189216dc5edULL,
+	0x92746b9be2f8552cULL, 0x32fd3cf5b4e49bb4ULL,
+	0xb7118682dbb66a77ULL, 0x3fbc8c33221dc2a1ULL,
+	0xe4d5e82392a40515ULL, 0x0fabaf3feaa5334aULL,
+	0x8f05b1163ba6832dULL, 0x29cb4d87f2a7400eULL,
+	0xb2c71d5bca9023f8ULL, 0x743e20e9ef511012ULL,
+	0xdf78e4b2bd342cf6ULL, 0x914da9246b255416ULL,
+	0x8bab8eefb6409c1aULL, 0x1ad089b6c2f7548eULL,
+	0xae9672aba3d0c320ULL, 0xa184ac2473b529b1ULL,
+	0xda3c0f568cc4f3e8ULL, 0xc9e5d72d90a2741eULL,
+	0x8865899617fb1871ULL, 0x7e2fa67c7a658892ULL,
+	0xaa7eebfb9df9de8dULL, 0xddbb901b98feeab7ULL,
+	0xd51ea6fa85785631ULL, 0x552a74227f3ea565ULL,
+	0x8533285c936b35deULL, 0xd53a88958f87275fULL,
+	0xa67ff273b8460356ULL, 0x8a892abaf368f137ULL,
+	0xd01fef10a657842cULL, 0x2d2b7569b0432d85ULL,
+	0x8213f56a67f6b29bULL, 0x9c3b29620e29fc73ULL,
+	0xa298f2c501f45f42ULL, 0x8349f3ba91b47b8fULL,
+	0xcb3f2f7642717713ULL, 0x241c70a936219a73ULL,
+	0xfe0efb53d30dd4d7ULL, 0xed238cd383aa0110ULL,
+	0x9ec95d1463e8a506ULL, 0xf4363804324a40aaULL,
+	0xc67bb4597ce2ce48ULL, 0xb143c6053edcd0d5ULL,
+	0xf81aa16fdc1b81daULL, 0xdd94b7868e94050aULL,
+	0x9b10a4e5e9913128ULL, 0xca7cf2b4191c8326ULL,
+	0xc1d4ce1f63f57d72ULL, 0xfd1c2f611f63a3f0ULL,
+	0xf24a01a73cf2dccfULL, 0xbc633b39673c8cecULL,
+	0x976e41088617ca01ULL, 0xd5be0503e085d813ULL,
+	0xbd49d14aa79dbc82ULL, 0x4b2d8644d8a74e18ULL,
+	0xec9c459d51852ba2ULL, 0xddf8e7d60ed1219eULL,
+	0x93e1ab8252f33b45ULL, 0xcabb90e5c942b503ULL,
+	0xb8da1662e7b00a17ULL, 0x3d6a751f3b936243ULL,
+	0xe7109bfba19c0c9dULL, 0x0cc512670a783ad4ULL,
+	0x906a617d450187e2ULL, 0x27fb2b80668b24c5ULL,
+	0xb484f9dc9641e9daULL, 0xb1f9f660802dedf6ULL,
+	0xe1a63853bbd26451ULL, 0x5e7873f8a0396973ULL,
+	0x8d07e33455637eb2ULL, 0xdb0b487b6423e1e8ULL,
+	0xb049dc016abc5e5fULL, 0x91ce1a9a3d2cda62ULL,
+	0xdc5c5301c56b75f7ULL, 0x7641a140cc7810fbULL,
+	0x89b9b3e11b6329baULL, 0xa9e904c87fcb0a9dULL,
+	0xac2820d9623bf429ULL, 0x546345fa9fbdcd44ULL,
+	0xd732290fbacaf133ULL, 0xa97c177947ad4095ULL,
+	0x867f59a9d4bed6c0ULL, 0x49ed8eabcccc485dULL,
+	0xa81f301449ee8c70ULL, 0x5c68f256bfff5a74ULL,
+	0xd226fc195c6a2f8cULL, 0x73832eec6fff3111ULL,
+	0x83585d8fd9c25db7ULL, 0xc831fd53c5ff7eabULL,
+	0xa42e74f3d032f525ULL, 0xba3e7ca8b77f5e55ULL,
+	0xcd3a1230c43fb26fULL, 0x28ce1bd2e55f35ebULL,
+	0x80444b5e7aa7cf85ULL, 0x7980d163cf5b81b3ULL,
+	0xa0555e361951c366ULL, 0xd7e105bcc332621fULL,
+	0xc86ab5c39fa63440ULL, 0x8dd9472bf3fefaa7ULL,
+	0xfa856334878fc150ULL, 0xb14f98f6f0feb951ULL,
+	0x9c935e00d4b9d8d2ULL, 0x6ed1bf9a569f33d3ULL,
+	0xc3b8358109e84f07ULL, 0x0a862f80ec4700c8ULL,
+	0xf4a642e14c6262c8ULL, 0xcd27bb612758c0faULL,
+	0x98e7e9cccfbd7dbdULL, 0x8038d51cb897789cULL,
+	0xbf21e44003acdd2cULL, 0xe0470a63e6bd56c3ULL,
+	0xeeea5d5004981478ULL, 0x1858ccfce06cac74ULL,
+	0x95527a5202df0ccbULL, 0x0f37801e0c43ebc8ULL,
+	0xbaa718e68396cffdULL, 0xd30560258f54e6baULL,
+	0xe950df20247c83fdULL, 0x47c6b82ef32a2069ULL,
+	0x91d28b7416cdd27eULL, 0x4cdc331d57fa5441ULL,
+	0xb6472e511c81471dULL, 0xe0133fe4adf8e952ULL,
+	0xe3d8f9e563a198e5ULL, 0x58180fddd97723a6ULL,
+	0x8e679c2f5e44ff8fULL, 0x570f09eaa7ea7648ULL,
+	0xb201833b35d63f73ULL, 0x2cd2cc6551e513daULL,
+	0xde81e40a034bcf4fULL, 0xf8077f7ea65e58d1ULL,
+	0x8b112e86420f6191ULL, 0xfb04afaf27faf782ULL,
+	0xadd57a27d29339f6ULL, 0x79c5db9af1f9b563ULL,
+	0xd94ad8b1c7380874ULL, 0x18375281ae7822bcULL,
+	0x87cec76f1c830548ULL, 0x8f2293910d0b15b5ULL,
+	0xa9c2794ae3a3c69aULL, 0xb2eb3875504ddb22ULL,
+	0xd433179d9c8cb841ULL, 0x5fa60692a46151ebULL,
+	0x849feec281d7f328ULL, 0xdbc7c41ba6bcd333ULL,
+	0xa5c7ea73224deff3ULL, 0x12b9b522906c0800ULL,
+	0xcf39e50feae16befULL, 0xd768226b34870a00ULL,
+	0x81842f29f2cce375ULL, 0xe6a1158300d46640ULL,
+	0xa1e53af46f801c53ULL, 0x60495ae3c1097fd0ULL,
+	0xca5e89b18b602368ULL, 0x385bb19cb14bdfc4ULL,
+	0xfcf62c1dee382c42ULL, 0x46729e03dd9ed7b5ULL,
+	0x9e19db92b4e31ba9ULL, 0x6c07a2c26a8346d1ULL
+};
+
+/* Exact doubles, for the products that round only once */
+static const double laz_pow10_f64[] = {
+	1e0,  1e1,  1e2,  1e3,	1e4,  1e5,  1e6,  1e7,	1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Bits of the double nearest to w 10^q, for a nonzero `w` and q from -342 to
+ * 308, after Eisel and Lemire. The table is rounded down, so the product
+ * comes out short by less than two units of its middle word. Returns -1 when
+ * that could change the rounding and the slow path has to decide. */
+static int laz_eisel_lemire(u64 w, int q, u64 *bits)
+{
+	const u64 *pow10 = laz_pow10_128 + (q - LAZ_POW10_MIN) * 2;
+	unsigned lz = laz_clz64(w);
+	u64 low = w << lz;
+	u64 high = pow10[0];
+	u64 mantissa = 0;
+	unsigned upper = 0;
+	unsigned shift = 0;
+	u64 mask = 0;
+	int exponent = 0;
+
+	laz_mul128(&low, &high);
+	upper = (unsigned)(high >> 63);
+	shift = upper + 9;
+	mask = ((u64)1 << shift) - 1;
+
+	/* The 54 bits kept are exact unless the bits below them are close
+	 * enough to a carry for the low word of the power to matter */
+	if ((high & mask) == 0 || (high & mask) >= mask - 1) {
+		u64 low2 = w << lz;
+		u64 high2 = pow10[1];
+
+		laz_mul128(&low2, &high2);
+		low += high2;
+		high += low < high2;
+		upper = (unsigned)(high >> 63);
+		shift = upper + 9;
+		mask = ((u64)1 << shift) - 1;
+
+		if (((high & mask) == mask && low >= UINT64_MAX - 1) ||
+		    ((high & mask) == 0 && low == 0 && (high >> shift & 1))) {
+			return -1;
+		}
+	}
+
+	mantissa = high >> shift;
+	exponent = ((217706 * q) >> 16) + 63 + (int)upper - (int)lz + 1023;
+
+	if (exponent <= 0) {
+		/* Subnormal. Halfway points need more than 19 digits, so
+		 * rounding half up is exact. */
+		if (1 - exponent >= 64) {
+			*bits = 0;
+			return 0;
+		}
+
+		mantissa >>= 1 - exponent;
+		*bits = (mantissa + (mantissa & 1)) >> 1;
+		return 0;
+	}
+
+	mantissa = (mantissa + (mantissa & 1)) >> 1;
+
+	if (mantissa == (u64)1 << 53) {
+		mantissa >>= 1;
+		exponent++;
+	}
+
+	if (exponent >= 0x7ff) {
+		*bits = LAZ_F64_INF;
+		return 0;
+	}
+
+	*bits = ((u64)exponent << 52) | (mantissa & LAZ_F64_FRACTION_MASK);
+	return 0;
+}
+
+#define LAZ_DECIMAL_DIGITS 800
+
+/* 0.d[0]d[1]... times 10^point, with digits as values, for the slow path as
+ * in Go's strconv. No double needs more than 767 digits to round, and
+ * `truncated` records nonzero digits past the last kept. */
+struct laz_decimal {
+	u8 d[LAZ_DECIMAL_DIGITS];
+	size_t count;
+	i64 point;
+	int truncated;
+};
+
+static void laz_decimal_trim(struct laz_decimal *dec)
+{
+	while (dec->count > 0 && dec->d[dec->count - 1] == 0) {
+		dec->count--;
+	}
+
+	if (dec->count == 0) {
+		dec->point = 0;
+	}
+}
+
+/* Digits with at most one point from `p` to `end`, times 10^exponent */
+static void laz_decimal_init(struct laz_decimal *dec, const char *p,
+			     const char *end, i64 exponent)
+{
+	int after_point = 0;
+
+	dec->count = 0;
+	dec->point = 0;
+	dec->truncated = 0;
+
+	for (; p < end; p++) {
+		if (*p == '.') {
+			after_point = 1;
+			continue;
+		}
+
+		if (dec->count == 0 && *p == '0') {
+			dec->point -= after_point;
+			continue;
+		}
+
+		dec->point += !after_point;
+
+		if (dec->count < LAZ_DECIMAL_DIGITS) {
+			dec->d[dec->count++] = (u8)(*p - '0');
+		} else if (*p != '0') {
+			dec->truncated = 1;
+		}
+	}
+
+	dec->point += exponent;
+	laz_decimal_trim(dec);
+}
+
+/* Divides by 2^k, for k up to 60 */
+static void laz_decimal_shr(struct laz_decimal *dec, unsigned k)
+{
+	u64 mask = ((u64)1 << k) - 1;
+	u64 n = 0;
+	size_t r = 0;
+	size_t w = 0;
+
+	/* Enough leading digits for the first digit out */
+	for (; n >> k == 0; r++) {
+		if (r >= dec->count) {
+			if (n == 0) {
+				dec->count = 0;
+				return;
+			}
+
+			while (n >> k == 0) {
+				n *= 10;
+				r++;
+			}
+
+			break;
+		}
+
+		n = n * 10 + dec->d[r];
+	}
+
+	dec->point -= (i64)r - 1;
+
+	for (; r < dec->count; r++) {
+		u8 digit = dec->d[r];
+
+		dec->d[w++] = (u8)(n >> k);
+		n = (n & mask) * 10 + digit;
+	}
+
+	while (n > 0) {
+		u64 digit = n >> k;
+
+		n = (n & mask) * 10;
+
+		if (w < LAZ_DECIMAL_DIGITS) {
+			dec->d[w++] = (u8)digit;
+		} else if (digit > 0) {
+			dec->truncated = 1;
+		}
+	}
+
+	dec->count = w;
+	laz_decimal_trim(dec);
+}
+
+/* Multiplies by 2^k, for k up to 60, from the last digit up */
+static void laz_decimal_shl(struct laz_decimal *dec, unsigned k)
+{
+	u8 digits[LAZ_DECIMAL_DIGITS + 20];
+	size_t w = sizeof(digits);
+	size_t count = 0;
+	u64 n = 0;
+
+	for (size_t r = dec->count; r-- > 0;) {
+		n += (u64)dec->d[r] << k;
+		digits[--w] = (u8)(n % 10);
+		n /= 10;
+	}
+
+	while (n > 0) {
+		digits[--w] = (u8)(n % 10);
+		n /= 10;
+	}
+
+	count = sizeof(digits) - w;
+	dec->point += (i64)(count - dec->count);
+
+	if (count > LAZ_DECIMAL_DIGITS) {
+		for (size_t i = w + LAZ_DECIMAL_DIGITS; i < sizeof(digits); i++) {
+			dec->truncated |= digits[i] != 0;
+		}
+
+		count = LAZ_DECIMAL_DIGITS;
+	}
+
+	memcpy(dec->d, digits + w, count);
+	dec->count = count;
+	laz_decimal_trim(dec);
+}
+
+static void laz_decimal_shift(struct laz_decimal *dec, int k)
+{
+	for (; k > 60; k -= 60) {
+		laz_decimal_shl(dec, 60);
+	}
+
+	for (; k < -60; k += 60) {
+		laz_decimal_shr(dec, 60);
+	}
+
+	if (k > 0) {
+		laz_decimal_shl(dec, (unsigned)k);
+	} else if (k < 0) {
+		laz_decimal_shr(dec, (unsigned)-k);
+	}
+}
+
+/* Whether dropping the digits from `i` on rounds up, ties to even */
+static int laz_decimal_round_up(const struct laz_decimal *dec, i64 i)
+{
+	if (i < 0 || (u64)i >= dec->count) {
+		return 0;
+	}
+
+	if (dec->d[i] == 5 && (u64)i + 1 == dec->count) {
+		return dec->truncated || (i > 0 && dec->d[i - 1] % 2 == 1);
+	}
+
+	return dec->d[i] >= 5;
+}
+
+/* Bits of the double nearest to `dec`, which is consumed */
+static u64 laz_decimal_bits(struct laz_decimal *dec)
+{
+	static const int steps[] = { 1, 3, 6, 9, 13, 16, 19, 23, 26 };
+	const i64 step_count = (i64)ARRAY_LENGTH(steps);
+	int exponent = 0;
+	u64 mantissa = 0;
+	i64 i = 0;
+
+	if (dec->count == 0 || dec->point < -330) {
+		return 0;
+	}
+
+	if (dec->point > 310) {
+		return LAZ_F64_INF;
+	}
+
+	/* Scale into [0.5, 1) by powers of two */
+	while (dec->point > 0) {
+		int n = dec->point >= step_count ? 27 : steps[dec->point];
+
+		laz_decimal_shift(dec, -n);
+		exponent += n;
+	}
+
+	while (dec->point < 0 || (dec->point == 0 && dec->d[0] < 5)) {
+		int n = -dec->point >= step_count ? 27 : steps[-dec->point];
+
+		laz_decimal_shift(dec, n);
+		exponent -= n;
+	}
+
+	/* Into [1, 2), then up to the smallest normal exponent */
+	exponent--;
+
+	if (exponent < -1022) {
+		laz_decimal_shift(dec, exponent + 1022);
+		exponent = -1022;
+	}
+
+	if (exponent >= 1024) {
+		return LAZ_F64_INF;
+	}
+
+	/* The integer part is the 53-bit mantissa, rounded */
+	laz_decimal_shift(dec, 53);
+
+	for (i = 0; i < dec->point && (u64)i < dec->count; i++) {
+		mantissa = mantissa * 10 + dec->d[i];
+	}
+
+	for (; i < dec->point; i++) {
+		mantissa *= 10;
+	}
+
+	mantissa += (u64)laz_decimal_round_up(dec, dec->point);
+
+	if (mantissa == (u64)2 << 52) {
+		mantissa >>= 1;
+		exponent++;
+
+		if (exponent >= 1024) {
+			return LAZ_F64_INF;
+		}
+	}
+
+	if ((mantissa & ((u64)1 << 52)) == 0) {
+		exponent = -1023;
+	}
+
+	return ((u64)(exponent + 1023) << 52) | (mantissa & LAZ_F64_FRACTION_MASK);
+}
+
+/* Case-insensitive match of all of [p, end) against a lowercase `word` */
+static int laz_is_word(const char *p, const char *end, const char *word)
+{
+	size_t len = strlen(word);
+
+	if ((size_t)(end - p) != len) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		if ((p[i] | 0x20) != word[i]) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int parse_f64(struct str_view text, double *out)
+{
+	const char *p = text.data;
+	const char *end = NULL;
+	const char *digits = NULL;
+	const char *int_end = NULL;
+	const char *frac = NULL;
+	const char *frac_end = NULL;
+	int negative = 0;
+	int many = 0;
+	size_t count = 0;
+	u64 w = 0;
+	i64 exponent = 0;
+	i64 q = 0;
+	u64 bits = 0;
+
+	if (text.len == 0) {
+		return -1;
+	}
+
+	end = p + text.len;
+
+	if (*p == '-' || *p == '+') {
+		negative = *p == '-';
+		p++;
+	}
+
+	if (laz_is_word(p, end, "inf") || laz_is_word(p, end, "infinity")) {
+		bits = LAZ_F64_INF;
+		goto out;
+	}
+
+	if (laz_is_word(p, end, "nan")) {
+		bits = LAZ_F64_NAN;
+		goto out;
+	}
+
+	/* Digits may overflow `w` here, which is redone below if so */
+	for (digits = p; p < end; p++) {
+		unsigned digit = (unsigned)(unsigned char)*p - '0';
+
+		if (digit > 9) {
+			break;
+		}
+
+		w = w * 10 + digit;
+	}
+
+	int_end = p;
+	frac = p;
+
+	if (p < end && *p == '.') {
+		frac = ++p;
+
+		for (; end - p >= 8; p += 8) {
+			u64 v = laz_read64((const unsigned char *)p);
+
+			if (!laz_is_digits8(v)) {
+				break;
+			}
+
+			w = w * 100000000 + laz_digits8(v);
+		}
+
+		for (; p < end; p++) {
+			unsigned digit = (unsigned)(unsigned char)*p - '0';
+
+			if (digit > 9) {
+				break;
+			}
+
+			w = w * 10 + digit;
+		}
+	}
+
+	frac_end = p;
+	count = (size_t)(int_end - digits) + (size_t)(frac_end - frac);
+
+	if (count == 0) {
+		return -1;
+	}
+
+	if (p < end && (*p | 0x20) == 'e') {
+		const char *exp_digits = NULL;
+		int exp_negative = 0;
+
+		if (++p < end && (*p == '-' || *p == '+')) {
+			exp_negative = *p == '-';
+			p++;
+		}
+
+		for (exp_digits = p; p < end; p++) {
+			unsigned digit = (unsigned)(unsigned char)*p - '0';
+
+			if (digit > 9) {
+				break;
+			}
+
+			/* Saturated, far past any double */
+			if (exponent < 0x100000) {
+				exponent = exponent * 10 + digit;
+			}
+		}
+
+		if (p == exp_digits) {
+			return -1;
+		}
+
+		exponent = exp_negative ? -exponent : exponent;
+	}
+
+	if (p != end) {
+		return -1;
+	}
+
+	q = exponent - (frac_end - frac);
+
+	if (count > 19) {
+		for (p = digits; p < frac_end && (*p == '0' || *p == '.'); p++) {
+			count -= *p == '0';
+		}
+
+		/* Keep 19 significant digits. The rest only place the value
+		 * between w 10^q and (w + 1) 10^q. */
+		if (count > 19) {
+			many = 1;
+			w = 0;
+
+			for (p = digits; p < int_end && w < 1000000000000000000ULL;
+			     p++) {
+				w = w * 10 + (u64)(*p - '0');
+			}
+
+			if (w >= 1000000000000000000ULL) {
+				q = exponent + (int_end - p);
+			} else {
+				for (p = frac; p < frac_end &&
+					       w < 1000000000000000000ULL;
+				     p++) {
+					w = w * 10 + (u64)(*p - '0');
+				}
+
+				q = exponent - (p - frac);
+			}
+		}
+	}
+
+	if (w == 0 || q < LAZ_POW10_MIN) {
+		bits = 0;
+	} else if (q > 308) {
+		bits = LAZ_F64_INF;
+	}
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+	else if (!many && w <= (u64)1 << 53 && q >= -22 && q <= 22) {
+		/* Both exact, so the one operation rounds correctly */
+		double value = q < 0 ? (double)w / laz_pow10_f64[-q] :
+				       (double)w * laz_pow10_f64[q];
+
+		memcpy(&bits, &value, sizeof(bits));
+	}
+#endif
+	else {
+		u64 next = 0;
+
+		if (laz_eisel_lemire(w, (int)q, &bits) != 0 ||
+		    (many && (laz_eisel_lemire(w + 1, (int)q, &next) != 0 ||
+			      next != bits))) {
+			struct laz_decimal dec;
+
+			laz_decimal_init(&dec, digits, frac_end, exponent);
+			bits = laz_decimal_bits(&dec);
+		}
+	}
+
+out:
+	bits |= (u64)negative << 63;
+	memcpy(out, &bits, sizeof(bits));
+	return 0;
+}
+
+static const char laz_digit_pairs[] = "0001020304050607080910111213141516171819"
+				      "2021222324252627282930313233343536373839"
+				      "4041424344454647484950515253545556575859"
+				      "6061626364656667686970717273747576777879"
+				      "8081828384858687888990919293949596979899";
+
+/* Writes the digits of `value` to end just before `end`, two at a time, and
+ * returns where they start */
+static char *laz_format_digits(u64 value, char *end)
+{
+	while (value >= 100) {
+		size_t pair = (size_t)(value % 100) * 2;
+
+		value /= 100;
+		end -= 2;
+		memcpy(end, laz_digit_pairs + pair, 2);
+	}
+
+	if (value >= 10) {
+		end -= 2;
+		memcpy(end, laz_digit_pairs + value * 2, 2);
+	} else {
+		*--end = (char)('0' + value);
+	}
+
+	return end;
+}
+
+size_t format_u64(u64 value, char *out)
+{
+	char buf[20];
+	char *start = laz_format_digits(value, buf + sizeof(buf));
+	size_t len = (size_t)(buf + sizeof(buf) - start);
+
+	memcpy(out, start, len);
+	out[len] = '\0';
+	return len;
+}
+
+size_t format_i64(i64 value, char *out)
+{
+	if (value < 0) {
+		out[0] = '-';
+		return format_u64(0 - (u64)value, out + 1) + 1;
+	}
+
+	return format_u64((u64)value, out);
+}
+
+#define LAZ_F64_C_MIN ((u64)1 << 52)
+#define LAZ_F64_Q_MIN (-1074)
+#define LAZ_MASK_63 0x7fffffffffffffffULL
+
+/* floor(q log10(2)), floor(log10(3/4 2^q)) and floor(e log2(10)), exact over
+ * the exponents of doubles */
+static int laz_flog10_pow2(int q)
+{
+	return (int)(((i64)q * 661971961083LL) >> 41);
+}
+
+static int laz_flog10_three_quarters_pow2(int q)
+{
+	return (int)(((i64)q * 661971961083LL - 274743187321LL) >> 41);
+}
+
+static int laz_flog2_pow10(int e)
+{
+	return (int)(((i64)e * 913124641741LL) >> 38);
+}
+
+/* g cp / 2^127 rounded to odd, with g = g1 2^63 + g0 */
+static u64 laz_rop(u64 g1, u64 g0, u64 cp)
+{
+	u64 x0 = g0;
+	u64 x1 = cp;
+	u64 y0 = g1;
+	u64 y1 = cp;
+	u64 z = 0;
+
+	laz_mul128(&x0, &x1);
+	laz_mul128(&y0, &y1);
+	z = (y0 >> 1) + x1;
+	return (y1 + (z >> 63)) | (((z & LAZ_MASK_63) + LAZ_MASK_63) >> 63);
+}
+
+/* The shortest decimal in the rounding interval of c 2^q, closest to it on
+ * ties, as digits 10^exponent. This is Giulietti's Schubfach, without the
+ * two digits Java keeps for subnormals. */
+static u64 laz_schubfach(int q, u64 c, int *exponent)
+{
+	u64 out = c & 1;
+	u64 cb = c << 2;
+	u64 cbr = cb + 2;
+	u64 cbl = 0;
+	int k = 0;
+	int h = 0;
+	const u64 *pow10 = NULL;
+	u64 g_hi = 0;
+	u64 g_lo = 0;
+	u64 g1 = 0;
+	u64 g0 = 0;
+	u64 vb = 0;
+	u64 vbl = 0;
+	u64 vbr = 0;
+	u64 s = 0;
+	u64 t = 0;
+	u64 sp10 = 0;
+	u64 tp10 = 0;
+	int upin = 0;
+	int wpin = 0;
+	int uin = 0;
+	int win = 0;
+	i64 cmp = 0;
+
+	/* Powers of two have a closer lower neighbor */
+	if (c != LAZ_F64_C_MIN || q == LAZ_F64_Q_MIN) {
+		cbl = cb - 2;
+		k = laz_flog10_pow2(q);
+	} else {
+		cbl = cb - 1;
+		k = laz_flog10_three_quarters_pow2(q);
+	}
+
+	h = q + laz_flog2_pow10(-k) + 2;
+
+	/* g = floor(10^-k 2^r) + 1 in [2^125, 2^126), from the table */
+	pow10 = laz_pow10_128 + (-k - LAZ_POW10_MIN) * 2;
+	g_hi = pow10[0] >> 2;
+	g_lo = (pow10[0] << 62) | (pow10[1] >> 2);
+	g_lo++;
+	g_hi += g_lo == 0;
+	g1 = (g_hi << 1) | (g_lo >> 63);
+	g0 = g_lo & LAZ_MASK_63;
+
+	vb = laz_rop(g1, g0, cb << h);
+	vbl = laz_rop(g1, g0, cbl << h);
+	vbr = laz_rop(g1, g0, cbr << h);
+	s = vb >> 2;
+
+	/* One digit fewer, when exactly one of its neighbors is inside. Java
+	 * skips this below s = 100 to keep two digits. */
+	sp10 = s;
+	tp10 = 1844674407370955168ULL;
+	laz_mul128(&sp10, &tp10);
+	sp10 = tp10 * 10;
+	tp10 = sp10 + 10;
+	upin = vbl + out <= sp10 << 2;
+	wpin = (tp10 << 2) + out <= vbr;
+	*exponent = k;
+
+	if (upin != wpin) {
+		return upin ? sp10 : tp10;
+	}
+
+	t = s + 1;
+	uin = vbl + out <= s << 2;
+	win = (t << 2) + out <= vbr;
+
+	if (uin != win) {
+		return uin ? s : t;
+	}
+
+	/* Both inside, so the one closer to the value */
+	cmp = (i64)(vb - ((s + t) << 1));
+	return cmp < 0 || (cmp == 0 && (s & 1) == 0) ? s : t;
+}
+
+/* digits 10^exponent as JavaScript prints numbers: plain from 1e-6 up to
+ * below 1e21, scientific outside */
+static size_t laz_format_decimal(u64 digits, int exponent, char *out)
+{
+	char buf[20];
+	char *start = NULL;
+	char *p = out;
+	int len = 0;
+	int point = 0;
+
+	while (digits % 10 == 0) {
+		digits /= 10;
+		exponent++;
+	}
+
+	start = laz_format_digits(digits, buf + sizeof(buf));
+	len = (int)(buf + sizeof(buf) - start);
+	point = len + exponent;
+
+	if (len <= point && point <= 21) {
+		memcpy(p, start, (size_t)len);
+		memset(p + len, '0', (size_t)(point - len));
+		p += point;
+	} else if (0 < point && point <= 21) {
+		memcpy(p, start, (size_t)point);
+		p[point] = '.';
+		memcpy(p + point + 1, start + point, (size_t)(len - point));
+		p += len + 1;
+	} else if (-6 < point && point <= 0) {
+		p[0] = '0';
+		p[1] = '.';
+		memset(p + 2, '0', (size_t)-point);
+		memcpy(p + 2 - point, start, (size_t)len);
+		p += 2 - point + len;
+	} else {
+		*p++ = start[0];
+
+		if (len > 1) {
+			*p++ = '.';
+			memcpy(p, start + 1, (size_t)(len - 1));
+			p += len - 1;
+		}
+
+		*p++ = 'e';
+		*p++ = point > 0 ? '+' : '-';
+		p += format_u64((u64)(point > 0 ? point - 1 : 1 - point), p);
+	}
+
+	*p = '\0';
+	return (size_t)(p - out);
+}
+
+size_t format_f64(double value, char *out)
+{
+	u64 bits = 0;
+	u64 fraction = 0;
+	unsigned biased = 0;
+	size_t sign = 0;
+	u64 digits = 0;
+	int exponent = 0;
+
+	memcpy(&bits, &value, sizeof(bits));
+	fraction = bits & LAZ_F64_FRACTION_MASK;
+	biased = (unsigned)(bits >> 52) & 0x7ff;
+	sign = (size_t)(bits >> 63);
+
+	if (biased == 0x7ff && fraction != 0) {
+		memcpy(out, "nan", 4);
+		return 3;
+	}
+
+	out[0] = '-';
+
+	if (biased == 0x7ff) {
+		memcpy(out + sign, "inf", 4);
+		return sign + 3;
+	}
+
+	if (biased == 0 && fraction == 0) {
+		memcpy(out + sign, "0", 2);
+		return sign + 1;
+	}
+
+	if (biased != 0) {
+		int mq = -LAZ_F64_Q_MIN + 1 - (int)biased;
+		u64 c = LAZ_F64_C_MIN | fraction;
+
+		/* Integers below 2^53 are their own shortest digits */
+		if (0 < mq && mq < 53 && (c & (((u64)1 << mq) - 1)) == 0) {
+			digits = c >> mq;
+		} else {
+			digits = laz_schubfach(-mq, c, &exponent);
+		}
+	} else {
+		digits = laz_schubfach(LAZ_F64_Q_MIN, fraction, &exponent);
+	}
+
+	return sign + laz_format_decimal(digits, exponent, out + sign);
+}
+
+void out_buf_init(struct out_buf *buf, size_t cap)
+{
+	buf->cap = MAX(cap, 64);
+	buf->data = (char *)malloc_try(buf->cap);
+	buf->len = 0;
+}
+
+void out_buf_destroy(struct out_buf *buf)
+{
+	free(buf->data);
+	buf->data = NULL;
+	buf->len = 0;
+	buf->cap = 0;
+}
+
+char *out_buf_reserve(struct out_buf *buf, size_t len)
+{
+	if (unlikely(buf->cap - buf->len < len)) {
+		buf->cap = MAX(buf->cap * 2, buf->len + len);
+		buf->data = (char *)realloc_try(buf->data, buf->cap);
+	}
+
+	return buf->data + buf->len;
+}
+
+void out_buf_append(struct out_buf *buf, const void *data, size_t len)
+{
+	if (len > 0) {
+		memcpy(out_buf_reserve(buf, len), data, len);
+		buf->len += len;
+	}
+}
+
+void out_buf_append_cstr(struct out_buf *buf, const char *str)
+{
+	out_buf_append(buf, str, scan_strlen(str));
+}
+
+void out_buf_append_char(struct out_buf *buf, char c)
+{
+	*out_buf_reserve(buf, 1) = c;
+	buf->len++;
+}
+
+void out_buf_append_u64(struct out_buf *buf, u64 value)
+{
+	buf->len += format_u64(value, out_buf_reserve(buf, FORMAT_NUMBER_MAX));
+}
+
+void out_buf_append_i64(struct out_buf *buf, i64 value)
+{
+	buf->len += format_i64(value, out_buf_reserve(buf, FORMAT_NUMBER_MAX));
+}
+
+void out_buf_append_f64(struct out_buf *buf, double value)
+{
+	buf->len += format_f64(value, out_buf_reserve(buf, FORMAT_NUMBER_MAX));
+}
+
+void out_buf_append_hex(struct out_buf *buf, u64 value, unsigned width)
+{
+	static const char digits[] = "0123456789abcdef";
+	unsigned len = 1;
+	char *out = NULL;
+
+	while (len < 16 && value >> (4 * len) != 0) {
+		len++;
+	}
+
+	len = MAX(len, width);
+	out = out_buf_reserve(buf, len);
+
+	/* Digits past those of the value are zeros */
+	for (unsigned i = len; i > 0; i--) {
+		out[i - 1] = digits[value & 15];
+		value >>= 4;
+	}
+
+	buf->len += len;
+}
+
+int out_buf_printf(struct out_buf *buf, const char *LAZ_RESTRICT format, ...)
+{
+	va_list args;
+	int ret = 0;
+
+	va_start(args, format);
+	ret = out_buf_vprintf(buf, format, args);
+	va_end(args);
+
+	return ret;
+}
+
+int out_buf_vprintf(struct out_buf *buf, const char *LAZ_RESTRICT format,
+		    va_list args)
+{
+	va_list retry;
+	char *out = out_buf_reserve(buf, 1);
+	int len = 0;
+
+	/* Formats into the free space, and again with room for the whole
+	 * text in the rare case it did not fit */
+	va_copy(retry, args);
+	len = vsnprintf(out, buf->cap - buf->len, format, args);
+
+	if (len >= 0 && (size_t)len >= buf->cap - buf->len) {
+		len = vsnprintf(out_buf_reserve(buf, (size_t)len + 1),
+				(size_t)len + 1, format, retry);
+	}
+
+	va_end(retry);
+
+	if (len >= 0) {
+		buf->len += (size_t)len;
+	}
+
+	return len;
+}
+
+#ifdef LAZ_POSIX
+int out_buf_flush(int fd, struct out_buf *bufs, size_t count)
+{
+	struct iovec iov[64];
+	size_t done = 0;
+	/* Bytes of bufs[done] already written */
+	size_t skip = 0;
+
+	while (done < count) {
+		int iov_count = 0;
+		ssize_t written = 0;
+
+		for (size_t i = done; i < count && iov_count < 64; i++) {
+			size_t from = i == done ? skip : 0;
+
+			if (bufs[i].len > from) {
+				iov[iov_count].iov_base = bufs[i].data + from;
+				iov[iov_count].iov_len = bufs[i].len - from;
+				iov_count++;
+			}
+		}
+
+		if (iov_count == 0) {
+			break;
+		}
+
+		written = writev(fd, iov, iov_count);
+
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (written < 0) {
+			break;
+		}
+
+		/* Steps over the buffers written in full */
+		skip += (size_t)written;
+
+		while (done < count && skip >= bufs[done].len) {
+			skip -= bufs[done].len;
+			done++;
+		}
+	}
+
+	/* Only what was not written stays, if anything */
+	for (size_t i = 0; i < done; i++) {
+		bufs[i].len = 0;
+	}
+
+	if (done == count) {
+		return 0;
+	}
+
+	memmove(bufs[done].data, bufs[done].data + skip, bufs[done].len - skip);
+	bufs[done].len -= skip;
+	return -1;
+}
+#endif
+
+static size_t laz_next_pow2(size_t n)
+{
+	size_t p = 1;
+
+	while (p < n) {
+		p <<= 1;
+	}
+
+	return p;
+}
+
+/* splitmix64, a small generator for tables that must be the same
+ * everywhere */
+static u64 laz_splitmix64(u64 *state)
+{
+	u64 z = (*state += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+#define LAZ_CDC_DEFAULT_AVG_SIZE (8 << 10)
+
+/* `bits` one bits spread over the top 48 bits of a word. The gear hash shifts
+ * left, so its high bits depend on the most bytes. */
+static u64 laz_cdc_mask(unsigned bits)
+{
+	unsigned step = MAX(1, 48 / bits);
+	u64 mask = 0;
+
+	for (unsigned i = 0; i < bits; i++) {
+		mask |= 1ULL << (63 - i * step);
+	}
+
+	return mask;
+}
+
+void cdc_init(struct cdc *cdc, size_t min_size, size_t avg_size,
+	      size_t max_size)
+{
+	u64 state = 0x6364635f67656172ULL; /* "cdc_gear" */
+	unsigned bits = 0;
+
+	avg_size = avg_size != 0 ? avg_size : LAZ_CDC_DEFAULT_AVG_SIZE;
+	avg_size = laz_next_pow2(CLAMP(avg_size, 64, (size_t)1 << 30));
+
+	while (((size_t)1 << bits) < avg_size) {
+		bits++;
+	}
+
+	cdc->avg_size = avg_size;
+	cdc->min_size = min_size != 0 ? MIN(min_size, avg_size / 2) :
+					avg_size / 4;
+	cdc->max_size = max_size != 0 ? MAX(max_size, avg_size * 2) :
+					avg_size * 8;
+
+	/* Normalized chunking: harder to cut before the average size and
+	 * easier after, which narrows the size distribution */
+	cdc->mask_small = laz_cdc_mask(bits + 2);
+	cdc->mask_large = laz_cdc_mask(bits - 2);
+
+	for (size_t i = 0; i < ARRAY_LENGTH(cdc->gear); i++) {
+		cdc->gear[i] = laz_splitmix64(&state);
+	}
+}
+
+size_t cdc_next(const struct cdc *cdc, const void *data, size_t len)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	size_t normal = MIN(cdc->avg_size, len);
+	size_t end = MIN(cdc->max_size, len);
+	size_t i = cdc->min_size;
+	u64 hash = 0;
+
+	if (len <= cdc->min_size) {
+		return len;
+	}
+
+	/* No boundary can fall before the minimum size, so skip it */
+	for (; i < normal; i++) {
+		hash = (hash << 1) + cdc->gear[p[i]];
+
+		if ((hash & cdc->mask_small) == 0) {
+			return i + 1;
+		}
+	}
+
+	for (; i < end; i++) {
+		hash = (hash << 1) + cdc->gear[p[i]];
+
+		if ((hash & cdc->mask_large) == 0) {
+			return i + 1;
+		}
+	}
+
+	return end;
+}
+
+int cdc_buf(const struct cdc *cdc, const void *data, size_t len,
+	    int (*fn)(const struct cdc_chunk *chunk, void *ctx), void *ctx)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	struct cdc_chunk chunk;
+	int ret = 0;
+
+	chunk.offset = 0;
+
+	while (ret == 0 && chunk.offset < len) {
+		chunk.len = cdc_next(cdc, p + chunk.offset,
+				     len - (size_t)chunk.offset);
+		chunk.hash = fast_hash_64(p + chunk.offset, chunk.len, 0);
+		ret = fn(&chunk, ctx);
+		chunk.offset += chunk.len;
+	}
+
+	return ret;
+}
+
+/* Blocks are one cache line of 512 bits */
+#define LAZ_BLOOM_BLOCK_WORDS 8
+#define LAZ_BLOOM_BLOCK_BITS 512
+#define LAZ_BLOOM_MAX_HASHES 16
+#define LAZ_BLOOM_MAGIC 0x4d4f4f4c425a414cULL /* "LAZBLOOM" */
+/* Version 2 takes the probes from independent hash bits */
+#define LAZ_BLOOM_VERSION 2
+#define LAZ_LN2 0.6931471805599453
+
+/* Header of saved filters, padded to a block so the blocks of a mapped file
+ * stay aligned */
+struct laz_bloom_header {
+	u64 magic;
+	u32 version;
+	u32 hashes;
+	u64 block_count;
+	u64 pad[5];
+};
+
+struct bloom {
+	u64 *blocks;
+	u64 block_count;
+	unsigned hashes;
+	/* Allocation behind `blocks`, null when they point into `map` */
+	void *mem;
+#ifdef LAZ_POSIX
+	struct mapped_file map;
+#endif
+};
+
+/* Natural logarithm and exponential, for sizing only, without linking libm */
+static double laz_log(double x)
+{
+	double y = 0.0;
+	double y2 = 0.0;
+	double sum = 0.0;
+	double term = 0.0;
+	int exponent = 0;
+
+	if (x <= 0.0) {
+		return -1e300;
+	}
+
+	for (; x >= 2.0; x /= 2.0) {
+		exponent++;
+	}
+
+	for (; x < 1.0; x *= 2.0) {
+		exponent--;
+	}
+
+	/* ln(x) = 2 atanh((x - 1) / (x + 1)), with |y| <= 1/3 here */
+	y = (x - 1.0) / (x + 1.0);
+	y2 = y * y;
+	term = y;
+
+	for (int i = 1; i < 40; i += 2) {
+		sum += term / i;
+		term *= y2;
+	}
+
+	return 2.0 * sum + exponent * LAZ_LN2;
+}
+
+static double laz_exp(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	int squarings = 0;
+
+	if (x < -745.0) {
+		return 0.0;
+	}
+
+	for (; x > 0.5 || x < -0.5; x /= 2.0) {
+		squarings++;
+	}
+
+	for (int i = 1; i < 16; i++) {
+		term *= x / i;
+		sum += term;
+	}
+
+	for (; squarings > 0; squarings--) {
+		sum *= sum;
+	}
+
+	return sum;
+}
+
+double bloom_fp_rate(u64 bits, unsigned hashes, u64 n)
+{
+	u64 blocks = MAX(bits / LAZ_BLOOM_BLOCK_BITS, 1);
+	double keys = (double)n / (double)blocks;
+	double log_keys = laz_log(keys);
+	double log_unset = laz_log(1.0 - 1.0 / LAZ_BLOOM_BLOCK_BITS);
+	double log_p = -keys;
+	double rate = 0.0;
+	double weight = 0.0;
+
+	if (n == 0) {
+		return 0.0;
+	}
+
+	/* Keys per block follow a Poisson distribution, and a block holding i
+	 * keys answers wrongly with the rate of a classic 512-bit filter */
+	for (u64 i = 0; i < 64 + 4 * (u64)keys; i++) {
+		double p = laz_exp(log_p);
+		double set = 1.0 - laz_exp((double)i * hashes * log_unset);
+
+		rate += p * laz_exp(hashes * laz_log(set));
+		weight += p;
+		log_p += log_keys - laz_log((double)(i + 1));
+
+		if (p < 1e-18 && (double)i > keys) {
+			break;
+		}
+	}
+
+	return MIN(rate / weight, 1.0);
+}
+
+unsigned bloom_hashes_for(u64 bits, u64 n)
+{
+	unsigned best = 1;
+	double best_rate = 2.0;
+
+	for (unsigned k = 1; k <= LAZ_BLOOM_MAX_HASHES; k++) {
+		double rate = bloom_fp_rate(bits, k, n);
+
+		if (rate < best_rate) {
+			best = k;
+			best_rate = rate;
+		}
+	}
+
+	return best;
+}
+
+u64 bloom_bits_for(u64 n, double fp_rate)
+{
+	/* Start from the size of a classic filter and grow by 5% steps */
+	double bits = (double)MAX(n, 1) * -laz_log(CLAMP(fp_rate, 1e-12, 0.5)) /
+		      (LAZ_LN2 * LAZ_LN2);
+	u64 rounded = 0;
+
+	for (int i = 0; i < 200; i++) {
+		rounded = ((u64)bits + LAZ_BLOOM_BLOCK_BITS - 1) /
+			  LAZ_BLOOM_BLOCK_BITS * LAZ_BLOOM_BLOCK_BITS;
+
+		if (bloom_fp_rate(rounded, bloom_hashes_for(rounded, n), n) <=
+		    fp_rate) {
+			break;
+		}
+
+		bits *= 1.05;
+	}
+
+	return MAX(rounded, LAZ_BLOOM_BLOCK_BITS);
+}
+
+struct bloom *bloom_create(u64 n, double fp_rate)
+{
+	struct bloom *bloom = (struct bloom *)calloc_try(1, sizeof(*bloom));
+	u64 bits = bloom_bits_for(n, fp_rate);
+	uintptr_t aligned = 0;
+
+	bloom->block_count = bits / LAZ_BLOOM_BLOCK_BITS;
+	bloom->hashes = bloom_hashes_for(bits, n);
+	/* Blocks are aligned to a cache line by hand, aligned_alloc being C11 */
+	bloom->mem = calloc_try((size_t)(bits / 8) + LAZ_CACHE_LINE, 1);
+	aligned = ((uintptr_t)bloom->mem + LAZ_CACHE_LINE - 1) &
+		  ~(uintptr_t)(LAZ_CACHE_LINE - 1);
+	bloom->blocks = (u64 *)aligned;
+
+	return bloom;
+}
+
+void bloom_destroy(struct bloom *bloom)
+{
+	if (bloom == NULL) {
+		return;
+	}
+
+#ifdef LAZ_POSIX
+	if (bloom->mem == NULL) {
+		unmap_file(&bloom->map);
+	}
+#endif
+	free(bloom->mem);
+	free(bloom);
+}
+
+u64 bloom_bits(const struct bloom *bloom)
+{
+	return bloom->block_count * LAZ_BLOOM_BLOCK_BITS;
+}
+
+unsigned bloom_hashes(const struct bloom *bloom)
+{
+	return bloom->hashes;
+}
+
+/* MurmurHash3 finalizer. FNV-1a leaves the last bytes of a key poorly mixed
+ * into the high bits, which pick the block. */
+static u64 laz_fmix64(u64 h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	return h ^ (h >> 33);
+}
+
+/* Picks the block of `hash` and builds the mask of its probed bits. Each
+ * probe is its own 9 bits of a remixed hash, 7 probes to a 64-bit word, so
+ * that probes are independent as the sizing assumes. */
+static u64 *laz_bloom_probe(const struct bloom *bloom, u64 hash,
+			    u64 mask[LAZ_BLOOM_BLOCK_WORDS])
+{
+	u64 h = laz_fmix64(hash);
+	u64 block = bloom->block_count;
+	u64 bits = 0;
+
+	memset(mask, 0, LAZ_BLOOM_BLOCK_WORDS * sizeof(u64));
+
+	for (unsigned i = 0; i < bloom->hashes; i++, bits >>= 9) {
+		unsigned bit = 0;
+
+		if (i % 7 == 0) {
+			bits = laz_fmix64(h + (i / 7 + 1) *
+						      0x9e3779b97f4a7c15ULL);
+		}
+
+		bit = (unsigned)bits & (LAZ_BLOOM_BLOCK_BITS - 1);
+		mask[bit >> 6] |= 1ULL << (bit & 63);
+	}
+
+	/* Multiply-shift maps the hash to a block without a division */
+	laz_mul128(&h, &block);
+
+	return bloom->blocks + block * LAZ_BLOOM_BLOCK_WORDS;
+}
+
+void bloom_add_hash(struct bloom *bloom, u64 hash)
+{
+	u64 mask[LAZ_BLOOM_BLOCK_WORDS];
+	u64 *block = laz_bloom_probe(bloom, hash, mask);
+
+	for (int i = 0; i < LAZ_BLOOM_BLOCK_WORDS; i++) {
+		block[i] |= mask[i];
+	}
+}
+
+int bloom_contains_hash(const struct bloom *bloom, u64 hash)
+{
+	u64 mask[LAZ_BLOOM_BLOCK_WORDS];
+	const u64 *block = laz_bloom_probe(bloom, hash, mask);
+#if defined(__SSE2__)
+	__m128i missing = _mm_setzero_si128();
+
+	/* A key is absent when a bit of its mask is clear in the block */
+	for (int i = 0; i < LAZ_BLOOM_BLOCK_WORDS; i += 2) {
+		__m128i b = _mm_load_si128((const __m128i *)(block + i));
+		__m128i m = _mm_loadu_si128((const __m128i *)(mask + i));
+
+		missing = _mm_or_si128(missing, _mm_andnot_si128(b, m));
+	}
+
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(missing,
+						_mm_setzero_si128())) == 0xffff;
+#elif defined(__ARM_NEON)
+	uint64x2_t missing = vdupq_n_u64(0);
+
+	for (int i = 0; i < LAZ_BLOOM_BLOCK_WORDS; i += 2) {
+		missing = vorrq_u64(missing, vbicq_u64(vld1q_u64(mask + i),
+						       vld1q_u64(block + i)));
+	}
+
+	return (vgetq_lane_u64(missing, 0) | vgetq_lane_u64(missing, 1)) == 0;
+#else
+	u64 missing = 0;
+
+	for (int i = 0; i < LAZ_BLOOM_BLOCK_WORDS; i++) {
+		missing |= mask[i] & ~block[i];
+	}
+
+	return missing == 0;
+#endif
+}
+
+void bloom_add(struct bloom *bloom, const void *key, size_t len)
+{
+	bloom_add_hash(bloom, fnv1a_64_buf(key, len));
+}
+
+int bloom_contains(const struct bloom *bloom, const void *key, size_t len)
+{
+	return bloom_contains_hash(bloom, fnv1a_64_buf(key, len));
+}
+
+int bloom_save(const struct bloom *bloom, const char *path)
+{
+	struct laz_bloom_header header;
+	FILE *file = fopen(path, "wb");
+	size_t words = (size_t)bloom->block_count * LAZ_BLOOM_BLOCK_WORDS;
+
+	if (file == NULL) {
+		(void)errorf("Error: unable to write file %s\n", path);
+		return -1;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = LAZ_BLOOM_MAGIC;
+	header.version = LAZ_BLOOM_VERSION;
+	header.hashes = bloom->hashes;
+	header.block_count = bloom->block_count;
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+	    fwrite(bloom->blocks, sizeof(u64), words, file) != words) {
+		(void)errorf("Error: unable to write file %s\n", path);
+		(void)fclose(file);
+		return -1;
+	}
+
+	if (fclose(file) != 0) {
+		(void)errorf("Error: unable to write file %s\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+#define LAZ_HLL_DEFAULT_PRECISION 14
+#define LAZ_HLL_SPARSE_MIN 64
+
+/* While sparse, registers are kept as `index << 8 | value` entries, sorted and
+ * unique up to `sorted` and appended unordered after */
+struct hll {
+	u8 *registers;
+	u32 *sparse;
+	size_t sparse_len;
+	size_t sparse_cap;
+	size_t sorted;
+	unsigned precision;
+};
+
+struct hll *hll_create(unsigned precision)
+{
+	struct hll *hll = (struct hll *)calloc_try(1, sizeof(*hll));
+
+	precision = precision != 0 ? precision : LAZ_HLL_DEFAULT_PRECISION;
+	hll->precision = CLAMP(precision, 4, 18);
+	hll->sparse_cap = LAZ_HLL_SPARSE_MIN;
+	hll->sparse = (u32 *)malloc_try(hll->sparse_cap * sizeof(u32));
+
+	return hll;
+}
+
+void hll_destroy(struct hll *hll)
+{
+	if (hll == NULL) {
+		return;
+	}
+
+	free(hll->registers);
+	free(hll->sparse);
+	free(hll);
+}
+
+unsigned hll_precision(const struct hll *hll)
+{
+	return hll->precision;
+}
+
+static int laz_hll_compare(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a;
+	u32 y = *(const u32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Sorts the sparse entries and keeps the largest value of each register */
+static void laz_hll_compact(struct hll *hll)
+{
+	size_t kept = 0;
+
+	if (hll->sorted == hll->sparse_len) {
+		return;
+	}
+
+	qsort(hll->sparse, hll->sparse_len, sizeof(u32), laz_hll_compare);
+
+	for (size_t i = 0; i < hll->sparse_len; i++) {
+		if (kept > 0 && hll->sparse[kept - 1] >> 8 == hll->sparse[i] >> 8) {
+			kept--;
+		}
+
+		hll->sparse[kept++] = hll->sparse[i];
+	}
+
+	hll->sparse_len = kept;
+	hll->sorted = kept;
+}
+
+static void laz_hll_densify(struct hll *hll)
+{
+	hll->registers = (u8 *)calloc_try((size_t)1 << hll->precision, 1);
+
+	for (size_t i = 0; i < hll->sparse_len; i++) {
+		u32 index = hll->sparse[i] >> 8;
+		u8 value = (u8)hll->sparse[i];
+
+		hll->registers[index] = MAX(hll->registers[index], value);
+	}
+
+	free(hll->sparse);
+	hll->sparse = NULL;
+	hll->sparse_len = 0;
+	hll->sparse_cap = 0;
+	hll->sorted = 0;
+}
+
+static void laz_hll_set(struct hll *hll, u32 index, u8 value)
+{
+	size_t dense_size = (size_t)1 << hll->precision;
+
+	if (hll->registers != NULL) {
+		hll->registers[index] = MAX(hll->registers[index], value);
+		return;
+	}
+
+	if (hll->sparse_len == hll->sparse_cap) {
+		laz_hll_compact(hll);
+
+		/* Entries take 4 bytes against 1 per dense register */
+		if (hll->sparse_len >= dense_size / 4) {
+			laz_hll_densify(hll);
+			hll->registers[index] = MAX(hll->registers[index], value);
+			return;
+		}
+
+		if (hll->sparse_len > hll->sparse_cap / 2) {
+			hll->sparse_cap *= 2;
+			hll->sparse = (u32 *)realloc_try(
+				hll->sparse, hll->sparse_cap * sizeof(u32));
+		}
+	}
+
+	hll->sparse[hll->sparse_len++] = index << 8 | value;
+}
+
+void hll_add_hash(struct hll *hll, u64 hash)
+{
+	unsigned p = hll->precision;
+	/* The top bits pick the register, the rest give the rank of the first
+	 * one bit */
+	u64 rest = hash << p;
+	unsigned rank = MIN(laz_clz64(rest), 64 - p) + 1;
+
+	laz_hll_set(hll, (u32)(hash >> (64 - p)), (u8)rank);
+}
+
+void hll_add(struct hll *hll, const void *key, size_t len)
+{
+	hll_add_hash(hll, fast_hash_64(key, len, 0));
+}
+
+int hll_merge(struct hll *dst, const struct hll *src)
+{
+	size_t m = (size_t)1 << src->precision;
+	size_t i = 0;
+
+	if (dst->precision != src->precision) {
+		return -1;
+	}
+
+	if (src->registers == NULL) {
+		for (; i < src->sparse_len; i++) {
+			laz_hll_set(dst, src->sparse[i] >> 8,
+				    (u8)src->sparse[i]);
+		}
+
+		return 0;
+	}
+
+	if (dst->registers == NULL) {
+		laz_hll_densify(dst);
+	}
+
+#if defined(__SSE2__)
+	for (; i + 16 <= m; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(dst->registers + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(src->registers + i));
+
+		_mm_storeu_si128((__m128i *)(dst->registers + i),
+				 _mm_max_epu8(a, b));
+	}
+#elif defined(__ARM_NEON)
+	for (; i + 16 <= m; i += 16) {
+		vst1q_u8(dst->registers + i, vmaxq_u8(vld1q_u8(dst->registers + i),
+						      vld1q_u8(src->registers + i)));
+	}
+#endif
+	for (; i < m; i++) {
+		dst->registers[i] = MAX(dst->registers[i], src->registers[i]);
+	}
+
+	return 0;
+}
+
+/* Square root by Newton's method, only called on [0, 1] */
+static double laz_sqrt(double x)
+{
+	double r = 1.0;
+
+	for (int i = 0; i < 64; i++) {
+		double next = 0.5 * (r + x / r);
+
+		if (next == r) {
+			break;
+		}
+
+		r = next;
+	}
+
+	return r;
+}
+
+/* The sigma and tau series of Ertl's improved estimator, which corrects
+ * registers that are still zero and registers that saturated */
+static double laz_hll_sigma(double x)
+{
+	double y = 1.0;
+	double z = x;
+
+	for (;;) {
+		double prev = z;
+
+		x *= x;
+		z += x * y;
+		y += y;
+
+		if (z == prev) {
+			return z;
+		}
+	}
+}
+
+static double laz_hll_tau(double x)
+{
+	double y = 1.0;
+	double z = 1.0 - x;
+
+	if (x == 0.0 || x == 1.0) {
+		return 0.0;
+	}
+
+	for (;;) {
+		double prev = z;
+
+		x = laz_sqrt(x);
+		y *= 0.5;
+		z -= (1.0 - x) * (1.0 - x) * y;
+
+		if (z == prev) {
+			return z / 3.0;
+		}
+	}
+}
+
+u64 hll_count(struct hll *hll)
+{
+	unsigned q = 64 - hll->precision;
+	double m = (double)((size_t)1 << hll->precision);
+	/* Four histograms break the dependency between neighbouring
+	 * registers of equal value */
+	u32 counts[4][66];
+	double z = 0.0;
+
+	memset(counts, 0, sizeof(counts));
+
+	if (hll->registers != NULL) {
+		size_t i = 0;
+
+		for (; i + 4 <= (size_t)m; i += 4) {
+			counts[0][hll->registers[i]]++;
+			counts[1][hll->registers[i + 1]]++;
+			counts[2][hll->registers[i + 2]]++;
+			counts[3][hll->registers[i + 3]]++;
+		}
+
+		for (int k = 0; k <= 65; k++) {
+			counts[0][k] += counts[1][k] + counts[2][k] + counts[3][k];
+		}
+	} else {
+		laz_hll_compact(hll);
+		counts[0][0] = (u32)m - (u32)hll->sparse_len;
+
+		for (size_t i = 0; i < hll->sparse_len; i++) {
+			counts[0][hll->sparse[i] & 0xff]++;
+		}
+	}
+
+	if (counts[0][0] == (u32)m) {
+		return 0;
+	}
+
+	z = m * laz_hll_tau(1.0 - counts[0][q + 1] / m);
+
+	for (unsigned k = q; k >= 1; k--) {
+		z = 0.5 * (z + counts[0][k]);
+	}
+
+	z += m * laz_hll_sigma(counts[0][0] / m);
+	return (u64)(0.5 / LAZ_LN2 * m * m / z + 0.5);
+}
+
+#define LAZ_CMS_DEFAULT_WIDTH 2048
+#define LAZ_CMS_DEFAULT_DEPTH 4
+#define LAZ_CMS_MAX_DEPTH 16
+
+/* `depth` rows of `mask + 1` counters */
+struct cms {
+	u64 *counters;
+	size_t mask;
+	unsigned depth;
+	u64 total;
+};
+
+struct cms *cms_create(size_t width, unsigned depth)
+{
+	struct cms *cms = (struct cms *)calloc_try(1, sizeof(*cms));
+
+	width = laz_next_pow2(width != 0 ? width : LAZ_CMS_DEFAULT_WIDTH);
+	depth = depth != 0 ? depth : LAZ_CMS_DEFAULT_DEPTH;
+	cms->mask = width - 1;
+	cms->depth = MIN(depth, LAZ_CMS_MAX_DEPTH);
+	cms->counters = (u64 *)calloc_try(width * cms->depth, sizeof(u64));
+
+	return cms;
+}
+
+void cms_destroy(struct cms *cms)
+{
+	if (cms == NULL) {
+		return;
+	}
+
+	free(cms->counters);
+	free(cms);
+}
+
+/* Counter of `hash` in each row, by double hashing */
+static void laz_cms_slots(const struct cms *cms, u64 hash, size_t *slots)
+{
+	u64 a = laz_fmix64(hash);
+	u64 b = laz_fmix64(hash ^ 0x9e3779b97f4a7c15ULL) | 1;
+
+	for (unsigned i = 0; i < cms->depth; i++) {
+		slots[i] = i * (cms->mask + 1) +
+			   ((size_t)((a + i * b) >> 32) & cms->mask);
+	}
+}
+
+void cms_add_hash(struct cms *cms, u64 hash, u64 count)
+{
+	size_t slots[LAZ_CMS_MAX_DEPTH];
+	u64 min = UINT64_MAX;
+
+	laz_cms_slots(cms, hash, slots);
+
+	for (unsigned i = 0; i < cms->depth; i++) {
+		min = MIN(min, cms->counters[slots[i]]);
+	}
+
+	/* Conservative update: only raise the counters below the new
+	 * estimate, which keeps the others from drifting upwards */
+	min += count;
+
+	for (unsigned i = 0; i < cms->depth; i++) {
+		cms->counters[slots[i]] = MAX(cms->counters[slots[i]], min);
+	}
+
+	cms->total += count;
+}
+
+u64 cms_estimate_hash(const struct cms *cms, u64 hash)
+{
+	size_t slots[LAZ_CMS_MAX_DEPTH];
+	u64 min = UINT64_MAX;
+
+	laz_cms_slots(cms, hash, slots);
+
+	for (unsigned i = 0; i < cms->depth; i++) {
+		min = MIN(min, cms->counters[slots[i]]);
+	}
+
+	return min;
+}
+
+void cms_add(struct cms *cms, const void *key, size_t len, u64 count)
+{
+	cms_add_hash(cms, fnv1a_64_buf(key, len), count);
+}
+
+u64 cms_estimate(const struct cms *cms, const void *key, size_t len)
+{
+	return cms_estimate_hash(cms, fnv1a_64_buf(key, len));
+}
+
+u64 cms_total(const struct cms *cms)
+{
+	return cms->total;
+}
+
+int cms_merge(struct cms *dst, const struct cms *src)
+{
+	size_t n = (src->mask + 1) * src->depth;
+
+	if (dst->mask != src->mask || dst->depth != src->depth) {
+		return -1;
+	}
+
+	/* Sums of conservative counters still bound the true counts */
+	for (size_t i = 0; i < n; i++) {
+		dst->counters[i] += src->counters[i];
+	}
+
+	dst->total += src->total;
+	return 0;
+}
+
+#define LAZ_TOP_K_EMPTY UINT32_MAX
+
+/* Min-heap of the tracked items by count, plus an open addressing table from
+ * key hashes to heap positions. `where` holds the table position of each heap
+ * item. */
+struct top_k {
+	struct top_k_item *heap;
+	size_t *where;
+	u32 *table;
+	size_t table_mask;
+	size_t size;
+	size_t k;
+};
+
+struct top_k *top_k_create(size_t k)
+{
+	struct top_k *top = (struct top_k *)calloc_try(1, sizeof(*top));
+	size_t table_size = laz_next_pow2(MAX(2 * k, 8));
+
+	top->k = MAX(k, 1);
+	top->heap = (struct top_k_item *)malloc_try(top->k *
+						    sizeof(*top->heap));
+	top->where = (size_t *)malloc_try(top->k * sizeof(*top->where));
+	top->table = (u32 *)malloc_try(table_size * sizeof(*top->table));
+	top->table_mask = table_size - 1;
+	memset(top->table, 0xff, table_size * sizeof(*top->table));
+
+	return top;
+}
+
+void top_k_destroy(struct top_k *top)
+{
+	if (top == NULL) {
+		return;
+	}
+
+	free(top->heap);
+	free(top->where);
+	free(top->table);
+	free(top);
+}
+
+/* Table position holding `hash`, or the empty one where it would go */
+static size_t laz_top_k_find(const struct top_k *top, u64 hash)
+{
+	size_t pos = (size_t)laz_fmix64(hash) & top->table_mask;
+
+	while (top->table[pos] != LAZ_TOP_K_EMPTY &&
+	       top->heap[top->table[pos]].hash != hash) {
+		pos = (pos + 1) & top->table_mask;
+	}
+
+	return pos;
+}
+
+/* Backward shift deletion, which leaves no tombstones behind */
+static void laz_top_k_unlink(struct top_k *top, size_t pos)
+{
+	size_t next = pos;
+
+	top->table[pos] = LAZ_TOP_K_EMPTY;
+
+	for (;;) {
+		size_t home = 0;
+
+		next = (next + 1) & top->table_mask;
+
+		if (top->table[next] == LAZ_TOP_K_EMPTY) {
+			return;
+		}
+
+		home = (size_t)laz_fmix64(top->heap[top->table[next]].hash) &
+		       top->table_mask;
+
+		/* Entries whose home lies cyclically in (pos, next] stay */
+		if (((next - home) & top->table_mask) <
+		    ((next - pos) & top->table_mask)) {
+			continue;
+		}
+
+		top->table[pos] = top->table[next];
+		top->where[top->table[pos]] = pos;
+		top->table[next] = LAZ_TOP_K_EMPTY;
+		pos = next;
+	}
+}
+
+static void laz_top_k_swap(struct top_k *top, size_t a, size_t b)
+{
+	struct top_k_item item = top->heap[a];
+	size_t where = top->where[a];
+
+	top->heap[a] = top->heap[b];
+	top->heap[b] = item;
+	top->where[a] = top->where[b];
+	top->where[b] = where;
+	top->table[top->where[a]] = (u32)a;
+	top->table[top->where[b]] = (u32)b;
+}
+
+static void laz_top_k_sift_up(struct top_k *top, size_t i)
+{
+	while (i > 0 && top->heap[(i - 1) / 2].count > top->heap[i].count) {
+		laz_top_k_swap(top, i, (i - 1) / 2);
+		i = (i - 1) / 2;
+	}
+}
+
+static void laz_top_k_sift_down(struct top_k *top, size_t i)
+{
+	for (;;) {
+		size_t smallest = i;
+		size_t left = 2 * i + 1;
+		size_t right = left + 1;
+
+		if (left < top->size &&
+		    top->heap[left].count < top->heap[smallest].count) {
+			smallest = left;
+		}
+
+		if (right < top->size &&
+		    top->heap[right].count < top->heap[smallest].count) {
+			smallest = right;
+		}
+
+		if (smallest == i) {
+			return;
+		}
+
+		laz_top_k_swap(top, i, smallest);
+		i = smallest;
+	}
+}
+
+static void laz_top_k_insert(struct top_k *top, u64 hash, const void *key,
+			     size_t len, u64 count, u64 error)
+{
+	size_t pos = laz_top_k_find(top, hash);
+	struct top_k_item *item = NULL;
+	size_t i = 0;
+
+	if (top->table[pos] != LAZ_TOP_K_EMPTY) {
+		i = top->table[pos];
+		top->heap[i].count += count;
+		top->heap[i].error += error;
+		laz_top_k_sift_down(top, i);
+		return;
+	}
+
+	if (top->size < top->k) {
+		i = top->size++;
+	} else {
+		/* Evict the least frequent key, whose count the newcomer
+		 * inherits as possible overcount */
+		laz_top_k_unlink(top, top->where[0]);
+		count += top->heap[0].count;
+		error += top->heap[0].count;
+		pos = laz_top_k_find(top, hash);
+	}
+
+	item = &top->heap[i];
+	item->count = count;
+	item->error = error;
+	item->hash = hash;
+	item->len = MIN(len, TOP_K_KEY_SIZE);
+	memcpy(item->key, key, item->len);
+	top->where[i] = pos;
+	top->table[pos] = (u32)i;
+
+	if (i == 0) {
+		laz_top_k_sift_down(top, i);
+	} else {
+		laz_top_k_sift_up(top, i);
+	}
+}
+
+void top_k_add(struct top_k *top, const void *key, size_t len, u64 count)
+{
+	laz_top_k_insert(top, fnv1a_64_buf(key, len), key, len, count, 0);
+}
+
+static int laz_top_k_compare(const void *a, const void *b)
+{
+	u64 x = ((const struct top_k_item *)a)->count;
+	u64 y = ((const struct top_k_item *)b)->count;
+
+	return (x < y) - (x > y);
+}
+
+void top_k_merge(struct top_k *dst, const struct top_k *src)
+{
+	/* A key missing from a full summary may have been counted up to its
+	 * minimum there */
+	u64 dst_min = dst->size == dst->k ? dst->heap[0].count : 0;
+	u64 src_min = src->size == src->k ? src->heap[0].count : 0;
+	struct top_k_item *items = (struct top_k_item *)malloc_try(
+		(dst->size + src->size) * sizeof(*items) + 1);
+	unsigned char *merged = (unsigned char *)calloc_try(src->size + 1, 1);
+	size_t n = 0;
+
+	for (size_t i = 0; i < dst->size; i++) {
+		size_t pos = laz_top_k_find(src, dst->heap[i].hash);
+
+		items[n] = dst->heap[i];
+
+		if (src->table[pos] != LAZ_TOP_K_EMPTY) {
+			items[n].count += src->heap[src->table[pos]].count;
+			items[n].error += src->heap[src->table[pos]].error;
+			merged[src->table[pos]] = 1;
+		} else {
+			items[n].count += src_min;
+			items[n].error += src_min;
+		}
+
+		n++;
+	}
+
+	for (size_t i = 0; i < src->size; i++) {
+		if (!merged[i]) {
+			items[n] = src->heap[i];
+			items[n].count += dst_min;
+			items[n].error += dst_min;
+			n++;
+		}
+	}
+
+	qsort(items, n, sizeof(*items), laz_top_k_compare);
+	memset(dst->table, 0xff, (dst->table_mask + 1) * sizeof(*dst->table));
+	dst->size = 0;
+
+	for (size_t i = 0; i < MIN(n, dst->k); i++) {
+		laz_top_k_insert(dst, items[i].hash, items[i].key, items[i].len,
+				 items[i].count, items[i].error);
+	}
+
+	free(merged);
+	free(items);
+}
+
+size_t top_k_list(const struct top_k *top, struct top_k_item *out)
+{
+	memcpy(out, top->heap, top->size * sizeof(*out));
+	qsort(out, top->size, sizeof(*out), laz_top_k_compare);
+	return top->size;
+}
+
+u32 jump_hash(u64 key, u32 buckets)
+{
+	i64 bucket = -1;
+	i64 next = 0;
+
+	/* Walks the buckets a key jumps to as their number grows, using a
+	 * linear congruential generator seeded by the key */
+	while (next < (i64)buckets) {
+		bucket = next;
+		key = key * 2862933555777941757ULL + 1;
+		next = (i64)((double)(bucket + 1) *
+			     ((double)(1LL << 31) / (double)((key >> 33) + 1)));
+	}
+
+	return (u32)MAX(bucket, 0);
+}
+
+size_t rendezvous_hash(u64 key, const u64 *nodes, size_t count)
+{
+	size_t best = 0;
+	u64 best_score = 0;
+
+	key = laz_fmix64(key);
+
+	for (size_t i = 0; i < count; i++) {
+		u64 score = laz_fmix64(key ^ laz_fmix64(nodes[i]));
+
+		if (i == 0 || score > best_score) {
+			best = i;
+			best_score = score;
+		}
+	}
+
+	return best;
+}
+
+#define LAZ_HASH_RING_DEFAULT_VNODES 128
+
+struct laz_ring_point {
+	u64 hash;
+	u64 node;
+};
+
+/* Points sorted by hash, each node owning the keys up to its points */
+struct hash_ring {
+	struct laz_ring_point *points;
+	size_t count;
+	size_t cap;
+	size_t vnodes;
+	size_t nodes;
+};
+
+struct hash_ring *hash_ring_create(size_t vnodes)
+{
+	struct hash_ring *ring =
+		(struct hash_ring *)calloc_try(1, sizeof(*ring));
+
+	ring->vnodes = vnodes != 0 ? vnodes : LAZ_HASH_RING_DEFAULT_VNODES;
+	return ring;
+}
+
+void hash_ring_destroy(struct hash_ring *ring)
+{
+	if (ring == NULL) {
+		return;
+	}
+
+	free(ring->points);
+	free(ring);
+}
+
+static int laz_ring_compare(const void *a, const void *b)
+{
+	const struct laz_ring_point *x = (const struct laz_ring_point *)a;
+	const struct laz_ring_point *y = (const struct laz_ring_point *)b;
+
+	if (x->hash != y->hash) {
+		return (x->hash > y->hash) - (x->hash < y->hash);
+	}
+
+	/* Colliding points still need an order every ring agrees on */
+	return (x->node > y->node) - (x->node < y->node);
+}
+
+static int laz_ring_has(const struct hash_ring *ring, u64 node)
+{
+	for (size_t i = 0; i < ring->count; i++) {
+		if (ring->points[i].node == node) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void hash_ring_add(struct hash_ring *ring, u64 node)
+{
+	u64 state = fnv1a_64_buf(&node, sizeof(node));
+
+	if (laz_ring_has(ring, node)) {
+		return;
+	}
+
+	if (ring->count + ring->vnodes > ring->cap) {
+		ring->cap = MAX(ring->cap * 2, ring->count + ring->vnodes);
+		ring->points = (struct laz_ring_point *)realloc_try(
+			ring->points, ring->cap * sizeof(*ring->points));
+	}
+
+	for (size_t i = 0; i < ring->vnodes; i++) {
+		ring->points[ring->count].hash = laz_splitmix64(&state);
+		ring->points[ring->count].node = node;
+		ring->count++;
+	}
+
+	qsort(ring->points, ring->count, sizeof(*ring->points),
+	      laz_ring_compare);
+	ring->nodes++;
+}
+
+void hash_ring_remove(struct hash_ring *ring, u64 node)
+{
+	size_t kept = 0;
+
+	for (size_t i = 0; i < ring->count; i++) {
+		if (ring->points[i].node != node) {
+			ring->points[kept++] = ring->points[i];
+		}
+	}
+
+	if (kept != ring->count) {
+		ring->nodes--;
+	}
+
+	ring->count = kept;
+}
+
+size_t hash_ring_size(const struct hash_ring *ring)
+{
+	return ring->nodes;
+}
+
+int hash_ring_lookup(const struct hash_ring *ring, u64 key, u64 *node)
+{
+	size_t low = 0;
+	size_t high = ring->count;
+
+	if (ring->count == 0) {
+		return -1;
+	}
+
+	key = laz_fmix64(key);
+
+	/* First point at or after the key, wrapping around */
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+
+		if (ring->points[mid].hash < key) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	*node = ring->points[low == ring->count ? 0 : low].node;
+	return 0;
+}
+
+/* PTHash parameters: 60% of the keys go to 30% of the buckets, which keeps
+ * the large buckets few and placed first, and the table is 1% larger than the
+ * key set */
+#define LAZ_MPHF_BUCKET_SIZE 4
+#define LAZ_MPHF_LOAD 0.99
+#define LAZ_MPHF_MAX_PILOT (1U << 24)
+#define LAZ_MPHF_MAX_SEEDS 16
+
+static u64 laz_mphf_hash(u64 seed, const void *key, size_t len)
+{
+	return laz_fmix64(fnv1a_64_buf(key, len) ^ seed);
+}
+
+static size_t laz_mphf_bucket(const struct mphf *mphf, u64 hash)
+{
+	u64 dense = (u64)mphf->bucket_count * 3 / 10;
+	u64 low = (u32)hash;
+
+	/* 0.6 * 2^32 */
+	if ((hash >> 32) < 2576980377ULL) {
+		return (size_t)((low * dense) >> 32);
+	}
+
+	return (size_t)(dense + ((low * (mphf->bucket_count - dense)) >> 32));
+}
+
+static size_t laz_mphf_position(const struct mphf *mphf, u64 hash, u32 pilot)
+{
+	u64 mixed = laz_fmix64(hash ^ laz_fmix64(pilot));
+
+	return (size_t)(((mixed >> 32) * mphf->table_size) >> 32);
+}
+
+size_t mphf_index(const struct mphf *mphf, const void *key, size_t len)
+{
+	u64 hash = laz_mphf_hash(mphf->seed, key, len);
+	size_t pos = laz_mphf_position(
+		mphf, hash, mphf->pilots[laz_mphf_bucket(mphf, hash)]);
+
+	return pos < mphf->count ? pos : mphf->remap[pos - mphf->count];
+}
+
+struct laz_mphf_key {
+	u64 hash;
+	size_t bucket;
+};
+
+static int laz_mphf_compare_keys(const void *a, const void *b)
+{
+	const struct laz_mphf_key *x = (const struct laz_mphf_key *)a;
+	const struct laz_mphf_key *y = (const struct laz_mphf_key *)b;
+
+	if (x->bucket != y->bucket) {
+		return (x->bucket > y->bucket) - (x->bucket < y->bucket);
+	}
+
+	return (x->hash > y->hash) - (x->hash < y->hash);
+}
+
+/* Buckets are placed largest first, by the index of their first key in
+ * `keys` */
+struct laz_mphf_bucket {
+	size_t first;
+	size_t size;
+};
+
+static int laz_mphf_compare_buckets(const void *a, const void *b)
+{
+	const struct laz_mphf_bucket *x = (const struct laz_mphf_bucket *)a;
+	const struct laz_mphf_bucket *y = (const struct laz_mphf_bucket *)b;
+
+	if (x->size != y->size) {
+		return (x->size < y->size) - (x->size > y->size);
+	}
+
+	return (x->first > y->first) - (x->first < y->first);
+}
+
+/* Finds a pilot for every bucket, returns -1 if one has none below
+ * LAZ_MPHF_MAX_PILOT */
+static int laz_mphf_place(struct mphf *mphf, struct laz_mphf_key *keys,
+			  u32 *pilots, unsigned char *taken)
+{
+	struct laz_mphf_bucket *buckets = (struct laz_mphf_bucket *)calloc_try(
+		mphf->bucket_count, sizeof(*buckets));
+	size_t positions[64];
+	size_t i = 0;
+	int ret = 0;
+
+	for (size_t k = 0; k < mphf->count; k++) {
+		struct laz_mphf_bucket *b = &buckets[keys[k].bucket];
+
+		b->first = b->size == 0 ? k : b->first;
+		b->size++;
+	}
+
+	qsort(buckets, mphf->bucket_count, sizeof(*buckets),
+	      laz_mphf_compare_buckets);
+
+	for (; ret == 0 && i < mphf->bucket_count && buckets[i].size > 0; i++) {
+		const struct laz_mphf_key *first = &keys[buckets[i].first];
+		size_t size = buckets[i].size;
+		u32 pilot = 0;
+
+		if (size > ARRAY_LENGTH(positions)) {
+			ret = -1;
+			break;
+		}
+
+		for (; pilot < LAZ_MPHF_MAX_PILOT; pilot++) {
+			size_t placed = 0;
+
+			for (; placed < size; placed++) {
+				size_t pos = laz_mphf_position(
+					mphf, first[placed].hash, pilot);
+
+				if (taken[pos]) {
+					break;
+				}
+
+				/* Marked right away so keys of the bucket
+				 * cannot share a slot */
+				taken[pos] = 1;
+				positions[placed] = pos;
+			}
+
+			if (placed == size) {
+				break;
+			}
+
+			while (placed > 0) {
+				taken[positions[--placed]] = 0;
+			}
+		}
+
+		ret = pilot < LAZ_MPHF_MAX_PILOT ? 0 : -1;
+		pilots[first->bucket] = pilot;
+	}
+
+	free(buckets);
+	return ret;
+}
+
+int mphf_build(struct mphf *mphf, const char *const *keys,
+	       const size_t *lens, size_t count)
+{
+	struct laz_mphf_key *hashed =
+		(struct laz_mphf_key *)malloc_try(MAX(count, 1) *
+						  sizeof(*hashed));
+	u32 *pilots = NULL;
+	u32 *remap = NULL;
+	unsigned char *taken = NULL;
+	int ret = -1;
+
+	memset(mphf, 0, sizeof(*mphf));
+	mphf->count = count;
+	mphf->bucket_count = MAX(count / LAZ_MPHF_BUCKET_SIZE, 1);
+	mphf->table_size = MAX((size_t)((double)count / LAZ_MPHF_LOAD), count);
+	mphf->table_size = MAX(mphf->table_size, 1);
+	pilots = (u32 *)calloc_try(mphf->bucket_count, sizeof(u32));
+	remap = (u32 *)calloc_try(mphf->table_size - count + 1, sizeof(u32));
+	taken = (unsigned char *)malloc_try(mphf->table_size);
+
+	for (u64 attempt = 0; ret != 0 && attempt < LAZ_MPHF_MAX_SEEDS;
+	     attempt++) {
+		int duplicate = 0;
+
+		mphf->seed = fnv1a_64_buf(&attempt, sizeof(attempt));
+
+		for (size_t i = 0; i < count; i++) {
+			size_t len = lens != NULL ? lens[i] : strlen(keys[i]);
+
+			hashed[i].hash = laz_mphf_hash(mphf->seed, keys[i], len);
+			hashed[i].bucket = laz_mphf_bucket(mphf, hashed[i].hash);
+		}
+
+		qsort(hashed, count, sizeof(*hashed), laz_mphf_compare_keys);
+
+		for (size_t i = 1; i < count; i++) {
+			duplicate |= hashed[i].hash == hashed[i - 1].hash;
+		}
+
+		if (duplicate) {
+			/* A 64-bit collision would go away with another seed,
+			 * but a repeated key never does */
+			continue;
+		}
+
+		memset(taken, 0, mphf->table_size);
+		ret = laz_mphf_place(mphf, hashed, pilots, taken);
+	}
+
+	if (ret != 0) {
+		(void)errorf("Error: unable to build a perfect hash, keys may "
+			     "repeat\n");
+		free(remap);
+		free(pilots);
+	} else {
+		/* Slots past `count` point to the free slots below it, which
+		 * there are exactly as many of as used slots past it */
+		size_t free_slot = 0;
+
+		for (size_t pos = count; pos < mphf->table_size; pos++) {
+			if (taken[pos]) {
+				while (taken[free_slot]) {
+					free_slot++;
+				}
+
+				remap[pos - count] = (u32)free_slot++;
+			}
+		}
+
+		mphf->pilots = pilots;
+		mphf->remap = remap;
+	}
+
+	free(taken);
+	free(hashed);
+	return ret;
+}
+
+void mphf_destroy(struct mphf *mphf)
+{
+	free((void *)mphf->pilots);
+	free((void *)mphf->remap);
+	memset(mphf, 0, sizeof(*mphf));
+}
+
+void *malloc_try(size_t size)
+{
+	void *mem = malloc(size);
+
+	if (mem == NULL) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	return mem;
+}
+
+void *calloc_try(size_t n, size_t size)
+{
+	void *mem = calloc(n, size);
+
+	if (mem == NULL) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+
+	return mem;
+}
+
+void *realloc_try(void *ptr, size_t size)
+{
+	void *mem = realloc(ptr, size);
+
+	if (mem == NULL) {
+		perror("realloc");
+		exit(EXIT_FAILURE);
+	}
+
+	return mem;
+}
+
+#if defined(_DEFAULT_SOURCE) || defined(_GNU_SOURCE)
+void *reallocarray_try(void *ptr, size_t n, size_t size)
+{
+	void *mem = reallocarray(ptr, n, size);
+
+	if (mem == NULL) {
+		perror("reallocarray");
+		exit(EXIT_FAILURE);
+	}
+
+	return mem;
+}
+#endif
+
+size_t cpu_count(void)
+{
+#if defined(LAZ_POSIX) && defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (n > 0) {
+		return (size_t)n;
+	}
+#endif
+	return 1;
+}
+
+#ifdef LAZ_POSIX
+int map_file(const char *path, struct mapped_file *out)
+{
+	struct stat st;
+	void *data = NULL;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	out->data = NULL;
+	out->size = 0;
+
+	if (fd < 0) {
+		(void)errorf("Error: unable to read file %s\n", path);
+		return -1;
+	}
+
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		(void)errorf("Error: unable to read file %s\n", path);
+		(void)close(fd);
+		return -1;
+	}
+
+	if (st.st_size == 0) {
+		/* mmap refuses empty mappings */
+		(void)close(fd);
+		out->data = "";
+		return 0;
+	}
+
+	data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	(void)close(fd);
+
+	if (data == MAP_FAILED) {
+		(void)errorf("Error: unable to map file %s\n", path);
+		return -1;
+	}
+
+	out->data = (const char *)data;
+	out->size = (size_t)st.st_size;
+	return 0;
+}
+
+void unmap_file(struct mapped_file *file)
+{
+	if (file->size != 0) {
+		(void)munmap((void *)file->data, file->size);
+	}
+
+	file->data = NULL;
+	file->size = 0;
+}
+
+/* `path` is a buffer of `cap` bytes holding the directory path, reused for
+ * the paths of its children. `failed` is set when an entry is skipped. */
+static int laz_walk_dir(char **path, size_t *cap, size_t len,
+			int (*fn)(const char *path, u64 size, void *ctx),
+			void *ctx, int *failed)
+{
+	DIR *dir = opendir(*path);
+	struct dirent *entry = NULL;
+	/* Only "/" keeps its trailing slash */
+	size_t sep = (*path)[len - 1] != '/';
+	int ret = 0;
+
+	if (dir == NULL) {
+		(void)errorf("Error: unable to read directory %s\n", *path);
+		*failed = 1;
+		return 0;
+	}
+
+	while (ret == 0 && (entry = readdir(dir)) != NULL) {
+		const char *name = entry->d_name;
+		size_t name_len = strlen(name);
+		struct stat st;
+
+		if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+			continue;
+		}
+
+		if (len + sep + name_len + 1 > *cap) {
+			*cap = (len + sep + name_len + 1) * 2;
+			*path = (char *)realloc_try(*path, *cap);
+		}
+
+		(*path)[len] = '/';
+		memcpy(*path + len + sep, name, name_len + 1);
+
+		if (lstat(*path, &st) != 0) {
+			(void)errorf("Error: unable to read file %s\n", *path);
+			*failed = 1;
+		} else if (S_ISDIR(st.st_mode)) {
+			ret = laz_walk_dir(path, cap, len + sep + name_len, fn,
+					   ctx, failed);
+		} else if (S_ISREG(st.st_mode)) {
+			ret = fn(*path, (u64)st.st_size, ctx);
+		}
+
+		(*path)[len] = '\0';
+	}
+
+	(void)closedir(dir);
+	return ret;
+}
+
+int walk_dir(const char *root,
+	     int (*fn)(const char *path, u64 size, void *ctx), void *ctx)
+{
+	struct stat st;
+	size_t len = strlen(root);
+	size_t cap = len + 256;
+	char *path = NULL;
+	int failed = 0;
+	int ret = 0;
+
+	if (lstat(root, &st) != 0) {
+		(void)errorf("Error: unable to read file %s\n", root);
+		return -1;
+	}
+
+	if (S_ISREG(st.st_mode)) {
+		return fn(root, (u64)st.st_size, ctx);
+	}
+
+	if (!S_ISDIR(st.st_mode)) {
+		return 0;
+	}
+
+	/* Avoid "dir//file" when given "dir/" */
+	while (len > 1 && root[len - 1] == '/') {
+		len--;
+	}
+
+	path = (char *)malloc_try(cap);
+	memcpy(path, root, len);
+	path[len] = '\0';
+	ret = laz_walk_dir(&path, &cap, len, fn, ctx, &failed);
+	free(path);
+
+	return ret != 0 ? ret : -failed;
+}
+
+int file_stream_open(struct file_stream *stream, const char *path,
+		     size_t capacity)
+{
+	memset(stream, 0, sizeof(*stream));
+	stream->fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if (stream->fd < 0) {
+		(void)errorf("Error: unable to read file %s\n", path);
+		return -1;
+	}
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	(void)posix_fadvise(stream->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	stream->cap = MAX(capacity, 1);
+	stream->buf = (char *)malloc_try(stream->cap);
+	stream->data = stream->buf;
+
+	return 0;
+}
+
+void file_stream_close(struct file_stream *stream)
+{
+	if (stream->fd >= 0) {
+		(void)close(stream->fd);
+	}
+
+	free(stream->buf);
+	memset(stream, 0, sizeof(*stream));
+	stream->fd = -1;
+}
+
+long file_stream_fill(struct file_stream *stream, size_t want)
+{
+	want = MIN(want, stream->cap);
+
+	if (stream->len >= want || stream->eof) {
+		return (long)stream->len;
+	}
+
+	/* Slide the unconsumed bytes to the front to make room */
+	if (stream->data != stream->buf) {
+		memmove(stream->buf, stream->data, stream->len);
+		stream->data = stream->buf;
+	}
+
+	while (stream->len < want) {
+		ssize_t n = read(stream->fd, stream->buf + stream->len,
+				 stream->cap - stream->len);
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (n < 0) {
+			(void)errorf("Error: unable to read stream\n");
+			return -1;
+		}
+
+		if (n == 0) {
+			stream->eof = 1;
+			break;
+		}
+
+		stream->len += (size_t)n;
+	}
+
+	return (long)stream->len;
+}
+
+void file_stream_consume(struct file_stream *stream, size_t n)
+{
+	n = MIN(n, stream->len);
+	stream->data += n;
+	stream->len -= n;
+	stream->offset += n;
+}
+
+/* Alignment of writer blocks, a page on most systems */
+#define LAZ_WRITER_ALIGN 4096
+
+static char *laz_strdup(const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *copy = (char *)malloc_try(len);
+
+	memcpy(copy, str, len);
+	return copy;
+}
+
+static void laz_writer_preallocate(struct file_writer *w, u64 size)
+{
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+	/* Reserves the blocks without growing the file. Those past the end of
+	 * the output are released on close. */
+	if (fallocate(w->fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)size) == 0) {
+		w->reserved = size;
+	}
+#elif !defined(__APPLE__)
+	if (posix_fallocate(w->fd, 0, (off_t)size) == 0) {
+		w->reserved = size;
+	}
+#else
+	(void)w;
+	(void)size;
+#endif
+}
+
+int file_writer_open(struct file_writer *w, const char *path, int flags,
+		     size_t block_size, u64 size_hint)
+{
+	uintptr_t aligned = 0;
+
+	memset(w, 0, sizeof(*w));
+	w->flags = flags;
+	w->path = laz_strdup(path);
+
+	if (flags & FILE_WRITER_ATOMIC) {
+		size_t len = strlen(path);
+		struct stat st;
+
+		w->tmp_path = (char *)malloc_try(len + sizeof(".XXXXXX"));
+		memcpy(w->tmp_path, path, len);
+		memcpy(w->tmp_path + len, ".XXXXXX", sizeof(".XXXXXX"));
+		w->fd = mkstemp(w->tmp_path);
+
+		/* mkstemp creates files only the owner can read */
+		if (w->fd >= 0) {
+			(void)fchmod(w->fd, stat(path, &st) == 0 ?
+						    st.st_mode & 07777 :
+						    0644);
+		}
+	} else {
+		w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			     0666);
+	}
+
+	if (w->fd < 0) {
+		(void)errorf("Error: unable to write file %s\n", path);
+		free(w->path);
+		free(w->tmp_path);
+		memset(w, 0, sizeof(*w));
+		w->fd = -1;
+		return -1;
+	}
+
+	if (size_hint > 0) {
+		laz_writer_preallocate(w, size_hint);
+	}
+
+	w->cap = block_size > 0 ? block_size : FILE_WRITER_BLOCK;
+	w->mem = malloc_try(w->cap + LAZ_WRITER_ALIGN);
+	aligned = ((uintptr_t)w->mem + LAZ_WRITER_ALIGN - 1) &
+		  ~(uintptr_t)(LAZ_WRITER_ALIGN - 1);
+	w->block = (char *)aligned;
+
+	return 0;
+}
+
+/* Writes the block and then `len` bytes of `data`, all with writev */
+static int laz_writer_flush(struct file_writer *w, const void *data,
+			    size_t len)
+{
+	struct iovec iov[2];
+
+	iov[0].iov_base = w->block;
+	iov[0].iov_len = w->len;
+	iov[1].iov_base = (void *)(uintptr_t)data;
+	iov[1].iov_len = len;
+
+	while (iov[0].iov_len + iov[1].iov_len > 0) {
+		int first = iov[0].iov_len == 0;
+		ssize_t written = writev(w->fd, iov + first, 2 - first);
+
+		if (written < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (written < 0) {
+			w->error = 1;
+			(void)errorf("Error: unable to write file %s\n",
+				     w->path);
+			return -1;
+		}
+
+		w->offset += (u64)written;
+
+		/* Steps over what a partial write covered */
+		for (int i = 0; i < 2 && written > 0; i++) {
+			size_t step = MIN(iov[i].iov_len, (size_t)written);
+
+			iov[i].iov_base = (char *)iov[i].iov_base + step;
+			iov[i].iov_len -= step;
+			written -= (ssize_t)step;
+		}
+	}
+
+	w->len = 0;
+	return 0;
+}
+
+int file_writer_write(struct file_writer *w, const void *data, size_t len)
+{
+	if (w->error) {
+		return -1;
+	}
+
+	if (len <= w->cap - w->len) {
+		memcpy(w->block + w->len, data, len);
+		w->len += len;
+		return 0;
+	}
+
+	/* Tops up the block when the rest fits in the next, so that writes
+	 * stay a whole block each */
+	if (len - (w->cap - w->len) < w->cap) {
+		size_t head = w->cap - w->len;
+
+		memcpy(w->block + w->len, data, head);
+		w->len = w->cap;
+
+		if (laz_writer_flush(w, NULL, 0) != 0) {
+			return -1;
+		}
+
+		memcpy(w->block, (const char *)data + head, len - head);
+		w->len = len - head;
+		return 0;
+	}
+
+	return laz_writer_flush(w, data, len);
+}
+
+/* Syncs the directory of `path`, so that a rename in it survives a crash */
+static int laz_sync_dir(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	char *dir = laz_strdup(slash == NULL ? "." : path);
+	int fd = -1;
+	int ret = 0;
+
+	if (slash != NULL) {
+		dir[MAX(slash - path, 1)] = '\0';
+	}
+
+	fd = open(dir, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0 || fsync(fd) != 0) {
+		ret = -1;
+	}
+
+	if (fd >= 0) {
+		(void)close(fd);
+	}
+
+	free(dir);
+	return ret;
+}
+
+int file_writer_close(struct file_writer *w)
+{
+	int ret = 0;
+
+	if (w->fd < 0) {
+		return -1;
+	}
+
+	if (w->error || laz_writer_flush(w, NULL, 0) != 0) {
+		file_writer_abort(w);
+		return -1;
+	}
+
+	/* Gives back the reserved space the output did not use. A truncate to
+	 * the current size keeps blocks reserved past the end on some file
+	 * systems, hence the hole punched first. */
+	if (w->reserved > w->offset) {
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+		(void)fallocate(w->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+				(off_t)w->offset,
+				(off_t)(w->reserved - w->offset));
+#endif
+		ret |= ftruncate(w->fd, (off_t)w->offset);
+	}
+
+	if (w->flags & FILE_WRITER_ATOMIC) {
+		ret |= fsync(w->fd);
+	}
+
+	ret |= close(w->fd);
+	w->fd = -1;
+
+	if (ret == 0 && (w->flags & FILE_WRITER_ATOMIC)) {
+		ret |= rename(w->tmp_path, w->path);
+	}
+
+	/* Renamed, so there is nothing left to remove */
+	if (ret == 0 && (w->flags & FILE_WRITER_ATOMIC)) {
+		free(w->tmp_path);
+		w->tmp_path = NULL;
+		ret |= laz_sync_dir(w->path);
+	}
+
+	if (ret != 0) {
+		(void)errorf("Error: unable to write file %s\n", w->path);
+		file_writer_abort(w);
+		return -1;
+	}
+
+	file_writer_abort(w);
+	return 0;
+}
+
+void file_writer_abort(struct file_writer *w)
+{
+	if (w->fd >= 0) {
+		(void)close(w->fd);
+	}
+
+	if (w->tmp_path != NULL) {
+		(void)unlink(w->tmp_path);
+	}
+
+	free(w->path);
+	free(w->tmp_path);
+	free(w->mem);
+	memset(w, 0, sizeof(*w));
+	w->fd = -1;
+}
+
+int save_file(const char *path, const void *data, size_t len)
+{
+	struct file_writer w;
+
+	/* The data is already in one piece, so the block only needs to exist */
+	if (file_writer_open(&w, path, FILE_WRITER_ATOMIC, 1, len) != 0) {
+		return -1;
+	}
+
+	if (laz_writer_flush(&w, data, len) != 0) {
+		file_writer_abort(&w);
+		return -1;
+	}
+
+	return file_writer_close(&w);
+}
+
+/* Files from this size on are mapped rather than read */
+#define LAZ_CACHE_MAP_MIN (64 << 10)
+
+struct laz_cache_entry {
+	/* First, so that the contents handed out lead back to the entry */
+	struct cached_file file;
+	/* Chain of the hash bucket */
+	struct laz_cache_entry *next;
+	/* Most recently used first */
+	struct laz_cache_entry *lru_prev;
+	struct laz_cache_entry *lru_next;
+	struct mapped_file map;
+	char *buf;
+	u64 hash;
+	/* What stat reported when the contents were read */
+	u64 dev;
+	u64 ino;
+	u64 mtime_ns;
+	u64 ctime_ns;
+	u64 stat_size;
+	/* When stat last confirmed the contents */
+	u64 checked;
+	size_t refs;
+	/* Out of the table, freed by the last release */
+	int detached;
+	/* Stored after the entry */
+	char *path;
+};
+
+struct file_cache {
+	pthread_mutex_t lock;
+	struct laz_cache_entry **buckets;
+	size_t bucket_count;
+	size_t count;
+	struct laz_cache_entry *lru_head;
+	struct laz_cache_entry *lru_tail;
+	/* Contents of the entries in the table */
+	size_t bytes;
+	size_t budget;
+	u64 check_ns;
+};
+
+static u64 laz_monotonic_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+static void laz_cache_identity(const struct stat *st, u64 *mtime_ns,
+			       u64 *ctime_ns)
+{
+#if defined(__APPLE__)
+	*mtime_ns = (u64)st->st_mtimespec.tv_sec * 1000000000ULL +
+		    (u64)st->st_mtimespec.tv_nsec;
+	*ctime_ns = (u64)st->st_ctimespec.tv_sec * 1000000000ULL +
+		    (u64)st->st_ctimespec.tv_nsec;
+#else
+	*mtime_ns = (u64)st->st_mtim.tv_sec * 1000000000ULL +
+		    (u64)st->st_mtim.tv_nsec;
+	*ctime_ns = (u64)st->st_ctim.tv_sec * 1000000000ULL +
+		    (u64)st->st_ctim.tv_nsec;
+#endif
+}
+
+static int laz_cache_unchanged(const struct laz_cache_entry *e,
+			       const struct stat *st)
+{
+	u64 mtime_ns = 0;
+	u64 ctime_ns = 0;
+
+	laz_cache_identity(st, &mtime_ns, &ctime_ns);
+	return e->dev == (u64)st->st_dev && e->ino == (u64)st->st_ino &&
+	       e->stat_size == (u64)st->st_size && e->mtime_ns == mtime_ns &&
+	       e->ctime_ns == ctime_ns;
+}
+
+static void laz_cache_free(struct laz_cache_entry *e)
+{
+	if (e->buf == NULL) {
+		unmap_file(&e->map);
+	}
+
+	free(e->buf);
+	free(e);
+}
+
+/* Reads `path` into a new entry, null on failure */
+static struct laz_cache_entry *laz_cache_load(const char *path, u64 hash,
+					      const struct stat *st)
+{
+	size_t path_len = strlen(path) + 1;
+	struct laz_cache_entry *e = (struct laz_cache_entry *)calloc_try(
+		1, sizeof(*e) + path_len);
+	size_t size = (size_t)st->st_size;
+	size_t len = 0;
+	int fd = -1;
+
+	e->path = (char *)(e + 1);
+	memcpy(e->path, path, path_len);
+	e->hash = hash;
+	e->dev = (u64)st->st_dev;
+	e->ino = (u64)st->st_ino;
+	e->stat_size = (u64)st->st_size;
+	laz_cache_identity(st, &e->mtime_ns, &e->ctime_ns);
+
+	if (size >= LAZ_CACHE_MAP_MIN) {
+		if (map_file(path, &e->map) != 0) {
+			free(e);
+			return NULL;
+		}
+
+		e->file.data = e->map.data;
+		e->file.size = e->map.size;
+		return e;
+	}
+
+	/* A file that grew since the stat reads short, and its new times
+	 * make the next lookup read it again */
+	e->buf = (char *)malloc_try(size + 1);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	while (fd >= 0 && len < size) {
+		ssize_t n = read(fd, e->buf + len, size - len);
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (n <= 0) {
+			break;
+		}
+
+		len += (size_t)n;
+	}
+
+	if (fd < 0 || len < size) {
+		(void)errorf("Error: unable to read file %s\n", path);
+
+		if (fd >= 0) {
+			(void)close(fd);
+		}
+
+		laz_cache_free(e);
+		return NULL;
+	}
+
+	(void)close(fd);
+	e->buf[len] = '\0';
+	e->file.data = e->buf;
+	e->file.size = len;
+	return e;
+}
+
+static struct laz_cache_entry *laz_cache_find(const struct file_cache *cache,
+					      const char *path, u64 hash)
+{
+	struct laz_cache_entry *e =
+		cache->buckets[hash & (cache->bucket_count - 1)];
+
+	while (e != NULL && (e->hash != hash || strcmp(e->path, path) != 0)) {
+		e = e->next;
+	}
+
+	return e;
+}
+
+static void laz_cache_lru_unlink(struct file_cache *cache,
+				 struct laz_cache_entry *e)
+{
+	if (e->lru_prev != NULL) {
+		e->lru_prev->lru_next = e->lru_next;
+	} else {
+		cache->lru_head = e->lru_next;
+	}
+
+	if (e->lru_next != NULL) {
+		e->lru_next->lru_prev = e->lru_prev;
+	} else {
+		cache->lru_tail = e->lru_prev;
+	}
+
+	e->lru_prev = NULL;
+	e->lru_next = NULL;
+}
+
+static void laz_cache_lru_push(struct file_cache *cache,
+			       struct laz_cache_entry *e)
+{
+	e->lru_next = cache->lru_head;
+
+	if (cache->lru_head != NULL) {
+		cache->lru_head->lru_prev = e;
+	} else {
+		cache->lru_tail = e;
+	}
+
+	cache->lru_head = e;
+}
+
+/* Takes a reference to an entry of the table and marks it most recent */
+static const struct cached_file *laz_cache_acquire(struct file_cache *cache,
+						   struct laz_cache_entry *e)
+{
+	e->refs++;
+	laz_cache_lru_unlink(cache, e);
+	laz_cache_lru_push(cache, e);
+	return &e->file;
+}
+
+/* Removes an entry from the table, freeing it unless it is still held */
+static void laz_cache_detach(struct file_cache *cache,
+			     struct laz_cache_entry *e)
+{
+	struct laz_cache_entry **link =
+		&cache->buckets[e->hash & (cache->bucket_count - 1)];
+
+	while (*link != e) {
+		link = &(*link)->next;
+	}
+
+	*link = e->next;
+	laz_cache_lru_unlink(cache, e);
+	cache->count--;
+	cache->bytes -= e->file.size;
+	e->detached = 1;
+
+	if (e->refs == 0) {
+		laz_cache_free(e);
+	}
+}
+
+static void laz_cache_insert(struct file_cache *cache,
+			     struct laz_cache_entry *e)
+{
+	struct laz_cache_entry **bucket = NULL;
+
+	/* Doubles the buckets at a load factor of 1 */
+	if (cache->count == cache->bucket_count) {
+		size_t count = cache->bucket_count * 2;
+		struct laz_cache_entry **buckets =
+			(struct laz_cache_entry **)calloc_try(
+				count, sizeof(*buckets));
+
+		for (size_t i = 0; i < cache->bucket_count; i++) {
+			while (cache->buckets[i] != NULL) {
+				struct laz_cache_entry *moved =
+					cache->buckets[i];
+
+				cache->buckets[i] = moved->next;
+				moved->next = buckets[moved->hash & (count - 1)];
+				buckets[moved->hash & (count - 1)] = moved;
+			}
+		}
+
+		free(cache->buckets);
+		cache->buckets = buckets;
+		cache->bucket_count = count;
+	}
+
+	bucket = &cache->buckets[e->hash & (cache->bucket_count - 1)];
+	e->next = *bucket;
+	*bucket = e;
+	laz_cache_lru_push(cache, e);
+	cache->count++;
+	cache->bytes += e->file.size;
+}
+
+struct file_cache *file_cache_create(size_t budget, u64 check_ns)
+{
+	struct file_cache *cache =
+		(struct file_cache *)calloc_try(1, sizeof(*cache));
+
+	pthread_mutex_init(&cache->lock, NULL);
+	cache->bucket_count = 64;
+	cache->buckets = (struct laz_cache_entry **)calloc_try(
+		cache->bucket_count, sizeof(*cache->buckets));
+	cache->budget = budget;
+	cache->check_ns = check_ns;
+
+	return cache;
+}
+
+void file_cache_destroy(struct file_cache *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	while (cache->lru_head != NULL) {
+		laz_cache_detach(cache, cache->lru_head);
+	}
+
+	pthread_mutex_destroy(&cache->lock);
+	free(cache->buckets);
+	free(cache);
+}
+
+const struct cached_file *file_cache_get(struct file_cache *cache,
+					 const char *path)
+{
+	u64 hash = fnv1a_64_str(path);
+	u64 now = laz_monotonic_ns();
+	const struct cached_file *file = NULL;
+	struct laz_cache_entry *e = NULL;
+	struct laz_cache_entry *stale = NULL;
+	struct stat st;
+
+	/* Recently checked entries are trusted without a stat */
+	pthread_mutex_lock(&cache->lock);
+	e = laz_cache_find(cache, path, hash);
+
+	if (e != NULL && now - e->checked < cache->check_ns) {
+		file = laz_cache_acquire(cache, e);
+	}
+
+	pthread_mutex_unlock(&cache->lock);
+
+	if (file != NULL) {
+		return file;
+	}
+
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+		(void)errorf("Error: unable to read file %s\n", path);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+	e = laz_cache_find(cache, path, hash);
+
+	if (e != NULL && laz_cache_unchanged(e, &st)) {
+		e->checked = now;
+		file = laz_cache_acquire(cache, e);
+	}
+
+	pthread_mutex_unlock(&cache->lock);
+
+	if (file != NULL) {
+		return file;
+	}
+
+	/* Read without the lock, so that hits on other files go on */
+	e = laz_cache_load(path, hash, &st);
+
+	if (e == NULL) {
+		return NULL;
+	}
+
+	e->checked = now;
+	pthread_mutex_lock(&cache->lock);
+	stale = laz_cache_find(cache, path, hash);
+
+	/* Replaces the changed entry, or one a concurrent miss loaded */
+	if (stale != NULL) {
+		laz_cache_detach(cache, stale);
+	}
+
+	laz_cache_insert(cache, e);
+	file = laz_cache_acquire(cache, e);
+
+	/* The new entry is held, so it never evicts itself */
+	while (cache->bytes > cache->budget && cache->lru_tail != e) {
+		laz_cache_detach(cache, cache->lru_tail);
+	}
+
+	pthread_mutex_unlock(&cache->lock);
+	return file;
+}
+
+void file_cache_release(struct file_cache *cache,
+			const struct cached_file *file)
+{
+	struct laz_cache_entry *e =
+		(struct laz_cache_entry *)(uintptr_t)file;
+
+	if (file == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+	e->refs--;
+
+	if (e->refs == 0 && e->detached) {
+		laz_cache_free(e);
+	}
+
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/* Chunks are cut from windows of this many maximum-sized chunks, to amortize
+ * the sliding of leftover bytes */
+#define LAZ_CDC_STREAM_CHUNKS 16
+
+int cdc_file(const struct cdc *cdc, const char *path,
+	     int (*fn)(const struct cdc_chunk *chunk, void *ctx), void *ctx)
+{
+	struct file_stream stream;
+	struct cdc_chunk chunk;
+	int ret = 0;
+
+	if (file_stream_open(&stream, path,
+			     cdc->max_size * LAZ_CDC_STREAM_CHUNKS) != 0) {
+		return -1;
+	}
+
+	while (ret == 0) {
+		long available = file_stream_fill(&stream, cdc->max_size);
+
+		if (available <= 0) {
+			ret = (int)available;
+			break;
+		}
+
+		chunk.offset = stream.offset;
+		chunk.len = cdc_next(cdc, stream.data, (size_t)available);
+		chunk.hash = fast_hash_64(stream.data, chunk.len, 0);
+		ret = fn(&chunk, ctx);
+		file_stream_consume(&stream, chunk.len);
+	}
+
+	file_stream_close(&stream);
+	return ret;
+}
+
+struct bloom *bloom_load(const char *path)
+{
+	struct bloom *bloom = (struct bloom *)calloc_try(1, sizeof(*bloom));
+	struct laz_bloom_header header;
+
+	if (map_file(path, &bloom->map) != 0) {
+		free(bloom);
+		return NULL;
+	}
+
+	if (bloom->map.size >= sizeof(header)) {
+		memcpy(&header, bloom->map.data, sizeof(header));
+	}
+
+	if (bloom->map.size < sizeof(header) ||
+	    header.magic != LAZ_BLOOM_MAGIC ||
+	    header.version != LAZ_BLOOM_VERSION || header.hashes == 0 ||
+	    header.hashes > LAZ_BLOOM_MAX_HASHES || header.block_count == 0 ||
+	    (bloom->map.size - sizeof(header)) % (LAZ_BLOOM_BLOCK_BITS / 8) !=
+		    0 ||
+	    (bloom->map.size - sizeof(header)) / (LAZ_BLOOM_BLOCK_BITS / 8) !=
+		    header.block_count) {
+		(void)errorf("Error: invalid bloom filter %s\n", path);
+		unmap_file(&bloom->map);
+		free(bloom);
+		return NULL;
+	}
+
+	bloom->blocks = (u64 *)(bloom->map.data + sizeof(header));
+	bloom->block_count = header.block_count;
+	bloom->hashes = header.hashes;
+
+	return bloom;
+}
+
+struct laz_task {
+	void (*fn)(void *arg);
+	void *arg;
+};
+
+struct thread_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t task_ready;
+	pthread_cond_t idle;
+	/* Ring buffer of queued tasks */
+	struct laz_task *tasks;
+	size_t task_cap;
+	size_t task_head;
+	size_t task_count;
+	/* Queued plus running tasks */
+	size_t pending;
+	int shutdown;
+	size_t thread_count;
+	pthread_t *threads;
+};
+
+static void *laz_thread_pool_worker(void *arg)
+{
+	struct thread_pool *pool = (struct thread_pool *)arg;
+	struct laz_task task;
+
+	PROFILE_THREAD_NAME("worker");
+	pthread_mutex_lock(&pool->lock);
+
+	for (;;) {
+		while (pool->task_count == 0 && !pool->shutdown) {
+			pthread_cond_wait(&pool->task_ready, &pool->lock);
+		}
+
+		if (pool->task_count == 0) {
+			/* Shutting down with nothing left to run */
+			break;
+		}
+
+		task = pool->tasks[pool->task_head];
+		pool->task_head = (pool->task_head + 1) % pool->task_cap;
+		pool->task_count--;
+
+		pthread_mutex_unlock(&pool->lock);
+		task.fn(task.arg);
+		pthread_mutex_lock(&pool->lock);
+
+		if (--pool->pending == 0) {
+			pthread_cond_broadcast(&pool->idle);
+		}
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+struct thread_pool *thread_pool_create(size_t threads)
+{
+	struct thread_pool *pool =
+		(struct thread_pool *)calloc_try(1, sizeof(*pool));
+
+	if (threads == 0) {
+		threads = cpu_count();
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->task_ready, NULL);
+	pthread_cond_init(&pool->idle, NULL);
+	pool->task_cap = 64;
+	pool->tasks = (struct laz_task *)malloc_try(pool->task_cap *
+						    sizeof(*pool->tasks));
+	pool->threads = (pthread_t *)malloc_try(threads * sizeof(pthread_t));
+
+	for (; pool->thread_count < threads; pool->thread_count++) {
+		if (pthread_create(&pool->threads[pool->thread_count], NULL,
+				   laz_thread_pool_worker, pool) != 0) {
+			(void)errorf("Warning: started %zu of %zu threads\n",
+				     pool->thread_count, threads);
+			break;
+		}
+	}
+
+	return pool;
+}
+
+void thread_pool_destroy(struct thread_pool *pool)
+{
+	if (pool == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->task_ready);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (size_t i = 0; i < pool->thread_count; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool->idle);
+	pthread_cond_destroy(&pool->task_ready);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->threads);
+	free(pool->tasks);
+	free(pool);
+}
+
+size_t thread_pool_size(const struct thread_pool *pool)
+{
+	return pool == NULL ? 0 : pool->thread_count;
+}
+
+void thread_pool_submit(struct thread_pool *pool, void (*fn)(void *arg),
+			void *arg)
+{
+	struct laz_task task;
+
+	task.fn = fn;
+	task.arg = arg;
+
+	if (pool == NULL || pool->thread_count == 0) {
+		/* Nobody to hand the task to */
+		fn(arg);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+
+	if (pool->task_count == pool->task_cap) {
+		/* Grow the ring and unwrap it so the head is at 0 again */
+		size_t cap = pool->task_cap * 2;
+		struct laz_task *tasks =
+			(struct laz_task *)malloc_try(cap * sizeof(*tasks));
+
+		for (size_t i = 0; i < pool->task_count; i++) {
+			tasks[i] = pool->tasks[(pool->task_head + i) %
+					       pool->task_cap];
+		}
+
+		free(pool->tasks);
+		pool->tasks = tasks;
+		pool->task_cap = cap;
+		pool->task_head = 0;
+	}
+
+	pool->tasks[(pool->task_head + pool->task_count) % pool->task_cap] =
+		task;
+	pool->task_count++;
+	pool->pending++;
+	pthread_cond_signal(&pool->task_ready);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(struct thread_pool *pool)
+{
+	if (pool == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+
+	while (pool->pending != 0) {
+		pthread_cond_wait(&pool->idle, &pool->lock);
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/* Subranges per participating thread when the grain is picked automatically,
+ * so that uneven subranges even out */
+#define LAZ_PARALLEL_SPLIT 8
+/* Subranges of an automatic deterministic reduction, independent of the pool
+ * size */
+#define LAZ_PARALLEL_DETERMINISTIC_SPLIT 256
+/* Partial results are spaced by a multiple of this to avoid false sharing */
+#define LAZ_PARALLEL_PARTIAL_ALIGN LAZ_CACHE_LINE
+
+struct laz_parallel_job {
+	pthread_mutex_t lock;
+	pthread_cond_t done;
+	size_t n;
+	size_t grain;
+	size_t chunk_count;
+	/* Next unclaimed chunk */
+	size_t next_chunk;
+	/* Helper tasks submitted and not yet finished */
+	size_t helpers;
+	/* Participants that have joined, the caller is participant 0 */
+	size_t joined;
+	void (*run)(struct laz_parallel_job *job, size_t chunk, size_t begin,
+		    size_t end, size_t participant);
+	/* parallel_for */
+	void (*for_fn)(size_t begin, size_t end, void *ctx);
+	/* parallel_reduce */
+	void (*map)(size_t begin, size_t end, void *partial, void *ctx);
+	unsigned char *partials;
+	size_t partial_stride;
+	int deterministic;
+	void *ctx;
+};
+
+static int laz_thread_pool_is_worker(const struct thread_pool *pool)
+{
+	pthread_t self = pthread_self();
+
+	for (size_t i = 0; i < pool->thread_count; i++) {
+		if (pthread_equal(self, pool->threads[i])) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void laz_parallel_work(struct laz_parallel_job *job, size_t participant)
+{
+	for (;;) {
+		size_t chunk = 0;
+		size_t begin = 0;
+
+		pthread_mutex_lock(&job->lock);
+		chunk = job->next_chunk;
+		if (chunk < job->chunk_count) {
+			job->next_chunk++;
+		}
+		pthread_mutex_unlock(&job->lock);
+
+		if (chunk >= job->chunk_count) {
+			return;
+		}
+
+		begin = chunk * job->grain;
+		job->run(job, chunk, begin, MIN(job->n, begin + job->grain),
+			 participant);
+	}
+}
+
+static void laz_parallel_helper(void *arg)
+{
+	struct laz_parallel_job *job = (struct laz_parallel_job *)arg;
+	size_t participant = 0;
+
+	pthread_mutex_lock(&job->lock);
+	participant = ++job->joined;
+	pthread_mutex_unlock(&job->lock);
+
+	laz_parallel_work(job, participant);
+
+	pthread_mutex_lock(&job->lock);
+	if (--job->helpers == 0) {
+		pthread_cond_signal(&job->done);
+	}
+	pthread_mutex_unlock(&job->lock);
+}
+
+/* Number of threads that may work on a job, the caller included */
+static size_t laz_parallel_participants(const struct thread_pool *pool)
+{
+	if (pool == NULL || laz_thread_pool_is_worker(pool)) {
+		return 1;
+	}
+
+	return pool->thread_count + 1;
+}
+
+/* Splits [0, n) into chunks of `job->grain` and runs them on up to
+ * `participants` threads */
+static void laz_parallel_run(struct thread_pool *pool,
+			     struct laz_parallel_job *job, size_t participants)
+{
+	job->chunk_count = (job->n + job->grain - 1) / job->grain;
+	job->next_chunk = 0;
+	job->joined = 0;
+	job->helpers = MIN(participants, job->chunk_count) - 1;
+	pthread_mutex_init(&job->lock, NULL);
+	pthread_cond_init(&job->done, NULL);
+
+	for (size_t i = job->helpers; i > 0; i--) {
+		thread_pool_submit(pool, laz_parallel_helper, job);
+	}
+
+	laz_parallel_work(job, 0);
+
+	/* The job lives on our stack, so wait for helpers that have not even
+	 * started yet */
+	pthread_mutex_lock(&job->lock);
+	while (job->helpers != 0) {
+		pthread_cond_wait(&job->done, &job->lock);
+	}
+	pthread_mutex_unlock(&job->lock);
+
+	pthread_cond_destroy(&job->done);
+	pthread_mutex_destroy(&job->lock);
+}
+
+static void laz_parallel_for_chunk(struct laz_parallel_job *job, size_t chunk,
+				   size_t begin, size_t end, size_t participant)
+{
+	(void)chunk;
+	(void)participant;
+	job->for_fn(begin, end, job->ctx);
+}
+
+void parallel_for(struct thread_pool *pool, size_t n, size_t grain,
+		  void (*fn)(size_t begin, size_t end, void *ctx), void *ctx)
+{
+	struct laz_parallel_job job;
+	size_t participants = laz_parallel_participants(pool);
+
+	if (n == 0) {
+		return;
+	}
+
+	if (participants == 1) {
+		fn(0, n, ctx);
+		return;
+	}
+
+	memset(&job, 0, sizeof(job));
+	job.n = n;
+	job.grain = grain != 0 ? grain :
+			MAX(1, n / (participants * LAZ_PARALLEL_SPLIT));
+	job.run = laz_parallel_for_chunk;
+	job.for_fn = fn;
+	job.ctx = ctx;
+	laz_parallel_run(pool, &job, participants);
+}
+
+static void laz_parallel_reduce_chunk(struct laz_parallel_job *job,
+				      size_t chunk, size_t begin, size_t end,
+				      size_t participant)
+{
+	size_t slot = job->deterministic ? chunk : participant;
+
+	job->map(begin, end, job->partials + slot * job->partial_stride,
+		 job->ctx);
+}
+
+void parallel_reduce(struct thread_pool *pool, size_t n, size_t grain,
+		     void *result, size_t result_size,
+		     void (*map)(size_t begin, size_t end, void *partial,
+				 void *ctx),
+		     void (*combine)(void *dst, const void *src, void *ctx),
+		     void *ctx, int flags)
+{
+	struct laz_parallel_job job;
+	size_t participants = laz_parallel_participants(pool);
+	size_t slots = 0;
+
+	if (n == 0) {
+		return;
+	}
+
+	memset(&job, 0, sizeof(job));
+	job.n = n;
+	job.deterministic = (flags & PARALLEL_DETERMINISTIC) != 0;
+
+	if (grain != 0) {
+		job.grain = grain;
+	} else if (job.deterministic) {
+		job.grain = MAX(1, n / LAZ_PARALLEL_DETERMINISTIC_SPLIT);
+	} else {
+		job.grain = MAX(1, n / (participants * LAZ_PARALLEL_SPLIT));
+	}
+
+	if (participants == 1 && !job.deterministic) {
+		map(0, n, result, ctx);
+		return;
+	}
+
+	slots = job.deterministic ? (n + job.grain - 1) / job.grain :
+				    participants;
+	job.partial_stride = (result_size + LAZ_PARALLEL_PARTIAL_ALIGN - 1) /
+			     LAZ_PARALLEL_PARTIAL_ALIGN *
+			     LAZ_PARALLEL_PARTIAL_ALIGN;
+	job.partials = (unsigned char *)malloc_try(slots * job.partial_stride);
+
+	for (size_t i = 0; i < slots; i++) {
+		memcpy(job.partials + i * job.partial_stride, result,
+		       result_size);
+	}
+
+	job.run = laz_parallel_reduce_chunk;
+	job.map = map;
+	job.ctx = ctx;
+	laz_parallel_run(pool, &job, participants);
+
+	/* Participants that never claimed a chunk still hold the identity,
+	 * which combines harmlessly */
+	for (size_t i = 0; i < slots; i++) {
+		combine(result, job.partials + i * job.partial_stride, ctx);
+	}
+
+	free(job.partials);
+}
+
+/* Chunks of the quote-aware boundary scan are at least this large, so small
+ * inputs are parsed on one thread */
+#define LAZ_CSV_CHUNK_BYTES (1 << 20)
+#define LAZ_CSV_NONE ((size_t)-1)
+
+/* Rows are cut where a newline follows an even number of quotes since the
+ * start of the input. Every chunk records the first newline after an even and
+ * after an odd number of its own quotes, before the parity of the quotes
+ * before it is known. */
+struct laz_csv_chunk {
+	size_t newline[2];
+	size_t quotes;
+};
+
+struct laz_csv_range {
+	const char *begin;
+	const char *end;
+	/* The input ends with this range, so its last row needs no newline */
+	int final;
+	int failed;
+	struct str_view *cells;
+	size_t count;
+	size_t cap;
+	size_t columns;
+	size_t rows;
+	size_t row_offset;
+	size_t consumed;
+};
+
+struct laz_csv_job {
+	const char *data;
+	size_t len;
+	char delim;
+	size_t chunk_size;
+	struct laz_csv_chunk *chunks;
+	struct laz_csv_range *ranges;
+	struct csv_table *table;
+};
+
+static void laz_csv_scan_chunks(size_t begin, size_t end, void *ctx)
+{
+	struct laz_csv_job *job = (struct laz_csv_job *)ctx;
+
+	for (size_t c = begin; c < end; c++) {
+		struct laz_csv_chunk *chunk = &job->chunks[c];
+		const char *start = job->data + c * job->chunk_size;
+		const char *stop =
+			job->data + MIN((c + 1) * job->chunk_size, job->len);
+		const char *p = start;
+		size_t quotes = 0;
+
+		chunk->newline[0] = LAZ_CSV_NONE;
+		chunk->newline[1] = LAZ_CSV_NONE;
+
+		/* Only quotes matter once the current parity has a newline */
+		while (p < stop && (chunk->newline[0] == LAZ_CSV_NONE ||
+				    chunk->newline[1] == LAZ_CSV_NONE)) {
+			size_t left = (size_t)(stop - p);
+			size_t n = chunk->newline[quotes & 1] == LAZ_CSV_NONE ?
+					   scan_any(p, left, "\"\n", 2) :
+					   scan_byte(p, left, '"');
+
+			if (n == left) {
+				p = stop;
+				break;
+			}
+
+			if (p[n] == '"') {
+				quotes++;
+			} else {
+				chunk->newline[quotes & 1] =
+					(size_t)(p + n + 1 - start);
+			}
+
+			p += n + 1;
+		}
+
+		chunk->quotes = quotes + count_byte(p, (size_t)(stop - p), '"');
+	}
+}
+
+static void laz_csv_push(struct laz_csv_range *range, const char *data,
+			 size_t len)
+{
+	if (range->count == range->cap) {
+		range->cap = MAX(range->cap * 2, 64);
+		range->cells = (struct str_view *)realloc_try(
+			range->cells, range->cap * sizeof(*range->cells));
+	}
+
+	range->cells[range->count++] = str_view_from(data, len);
+}
+
+/* Parses whole rows, starting outside quotes. Without `final`, a row cut by
+ * the end of the range is left for later, as it may end in the next window. */
+static void laz_csv_parse_range(const struct laz_csv_job *job,
+				struct laz_csv_range *range)
+{
+	const char set[3] = { job->delim, '\n', '"' };
+	const char *p = range->begin;
+	const char *end = range->end;
+	const char *row = p;
+	size_t row_cells = 0;
+
+	while (p < end) {
+		size_t fields = 0;
+		int quoted = 0;
+
+		row = p;
+		row_cells = range->count;
+
+		for (;;) {
+			quoted = *p == '"';
+
+			if (quoted) {
+				const char *start = ++p;
+				size_t n = 0;
+
+				for (;;) {
+					n = scan_byte(p, (size_t)(end - p), '"');
+
+					if (p + n == end && range->final) {
+						range->failed = 1;
+						return;
+					}
+
+					/* A quote ending the window may be
+					 * the first of a doubled pair */
+					if (p + n + 1 >= end && !range->final) {
+						goto incomplete;
+					}
+
+					if (p + n + 1 == end || p[n + 1] != '"') {
+						break;
+					}
+
+					p += n + 2;
+				}
+
+				laz_csv_push(range, start, (size_t)(p + n - start));
+				p += n + 1;
+
+				if (p < end && *p == '\r') {
+					p++;
+				}
+
+				if (p < end && *p != job->delim && *p != '\n') {
+					range->failed = 1;
+					return;
+				}
+			} else {
+				size_t n = scan_any(p, (size_t)(end - p), set,
+						    sizeof(set));
+				size_t len = n;
+
+				if (p + n < end && p[n] == '"') {
+					range->failed = 1;
+					return;
+				}
+
+				if (n > 0 && p[n - 1] == '\r' &&
+				    (p + n == end || p[n] == '\n')) {
+					len--;
+				}
+
+				laz_csv_push(range, p, len);
+				p += n;
+			}
+
+			if (p == end) {
+				if (!range->final) {
+					goto incomplete;
+				}
+
+				break;
+			}
+
+			if (*p++ == '\n') {
+				break;
+			}
+
+			/* A delimiter ending the input leaves an empty field */
+			if (p == end) {
+				if (!range->final) {
+					goto incomplete;
+				}
+
+				laz_csv_push(range, p, 0);
+				break;
+			}
+		}
+
+		fields = range->count - row_cells;
+
+		if (fields == 1 && !quoted && range->cells[row_cells].len == 0) {
+			range->count = row_cells;
+		} else if (range->columns == 0) {
+			range->columns = fields;
+			range->rows++;
+		} else if (fields != range->columns) {
+			range->failed = 2;
+			return;
+		} else {
+			range->rows++;
+		}
+	}
+
+	range->consumed = (size_t)(end - range->begin);
+	return;
+incomplete:
+	range->count = row_cells;
+	range->consumed = (size_t)(row - range->begin);
+}
+
+static void laz_csv_parse_ranges(size_t begin, size_t end, void *ctx)
+{
+	struct laz_csv_job *job = (struct laz_csv_job *)ctx;
+
+	for (size_t r = begin; r < end; r++) {
+		laz_csv_parse_range(job, &job->ranges[r]);
+	}
+}
+
+/* Transposes each range's row-major cells into the table */
+static void laz_csv_scatter(size_t begin, size_t end, void *ctx)
+{
+	struct laz_csv_job *job = (struct laz_csv_job *)ctx;
+	struct csv_table *table = job->table;
+
+	for (size_t r = begin; r < end; r++) {
+		const struct laz_csv_range *range = &job->ranges[r];
+
+		for (size_t row = 0; row < range->rows; row++) {
+			for (size_t col = 0; col < table->columns; col++) {
+				table->cells[col * table->rows +
+					     range->row_offset + row] =
+					range->cells[row * table->columns +
+						     col];
+			}
+		}
+	}
+}
+
+/* Returns the bytes of whole rows parsed, or -1. `columns` holds the field
+ * count of earlier batches, or 0. */
+static long laz_csv_parse(struct csv_table *table, const char *data,
+			  size_t len, char delim, struct thread_pool *pool,
+			  int final, size_t *columns)
+{
+	struct laz_csv_job job;
+	size_t participants = pool != NULL ? thread_pool_size(pool) + 1 : 1;
+	size_t chunk_count =
+		MIN(len / LAZ_CSV_CHUNK_BYTES + 1, participants * 4);
+	size_t range_count = 1;
+	size_t parity = 0;
+	size_t rows = 0;
+	long consumed = 0;
+	int failed = 0;
+
+	memset(table, 0, sizeof(*table));
+	memset(&job, 0, sizeof(job));
+	job.data = data;
+	job.len = len;
+	job.delim = delim;
+	job.chunk_size = (len + chunk_count - 1) / chunk_count;
+	job.chunks = (struct laz_csv_chunk *)malloc_try(chunk_count *
+							sizeof(*job.chunks));
+	job.ranges = (struct laz_csv_range *)calloc_try(chunk_count,
+							sizeof(*job.ranges));
+	job.table = table;
+
+	if (chunk_count > 1) {
+		parallel_for(pool, chunk_count, 1, laz_csv_scan_chunks, &job);
+	}
+
+	job.ranges[0].begin = data;
+
+	/* Chunks without a row boundary join the range before them */
+	for (size_t c = 1; c < chunk_count; c++) {
+		size_t newline = 0;
+
+		parity ^= job.chunks[c - 1].quotes & 1;
+		newline = job.chunks[c].newline[parity];
+
+		if (newline != LAZ_CSV_NONE &&
+		    c * job.chunk_size + newline < len) {
+			job.ranges[range_count - 1].end =
+				data + c * job.chunk_size + newline;
+			job.ranges[range_count++].begin =
+				data + c * job.chunk_size + newline;
+		}
+	}
+
+	job.ranges[range_count - 1].end = data + len;
+
+	/* Only the last range can end in the middle of a row */
+	for (size_t r = 0; r < range_count; r++) {
+		job.ranges[r].final = final || r + 1 < range_count;
+	}
+
+	parallel_for(pool, range_count, 1, laz_csv_parse_ranges, &job);
+
+	for (size_t r = 0; r < range_count && !failed; r++) {
+		struct laz_csv_range *range = &job.ranges[r];
+
+		failed = range->failed;
+
+		if (!failed && range->rows > 0) {
+			if (*columns == 0) {
+				*columns = range->columns;
+			} else if (range->columns != *columns) {
+				failed = 2;
+			}
+
+			range->row_offset = rows;
+			rows += range->rows;
+		}
+	}
+
+	if (failed == 1) {
+		(void)errorf("Error: malformed quotes in CSV\n");
+	} else if (failed == 2) {
+		(void)errorf("Error: CSV rows have different field counts\n");
+	}
+
+	if (!failed && rows > 0) {
+		table->rows = rows;
+		table->columns = *columns;
+		table->cells = (struct str_view *)malloc_try(
+			rows * table->columns * sizeof(*table->cells));
+		parallel_for(pool, range_count, 1, laz_csv_scatter, &job);
+	}
+
+	consumed = (long)(job.ranges[range_count - 1].begin - data +
+			  job.ranges[range_count - 1].consumed);
+
+	for (size_t r = 0; r < range_count; r++) {
+		free(job.ranges[r].cells);
+	}
+
+	free(job.ranges);
+	free(job.chunks);
+	return failed ? -1 : consumed;
+}
+
+int csv_parse(struct csv_table *table, const char *data, size_t len,
+	      char delim, struct thread_pool *pool)
+{
+	size_t columns = 0;
+
+	return laz_csv_parse(table, data, len, delim, pool, 1, &columns) < 0 ?
+		       -1 :
+		       0;
+}
+
+void csv_destroy(struct csv_table *table)
+{
+	free(table->cells);
+	memset(table, 0, sizeof(*table));
+}
+
+struct str_view csv_cell(const struct csv_table *table, size_t row,
+			 size_t column)
+{
+	return table->cells[column * table->rows + row];
+}
+
+size_t csv_unescape(struct str_view field, char *out)
+{
+	size_t len = 0;
+
+	for (size_t i = 0; i < field.len; i++) {
+		out[len++] = field.data[i];
+		i += field.data[i] == '"' && i + 1 < field.len &&
+		     field.data[i + 1] == '"';
+	}
+
+	return len;
+}
+
+struct laz_csv_column {
+	const struct str_view *cells;
+	void *out;
+};
+
+static void laz_csv_map_i64(size_t begin, size_t end, void *partial, void *ctx)
+{
+	const struct laz_csv_column *column = (const struct laz_csv_column *)ctx;
+
+	for (size_t i = begin; i < end; i++) {
+		*(int *)partial |=
+			parse_i64(column->cells[i], (i64 *)column->out + i);
+	}
+}
+
+static void laz_csv_map_f64(size_t begin, size_t end, void *partial, void *ctx)
+{
+	const struct laz_csv_column *column = (const struct laz_csv_column *)ctx;
+
+	for (size_t i = begin; i < end; i++) {
+		*(int *)partial |=
+			parse_f64(column->cells[i], (double *)column->out + i);
+	}
+}
+
+static void laz_csv_combine(void *dst, const void *src, void *ctx)
+{
+	(void)ctx;
+	*(int *)dst |= *(const int *)src;
+}
+
+int csv_column_i64(const struct csv_table *table, size_t column, i64 *out,
+		   struct thread_pool *pool)
+{
+	struct laz_csv_column job;
+	int failed = 0;
+
+	job.cells = table->cells + column * table->rows;
+	job.out = out;
+	parallel_reduce(pool, table->rows, 0, &failed, sizeof(failed),
+			laz_csv_map_i64, laz_csv_combine, &job, 0);
+	return failed;
+}
+
+int csv_column_f64(const struct csv_table *table, size_t column, double *out,
+		   struct thread_pool *pool)
+{
+	struct laz_csv_column job;
+	int failed = 0;
+
+	job.cells = table->cells + column * table->rows;
+	job.out = out;
+	parallel_reduce(pool, table->rows, 0, &failed, sizeof(failed),
+			laz_csv_map_f64, laz_csv_combine, &job, 0);
+	return failed;
+}
+
+int csv_file(const char *path, char delim, size_t window,
+	     struct thread_pool *pool,
+	     int (*fn)(const struct csv_table *batch, void *ctx), void *ctx)
+{
+	struct file_stream stream;
+	struct csv_table batch;
+	size_t columns = 0;
+	int ret = 0;
+
+	if (file_stream_open(&stream, path, window) != 0) {
+		return -1;
+	}
+
+	while (ret == 0) {
+		long available = file_stream_fill(&stream, stream.cap);
+		long consumed = 0;
+
+		if (available <= 0) {
+			ret = (int)available;
+			break;
+		}
+
+		consumed = laz_csv_parse(&batch, stream.data, (size_t)available,
+					 delim, pool, stream.eof, &columns);
+
+		if (consumed < 0) {
+			ret = -1;
+			break;
+		}
+
+		if (consumed == 0 && batch.rows == 0 && !stream.eof) {
+			(void)errorf("Error: CSV row longer than %zu bytes in "
+				     "%s\n",
+				     stream.cap, path);
+			ret = -1;
+			break;
+		}
+
+		if (batch.rows > 0) {
+			ret = fn(&batch, ctx);
+		}
+
+		csv_destroy(&batch);
+		file_stream_consume(&stream, (size_t)consumed);
+	}
+
+	file_stream_close(&stream);
+	return ret;
+}
+
+#ifdef __cplusplus
+#define LAZ_THREAD_LOCAL thread_local
+#elif __STDC_VERSION__ >= 201112L
+#define LAZ_THREAD_LOCAL _Thread_local
+#else
+#define LAZ_THREAD_LOCAL __thread
+#endif
+
+/* Events per chunk of a thread's buffer */
+#define LAZ_PROFILE_CHUNK 4096
+
+enum laz_profile_kind {
+	LAZ_PROFILE_BEGIN,
+	LAZ_PROFILE_END,
+	LAZ_PROFILE_COUNTER
+};
+
+struct laz_profile_event {
+	/* Monotonic nanoseconds, shifted over the kind in the low two bits */
+	u64 stamp;
+	const char *name;
+	i64 value;
+};
+
+struct laz_profile_chunk {
+	struct laz_profile_chunk *next;
+	size_t count;
+	struct laz_profile_event events[LAZ_PROFILE_CHUNK];
+};
+
+/* Only its own thread adds to a buffer, so recording takes no lock. Buffers
+ * outlive their threads to be written at the end. */
+struct laz_profile_thread {
+	struct laz_profile_thread *next;
+	struct laz_profile_chunk *first;
+	struct laz_profile_chunk *last;
+	const char *name;
+	u32 id;
+};
+
+static pthread_mutex_t laz_profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct laz_profile_thread *laz_profile_threads;
+static u32 laz_profile_thread_count;
+static const char *laz_profile_path;
+static LAZ_THREAD_LOCAL struct laz_profile_thread *laz_profile_self;
+
+static struct laz_profile_thread *laz_profile_register(void)
+{
+	struct laz_profile_thread *self =
+		(struct laz_profile_thread *)calloc_try(1, sizeof(*self));
+
+	pthread_mutex_lock(&laz_profile_lock);
+	self->id = ++laz_profile_thread_count;
+	self->next = laz_profile_threads;
+	laz_profile_threads = self;
+	pthread_mutex_unlock(&laz_profile_lock);
+
+	laz_profile_self = self;
+	return self;
+}
+
+static struct laz_profile_chunk *
+laz_profile_grow(struct laz_profile_thread *self)
+{
+	struct laz_profile_chunk *chunk =
+		(struct laz_profile_chunk *)malloc_try(sizeof(*chunk));
+
+	chunk->next = NULL;
+	chunk->count = 0;
+
+	if (self->last == NULL) {
+		self->first = chunk;
+	} else {
+		self->last->next = chunk;
+	}
+
+	self->last = chunk;
+	return chunk;
+}
+
+static void laz_profile_record(enum laz_profile_kind kind, const char *name,
+			       i64 value)
+{
+	struct laz_profile_thread *self = laz_profile_self;
+	struct laz_profile_chunk *chunk = NULL;
+	struct laz_profile_event *event = NULL;
+	struct timespec ts;
+
+	if (unlikely(self == NULL)) {
+		self = laz_profile_register();
+	}
+
+	chunk = self->last;
+
+	if (unlikely(chunk == NULL || chunk->count == LAZ_PROFILE_CHUNK)) {
+		chunk = laz_profile_grow(self);
+	}
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	event = &chunk->events[chunk->count++];
+	event->stamp = ((u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec) << 2 |
+		       (u64)kind;
+	event->name = name;
+	event->value = value;
+}
+
+void profile_begin(const char *name)
+{
+	laz_profile_record(LAZ_PROFILE_BEGIN, name, 0);
+}
+
+void profile_end(void)
+{
+	laz_profile_record(LAZ_PROFILE_END, NULL, 0);
+}
+
+void profile_counter(const char *name, i64 value)
+{
+	laz_profile_record(LAZ_PROFILE_COUNTER, name, value);
+}
+
+void profile_thread_name(const char *name)
+{
+	struct laz_profile_thread *self = laz_profile_self;
+
+	if (self == NULL) {
+		self = laz_profile_register();
+	}
+
+	self->name = name;
+}
+
+int laz_profile_scope_begin(const char *name)
+{
+	profile_begin(name);
+	return 0;
+}
+
+void laz_profile_scope_end(int *scope)
+{
+	(void)scope;
+	profile_end();
+}
+
+/* `text` as a JSON string */
+static void laz_profile_string(FILE *file, const char *text)
+{
+	(void)fputc('"', file);
+
+	for (; *text != '\0'; text++) {
+		unsigned char c = (unsigned char)*text;
+
+		if (c == '"' || c == '\\') {
+			(void)fputc('\\', file);
+			(void)fputc(c, file);
+		} else if (c < 0x20) {
+			(void)fprintf(file, "\\u%04x", c);
+		} else {
+			(void)fputc(c, file);
+		}
+	}
+
+	(void)fputc('"', file);
+}
+
+int profile_write(const char *path)
+{
+	static const char phases[] = { 'B', 'E', 'C' };
+	FILE *file = fopen(path, "w");
+	long pid = (long)getpid();
+	const char *separator = "\n";
+	int failed = 0;
+
+	if (file == NULL) {
+		(void)errorf("Error: unable to write file %s\n", path);
+		return -1;
+	}
+
+	(void)fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+	pthread_mutex_lock(&laz_profile_lock);
+
+	for (const struct laz_profile_thread *thread = laz_profile_threads;
+	     thread != NULL; thread = thread->next) {
+		if (thread->name != NULL) {
+			(void)fprintf(file,
+				      "%s{\"ph\":\"M\",\"pid\":%ld,\"tid\":%u,"
+				      "\"name\":\"thread_name\",\"args\":{"
+				      "\"name\":",
+				      separator, pid, thread->id);
+			laz_profile_string(file, thread->name);
+			(void)fputs("}}", file);
+			separator = ",\n";
+		}
+
+		for (const struct laz_profile_chunk *chunk = thread->first;
+		     chunk != NULL; chunk = chunk->next) {
+			for (size_t i = 0; i < chunk->count; i++) {
+				const struct laz_profile_event *event =
+					&chunk->events[i];
+				unsigned kind = (unsigned)(event->stamp & 3);
+				u64 ns = event->stamp >> 2;
+
+				/* Microseconds, to the nanosecond */
+				(void)fprintf(file,
+					      "%s{\"ph\":\"%c\",\"pid\":%ld,"
+					      "\"tid\":%u,\"ts\":%llu.%03u",
+					      separator, phases[kind], pid,
+					      thread->id,
+					      (unsigned long long)(ns / 1000),
+					      (unsigned)(ns % 1000));
+				separator = ",\n";
+
+				if (kind != LAZ_PROFILE_END) {
+					(void)fputs(",\"name\":", file);
+					laz_profile_string(file, event->name);
+				}
+
+				if (kind == LAZ_PROFILE_COUNTER) {
+					(void)fprintf(file,
+						      ",\"args\":{\"value\":%lld}",
+						      (long long)event->value);
+				}
+
+				(void)fputc('}', file);
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&laz_profile_lock);
+	(void)fputs("\n]}\n", file);
+	failed = ferror(file);
+
+	if (fclose(file) != 0 || failed) {
+		(void)errorf("Error: unable to write file %s\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void laz_profile_at_exit(void)
+{
+	(void)profile_write(laz_profile_path);
+}
+
+void profile_write_at_exit(const char *path)
+{
+	int registered = 0;
+
+	pthread_mutex_lock(&laz_profile_lock);
+	registered = laz_profile_path != NULL;
+	laz_profile_path = path;
+	pthread_mutex_unlock(&laz_profile_lock);
+
+	if (!registered) {
+		(void)atexit(laz_profile_at_exit);
+	}
+}
+
+#ifdef LAZ_PERF
+static const u32 laz_perf_types[PERF_COUNTER_COUNT] = {
+	PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+	PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE
+};
+
+static const u64 laz_perf_configs[PERF_COUNTER_COUNT] = {
+	PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+	PERF_COUNT_SW_TASK_CLOCK
+};
+
+int perf_counters_open(struct perf_counters *pc)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	int leader = -1;
+	unsigned slot = 0;
+
+	memset(pc, 0, sizeof(*pc));
+
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		struct perf_event_attr attr;
+		void *page = NULL;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.type = laz_perf_types[i];
+		attr.size = sizeof(attr);
+		attr.config = laz_perf_configs[i];
+		attr.read_format = PERF_FORMAT_GROUP |
+				   PERF_FORMAT_TOTAL_TIME_ENABLED |
+				   PERF_FORMAT_TOTAL_TIME_RUNNING;
+		/* User space only, which unprivileged processes may count */
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		pc->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1,
+					  leader, PERF_FLAG_FD_CLOEXEC);
+
+		if (pc->fds[i] < 0) {
+			pc->fds[i] = -1;
+			continue;
+		}
+
+		if (leader < 0) {
+			leader = pc->fds[i];
+		}
+
+		page = mmap(NULL, (size_t)page_size, PROT_READ, MAP_SHARED,
+			    pc->fds[i], 0);
+		pc->pages[i] = page == MAP_FAILED ? NULL : page;
+		pc->slots[i] = slot++;
+		pc->available |= 1U << i;
+	}
+
+	pc->start.available = pc->available;
+	return leader < 0 ? -1 : 0;
+}
+
+void perf_counters_close(struct perf_counters *pc)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if (pc->pages[i] != NULL) {
+			(void)munmap(pc->pages[i], (size_t)page_size);
+		}
+
+		if (pc->fds[i] >= 0) {
+			(void)close(pc->fds[i]);
+		}
+	}
+
+	memset(pc, 0, sizeof(*pc));
+
+	/* Closing again must not close descriptor 0 */
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		pc->fds[i] = -1;
+	}
+}
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+	(defined(__x86_64__) || defined(__i386__))
+/* Reads the counter from its mapped page without entering the kernel, which
+ * publishes the page under a sequence lock. Returns -1 if the counter is not
+ * on the PMU right now or rdpmc is not allowed. */
+static int laz_perf_rdpmc(const void *mapped, u64 *out)
+{
+	const volatile struct perf_event_mmap_page *page =
+		(const volatile struct perf_event_mmap_page *)mapped;
+	u32 seq = 0;
+	u64 count = 0;
+
+	do {
+		u32 index = 0;
+
+		seq = page->lock;
+		__asm__ volatile("" ::: "memory");
+		index = page->index;
+
+		if (!page->cap_user_rdpmc || index == 0) {
+			return -1;
+		}
+
+		{
+			u32 lo = 0;
+			u32 hi = 0;
+			unsigned shift = 64 - page->pmc_width;
+
+			__asm__ volatile("rdpmc"
+					 : "=a"(lo), "=d"(hi)
+					 : "c"(index - 1));
+			/* Sign-extend from the counter width */
+			count = (u64)page->offset +
+				(u64)((i64)(((u64)hi << 32 | lo) << shift) >>
+				      shift);
+		}
+
+		__asm__ volatile("" ::: "memory");
+	} while (page->lock != seq);
+
+	*out = count;
+	return 0;
+}
+#else
+static int laz_perf_rdpmc(const void *mapped, u64 *out)
+{
+	(void)mapped;
+	(void)out;
+	return -1;
+}
+#endif
+
+void perf_counters_read(const struct perf_counters *pc,
+			struct perf_sample *out)
+{
+	/* A group read: the number of counters, the time the group was
+	 * enabled and the time it was on the CPU, then the values */
+	u64 group[3 + PERF_COUNTER_COUNT];
+	unsigned missing = 0;
+	int leader = -1;
+
+	memset(out, 0, sizeof(*out));
+	out->available = pc->available;
+
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if ((pc->available & 1U << i) == 0) {
+			continue;
+		}
+
+		leader = leader < 0 ? pc->fds[i] : leader;
+
+		if (pc->pages[i] == NULL ||
+		    laz_perf_rdpmc(pc->pages[i], &out->values[i]) != 0) {
+			missing |= 1U << i;
+		}
+	}
+
+	/* Software counters, or hardware ones without rdpmc, need the
+	 * kernel */
+	if (missing == 0) {
+		return;
+	}
+
+	/* A group that never got on the PMU, because other events held it,
+	 * counted nothing */
+	if (read(leader, group, sizeof(group)) < (ssize_t)(3 * sizeof(u64)) ||
+	    group[2] == 0) {
+		out->available &= ~missing;
+		return;
+	}
+
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if ((missing & 1U << i) != 0 && pc->slots[i] < group[0]) {
+			out->values[i] = group[3 + pc->slots[i]];
+		}
+	}
+}
+
+void perf_counters_start(struct perf_counters *pc)
+{
+	perf_counters_read(pc, &pc->start);
+}
+
+void perf_counters_stop(struct perf_counters *pc, struct perf_sample *out)
+{
+	perf_counters_read(pc, out);
+
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		out->values[i] -= pc->start.values[i];
+	}
+
+	out->available &= pc->start.available;
+}
+#endif
+#endif /* LAZ_POSIX */
+
+#ifdef LAZ_ATOMICS
+#ifdef __cplusplus
+#include <atomic>
+#define LAZ_ATOMIC(type) std::atomic<type>
+#define LAZ_RELAXED std::memory_order_relaxed
+#define LAZ_ACQUIRE std::memory_order_acquire
+#define LAZ_RELEASE std::memory_order_release
+#define LAZ_ACQ_REL std::memory_order_acq_rel
+#define laz_atomic_init(obj, val) std::atomic_init(obj, val)
+#define laz_atomic_load(obj, order) std::atomic_load_explicit(obj, order)
+#define laz_atomic_store(obj, val, order) \
+	std::atomic_store_explicit(obj, val, order)
+#define laz_atomic_fetch_add(obj, val, order) \
+	std::atomic_fetch_add_explicit(obj, val, order)
+#define laz_atomic_cas_weak(obj, expected, desired, success, failure) \
+	std::atomic_compare_exchange_weak_explicit(obj, expected, desired, \
+						   success, failure)
+#else
+#include <stdatomic.h>
+#define LAZ_ATOMIC(type) _Atomic(type)
+#define LAZ_RELAXED memory_order_relaxed
+#define LAZ_ACQUIRE memory_order_acquire
+#define LAZ_RELEASE memory_order_release
+#define LAZ_ACQ_REL memory_order_acq_rel
+#define laz_atomic_init(obj, val) atomic_init(obj, val)
+#define laz_atomic_load(obj, order) atomic_load_explicit(obj, order)
+#define laz_atomic_store(obj, val, order) atomic_store_explicit(obj, val, order)
+#define laz_atomic_fetch_add(obj, val, order) \
+	atomic_fetch_add_explicit(obj, val, order)
+#define laz_atomic_cas_weak(obj, expected, desired, success, failure) \
+	atomic_compare_exchange_weak_explicit(obj, expected, desired, success, \
+					      failure)
+#endif
+
+/* Full cache lines of padding separate the fields written by each side, so
+ * no alignment is needed from the allocator */
+struct spsc_ring {
+	void **slots;
+	size_t mask;
+	unsigned char pad0[LAZ_CACHE_LINE];
+	/* Written by the producer. `tail_cache` is its last view of `tail`, so
+	 * it only touches the consumer's line when the ring looks full. */
+	LAZ_ATOMIC(size_t) head;
+	size_t tail_cache;
+	unsigned char pad1[LAZ_CACHE_LINE];
+	/* Written by the consumer */
+	LAZ_ATOMIC(size_t) tail;
+	size_t head_cache;
+	unsigned char pad2[LAZ_CACHE_LINE];
+};
+
+struct spsc_ring *spsc_ring_create(size_t capacity)
+{
+	struct spsc_ring *ring =
+		(struct spsc_ring *)calloc_try(1, sizeof(*ring));
+
+	capacity = laz_next_pow2(MAX(capacity, 1));
+	ring->slots = (void **)malloc_try(capacity * sizeof(void *));
+	ring->mask = capacity - 1;
+	laz_atomic_init(&ring->head, (size_t)0);
+	laz_atomic_init(&ring->tail, (size_t)0);
+
+	return ring;
+}
+
+void spsc_ring_destroy(struct spsc_ring *ring)
+{
+	if (ring == NULL) {
+		return;
+	}
+
+	free(ring->slots);
+	free(ring);
+}
+
+size_t spsc_ring_capacity(const struct spsc_ring *ring)
+{
+	return ring->mask + 1;
+}
+
+size_t spsc_ring_push_n(struct spsc_ring *ring, void *const *items, size_t n)
+{
+	size_t head = laz_atomic_load(&ring->head, LAZ_RELAXED);
+	size_t space = ring->mask + 1 - (head - ring->tail_cache);
+
+	if (space < n) {
+		ring->tail_cache = laz_atomic_load(&ring->tail, LAZ_ACQUIRE);
+		space = ring->mask + 1 - (head - ring->tail_cache);
+		n = MIN(n, space);
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		ring->slots[(head + i) & ring->mask] = items[i];
+	}
+
+	laz_atomic_store(&ring->head, head + n, LAZ_RELEASE);
+	return n;
+}
+
+size_t spsc_ring_pop_n(struct spsc_ring *ring, void **items, size_t n)
+{
+	size_t tail = laz_atomic_load(&ring->tail, LAZ_RELAXED);
+	size_t available = ring->head_cache - tail;
+
+	if (available < n) {
+		ring->head_cache = laz_atomic_load(&ring->head, LAZ_ACQUIRE);
+		available = ring->head_cache - tail;
+		n = MIN(n, available);
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		items[i] = ring->slots[(tail + i) & ring->mask];
+	}
+
+	laz_atomic_store(&ring->tail, tail + n, LAZ_RELEASE);
+	return n;
+}
+
+int spsc_ring_push(struct spsc_ring *ring, void *item)
+{
+	return spsc_ring_push_n(ring, &item, 1) == 1 ? 0 : -1;
+}
+
+int spsc_ring_pop(struct spsc_ring *ring, void **item)
+{
+	return spsc_ring_pop_n(ring, item, 1) == 1 ? 0 : -1;
+}
+
+/* A cell is free for the push of position `pos` when its sequence equals
+ * `pos`, and holds the item for the pop of `pos` when it equals `pos + 1` */
+struct laz_mpmc_cell {
+	LAZ_ATOMIC(size_t) sequence;
+	void *data;
+};
+
+struct mpmc_queue {
+	struct laz_mpmc_cell *cells;
+	size_t mask;
+	unsigned char pad0[LAZ_CACHE_LINE];
+	LAZ_ATOMIC(size_t) enqueue_pos;
+	unsigned char pad1[LAZ_CACHE_LINE];
+	LAZ_ATOMIC(size_t) dequeue_pos;
+	unsigned char pad2[LAZ_CACHE_LINE];
+};
+
+struct mpmc_queue *mpmc_queue_create(size_t capacity)
+{
+	struct mpmc_queue *queue =
+		(struct mpmc_queue *)calloc_try(1, sizeof(*queue));
+
+	/* With one cell, the full and empty sequences would be the same */
+	capacity = laz_next_pow2(MAX(capacity, 2));
+	queue->cells = (struct laz_mpmc_cell *)malloc_try(
+		capacity * sizeof(*queue->cells));
+	queue->mask = capacity - 1;
+
+	for (size_t i = 0; i < capacity; i++) {
+		laz_atomic_init(&queue->cells[i].sequence, i);
+	}
+
+	laz_atomic_init(&queue->enqueue_pos, (size_t)0);
+	laz_atomic_init(&queue->dequeue_pos, (size_t)0);
+
+	return queue;
+}
+
+void mpmc_queue_destroy(struct mpmc_queue *queue)
+{
+	if (queue == NULL) {
+		return;
+	}
+
+	free(queue->cells);
+	free(queue);
+}
+
+size_t mpmc_queue_capacity(const struct mpmc_queue *queue)
+{
+	return queue->mask + 1;
+}
+
+int mpmc_queue_push(struct mpmc_queue *queue, void *item)
+{
+	struct laz_mpmc_cell *cell = NULL;
+	size_t pos = laz_atomic_load(&queue->enqueue_pos, LAZ_RELAXED);
+
+	for (;;) {
+		size_t seq = 0;
+		intptr_t diff = 0;
+
+		cell = &queue->cells[pos & queue->mask];
+		seq = laz_atomic_load(&cell->sequence, LAZ_ACQUIRE);
+		diff = (intptr_t)seq - (intptr_t)pos;
+
+		if (diff == 0) {
+			if (laz_atomic_cas_weak(&queue->enqueue_pos, &pos,
+						pos + 1, LAZ_RELAXED,
+						LAZ_RELAXED)) {
+				break;
+			}
+		} else if (diff < 0) {
+			/* The consumer of the previous lap is not done */
+			return -1;
+		} else {
+			pos = laz_atomic_load(&queue->enqueue_pos,
+					      LAZ_RELAXED);
+		}
+	}
+
+	cell->data = item;
+	laz_atomic_store(&cell->sequence, pos + 1, LAZ_RELEASE);
+	return 0;
+}
+
+int mpmc_queue_pop(struct mpmc_queue *queue, void **item)
+{
+	struct laz_mpmc_cell *cell = NULL;
+	size_t pos = laz_atomic_load(&queue->dequeue_pos, LAZ_RELAXED);
+
+	for (;;) {
+		size_t seq = 0;
+		intptr_t diff = 0;
+
+		cell = &queue->cells[pos & queue->mask];
+		seq = laz_atomic_load(&cell->sequence, LAZ_ACQUIRE);
+		diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+		if (diff == 0) {
+			if (laz_atomic_cas_weak(&queue->dequeue_pos, &pos,
+						pos + 1, LAZ_RELAXED,
+						LAZ_RELAXED)) {
+				break;
+			}
+		} else if (diff < 0) {
+			/* The producer of this position is not done */
+			return -1;
+		} else {
+			pos = laz_atomic_load(&queue->dequeue_pos,
+					      LAZ_RELAXED);
+		}
+	}
+
+	*item = cell->data;
+	laz_atomic_store(&cell->sequence, pos + queue->mask + 1, LAZ_RELEASE);
+	return 0;
+}
+#endif /* LAZ_ATOMICS */
 
 #undef LAZ_RESTRICT
 #undef LAZ_INIT
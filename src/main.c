@@ -1,3 +1,794 @@
-int main(void)
+#include "config.h"
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Files at least this large are memory mapped, smaller ones are read into a
+ * buffer shared by a batch of files */
+#define LARGE_FILE (1 << 20)
+#define BATCH_BYTES (4 << 20)
+#define BATCH_FILES 256
+/* Duplicate detection first compares the first and last EDGE_BYTES of files
+ * of the same size, and only hashes whole files whose edges also match */
+#define EDGE_BYTES 4096
+/* More workers than this for -j is taken for a typo */
+#define MAX_THREADS 1024
+
+enum algorithm {
+	ALGO_FNV32,
+	ALGO_FNV64,
+	ALGO_CRC32C,
+	ALGO_FAST,
+};
+
+static const struct {
+	const char *name;
+	/* Digest width in bytes */
+	int width;
+} algorithms[] = {
+	[ALGO_FNV32] = { "fnv32", 4 },
+	[ALGO_FNV64] = { "fnv64", 8 },
+	[ALGO_CRC32C] = { "crc32c", 4 },
+	[ALGO_FAST] = { "fast", 8 },
+};
+
+struct file {
+	const char *path;
+	u64 size;
+	u64 digest;
+	/* Hash of the first and last EDGE_BYTES, for duplicate detection */
+	u64 edges;
+	u64 bytes_read;
+	/* Identity of the file, set by duplicate detection to skip hard links */
+	u64 dev;
+	u64 ino;
+	int error;
+};
+
+/* Range of files hashed by one task: either a single large file or a batch of
+ * small ones */
+struct unit {
+	size_t begin;
+	size_t end;
+};
+
+struct hasher {
+	struct file *files;
+	size_t file_count;
+	size_t file_cap;
+	/* Paths live in large blocks instead of one allocation each, every
+	 * block starts with a pointer to the previous one */
+	char *blocks;
+	char *strings;
+	size_t strings_left;
+	struct unit *units;
+	size_t unit_count;
+	enum algorithm algorithm;
+};
+
+static u64 digest(enum algorithm algorithm, const void *buf, size_t len)
 {
+	switch (algorithm) {
+	case ALGO_FNV32:
+		return fnv1a_32_buf(buf, len);
+	case ALGO_FNV64:
+		return fnv1a_64_buf(buf, len);
+	case ALGO_CRC32C:
+		return crc32c_buf(buf, len);
+	case ALGO_FAST:
+		return fast_hash_64(buf, len, 0);
+	}
+
+	return 0;
+}
+
+static const char *intern_path(struct hasher *h, const char *path)
+{
+	size_t len = strlen(path) + 1;
+	char *copy = NULL;
+
+	if (len > h->strings_left) {
+		size_t size = sizeof(char *) + MAX(len, 1 << 16);
+		char *block = (char *)malloc_try(size);
+
+		memcpy(block, &h->blocks, sizeof(char *));
+		h->blocks = block;
+		h->strings = block + sizeof(char *);
+		h->strings_left = size - sizeof(char *);
+	}
+
+	copy = h->strings;
+	memcpy(copy, path, len);
+	h->strings += len;
+	h->strings_left -= len;
+
+	return copy;
+}
+
+static int add_file(const char *path, u64 size, void *ctx)
+{
+	struct hasher *h = (struct hasher *)ctx;
+	struct file *f = NULL;
+
+	if (h->file_count == h->file_cap) {
+		h->file_cap = MAX(h->file_cap * 2, 1024);
+		h->files = (struct file *)realloc_try(
+			h->files, h->file_cap * sizeof(*h->files));
+	}
+
+	f = &h->files[h->file_count++];
+	f->path = intern_path(h, path);
+	f->size = size;
+	f->digest = 0;
+	f->edges = 0;
+	f->bytes_read = 0;
+	f->dev = 0;
+	f->ino = 0;
+	f->error = 0;
+
+	return 0;
+}
+
+static void free_hasher(struct hasher *h)
+{
+	while (h->blocks != NULL) {
+		char *prev = NULL;
+
+		memcpy(&prev, h->blocks, sizeof(char *));
+		free(h->blocks);
+		h->blocks = prev;
+	}
+
+	free(h->files);
+	free(h->units);
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+	return strcmp(((const struct file *)a)->path,
+		      ((const struct file *)b)->path);
+}
+
+/* Reads up to `size` bytes at `offset`, returns the amount read or -1 */
+static long read_at(int fd, char *buf, u64 size, u64 offset)
+{
+	u64 done = 0;
+
+	while (done < size) {
+		ssize_t n = pread(fd, buf + done, size - done,
+				  (off_t)(offset + done));
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+
+		if (n < 0) {
+			return -1;
+		}
+
+		if (n == 0) {
+			/* Truncated since it was listed */
+			break;
+		}
+
+		done += (u64)n;
+	}
+
+	return (long)done;
+}
+
+static void hash_large(struct hasher *h, struct file *f)
+{
+	PROFILE_SCOPE("hash_large");
+	struct mapped_file map;
+
+	if (map_file(f->path, &map) != 0) {
+		f->error = 1;
+		return;
+	}
+
+	(void)posix_madvise((void *)map.data, map.size,
+			    POSIX_MADV_SEQUENTIAL);
+	f->size = map.size;
+	f->digest = digest(h->algorithm, map.data, map.size);
+	f->bytes_read += map.size;
+	unmap_file(&map);
+}
+
+/* `buf` holds at least `f->size` bytes */
+static void hash_small(struct hasher *h, struct file *f, char *buf)
+{
+	int fd = open(f->path, O_RDONLY | O_CLOEXEC);
+	long n = 0;
+
+	if (fd < 0 || (n = read_at(fd, buf, f->size, 0)) < 0) {
+		(void)errorf("Error: unable to read file %s\n", f->path);
+		f->error = 1;
+	} else {
+		f->size = (u64)n;
+		f->digest = digest(h->algorithm, buf, (size_t)n);
+		f->bytes_read += (u64)n;
+	}
+
+	if (fd >= 0) {
+		(void)close(fd);
+	}
+}
+
+static void hash_batch(struct hasher *h, const struct unit *u)
+{
+	PROFILE_SCOPE("hash_batch");
+	u64 largest = 0;
+	char *buf = NULL;
+
+	for (size_t i = u->begin; i < u->end; i++) {
+		largest = MAX(largest, h->files[i].size);
+	}
+
+	buf = (char *)malloc_try(largest + 1);
+
+	for (size_t i = u->begin; i < u->end; i++) {
+		hash_small(h, &h->files[i], buf);
+	}
+
+	free(buf);
+}
+
+static void hash_units(size_t begin, size_t end, void *ctx)
+{
+	struct hasher *h = (struct hasher *)ctx;
+
+	for (size_t i = begin; i < end; i++) {
+		const struct unit *u = &h->units[i];
+
+		if (u->end - u->begin == 1 &&
+		    h->files[u->begin].size >= LARGE_FILE) {
+			hash_large(h, &h->files[u->begin]);
+		} else {
+			hash_batch(h, u);
+		}
+	}
+}
+
+/* Groups consecutive small files into batches, large files get a unit each */
+static void plan_units(struct hasher *h)
+{
+	size_t i = 0;
+
+	h->units = (struct unit *)malloc_try(
+		MAX(h->file_count, 1) * sizeof(*h->units));
+
+	while (i < h->file_count) {
+		struct unit *u = &h->units[h->unit_count++];
+		u64 bytes = 0;
+
+		u->begin = i;
+
+		if (h->files[i].size >= LARGE_FILE) {
+			u->end = ++i;
+			continue;
+		}
+
+		while (i < h->file_count && h->files[i].size < LARGE_FILE &&
+		       i - u->begin < BATCH_FILES && bytes < BATCH_BYTES) {
+			bytes += h->files[i++].size;
+		}
+
+		u->end = i;
+	}
+}
+
+/* Flushed to stdout whenever it holds this much */
+#define OUTPUT_BYTES (1 << 16)
+
+static int print_digests(const struct hasher *h, int binary)
+{
+	PROFILE_SCOPE("print_digests");
+	int width = algorithms[h->algorithm].width;
+	int status = EXIT_SUCCESS;
+	struct out_buf out;
+
+	out_buf_init(&out, OUTPUT_BYTES + 4096);
+
+	for (size_t i = 0; i < h->file_count; i++) {
+		const struct file *f = &h->files[i];
+
+		if (f->error) {
+			status = EXIT_FAILURE;
+			continue;
+		}
+
+		if (binary) {
+			unsigned char *bytes =
+				(unsigned char *)out_buf_reserve(&out, 8);
+
+			/* Big-endian, so the bytes read like the hex form */
+			for (int b = 0; b < width; b++) {
+				bytes[b] = (unsigned char)(f->digest >>
+							   (8 * (width - 1 - b)));
+			}
+
+			out.len += (size_t)width;
+		} else {
+			out_buf_append_hex(&out, f->digest, 2 * (unsigned)width);
+			out_buf_append(&out, "  ", 2);
+			out_buf_append_cstr(&out, f->path);
+			out_buf_append_char(&out, '\n');
+		}
+
+		if (out.len >= OUTPUT_BYTES &&
+		    out_buf_flush(STDOUT_FILENO, &out, 1) != 0) {
+			break;
+		}
+	}
+
+	if (out_buf_flush(STDOUT_FILENO, &out, 1) != 0) {
+		perror("stdout");
+		status = EXIT_FAILURE;
+	}
+
+	out_buf_destroy(&out);
+	return status;
+}
+
+/* `start` is when the walk began, so the reported rate covers it too */
+static int hash_files(struct hasher *h, struct thread_pool *pool, int binary,
+		      int quiet, u64 start)
+{
+	int status = EXIT_SUCCESS;
+	u64 bytes = 0;
+	u64 elapsed = 0;
+
+	PROFILE_BEGIN("sort");
+	qsort(h->files, h->file_count, sizeof(*h->files), compare_paths);
+	plan_units(h);
+	PROFILE_END();
+	parallel_for(pool, h->unit_count, 1, hash_units, h);
+	elapsed = get_nanoseconds() - start;
+	status = print_digests(h, binary);
+
+	for (size_t i = 0; i < h->file_count; i++) {
+		bytes += h->files[i].size;
+	}
+
+	if (!quiet) {
+		double seconds = (double)MAX(elapsed, 1) / 1e9;
+
+		(void)errorf("%zu files, %.1f MB in %.3f s, %.2f GB/s (%s)\n",
+			     h->file_count, (double)bytes / 1e6, seconds,
+			     (double)bytes / seconds / 1e9,
+			     algorithms[h->algorithm].name);
+	}
+
+	return status;
+}
+
+struct dedupe {
+	struct hasher *h;
+	/* Files that may still have a duplicate */
+	struct file **candidates;
+	size_t count;
+};
+
+static int compare_size(const struct file *a, const struct file *b)
+{
+	return (a->size > b->size) - (a->size < b->size);
+}
+
+static int compare_by_size(const void *a, const void *b)
+{
+	const struct file *fa = *(const struct file *const *)a;
+	const struct file *fb = *(const struct file *const *)b;
+
+	return compare_size(fa, fb);
+}
+
+static int compare_by_edges(const void *a, const void *b)
+{
+	const struct file *fa = *(const struct file *const *)a;
+	const struct file *fb = *(const struct file *const *)b;
+	int c = compare_size(fa, fb);
+
+	return c != 0 ? c : (fa->edges > fb->edges) - (fa->edges < fb->edges);
+}
+
+static int compare_by_digest(const void *a, const void *b)
+{
+	const struct file *fa = *(const struct file *const *)a;
+	const struct file *fb = *(const struct file *const *)b;
+	int c = compare_by_edges(a, b);
+
+	return c != 0 ? c : (fa->digest > fb->digest) - (fa->digest < fb->digest);
+}
+
+static int compare_by_inode_path(const void *a, const void *b)
+{
+	const struct file *fa = *(const struct file *const *)a;
+	const struct file *fb = *(const struct file *const *)b;
+	int c = (fa->dev > fb->dev) - (fa->dev < fb->dev);
+
+	c = c != 0 ? c : (fa->ino > fb->ino) - (fa->ino < fb->ino);
+	return c != 0 ? c : strcmp(fa->path, fb->path);
+}
+
+/* Sorting by path last keeps the output stable */
+static int compare_by_digest_path(const void *a, const void *b)
+{
+	const struct file *fa = *(const struct file *const *)a;
+	const struct file *fb = *(const struct file *const *)b;
+	int c = compare_by_digest(a, b);
+
+	return c != 0 ? c : strcmp(fa->path, fb->path);
+}
+
+/* Sorts the candidates with `compare` and keeps the ones that compare equal
+ * to at least one other */
+static void keep_collisions(struct dedupe *d,
+			    int (*compare)(const void *, const void *))
+{
+	size_t kept = 0;
+	size_t i = 0;
+
+	qsort(d->candidates, d->count, sizeof(*d->candidates), compare);
+
+	while (i < d->count) {
+		size_t run = i + 1;
+
+		while (run < d->count &&
+		       compare(&d->candidates[i], &d->candidates[run]) == 0) {
+			run++;
+		}
+
+		if (run - i > 1) {
+			for (; i < run; i++) {
+				d->candidates[kept++] = d->candidates[i];
+			}
+		}
+
+		i = run;
+	}
+
+	d->count = kept;
+}
+
+static void hash_edges(size_t begin, size_t end, void *ctx)
+{
+	PROFILE_SCOPE("hash_edges");
+	struct dedupe *d = (struct dedupe *)ctx;
+	char buf[2 * EDGE_BYTES];
+
+	for (size_t i = begin; i < end; i++) {
+		struct file *f = d->candidates[i];
+		int fd = open(f->path, O_RDONLY | O_CLOEXEC);
+		struct stat st;
+		long n = 0;
+
+		if (fd < 0 || fstat(fd, &st) != 0) {
+			(void)errorf("Error: unable to read file %s\n",
+				     f->path);
+			f->error = 1;
+
+			if (fd >= 0) {
+				(void)close(fd);
+			}
+
+			continue;
+		}
+
+		f->dev = (u64)st.st_dev;
+		f->ino = (u64)st.st_ino;
+
+		if (f->size <= sizeof(buf)) {
+			/* The edges are the whole file */
+			n = read_at(fd, buf, f->size, 0);
+		} else if ((n = read_at(fd, buf, EDGE_BYTES, 0)) >= 0) {
+			long tail = read_at(fd, buf + n, EDGE_BYTES,
+					    f->size - EDGE_BYTES);
+
+			n = tail < 0 ? -1 : n + tail;
+		}
+
+		(void)close(fd);
+
+		if (n < 0) {
+			(void)errorf("Error: unable to read file %s\n",
+				     f->path);
+			f->error = 1;
+			continue;
+		}
+
+		f->edges = fast_hash_64(buf, (size_t)n, 0);
+		f->bytes_read += (u64)n;
+
+		if (f->size <= sizeof(buf)) {
+			f->digest = f->edges;
+		}
+	}
+}
+
+static void hash_whole(size_t begin, size_t end, void *ctx)
+{
+	PROFILE_SCOPE("hash_whole");
+	struct dedupe *d = (struct dedupe *)ctx;
+	u64 largest = 0;
+	char *buf = NULL;
+
+	for (size_t i = begin; i < end; i++) {
+		if (d->candidates[i]->size < LARGE_FILE) {
+			largest = MAX(largest, d->candidates[i]->size);
+		}
+	}
+
+	buf = (char *)malloc_try(largest + 1);
+
+	for (size_t i = begin; i < end; i++) {
+		struct file *f = d->candidates[i];
+
+		if (f->size <= 2 * EDGE_BYTES) {
+			/* Already hashed whole by hash_edges */
+		} else if (f->size >= LARGE_FILE) {
+			hash_large(d->h, f);
+		} else {
+			hash_small(d->h, f, buf);
+		}
+	}
+
+	free(buf);
+}
+
+static void drop_errors(struct dedupe *d)
+{
+	size_t kept = 0;
+
+	for (size_t i = 0; i < d->count; i++) {
+		if (!d->candidates[i]->error) {
+			d->candidates[kept++] = d->candidates[i];
+		}
+	}
+
+	d->count = kept;
+}
+
+/* Hard links to one file are not copies of it and reclaim nothing, keeps only
+ * the first path of each */
+static void drop_links(struct dedupe *d)
+{
+	size_t kept = 0;
+
+	qsort(d->candidates, d->count, sizeof(*d->candidates),
+	      compare_by_inode_path);
+
+	for (size_t i = 0; i < d->count; i++) {
+		const struct file *f = d->candidates[i];
+
+		if (kept == 0 || f->dev != d->candidates[kept - 1]->dev ||
+		    f->ino != d->candidates[kept - 1]->ino) {
+			d->candidates[kept++] = d->candidates[i];
+		}
+	}
+
+	d->count = kept;
+}
+
+/* Prints groups of identical files separated by blank lines and counts the
+ * redundant copies */
+static int print_duplicates(struct dedupe *d, size_t *redundant, u64 *wasted)
+{
+	int status = EXIT_SUCCESS;
+	struct out_buf out;
+	size_t i = 0;
+
+	out_buf_init(&out, OUTPUT_BYTES + 4096);
+	qsort(d->candidates, d->count, sizeof(*d->candidates),
+	      compare_by_digest_path);
+
+	while (i < d->count) {
+		size_t run = i + 1;
+
+		while (run < d->count &&
+		       compare_by_digest(&d->candidates[i],
+					 &d->candidates[run]) == 0) {
+			run++;
+		}
+
+		if (run - i > 1) {
+			if (*redundant != 0) {
+				out_buf_append_char(&out, '\n');
+			}
+
+			out_buf_append_u64(&out, d->candidates[i]->size);
+			out_buf_append_cstr(&out, " bytes each:\n");
+			*redundant += run - i - 1;
+			*wasted += (run - i - 1) * d->candidates[i]->size;
+
+			for (; i < run; i++) {
+				out_buf_append_cstr(&out, d->candidates[i]->path);
+				out_buf_append_char(&out, '\n');
+			}
+		}
+
+		i = run;
+
+		if (out.len >= OUTPUT_BYTES &&
+		    out_buf_flush(STDOUT_FILENO, &out, 1) != 0) {
+			break;
+		}
+	}
+
+	if (out_buf_flush(STDOUT_FILENO, &out, 1) != 0) {
+		perror("stdout");
+		status = EXIT_FAILURE;
+	}
+
+	out_buf_destroy(&out);
+	return status;
+}
+
+/* Same size, then same edges, then same digest, each stage only reading the
+ * files left by the previous one */
+static int find_duplicates(struct hasher *h, struct thread_pool *pool,
+			   int quiet)
+{
+	struct dedupe d;
+	size_t redundant = 0;
+	u64 total = 0;
+	u64 read = 0;
+	u64 wasted = 0;
+	int status = EXIT_SUCCESS;
+
+	d.h = h;
+	d.count = 0;
+	d.candidates = (struct file **)malloc_try(MAX(h->file_count, 1) *
+						  sizeof(*d.candidates));
+
+	/* Empty files are all identical but hold nothing to reclaim */
+	for (size_t i = 0; i < h->file_count; i++) {
+		if (h->files[i].size != 0) {
+			d.candidates[d.count++] = &h->files[i];
+		}
+
+		total += h->files[i].size;
+	}
+
+	h->algorithm = ALGO_FAST;
+	keep_collisions(&d, compare_by_size);
+	parallel_for(pool, d.count, 0, hash_edges, &d);
+	drop_errors(&d);
+	drop_links(&d);
+	keep_collisions(&d, compare_by_edges);
+	parallel_for(pool, d.count, 1, hash_whole, &d);
+	drop_errors(&d);
+	status = print_duplicates(&d, &redundant, &wasted);
+
+	for (size_t i = 0; i < h->file_count; i++) {
+		read += h->files[i].bytes_read;
+		status = h->files[i].error ? EXIT_FAILURE : status;
+	}
+
+	if (!quiet) {
+		(void)errorf("%zu redundant files, %.1f MB reclaimable, read "
+			     "%.1f of %.1f MB\n",
+			     redundant, (double)wasted / 1e6,
+			     (double)read / 1e6, (double)total / 1e6);
+	}
+
+	free(d.candidates);
+	return status;
+}
+
+static noreturn void usage(int status)
+{
+	(void)fprintf(status == EXIT_SUCCESS ? stdout : stderr,
+		      "usage: %s [-a algorithm] [-j threads] [-b] [-d] [-q] path...\n"
+		      "Hash every regular file under each path.\n"
+		      "  -a  fnv32, fnv64, crc32c or fast (default)\n"
+		      "  -j  worker threads, all processors by default\n"
+		      "  -b  write raw big-endian digests in listing order\n"
+		      "  -d  list groups of identical files instead\n"
+		      "  -q  do not report throughput on stderr\n",
+		      PROJECT_NAME);
+	exit(status);
+}
+
+int main(int argc, char **argv)
+{
+	struct hasher h;
+	struct thread_pool *pool = NULL;
+	size_t threads = 0;
+	int binary = 0;
+	int duplicates = 0;
+	int quiet = 0;
+	int status = EXIT_SUCCESS;
+	int opt = 0;
+	int ret = 0;
+	u64 start = 0;
+
+	memset(&h, 0, sizeof(h));
+	h.algorithm = ALGO_FAST;
+
+	while ((opt = getopt(argc, argv, "a:j:bdqh")) != -1) {
+		switch (opt) {
+		case 'a': {
+			size_t i = 0;
+
+			while (i < ARRAY_LENGTH(algorithms) &&
+			       strcmp(optarg, algorithms[i].name) != 0) {
+				i++;
+			}
+
+			if (i == ARRAY_LENGTH(algorithms)) {
+				(void)errorf("Error: unknown algorithm %s\n",
+					     optarg);
+				usage(EXIT_FAILURE);
+			}
+
+			h.algorithm = (enum algorithm)i;
+			break;
+		}
+		case 'j': {
+			u64 value = 0;
+
+			if (parse_u64(str_view_cstr(optarg), &value) != 0 ||
+			    value == 0 || value > MAX_THREADS) {
+				(void)errorf("Error: invalid thread count %s, "
+					     "expected 1 to %d\n",
+					     optarg, MAX_THREADS);
+				usage(EXIT_FAILURE);
+			}
+
+			threads = (size_t)value;
+			break;
+		}
+		case 'b':
+			binary = 1;
+			break;
+		case 'd':
+			duplicates = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'h':
+			usage(EXIT_SUCCESS);
+		default:
+			usage(EXIT_FAILURE);
+		}
+	}
+
+	if (optind == argc) {
+		usage(EXIT_FAILURE);
+	}
+
+	PROFILE_WRITE_AT_EXIT(PROJECT_NAME ".trace.json");
+	PROFILE_THREAD_NAME("main");
+	start = get_nanoseconds();
+	PROFILE_BEGIN("walk");
+
+	for (int i = optind; i < argc; i++) {
+		if (walk_dir(argv[i], add_file, &h) != 0) {
+			status = EXIT_FAILURE;
+		}
+	}
+
+	PROFILE_END();
+	PROFILE_COUNTER("files", h.file_count);
+
+	pool = thread_pool_create(threads);
+
+	if (duplicates) {
+		ret = find_duplicates(&h, pool, quiet);
+	} else {
+		ret = hash_files(&h, pool, binary, quiet, start);
+	}
+
+	if (ret != EXIT_SUCCESS) {
+		status = EXIT_FAILURE;
+	}
+
+	thread_pool_destroy(pool);
+	free_hasher(&h);
+	return status;
 }
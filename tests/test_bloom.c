@@ -0,0 +1,188 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define KEYS 100000
+
+static char path[] = "/tmp/test_bloom_XXXXXX";
+
+void setUp(void)
+{
+	int fd = 0;
+
+	strcpy(path, "/tmp/test_bloom_XXXXXX");
+	fd = mkstemp(path);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+	(void)close(fd);
+}
+
+void tearDown(void)
+{
+	(void)remove(path);
+}
+
+void test_bloom_sizing(void)
+{
+	/* A classic filter needs 9.59 bits per key for 1% */
+	u64 bits = bloom_bits_for(1000000, 0.01);
+	unsigned hashes = bloom_hashes_for(bits, 1000000);
+
+	TEST_ASSERT_EQUAL_UINT64(0, bits % 512);
+	TEST_ASSERT_GREATER_THAN_UINT64(9585059, bits);
+	TEST_ASSERT_LESS_THAN_UINT64(9585059 * 13 / 10, bits);
+	TEST_ASSERT_UINT_WITHIN(2, 7, hashes);
+	TEST_ASSERT_TRUE(bloom_fp_rate(bits, hashes, 1000000) <= 0.01);
+	TEST_ASSERT_TRUE(bloom_fp_rate(bits, hashes, 2000000) > 0.01);
+	TEST_ASSERT_TRUE(bloom_bits_for(1000000, 0.001) > bits);
+	TEST_ASSERT_EQUAL_UINT64(512, bloom_bits_for(0, 0.01));
+	TEST_ASSERT_TRUE(bloom_fp_rate(bits, hashes, 0) == 0.0);
+}
+
+static void add_keys(struct bloom *bloom)
+{
+	for (u64 i = 0; i < KEYS; i++) {
+		bloom_add(bloom, &i, sizeof(i));
+	}
+}
+
+static double false_positives(const struct bloom *bloom)
+{
+	size_t hits = 0;
+
+	for (u64 i = KEYS; i < 2 * KEYS; i++) {
+		hits += (size_t)bloom_contains(bloom, &i, sizeof(i));
+	}
+
+	return (double)hits / KEYS;
+}
+
+void test_bloom_membership(void)
+{
+	struct bloom *bloom = bloom_create(KEYS, 0.01);
+
+	TEST_ASSERT_EQUAL_INT(0, bloom_contains(bloom, "missing", 7));
+	add_keys(bloom);
+
+	for (u64 i = 0; i < KEYS; i++) {
+		TEST_ASSERT_EQUAL_INT(1, bloom_contains(bloom, &i, sizeof(i)));
+	}
+
+	TEST_ASSERT_TRUE(false_positives(bloom) < 0.015);
+	TEST_ASSERT_EQUAL_UINT64(bloom_bits_for(KEYS, 0.01), bloom_bits(bloom));
+	bloom_destroy(bloom);
+}
+
+void test_bloom_hashes(void)
+{
+	struct bloom *bloom = bloom_create(1000, 0.001);
+	size_t hits = 0;
+
+	for (u64 i = 0; i < 1000; i++) {
+		bloom_add_hash(bloom, fast_hash_64(&i, sizeof(i), 0));
+	}
+
+	for (u64 i = 0; i < 1000; i++) {
+		TEST_ASSERT_EQUAL_INT(
+			1, bloom_contains_hash(bloom,
+					       fast_hash_64(&i, sizeof(i), 0)));
+	}
+
+	/* Sequential integers are poor hashes, which the filter must cope
+	 * with */
+	for (u64 i = 0; i < 100000; i++) {
+		hits += (size_t)bloom_contains_hash(bloom, i);
+	}
+
+	TEST_ASSERT_LESS_THAN_size_t(300, hits);
+	bloom_destroy(bloom);
+}
+
+/* Random 64-bit hashes, from a fixed seed */
+static u64 next_hash(u64 *state)
+{
+	*state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return *state ^ *state >> 29;
+}
+
+/* Measured against the sized rate with uniform hashes, which only holds when
+ * the probes of a key are independent */
+static void check_fp_rate(u64 n, double fp_rate)
+{
+	struct bloom *bloom = bloom_create(n, fp_rate);
+	u64 state = 42;
+	u64 queries = 2000000;
+	u64 hits = 0;
+	double measured = 0;
+
+	for (u64 i = 0; i < n; i++) {
+		bloom_add_hash(bloom, next_hash(&state));
+	}
+
+	for (u64 i = 0; i < queries; i++) {
+		hits += (u64)bloom_contains_hash(bloom, next_hash(&state));
+	}
+
+	measured = (double)hits / (double)queries;
+	bloom_destroy(bloom);
+	TEST_ASSERT_TRUE(measured <= fp_rate * 1.2);
+	TEST_ASSERT_TRUE(measured >= fp_rate * 0.5);
+}
+
+void test_bloom_fp_rate(void)
+{
+	check_fp_rate(200000, 0.001);
+	check_fp_rate(200000, 0.0001);
+}
+
+void test_bloom_save_and_load(void)
+{
+	struct bloom *bloom = bloom_create(KEYS, 0.01);
+	struct bloom *loaded = NULL;
+	FILE *file = NULL;
+
+	add_keys(bloom);
+	TEST_ASSERT_EQUAL_INT(0, bloom_save(bloom, path));
+	loaded = bloom_load(path);
+	TEST_ASSERT_NOT_NULL(loaded);
+	TEST_ASSERT_EQUAL_UINT64(bloom_bits(bloom), bloom_bits(loaded));
+	TEST_ASSERT_EQUAL_UINT(bloom_hashes(bloom), bloom_hashes(loaded));
+
+	for (u64 i = 0; i < KEYS; i++) {
+		TEST_ASSERT_EQUAL_INT(1, bloom_contains(loaded, &i, sizeof(i)));
+	}
+
+	TEST_ASSERT_TRUE(false_positives(bloom) == false_positives(loaded));
+	bloom_destroy(loaded);
+
+	/* Files with trailing bytes are rejected */
+	file = fopen(path, "ab");
+	(void)fputc(0, file);
+	(void)fclose(file);
+	TEST_ASSERT_NULL(bloom_load(path));
+	bloom_destroy(bloom);
+
+	/* So are truncated ones */
+	TEST_ASSERT_EQUAL_INT(0, truncate(path, 64 + 100));
+	TEST_ASSERT_NULL(bloom_load(path));
+	file = fopen(path, "wb");
+	(void)fputs("not a filter", file);
+	(void)fclose(file);
+	TEST_ASSERT_NULL(bloom_load(path));
+
+	bloom = bloom_create(1, 0.5);
+	TEST_ASSERT_EQUAL_INT(-1, bloom_save(bloom, "/nonexistent/filter"));
+	bloom_destroy(bloom);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_bloom_sizing);
+	RUN_TEST(test_bloom_membership);
+	RUN_TEST(test_bloom_hashes);
+	RUN_TEST(test_bloom_fp_rate);
+	RUN_TEST(test_bloom_save_and_load);
+
+	return UNITY_END();
+}
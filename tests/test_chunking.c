@@ -0,0 +1,181 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define DATA_SIZE (1 << 20)
+#define MAX_CHUNKS 4096
+
+struct chunks {
+	struct cdc_chunk items[MAX_CHUNKS];
+	size_t count;
+};
+
+static struct cdc cdc;
+static unsigned char data[DATA_SIZE + 100];
+static struct chunks before;
+static struct chunks after;
+
+static int collect(const struct cdc_chunk *chunk, void *ctx)
+{
+	struct chunks *chunks = (struct chunks *)ctx;
+
+	TEST_ASSERT_LESS_THAN_size_t(MAX_CHUNKS, chunks->count);
+	chunks->items[chunks->count++] = *chunk;
+
+	return 0;
+}
+
+void setUp(void)
+{
+	u64 state = 1;
+
+	for (size_t i = 0; i < sizeof(data); i++) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		data[i] = (unsigned char)(state >> 56);
+	}
+
+	cdc_init(&cdc, 0, 0, 0);
+	memset(&before, 0, sizeof(before));
+	memset(&after, 0, sizeof(after));
+}
+
+void tearDown(void)
+{
+}
+
+void test_cdc_init_sizes(void)
+{
+	struct cdc c;
+
+	TEST_ASSERT_EQUAL_size_t(2 << 10, cdc.min_size);
+	TEST_ASSERT_EQUAL_size_t(8 << 10, cdc.avg_size);
+	TEST_ASSERT_EQUAL_size_t(64 << 10, cdc.max_size);
+
+	cdc_init(&c, 100000, 3000, 10);
+	TEST_ASSERT_EQUAL_size_t(4096, c.avg_size);
+	TEST_ASSERT_EQUAL_size_t(2048, c.min_size);
+	TEST_ASSERT_EQUAL_size_t(8192, c.max_size);
+}
+
+void test_cdc_chunks_cover_input(void)
+{
+	u64 offset = 0;
+
+	TEST_ASSERT_EQUAL_INT(0, cdc_buf(&cdc, data, DATA_SIZE, collect,
+					 &before));
+
+	for (size_t i = 0; i < before.count; i++) {
+		const struct cdc_chunk *c = &before.items[i];
+
+		TEST_ASSERT_EQUAL_UINT64(offset, c->offset);
+		TEST_ASSERT_LESS_OR_EQUAL_size_t(cdc.max_size, c->len);
+		if (i + 1 < before.count) {
+			TEST_ASSERT_GREATER_THAN_size_t(cdc.min_size, c->len);
+		}
+		TEST_ASSERT_EQUAL_UINT64(fast_hash_64(data + c->offset, c->len,
+						      0),
+					 c->hash);
+		offset += c->len;
+	}
+
+	TEST_ASSERT_EQUAL_UINT64(DATA_SIZE, offset);
+	/* Normalized chunking keeps the mean close to the target */
+	TEST_ASSERT_UINT64_WITHIN(4096, 8192, DATA_SIZE / before.count);
+}
+
+void test_cdc_survives_insertion(void)
+{
+	size_t shared = 0;
+
+	(void)cdc_buf(&cdc, data, DATA_SIZE, collect, &before);
+	memmove(data + 300000 + 100, data + 300000, DATA_SIZE - 300000);
+	memset(data + 300000, 'x', 100);
+	(void)cdc_buf(&cdc, data, DATA_SIZE + 100, collect, &after);
+
+	for (size_t i = 0; i < before.count; i++) {
+		for (size_t j = 0; j < after.count; j++) {
+			if (before.items[i].hash == after.items[j].hash) {
+				shared++;
+				break;
+			}
+		}
+	}
+
+	/* Only the chunks around the insertion change */
+	TEST_ASSERT_GREATER_OR_EQUAL_size_t(before.count - 3, shared);
+}
+
+static int stop_after_two(const struct cdc_chunk *chunk, void *ctx)
+{
+	(void)chunk;
+	return ++*(int *)ctx == 2 ? 5 : 0;
+}
+
+void test_cdc_file_matches_buffer(void)
+{
+	char path[] = "/tmp/test_chunking_XXXXXX";
+	int fd = mkstemp(path);
+	int calls = 0;
+
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+	TEST_ASSERT_EQUAL_INT(DATA_SIZE, write(fd, data, DATA_SIZE));
+	(void)close(fd);
+
+	(void)cdc_buf(&cdc, data, DATA_SIZE, collect, &before);
+	TEST_ASSERT_EQUAL_INT(0, cdc_file(&cdc, path, collect, &after));
+	TEST_ASSERT_EQUAL_size_t(before.count, after.count);
+	TEST_ASSERT_EQUAL_MEMORY(before.items, after.items,
+				 before.count * sizeof(before.items[0]));
+
+	TEST_ASSERT_EQUAL_INT(5, cdc_file(&cdc, path, stop_after_two, &calls));
+	TEST_ASSERT_EQUAL_INT(2, calls);
+
+	(void)remove(path);
+	TEST_ASSERT_EQUAL_INT(-1, cdc_file(&cdc, path, collect, &after));
+}
+
+void test_file_stream_window(void)
+{
+	char path[] = "/tmp/test_chunking_XXXXXX";
+	int fd = mkstemp(path);
+	struct file_stream stream;
+	u64 total = 0;
+
+	TEST_ASSERT_EQUAL_INT(10000, write(fd, data, 10000));
+	(void)close(fd);
+	TEST_ASSERT_EQUAL_INT(0, file_stream_open(&stream, path, 4096));
+
+	/* Odd consumption sizes make the window slide */
+	for (;;) {
+		long n = file_stream_fill(&stream, 5000);
+
+		TEST_ASSERT_GREATER_OR_EQUAL_INT(0, n);
+		if (n == 0) {
+			break;
+		}
+
+		TEST_ASSERT_LESS_OR_EQUAL_INT(4096, n);
+		TEST_ASSERT_EQUAL_UINT64(total, stream.offset);
+		TEST_ASSERT_EQUAL_MEMORY(data + total, stream.data,
+					 MIN((size_t)n, 777));
+		file_stream_consume(&stream, MIN((size_t)n, 777));
+		total += MIN((size_t)n, 777);
+	}
+
+	TEST_ASSERT_EQUAL_UINT64(10000, total);
+	file_stream_close(&stream);
+	(void)remove(path);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_cdc_init_sizes);
+	RUN_TEST(test_cdc_chunks_cover_input);
+	RUN_TEST(test_cdc_survives_insertion);
+	RUN_TEST(test_cdc_file_matches_buffer);
+	RUN_TEST(test_file_stream_window);
+
+	return UNITY_END();
+}
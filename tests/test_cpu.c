@@ -0,0 +1,266 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define SIZE 4000
+
+/* From the portable code up to everything detected. Features the CPU lacks
+ * drop out, so some levels repeat on any one machine. */
+static const unsigned levels[] = {
+	0,
+	CPU_FEATURE_SSE2,
+	CPU_FEATURE_SSE2 | CPU_FEATURE_SSE4_2,
+	CPU_FEATURE_NEON,
+	CPU_FEATURE_NEON | CPU_FEATURE_CRC32,
+	~0U,
+};
+
+static unsigned char buf[SIZE];
+static char json[SIZE * 2];
+static size_t json_len;
+static unsigned detected;
+
+void setUp(void)
+{
+	u64 state = 7;
+
+	for (size_t i = 0; i < SIZE; i++) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		buf[i] = (unsigned char)('a' + (state >> 59) % 26);
+	}
+
+	/* Escapes and multibyte text in strings that cross 64-byte blocks */
+	json_len = 0;
+	json[json_len++] = '[';
+
+	for (size_t i = 0; json_len < sizeof(json) - 64; i++) {
+		json_len += (size_t)snprintf(
+			json + json_len, sizeof(json) - json_len,
+			"%s{\"k%zu\": \"\\\"%.*s\xc3\xa9\\\\\", \"n\": [%zu, true]}",
+			i > 0 ? ", " : "", i, (int)(i % 40), (const char *)buf,
+			i * 31);
+	}
+
+	json[json_len++] = ']';
+	(void)cpu_features_limit(~0U);
+	detected = cpu_features();
+}
+
+void tearDown(void)
+{
+	(void)cpu_features_limit(~0U);
+}
+
+void test_cpu_features_limit(void)
+{
+	const char *env = getenv("LAZ_CPU");
+
+	TEST_ASSERT_EQUAL_HEX32(detected, cpu_features());
+
+	/* Limits never bring back what LAZ_CPU left out */
+	if (env != NULL && strcmp(env, "none") == 0) {
+		TEST_ASSERT_EQUAL_HEX32(0, detected);
+	} else if (env == NULL) {
+#if defined(__x86_64__)
+		TEST_ASSERT_TRUE(detected & CPU_FEATURE_SSE2);
+#elif defined(__aarch64__)
+		TEST_ASSERT_TRUE(detected & CPU_FEATURE_NEON);
+#endif
+	}
+
+	TEST_ASSERT_EQUAL_HEX32(detected, cpu_features_limit(0));
+	TEST_ASSERT_EQUAL_HEX32(0, cpu_features());
+	TEST_ASSERT_EQUAL_HEX32(0, cpu_features_limit(CPU_FEATURE_AVX2));
+	TEST_ASSERT_EQUAL_HEX32(detected & CPU_FEATURE_AVX2, cpu_features());
+}
+
+void test_cpu_scan_levels(void)
+{
+	static size_t expected[4][SIZE / 7 + 1];
+	static char str[SIZE + 1];
+	const char *set = "xyz{|}";
+
+	for (size_t l = 0; l < ARRAY_LENGTH(levels); l++) {
+		(void)cpu_features_limit(levels[l]);
+
+		for (size_t len = 0, i = 0; len <= SIZE; len += 7, i++) {
+			size_t results[4];
+
+			results[0] = scan_byte(buf, len, 'q');
+			results[1] = scan_any(buf, len, set, strlen(set));
+			results[2] = count_byte(buf, len, 'c');
+			memcpy(str, buf, len);
+			str[len] = '\0';
+			results[3] = scan_strlen(str);
+
+			for (size_t k = 0; k < 4; k++) {
+				if (l == 0) {
+					expected[k][i] = results[k];
+				}
+
+				TEST_ASSERT_EQUAL_size_t(expected[k][i],
+							 results[k]);
+			}
+		}
+	}
+}
+
+void test_cpu_json_levels(void)
+{
+	struct json_doc reference;
+
+	(void)cpu_features_limit(0);
+	TEST_ASSERT_EQUAL_INT(0, json_parse(&reference, json, json_len));
+	TEST_ASSERT_GREATER_THAN_size_t(100, reference.count);
+
+	for (size_t l = 1; l < ARRAY_LENGTH(levels); l++) {
+		struct json_doc doc;
+
+		(void)cpu_features_limit(levels[l]);
+		TEST_ASSERT_EQUAL_INT(0, json_parse(&doc, json, json_len));
+		TEST_ASSERT_EQUAL_size_t(reference.count, doc.count);
+		TEST_ASSERT_EQUAL_MEMORY(reference.nodes, doc.nodes,
+					 doc.count * sizeof(*doc.nodes));
+		json_destroy(&doc);
+	}
+
+	json_destroy(&reference);
+}
+
+void test_cpu_utf8_crc32c_levels(void)
+{
+	for (size_t l = 0; l < ARRAY_LENGTH(levels); l++) {
+		(void)cpu_features_limit(levels[l]);
+		TEST_ASSERT_EQUAL_INT(0, utf8_validate(json, json_len));
+		TEST_ASSERT_EQUAL_HEX32(0xe3069283U, crc32c_buf("123456789", 9));
+
+		/* A byte UTF-8 never uses, at every position */
+		for (size_t i = 0; i < 100; i += 3) {
+			char saved = json[i];
+
+			json[i] = (char)0xff;
+			TEST_ASSERT_EQUAL_INT(-1, utf8_validate(json, 100));
+			json[i] = saved;
+		}
+
+		TEST_ASSERT_EQUAL_HEX32(
+			crc32c_update(crc32c_buf(buf, 1234), buf + 1234,
+				      SIZE - 1234),
+			crc32c_buf(buf, SIZE));
+	}
+}
+
+/* Sizes the output exactly, so a kernel storing past the end trips the
+ * sanitizer */
+static void assert_transcodes(const char *text, size_t len)
+{
+	size_t units16 = utf16_length_from_utf8(text, len);
+	size_t units32 = utf32_length_from_utf8(text, len);
+	u16 *utf16 = malloc(units16 * sizeof(*utf16));
+	u32 *utf32 = malloc(units32 * sizeof(*utf32));
+	char *back = malloc(len);
+
+	TEST_ASSERT_NOT_NULL(utf16);
+	TEST_ASSERT_NOT_NULL(utf32);
+	TEST_ASSERT_NOT_NULL(back);
+	TEST_ASSERT_EQUAL_size_t(units16, utf8_to_utf16(text, len, utf16));
+	TEST_ASSERT_EQUAL_size_t(len, utf16_to_utf8(utf16, units16, back));
+	TEST_ASSERT_EQUAL_MEMORY(text, back, len);
+	TEST_ASSERT_EQUAL_size_t(units32, utf8_to_utf32(text, len, utf32));
+	TEST_ASSERT_EQUAL_size_t(len, utf32_to_utf8(utf32, units32, back));
+	TEST_ASSERT_EQUAL_MEMORY(text, back, len);
+	free(utf16);
+	free(utf32);
+	free(back);
+}
+
+/* Units UTF-8 cannot encode, among ones the SIMD blocks take */
+static void assert_rejects_units(void)
+{
+	u16 utf16[40];
+	u32 utf32[40];
+	char back[80];
+
+	for (size_t k = 0; k < 40; k++) {
+		utf16[k] = (u16)(0x80 + k * 41);
+		utf32[k] = utf16[k];
+	}
+
+	for (size_t i = 0; i < 24; i++) {
+		u16 saved16 = utf16[i];
+		u32 saved32 = utf32[i];
+
+		utf16[i] = (u16)(i % 2 == 0 ? 0xdc00 : 0xd800);
+		utf32[i] = i % 2 == 0 ? 0xdfff : 0x110000U << i % 8;
+		TEST_ASSERT_EQUAL_size_t(UTF_INVALID,
+					 utf16_to_utf8(utf16, 40, back));
+		TEST_ASSERT_EQUAL_size_t(UTF_INVALID,
+					 utf32_to_utf8(utf32, 40, back));
+		utf16[i] = saved16;
+		utf32[i] = saved32;
+	}
+
+	TEST_ASSERT_EQUAL_size_t(80, utf16_to_utf8(utf16, 40, back));
+	TEST_ASSERT_EQUAL_size_t(80, utf32_to_utf8(utf32, 40, back));
+}
+
+void test_cpu_utf8_transcode_levels(void)
+{
+	/* Mostly two-byte text, then every length mixed */
+	static const u32 firsts[] = { 0x3b1, 0x61, 0x4e00, 0x1f600 };
+	static char text[SIZE + 4];
+	static u16 utf16[SIZE];
+	static u32 utf32[SIZE];
+	u64 state = 11;
+
+	for (size_t mix = 2; mix <= 4; mix += 2) {
+		size_t len = 0;
+		char saved = 0;
+
+		while (len < SIZE) {
+			u32 cp = 0;
+
+			state = state * 6364136223846793005ULL +
+				1442695040888963407ULL;
+			cp = firsts[(state >> 62) % mix] + (u32)(state >> 58);
+			len += utf32_to_utf8(&cp, 1, text + len);
+		}
+
+		for (size_t l = 0; l < ARRAY_LENGTH(levels); l++) {
+			(void)cpu_features_limit(levels[l]);
+
+			for (size_t end = 1; end <= 300; end++) {
+				while ((text[end] & 0xc0) == 0x80) {
+					end++;
+				}
+
+				assert_transcodes(text, end);
+			}
+
+			assert_transcodes(text, len);
+
+			/* A broken sequence past where the kernels stop */
+			saved = text[len - 1];
+			text[len - 1] = (char)0xc3;
+			TEST_ASSERT_EQUAL_size_t(
+				UTF_INVALID, utf8_to_utf16(text, len, utf16));
+			TEST_ASSERT_EQUAL_size_t(
+				UTF_INVALID, utf8_to_utf32(text, len, utf32));
+			text[len - 1] = saved;
+			assert_rejects_units();
+		}
+	}
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_cpu_features_limit);
+	RUN_TEST(test_cpu_scan_levels);
+	RUN_TEST(test_cpu_json_levels);
+	RUN_TEST(test_cpu_utf8_crc32c_levels);
+	RUN_TEST(test_cpu_utf8_transcode_levels);
+
+	return UNITY_END();
+}
@@ -0,0 +1,211 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define BIG_ROWS 60000
+
+static struct thread_pool *pool;
+static char *big;
+static size_t big_len;
+
+/* Three columns, the last quoted with delimiters, newlines and quotes inside
+ * often enough that chunk boundaries land inside quoted fields */
+static void make_big(void)
+{
+	u64 state = 7;
+	size_t cap = BIG_ROWS * 64;
+
+	big = (char *)malloc_try(cap);
+	big_len = 0;
+
+	for (size_t i = 0; i < BIG_ROWS; i++) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		big_len += (size_t)snprintf(
+			big + big_len, cap - big_len, "%zu,%d.5,\"%s%u\"\r\n", i,
+			(int)(state >> 60) - 8,
+			(state >> 58) % 3 == 0 ? "a,\nb \"\"q\"\" " : "x",
+			(unsigned)(state >> 40) & 0xffff);
+	}
+}
+
+void setUp(void)
+{
+	pool = thread_pool_create(4);
+	make_big();
+}
+
+void tearDown(void)
+{
+	thread_pool_destroy(pool);
+	free(big);
+}
+
+void test_csv_fields(void)
+{
+	const char *text = "a,\"b,\"\"c\"\"\n\",d\r\n\n,,\r\n\"\",e,";
+	struct csv_table table;
+	char buf[16];
+
+	TEST_ASSERT_EQUAL_INT(0, csv_parse(&table, text, strlen(text), ',',
+					   NULL));
+	TEST_ASSERT_EQUAL_size_t(3, table.rows);
+	TEST_ASSERT_EQUAL_size_t(3, table.columns);
+	TEST_ASSERT_TRUE(str_view_eq_cstr(csv_cell(&table, 0, 0), "a"));
+	TEST_ASSERT_TRUE(
+		str_view_eq_cstr(csv_cell(&table, 0, 1), "b,\"\"c\"\"\n"));
+	TEST_ASSERT_EQUAL_size_t(6, csv_unescape(csv_cell(&table, 0, 1), buf));
+	TEST_ASSERT_EQUAL_MEMORY("b,\"c\"\n", buf, 6);
+	TEST_ASSERT_TRUE(str_view_eq_cstr(csv_cell(&table, 0, 2), "d"));
+	TEST_ASSERT_TRUE(str_view_eq_cstr(csv_cell(&table, 1, 0), ""));
+	TEST_ASSERT_TRUE(str_view_eq_cstr(csv_cell(&table, 1, 2), ""));
+	TEST_ASSERT_TRUE(str_view_eq_cstr(csv_cell(&table, 2, 1), "e"));
+	TEST_ASSERT_TRUE(str_view_eq_cstr(csv_cell(&table, 2, 2), ""));
+	csv_destroy(&table);
+
+	TEST_ASSERT_EQUAL_INT(0, csv_parse(&table, "", 0, ',', NULL));
+	TEST_ASSERT_EQUAL_size_t(0, table.rows);
+	csv_destroy(&table);
+}
+
+void test_csv_errors(void)
+{
+	const char *bad[] = { "a,b\nc\n", "a,b\"c\n", "\"a\"b\n", "\"a\n" };
+	struct csv_table table;
+
+	for (size_t i = 0; i < ARRAY_LENGTH(bad); i++) {
+		TEST_ASSERT_EQUAL_INT(-1, csv_parse(&table, bad[i],
+						    strlen(bad[i]), ',', pool));
+		TEST_ASSERT_EQUAL_size_t(0, table.rows);
+	}
+}
+
+void test_csv_parallel_matches_serial(void)
+{
+	struct csv_table serial;
+	struct csv_table parallel;
+
+	TEST_ASSERT_EQUAL_INT(0, csv_parse(&serial, big, big_len, ',', NULL));
+	TEST_ASSERT_EQUAL_INT(0, csv_parse(&parallel, big, big_len, ',', pool));
+	TEST_ASSERT_EQUAL_size_t(BIG_ROWS, serial.rows);
+	TEST_ASSERT_EQUAL_size_t(3, serial.columns);
+	TEST_ASSERT_EQUAL_size_t(serial.rows, parallel.rows);
+	TEST_ASSERT_EQUAL_MEMORY(serial.cells, parallel.cells,
+				 serial.rows * serial.columns *
+					 sizeof(*serial.cells));
+	csv_destroy(&serial);
+	csv_destroy(&parallel);
+}
+
+void test_csv_columns(void)
+{
+	struct csv_table table;
+	i64 *ints = (i64 *)malloc_try(BIG_ROWS * sizeof(*ints));
+	double *doubles = (double *)malloc_try(BIG_ROWS * sizeof(*doubles));
+	const char *edges = "-9223372036854775808,9223372036854775807,-0\n";
+	i64 edge[1];
+
+	TEST_ASSERT_EQUAL_INT(0, csv_parse(&table, big, big_len, ',', pool));
+	TEST_ASSERT_EQUAL_INT(0, csv_column_i64(&table, 0, ints, pool));
+	TEST_ASSERT_EQUAL_INT(0, csv_column_f64(&table, 1, doubles, pool));
+
+	for (size_t i = 0; i < BIG_ROWS; i++) {
+		TEST_ASSERT_EQUAL_INT64((i64)i, ints[i]);
+		TEST_ASSERT_TRUE(doubles[i] >= -8.5 && doubles[i] <= 7.5);
+	}
+
+	TEST_ASSERT_EQUAL_INT(-1, csv_column_i64(&table, 1, ints, pool));
+	TEST_ASSERT_EQUAL_INT(-1, csv_column_f64(&table, 2, doubles, pool));
+	csv_destroy(&table);
+
+	TEST_ASSERT_EQUAL_INT(0, csv_parse(&table, edges, strlen(edges), ',',
+					   NULL));
+	TEST_ASSERT_EQUAL_INT(0, csv_column_i64(&table, 0, edge, NULL));
+	TEST_ASSERT_EQUAL_INT64(INT64_MIN, edge[0]);
+	TEST_ASSERT_EQUAL_INT(0, csv_column_i64(&table, 1, edge, NULL));
+	TEST_ASSERT_EQUAL_INT64(INT64_MAX, edge[0]);
+	TEST_ASSERT_EQUAL_INT(0, csv_column_i64(&table, 2, edge, NULL));
+	TEST_ASSERT_EQUAL_INT64(0, edge[0]);
+	csv_destroy(&table);
+	free(ints);
+	free(doubles);
+}
+
+struct digest {
+	size_t rows;
+	u64 hash;
+};
+
+static void digest_table(const struct csv_table *table, struct digest *d)
+{
+	for (size_t row = 0; row < table->rows; row++) {
+		for (size_t col = 0; col < table->columns; col++) {
+			struct str_view cell = csv_cell(table, row, col);
+
+			d->hash = fast_hash_64(cell.data, cell.len, d->hash);
+		}
+	}
+
+	d->rows += table->rows;
+}
+
+static int digest_batch(const struct csv_table *batch, void *ctx)
+{
+	digest_table(batch, (struct digest *)ctx);
+	return 0;
+}
+
+static int stop_after_two(const struct csv_table *batch, void *ctx)
+{
+	(void)batch;
+	return ++*(int *)ctx == 2 ? 5 : 0;
+}
+
+void test_csv_file(void)
+{
+	char path[] = "/tmp/test_csv_XXXXXX";
+	int fd = mkstemp(path);
+	struct csv_table table;
+	struct digest whole = { 0, 0 };
+	struct digest streamed = { 0, 0 };
+	int calls = 0;
+
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+	/* Without the last newline */
+	TEST_ASSERT_EQUAL_INT((long)big_len - 2,
+			      (long)write(fd, big, big_len - 2));
+	(void)close(fd);
+
+	TEST_ASSERT_EQUAL_INT(0, csv_parse(&table, big, big_len - 2, ',',
+					   NULL));
+	digest_table(&table, &whole);
+	csv_destroy(&table);
+
+	TEST_ASSERT_EQUAL_INT(0, csv_file(path, ',', 4096, pool, digest_batch,
+					  &streamed));
+	TEST_ASSERT_EQUAL_size_t(BIG_ROWS, streamed.rows);
+	TEST_ASSERT_EQUAL_HEX64(whole.hash, streamed.hash);
+
+	TEST_ASSERT_EQUAL_INT(5, csv_file(path, ',', 4096, pool, stop_after_two,
+					  &calls));
+	TEST_ASSERT_EQUAL_INT(2, calls);
+	/* No window holds a whole row */
+	TEST_ASSERT_EQUAL_INT(-1, csv_file(path, ',', 8, pool, digest_batch,
+					   &streamed));
+
+	(void)remove(path);
+	TEST_ASSERT_EQUAL_INT(-1, csv_file(path, ',', 4096, pool, digest_batch,
+					   &streamed));
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_csv_fields);
+	RUN_TEST(test_csv_errors);
+	RUN_TEST(test_csv_parallel_matches_serial);
+	RUN_TEST(test_csv_columns);
+	RUN_TEST(test_csv_file);
+
+	return UNITY_END();
+}
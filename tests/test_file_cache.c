@@ -0,0 +1,199 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#include <sys/stat.h>
+
+#define THREADS 4
+#define LOOKUPS 2000
+
+static char dir[] = "/tmp/test_file_cache_XXXXXX";
+static char paths[4][256];
+
+static void write_file(const char *path, const char *contents, size_t len)
+{
+	FILE *file = fopen(path, "wb");
+
+	TEST_ASSERT_NOT_NULL(file);
+	TEST_ASSERT_EQUAL_size_t(len, fwrite(contents, 1, len, file));
+	TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+void setUp(void)
+{
+	strcpy(dir, "/tmp/test_file_cache_XXXXXX");
+	TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+
+	for (size_t i = 0; i < ARRAY_LENGTH(paths); i++) {
+		char contents[32];
+		int len = snprintf(contents, sizeof(contents), "file %zu", i);
+
+		(void)snprintf(paths[i], sizeof(paths[i]), "%s/%zu.txt", dir, i);
+		write_file(paths[i], contents, (size_t)len);
+	}
+}
+
+void tearDown(void)
+{
+	for (size_t i = 0; i < ARRAY_LENGTH(paths); i++) {
+		(void)remove(paths[i]);
+	}
+
+	(void)remove(dir);
+}
+
+void test_file_cache_hit(void)
+{
+	struct file_cache *cache = file_cache_create(1 << 20, 0);
+	const struct cached_file *first = file_cache_get(cache, paths[0]);
+	const struct cached_file *second = NULL;
+
+	TEST_ASSERT_NOT_NULL(first);
+	TEST_ASSERT_EQUAL_size_t(6, first->size);
+	TEST_ASSERT_EQUAL_STRING("file 0", first->data);
+	file_cache_release(cache, first);
+
+	second = file_cache_get(cache, paths[0]);
+	TEST_ASSERT_EQUAL_PTR(first, second);
+	TEST_ASSERT_EQUAL_PTR(first->data, second->data);
+	file_cache_release(cache, second);
+
+	TEST_ASSERT_NULL(file_cache_get(cache, "/nonexistent/file"));
+	TEST_ASSERT_NULL(file_cache_get(cache, dir));
+	file_cache_destroy(cache);
+}
+
+void test_file_cache_revalidate(void)
+{
+	struct file_cache *cache = file_cache_create(1 << 20, 0);
+	const struct cached_file *old = file_cache_get(cache, paths[1]);
+	const struct cached_file *changed = NULL;
+
+	/* A held file keeps its contents after a change */
+	write_file(paths[1], "changed contents", 16);
+	changed = file_cache_get(cache, paths[1]);
+	TEST_ASSERT_EQUAL_STRING("changed contents", changed->data);
+	TEST_ASSERT_EQUAL_STRING("file 1", old->data);
+	file_cache_release(cache, old);
+	file_cache_release(cache, changed);
+
+	/* Within `check_ns` of the last check, no stat is made */
+	file_cache_destroy(cache);
+	cache = file_cache_create(1 << 20, 60000000000ULL);
+	old = file_cache_get(cache, paths[2]);
+	file_cache_release(cache, old);
+	write_file(paths[2], "unseen", 6);
+	changed = file_cache_get(cache, paths[2]);
+	TEST_ASSERT_EQUAL_STRING("file 2", changed->data);
+	file_cache_release(cache, changed);
+	file_cache_destroy(cache);
+}
+
+void test_file_cache_mapped(void)
+{
+	static char big[200000];
+	struct file_cache *cache = file_cache_create(1 << 20, 0);
+	const struct cached_file *file = NULL;
+
+	for (size_t i = 0; i < sizeof(big); i++) {
+		big[i] = (char)('a' + i % 26);
+	}
+
+	write_file(paths[3], big, sizeof(big));
+	file = file_cache_get(cache, paths[3]);
+	TEST_ASSERT_NOT_NULL(file);
+	TEST_ASSERT_EQUAL_size_t(sizeof(big), file->size);
+	TEST_ASSERT_EQUAL_MEMORY(big, file->data, sizeof(big));
+	file_cache_release(cache, file);
+	file_cache_destroy(cache);
+}
+
+void test_file_cache_evicts_lru(void)
+{
+	/* Room for two of the six-byte files */
+	struct file_cache *cache = file_cache_create(12, 0);
+	const struct cached_file *files[3];
+	const struct cached_file *held = NULL;
+
+	for (size_t i = 0; i < 3; i++) {
+		files[i] = file_cache_get(cache, paths[i]);
+		file_cache_release(cache, files[i]);
+
+		/* Keeps the first file the most recent */
+		file_cache_release(cache, file_cache_get(cache, paths[0]));
+	}
+
+	/* The second file was the least recently used */
+	TEST_ASSERT_EQUAL_PTR(files[0], file_cache_get(cache, paths[0]));
+	TEST_ASSERT_EQUAL_PTR(files[2], file_cache_get(cache, paths[2]));
+	file_cache_release(cache, files[0]);
+	file_cache_release(cache, files[2]);
+
+	/* An evicted file stays valid while held */
+	held = file_cache_get(cache, paths[1]);
+	file_cache_release(cache, file_cache_get(cache, paths[3]));
+	file_cache_release(cache, file_cache_get(cache, paths[0]));
+	TEST_ASSERT_EQUAL_STRING("file 1", held->data);
+	file_cache_release(cache, held);
+	file_cache_destroy(cache);
+}
+
+static struct file_cache *shared;
+
+static void *reader(void *arg)
+{
+	size_t seed = (size_t)(uintptr_t)arg;
+
+	for (size_t i = 0; i < LOOKUPS; i++) {
+		size_t which = (seed + i * 7) % 3;
+		const struct cached_file *file =
+			file_cache_get(shared, paths[which]);
+		char expected[32];
+
+		(void)snprintf(expected, sizeof(expected), "file %zu", which);
+
+		if (file == NULL || strcmp(file->data, expected) != 0) {
+			return arg;
+		}
+
+		file_cache_release(shared, file);
+	}
+
+	return NULL;
+}
+
+void test_file_cache_threads(void)
+{
+	pthread_t threads[THREADS];
+
+	/* A budget of two files out of three keeps evicting */
+	shared = file_cache_create(12, 0);
+
+	for (size_t i = 0; i < THREADS; i++) {
+		TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL,
+							reader,
+							(void *)(uintptr_t)(i + 1)));
+	}
+
+	for (size_t i = 0; i < THREADS; i++) {
+		void *failed = NULL;
+
+		TEST_ASSERT_EQUAL_INT(0, pthread_join(threads[i], &failed));
+		TEST_ASSERT_NULL(failed);
+	}
+
+	file_cache_destroy(shared);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_file_cache_hit);
+	RUN_TEST(test_file_cache_revalidate);
+	RUN_TEST(test_file_cache_mapped);
+	RUN_TEST(test_file_cache_evicts_lru);
+	RUN_TEST(test_file_cache_threads);
+
+	return UNITY_END();
+}
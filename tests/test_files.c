@@ -0,0 +1,189 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#include <sys/stat.h>
+
+static char dir[] = "/tmp/test_files_XXXXXX";
+
+static void write_file(const char *name, const char *contents)
+{
+	char path[256];
+	FILE *file = NULL;
+
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, name);
+	file = fopen(path, "wb");
+	TEST_ASSERT_NOT_NULL(file);
+	(void)fputs(contents, file);
+	(void)fclose(file);
+}
+
+static void remove_file(const char *name)
+{
+	char path[256];
+
+	(void)snprintf(path, sizeof(path), "%s/%s", dir, name);
+	(void)remove(path);
+}
+
+void setUp(void)
+{
+	char path[256];
+
+	strcpy(dir, "/tmp/test_files_XXXXXX");
+	TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+	(void)snprintf(path, sizeof(path), "%s/sub", dir);
+	TEST_ASSERT_EQUAL_INT(0, mkdir(path, 0700));
+	write_file("a.txt", "hello");
+	write_file("empty", "");
+	write_file("sub/b.txt", "world!");
+}
+
+void tearDown(void)
+{
+	char path[256];
+
+	remove_file("a.txt");
+	remove_file("empty");
+	remove_file("sub/b.txt");
+	(void)snprintf(path, sizeof(path), "%s/sub", dir);
+	(void)remove(path);
+	(void)remove(dir);
+}
+
+void test_load_file(void)
+{
+	char path[256];
+	char buf[16];
+
+	(void)snprintf(path, sizeof(path), "%s/a.txt", dir);
+	TEST_ASSERT_EQUAL_INT(6, load_file(path, NULL));
+	TEST_ASSERT_EQUAL_INT(6, load_file(path, buf));
+	TEST_ASSERT_EQUAL_STRING("hello", buf);
+}
+
+void test_map_file(void)
+{
+	struct mapped_file map;
+	char path[256];
+
+	(void)snprintf(path, sizeof(path), "%s/sub/b.txt", dir);
+	TEST_ASSERT_EQUAL_INT(0, map_file(path, &map));
+	TEST_ASSERT_EQUAL_size_t(6, map.size);
+	TEST_ASSERT_EQUAL_MEMORY("world!", map.data, 6);
+	unmap_file(&map);
+	TEST_ASSERT_NULL(map.data);
+
+	(void)snprintf(path, sizeof(path), "%s/empty", dir);
+	TEST_ASSERT_EQUAL_INT(0, map_file(path, &map));
+	TEST_ASSERT_EQUAL_size_t(0, map.size);
+	TEST_ASSERT_NOT_NULL(map.data);
+	unmap_file(&map);
+
+	(void)snprintf(path, sizeof(path), "%s/missing", dir);
+	TEST_ASSERT_EQUAL_INT(-1, map_file(path, &map));
+	TEST_ASSERT_EQUAL_INT(-1, map_file(dir, &map));
+}
+
+struct listing {
+	int count;
+	u64 bytes;
+	int saw_b;
+};
+
+static int list_file(const char *path, u64 size, void *ctx)
+{
+	struct listing *l = (struct listing *)ctx;
+	char expected[256];
+
+	(void)snprintf(expected, sizeof(expected), "%s/sub/b.txt", dir);
+	l->saw_b |= strcmp(path, expected) == 0;
+	l->count++;
+	l->bytes += size;
+
+	return 0;
+}
+
+static int stop_walk(const char *path, u64 size, void *ctx)
+{
+	(void)path;
+	(void)size;
+	(*(int *)ctx)++;
+
+	return 7;
+}
+
+void test_walk_dir(void)
+{
+	struct listing l = { 0, 0, 0 };
+	char path[256];
+	int calls = 0;
+
+	TEST_ASSERT_EQUAL_INT(0, walk_dir(dir, list_file, &l));
+	TEST_ASSERT_EQUAL_INT(3, l.count);
+	TEST_ASSERT_EQUAL_UINT64(11, l.bytes);
+	TEST_ASSERT_TRUE(l.saw_b);
+
+	/* Trailing slashes do not end up in the paths */
+	(void)snprintf(path, sizeof(path), "%s//", dir);
+	memset(&l, 0, sizeof(l));
+	TEST_ASSERT_EQUAL_INT(0, walk_dir(path, list_file, &l));
+	TEST_ASSERT_TRUE(l.saw_b);
+
+	TEST_ASSERT_EQUAL_INT(7, walk_dir(dir, stop_walk, &calls));
+	TEST_ASSERT_EQUAL_INT(1, calls);
+
+	(void)snprintf(path, sizeof(path), "%s/missing", dir);
+	TEST_ASSERT_EQUAL_INT(-1, walk_dir(path, list_file, &l));
+}
+
+static int first_file(const char *path, u64 size, void *ctx)
+{
+	(void)size;
+	(void)snprintf((char *)ctx, 256, "%s", path);
+
+	return 1;
+}
+
+void test_walk_dir_root(void)
+{
+	char first[256] = "";
+
+	/* No doubled slash after the root directory */
+	TEST_ASSERT_EQUAL_INT(1, walk_dir("/", first_file, first));
+	TEST_ASSERT_EQUAL_CHAR('/', first[0]);
+	TEST_ASSERT_NOT_EQUAL('/', first[1]);
+}
+
+void test_walk_dir_unreadable(void)
+{
+	struct listing l = { 0, 0, 0 };
+	char path[256];
+	int ret = 0;
+
+	if (geteuid() == 0) {
+		TEST_IGNORE_MESSAGE("root can read any directory");
+	}
+
+	/* The walk goes on past the unreadable directory but fails */
+	(void)snprintf(path, sizeof(path), "%s/sub", dir);
+	TEST_ASSERT_EQUAL_INT(0, chmod(path, 0));
+	ret = walk_dir(dir, list_file, &l);
+	TEST_ASSERT_EQUAL_INT(0, chmod(path, 0700));
+	TEST_ASSERT_EQUAL_INT(-1, ret);
+	TEST_ASSERT_EQUAL_INT(2, l.count);
+	TEST_ASSERT_FALSE(l.saw_b);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_load_file);
+	RUN_TEST(test_map_file);
+	RUN_TEST(test_walk_dir);
+	RUN_TEST(test_walk_dir_root);
+	RUN_TEST(test_walk_dir_unreadable);
+
+	return UNITY_END();
+}
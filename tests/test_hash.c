@@ -0,0 +1,111 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_fnv1a_known_values(void)
+{
+	TEST_ASSERT_EQUAL_HEX32(0x811c9dc5U, fnv1a_32_str(""));
+	TEST_ASSERT_EQUAL_HEX32(0xbf9cf968U, fnv1a_32_str("foobar"));
+	TEST_ASSERT_EQUAL_HEX32(0xbf9cf968U, fnv1a_32_buf("foobar", 6));
+	TEST_ASSERT_EQUAL_HEX64(0x85944171f73967e8ULL, fnv1a_64_str("foobar"));
+	TEST_ASSERT_EQUAL_HEX64(0x85944171f73967e8ULL,
+				fnv1a_64_buf("foobar", 6));
+}
+
+void test_crc32c_known_values(void)
+{
+	unsigned char zeros[32] = { 0 };
+	unsigned char ones[32];
+	unsigned char bytes[256];
+
+	memset(ones, 0xff, sizeof(ones));
+
+	for (size_t i = 0; i < sizeof(bytes); i++) {
+		bytes[i] = (unsigned char)i;
+	}
+
+	TEST_ASSERT_EQUAL_HEX32(0, crc32c_buf("", 0));
+	TEST_ASSERT_EQUAL_HEX32(0xe3069283U, crc32c_buf("123456789", 9));
+	TEST_ASSERT_EQUAL_HEX32(0x8a9136aaU, crc32c_buf(zeros, sizeof(zeros)));
+	TEST_ASSERT_EQUAL_HEX32(0x62a8ab43U, crc32c_buf(ones, sizeof(ones)));
+	TEST_ASSERT_EQUAL_HEX32(0x9c44184bU, crc32c_buf(bytes, sizeof(bytes)));
+}
+
+void test_crc32c_update_in_pieces(void)
+{
+	unsigned char bytes[256];
+	u32 whole = 0;
+
+	for (size_t i = 0; i < sizeof(bytes); i++) {
+		bytes[i] = (unsigned char)(i * 7);
+	}
+
+	whole = crc32c_buf(bytes, sizeof(bytes));
+
+	for (size_t split = 0; split <= sizeof(bytes); split += 13) {
+		u32 crc = crc32c_update(0, bytes, split);
+
+		crc = crc32c_update(crc, bytes + split, sizeof(bytes) - split);
+		TEST_ASSERT_EQUAL_HEX32(whole, crc);
+	}
+}
+
+void test_fast_hash_known_values(void)
+{
+	unsigned char bytes[256];
+
+	for (size_t i = 0; i < sizeof(bytes); i++) {
+		bytes[i] = (unsigned char)i;
+	}
+
+	/* Pinned so digests stay stable across releases and platforms */
+	TEST_ASSERT_EQUAL_HEX64(0x93228a4de0eec5a2ULL, fast_hash_64("", 0, 0));
+	TEST_ASSERT_EQUAL_HEX64(0xe7f8b1dc82171923ULL,
+				fast_hash_64("hello world", 11, 0));
+	TEST_ASSERT_EQUAL_HEX64(0xf9a18ee9194a4507ULL,
+				fast_hash_64(bytes, sizeof(bytes), 42));
+}
+
+void test_fast_hash_every_byte_matters(void)
+{
+	unsigned char bytes[100];
+
+	for (size_t i = 0; i < sizeof(bytes); i++) {
+		bytes[i] = (unsigned char)(i * 31);
+	}
+
+	/* Every length takes a different path through the tail handling */
+	for (size_t len = 1; len <= sizeof(bytes); len++) {
+		u64 h = fast_hash_64(bytes, len, 0);
+
+		TEST_ASSERT(h != fast_hash_64(bytes, len - 1, 0));
+		TEST_ASSERT(h != fast_hash_64(bytes, len, 1));
+
+		for (size_t i = 0; i < len; i++) {
+			bytes[i] ^= 0x10;
+			TEST_ASSERT(h != fast_hash_64(bytes, len, 0));
+			bytes[i] ^= 0x10;
+		}
+	}
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_fnv1a_known_values);
+	RUN_TEST(test_crc32c_known_values);
+	RUN_TEST(test_crc32c_update_in_pieces);
+	RUN_TEST(test_fast_hash_known_values);
+	RUN_TEST(test_fast_hash_every_byte_matters);
+
+	return UNITY_END();
+}
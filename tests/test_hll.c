@@ -0,0 +1,126 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void add_range(struct hll *hll, u64 begin, u64 end)
+{
+	for (u64 i = begin; i < end; i++) {
+		hll_add(hll, &i, sizeof(i));
+	}
+}
+
+static void assert_close(u64 expected, u64 actual, double error)
+{
+	double delta = (double)actual - (double)expected;
+
+	if (delta < 0) {
+		delta = -delta;
+	}
+
+	TEST_ASSERT_TRUE_MESSAGE(delta <= error * (double)expected + 1.0,
+				 "estimate too far off");
+}
+
+void test_hll_empty_and_small(void)
+{
+	struct hll *hll = hll_create(0);
+
+	TEST_ASSERT_EQUAL_UINT(14, hll_precision(hll));
+	TEST_ASSERT_EQUAL_UINT64(0, hll_count(hll));
+
+	/* Duplicates do not count */
+	for (int round = 0; round < 3; round++) {
+		add_range(hll, 0, 10);
+	}
+
+	TEST_ASSERT_EQUAL_UINT64(10, hll_count(hll));
+	add_range(hll, 10, 1000);
+	assert_close(1000, hll_count(hll), 0.01);
+	hll_destroy(hll);
+}
+
+void test_hll_accuracy(void)
+{
+	struct hll *hll = hll_create(14);
+	u64 checkpoints[] = { 5000, 50000, 500000, 2000000 };
+	u64 added = 0;
+
+	/* Three standard errors */
+	for (size_t i = 0; i < ARRAY_LENGTH(checkpoints); i++) {
+		add_range(hll, added, checkpoints[i]);
+		added = checkpoints[i];
+		assert_close(added, hll_count(hll), 3 * 0.0081);
+	}
+
+	hll_destroy(hll);
+}
+
+void test_hll_low_precision(void)
+{
+	struct hll *hll = hll_create(1);
+
+	TEST_ASSERT_EQUAL_UINT(4, hll_precision(hll));
+	add_range(hll, 0, 100000);
+	assert_close(100000, hll_count(hll), 3 * 0.26);
+	hll_destroy(hll);
+}
+
+void test_hll_merge(void)
+{
+	struct hll *all = hll_create(12);
+	struct hll *dense = hll_create(12);
+	struct hll *sparse = hll_create(12);
+	struct hll *other = hll_create(10);
+
+	add_range(all, 0, 100100);
+	add_range(dense, 0, 100000);
+	add_range(sparse, 100000, 100100);
+
+	/* Sparse into dense, then dense into sparse */
+	TEST_ASSERT_EQUAL_INT(0, hll_merge(dense, sparse));
+	TEST_ASSERT_EQUAL_UINT64(hll_count(all), hll_count(dense));
+	TEST_ASSERT_EQUAL_INT(0, hll_merge(sparse, dense));
+	TEST_ASSERT_EQUAL_UINT64(hll_count(all), hll_count(sparse));
+	TEST_ASSERT_EQUAL_INT(-1, hll_merge(dense, other));
+
+	hll_destroy(other);
+	hll_destroy(sparse);
+	hll_destroy(dense);
+	hll_destroy(all);
+}
+
+void test_hll_hashes(void)
+{
+	struct hll *a = hll_create(14);
+	struct hll *b = hll_create(14);
+
+	for (u64 i = 0; i < 20000; i++) {
+		hll_add(a, &i, sizeof(i));
+		hll_add_hash(b, fast_hash_64(&i, sizeof(i), 0));
+	}
+
+	TEST_ASSERT_EQUAL_UINT64(hll_count(a), hll_count(b));
+	hll_destroy(b);
+	hll_destroy(a);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_hll_empty_and_small);
+	RUN_TEST(test_hll_accuracy);
+	RUN_TEST(test_hll_low_precision);
+	RUN_TEST(test_hll_merge);
+	RUN_TEST(test_hll_hashes);
+
+	return UNITY_END();
+}
@@ -0,0 +1,176 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define STRINGS 2000
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static int text_is(const struct json_doc *doc, size_t node, const char *str)
+{
+	return str_view_eq_cstr(json_text(doc, node), str);
+}
+
+void test_json_dom(void)
+{
+	const char *text = " {\"a\": [1, -2.5e3, true, false, null, {}, []],\n"
+			   "\t\"b\\\"c\": \"d\\\\\", \"e\": {\"f\": \"\"}} ";
+	struct json_doc doc;
+	size_t a = 0;
+	size_t e = 0;
+	i64 i = 0;
+	double f = 0;
+
+	TEST_ASSERT_EQUAL_INT(0, json_parse(&doc, text, strlen(text)));
+	TEST_ASSERT_EQUAL_UINT32(JSON_OBJECT, doc.nodes[0].type);
+	TEST_ASSERT_EQUAL_UINT32(3, doc.nodes[0].count);
+	TEST_ASSERT_EQUAL_UINT32(doc.count, doc.nodes[0].next);
+	TEST_ASSERT_EQUAL_UINT32(strlen(text) - 2, doc.nodes[0].len);
+
+	a = json_find(&doc, 0, "a");
+	TEST_ASSERT_EQUAL_UINT32(JSON_ARRAY, doc.nodes[a].type);
+	TEST_ASSERT_EQUAL_UINT32(7, doc.nodes[a].count);
+	TEST_ASSERT_EQUAL_INT(0, json_i64(&doc, json_at(&doc, a, 0), &i));
+	TEST_ASSERT_EQUAL_INT64(1, i);
+	TEST_ASSERT_EQUAL_INT(0, json_f64(&doc, json_at(&doc, a, 1), &f));
+	TEST_ASSERT_TRUE(f == -2500.0);
+	TEST_ASSERT_EQUAL_INT(-1, json_i64(&doc, json_at(&doc, a, 1), &i));
+	TEST_ASSERT_EQUAL_UINT32(JSON_TRUE, doc.nodes[json_at(&doc, a, 2)].type);
+	TEST_ASSERT_EQUAL_UINT32(JSON_FALSE,
+				 doc.nodes[json_at(&doc, a, 3)].type);
+	TEST_ASSERT_EQUAL_UINT32(JSON_NULL, doc.nodes[json_at(&doc, a, 4)].type);
+	TEST_ASSERT_EQUAL_UINT32(JSON_OBJECT,
+				 doc.nodes[json_at(&doc, a, 5)].type);
+	TEST_ASSERT_TRUE(text_is(&doc, json_at(&doc, a, 6), "[]"));
+	TEST_ASSERT_EQUAL_size_t(JSON_NONE, json_at(&doc, a, 7));
+
+	TEST_ASSERT_TRUE(text_is(&doc, json_find(&doc, 0, "b\\\"c"), "d\\\\"));
+	e = json_find(&doc, 0, "e");
+	TEST_ASSERT_TRUE(text_is(&doc, json_find(&doc, e, "f"), ""));
+	TEST_ASSERT_EQUAL_size_t(JSON_NONE, json_find(&doc, 0, "f"));
+	TEST_ASSERT_EQUAL_size_t(JSON_NONE, json_find(&doc, a, "a"));
+	json_destroy(&doc);
+
+	TEST_ASSERT_EQUAL_INT(0, json_parse(&doc, "-0", 2));
+	TEST_ASSERT_EQUAL_UINT32(JSON_NUMBER, doc.nodes[0].type);
+	json_destroy(&doc);
+}
+
+void test_json_invalid(void)
+{
+	const char *bad[] = { "",	   " ",		 "{",	     "[1,]",
+			      "[1 2]",	   "{\"a\" 1}",	 "{\"a\":}", "{1:2}",
+			      "[}",	   "{]",	 "\"abc",    "\"a\\\"",
+			      "tru",	   "nul",	 "01",	     "1.",
+			      "-",	   "1e",	 "[1]]",     "[1] 2",
+			      "{\"a\":1,}", "{} {}",	 "[\"a\"1]", "\\" };
+	struct json_doc doc;
+
+	for (size_t i = 0; i < ARRAY_LENGTH(bad); i++) {
+		TEST_ASSERT_EQUAL_INT_MESSAGE(
+			-1, json_parse(&doc, bad[i], strlen(bad[i])), bad[i]);
+		TEST_ASSERT_NULL(doc.nodes);
+	}
+}
+
+void test_json_unescape(void)
+{
+	const char *bad[] = { "\\", "\\x", "\\u12", "\\ud800", "\\udc00",
+			      "\\ud800\\u0041", "\t" };
+	char out[32];
+
+	TEST_ASSERT_EQUAL_size_t(
+		11, json_unescape(str_view_cstr("a\\n\\u00e9\\u20ac\\ud83d\\ude00"),
+				  out));
+	TEST_ASSERT_EQUAL_MEMORY("a\n\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", out,
+				 11);
+	TEST_ASSERT_EQUAL_size_t(
+		4, json_unescape(str_view_cstr("\\\"\\/\\\\\\t"), out));
+	TEST_ASSERT_EQUAL_MEMORY("\"/\\\t", out, 4);
+
+	for (size_t i = 0; i < ARRAY_LENGTH(bad); i++) {
+		TEST_ASSERT_EQUAL_size_t(JSON_NONE,
+					 json_unescape(str_view_cstr(bad[i]),
+						       out));
+	}
+}
+
+/* Strings of quotes and backslash runs of every length, escaped, so that runs
+ * cross the 64-byte blocks of the structural index at every offset */
+void test_json_escapes_across_blocks(void)
+{
+	static char raw[STRINGS][24];
+	size_t cap = STRINGS * 64;
+	char *text = (char *)malloc_try(cap);
+	char out[24];
+	struct json_doc doc;
+	size_t len = 0;
+	size_t node = 1;
+	u64 state = 5;
+
+	text[len++] = '[';
+
+	for (size_t i = 0; i < STRINGS; i++) {
+		size_t n = 0;
+
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+
+		for (n = 0; n < (state >> 60) + 1; n++) {
+			unsigned pick = (unsigned)(state >> (n * 2 % 56)) & 3;
+
+			raw[i][n] = pick == 0 ? '"' : pick == 1 ? 'x' : '\\';
+		}
+
+		raw[i][n] = '\0';
+		text[len++] = '"';
+
+		for (size_t j = 0; j < n; j++) {
+			if (raw[i][j] == '"' || raw[i][j] == '\\') {
+				text[len++] = '\\';
+			}
+
+			text[len++] = raw[i][j];
+		}
+
+		len += (size_t)snprintf(text + len, cap - len, "\",%*s",
+					(int)(state >> 61), "");
+	}
+
+	/* Replace the last comma */
+	while (text[len - 1] != ',') {
+		len--;
+	}
+
+	text[len - 1] = ']';
+	TEST_ASSERT_EQUAL_INT(0, json_parse(&doc, text, len));
+	TEST_ASSERT_EQUAL_UINT32(STRINGS, doc.nodes[0].count);
+
+	for (size_t i = 0; i < STRINGS; i++) {
+		size_t n = json_unescape(json_text(&doc, node), out);
+
+		TEST_ASSERT_EQUAL_size_t(strlen(raw[i]), n);
+		TEST_ASSERT_EQUAL_MEMORY(raw[i], out, n);
+		node = doc.nodes[node].next;
+	}
+
+	json_destroy(&doc);
+	free(text);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_json_dom);
+	RUN_TEST(test_json_invalid);
+	RUN_TEST(test_json_unescape);
+	RUN_TEST(test_json_escapes_across_blocks);
+
+	return UNITY_END();
+}
@@ -0,0 +1,109 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+/* Generated from keywords.txt by add_perfect_hash */
+#include "keywords.h"
+
+#define KEYS 100000
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static void assert_minimal_perfect(const struct mphf *mphf,
+				   const char *const *keys, const size_t *lens,
+				   size_t count)
+{
+	unsigned char *seen = (unsigned char *)calloc_try(count, 1);
+
+	for (size_t i = 0; i < count; i++) {
+		size_t len = lens != NULL ? lens[i] : strlen(keys[i]);
+		size_t slot = mphf_index(mphf, keys[i], len);
+
+		TEST_ASSERT_LESS_THAN_size_t(count, slot);
+		TEST_ASSERT_EQUAL_UINT8(0, seen[slot]);
+		seen[slot] = 1;
+	}
+
+	free(seen);
+}
+
+void test_mphf_large_set(void)
+{
+	static char text[KEYS][16];
+	static const char *keys[KEYS];
+	static size_t lens[KEYS];
+	struct mphf mphf;
+
+	for (size_t i = 0; i < KEYS; i++) {
+		/* Binary keys, not null-terminated */
+		u64 key = i * 0x9e3779b97f4a7c15ULL;
+
+		memcpy(text[i], &key, sizeof(key));
+		keys[i] = text[i];
+		lens[i] = sizeof(key);
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, mphf_build(&mphf, keys, lens, KEYS));
+	TEST_ASSERT_EQUAL_size_t(KEYS, mphf.count);
+	TEST_ASSERT_LESS_THAN_size_t(KEYS + KEYS / 50, mphf.table_size);
+	assert_minimal_perfect(&mphf, keys, lens, KEYS);
+	mphf_destroy(&mphf);
+}
+
+void test_mphf_small_sets(void)
+{
+	const char *keys[] = { "a", "b", "c", "d", "e" };
+	struct mphf mphf;
+
+	for (size_t n = 0; n <= ARRAY_LENGTH(keys); n++) {
+		TEST_ASSERT_EQUAL_INT(0, mphf_build(&mphf, keys, NULL, n));
+		assert_minimal_perfect(&mphf, keys, NULL, n);
+		mphf_destroy(&mphf);
+	}
+}
+
+void test_mphf_repeated_keys(void)
+{
+	const char *keys[] = { "one", "two", "one" };
+	struct mphf mphf;
+
+	TEST_ASSERT_EQUAL_INT(-1, mphf_build(&mphf, keys, NULL, 3));
+}
+
+void test_mphf_generated_table(void)
+{
+	TEST_ASSERT_EQUAL_INT(0, keywords_lookup("auto", 4));
+	TEST_ASSERT_EQUAL_INT(4, keywords_lookup("const", 5));
+	TEST_ASSERT_EQUAL_INT(33, keywords_lookup("while", 5));
+	TEST_ASSERT_EQUAL_INT(36, keywords_lookup("_Imaginary", 10));
+	TEST_ASSERT_EQUAL_INT(3, keywords_lookup("character", 4));
+	TEST_ASSERT_EQUAL_INT(-1, keywords_lookup("character", 9));
+	TEST_ASSERT_EQUAL_INT(-1, keywords_lookup("whil", 4));
+	TEST_ASSERT_EQUAL_INT(-1, keywords_lookup("", 0));
+	TEST_ASSERT_EQUAL_size_t(37, keywords_mphf.count);
+
+	for (size_t i = 0; i < ARRAY_LENGTH(keywords_keys); i++) {
+		const char *key = keywords_keys[i];
+
+		TEST_ASSERT_EQUAL_INT((int)keywords_order[i],
+				      keywords_lookup(key, strlen(key)));
+	}
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_mphf_large_set);
+	RUN_TEST(test_mphf_small_sets);
+	RUN_TEST(test_mphf_repeated_keys);
+	RUN_TEST(test_mphf_generated_table);
+
+	return UNITY_END();
+}
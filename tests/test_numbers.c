@@ -0,0 +1,392 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#include <float.h>
+#include <math.h>
+
+#define RANDOM_VALUES 200000
+
+static u64 state = 88172645463325252ULL;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static u64 next_random(void)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+static double from_bits(u64 bits)
+{
+	double value = 0;
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static u64 to_bits(double value)
+{
+	u64 bits = 0;
+
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+/* Same bits as strtod, which glibc rounds correctly */
+static void assert_parses_like_libc(const char *text)
+{
+	double ours = 0;
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, parse_f64(str_view_cstr(text), &ours),
+				      text);
+	TEST_ASSERT_EQUAL_HEX64_MESSAGE(to_bits(strtod(text, NULL)),
+					to_bits(ours), text);
+}
+
+/* Significant digits of a number, without leading or trailing zeros */
+static size_t significant(const char *text, char *digits)
+{
+	size_t len = 0;
+
+	for (; *text != '\0' && *text != 'e'; text++) {
+		if (*text >= '0' && *text <= '9' && (len > 0 || *text != '0')) {
+			digits[len++] = *text;
+		}
+	}
+
+	while (len > 0 && digits[len - 1] == '0') {
+		len--;
+	}
+
+	return len;
+}
+
+/* Parses back to `value`, and has no more digits than the shortest printf
+ * precision that does, and the same digits when as many */
+static void assert_formats_shortest(double value)
+{
+	char out[FORMAT_NUMBER_MAX];
+	char libc[40];
+	char ours_digits[40];
+	char libc_digits[40];
+	size_t len = format_f64(value, out);
+	size_t ours = 0;
+	int precision = 1;
+	double back = 0;
+
+	TEST_ASSERT_EQUAL_size_t(strlen(out), len);
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, parse_f64(str_view_from(out, len), &back),
+				      out);
+	TEST_ASSERT_EQUAL_HEX64_MESSAGE(to_bits(value), to_bits(back), out);
+	TEST_ASSERT_EQUAL_HEX64_MESSAGE(to_bits(value),
+					to_bits(strtod(out, NULL)), out);
+
+	for (; precision < 17; precision++) {
+		(void)snprintf(libc, sizeof(libc), "%.*e", precision - 1, value);
+
+		if (strtod(libc, NULL) == value) {
+			break;
+		}
+	}
+
+	(void)snprintf(libc, sizeof(libc), "%.*e", precision - 1, value);
+	ours = significant(out, ours_digits);
+	TEST_ASSERT_TRUE_MESSAGE(ours <= (size_t)precision, out);
+
+	if (ours == (size_t)precision) {
+		TEST_ASSERT_EQUAL_size_t_MESSAGE(
+			ours, significant(libc, libc_digits), out);
+		TEST_ASSERT_EQUAL_MEMORY_MESSAGE(libc_digits, ours_digits, ours,
+						 out);
+	}
+}
+
+void test_integers_exhaustive_16_bits(void)
+{
+	char text[FORMAT_NUMBER_MAX];
+	char libc[32];
+
+	for (long value = -70000; value <= 70000; value++) {
+		int fits_i16 = value >= INT16_MIN && value <= INT16_MAX;
+		int fits_u16 = value >= 0 && value <= UINT16_MAX;
+		int fits_i8 = value >= INT8_MIN && value <= INT8_MAX;
+		int fits_u8 = value >= 0 && value <= UINT8_MAX;
+		struct str_view view;
+		i16 s16 = 0;
+		u16 u16v = 0;
+		i8 s8 = 0;
+		u8 u8v = 0;
+
+		(void)snprintf(libc, sizeof(libc), "%ld", value);
+		TEST_ASSERT_EQUAL_size_t(strlen(libc), format_i64(value, text));
+		TEST_ASSERT_EQUAL_STRING(libc, text);
+		view = str_view_cstr(text);
+
+		TEST_ASSERT_EQUAL_INT(fits_i16 ? 0 : -1, parse_i16(view, &s16));
+		TEST_ASSERT_EQUAL_INT(fits_u16 ? 0 : -1, parse_u16(view, &u16v));
+		TEST_ASSERT_EQUAL_INT(fits_i8 ? 0 : -1, parse_i8(view, &s8));
+		TEST_ASSERT_EQUAL_INT(fits_u8 ? 0 : -1, parse_u8(view, &u8v));
+		TEST_ASSERT_TRUE(!fits_i16 || s16 == value);
+		TEST_ASSERT_TRUE(!fits_u16 || u16v == value);
+		TEST_ASSERT_TRUE(!fits_i8 || s8 == value);
+		TEST_ASSERT_TRUE(!fits_u8 || u8v == value);
+	}
+}
+
+void test_integers_random(void)
+{
+	char text[FORMAT_NUMBER_MAX];
+	char libc[32];
+
+	for (size_t i = 0; i < RANDOM_VALUES; i++) {
+		/* Every length of number equally often */
+		u64 value = next_random() >> (next_random() % 64);
+		i64 signed_value = (i64)value;
+		u64 u = 0;
+		i64 s = 0;
+
+		(void)snprintf(libc, sizeof(libc), "%llu",
+			       (unsigned long long)value);
+		TEST_ASSERT_EQUAL_size_t(strlen(libc), format_u64(value, text));
+		TEST_ASSERT_EQUAL_STRING(libc, text);
+		TEST_ASSERT_EQUAL_INT(0, parse_u64(str_view_cstr(text), &u));
+		TEST_ASSERT_EQUAL_HEX64(value, u);
+
+		(void)snprintf(libc, sizeof(libc), "%lld", (long long)signed_value);
+		TEST_ASSERT_EQUAL_size_t(strlen(libc),
+					 format_i64(signed_value, text));
+		TEST_ASSERT_EQUAL_STRING(libc, text);
+		TEST_ASSERT_EQUAL_INT(0, parse_i64(str_view_cstr(text), &s));
+		TEST_ASSERT_EQUAL_INT64(signed_value, s);
+	}
+}
+
+void test_integers_limits(void)
+{
+	const char *bad_u64[] = { "",
+				  "+",
+				  "-1",
+				  " 1",
+				  "1 ",
+				  "1a",
+				  "0x10",
+				  "18446744073709551616",
+				  "99999999999999999999",
+				  "123456789012345678901" };
+	const char *bad_i64[] = { "-", "--1", "+-1", "9223372036854775808",
+				  "-9223372036854775809" };
+	u64 u = 0;
+	i64 s = 0;
+	u32 u32v = 0;
+	i32 s32 = 0;
+	char text[FORMAT_NUMBER_MAX];
+
+	for (size_t i = 0; i < ARRAY_LENGTH(bad_u64); i++) {
+		TEST_ASSERT_EQUAL_INT_MESSAGE(
+			-1, parse_u64(str_view_cstr(bad_u64[i]), &u), bad_u64[i]);
+	}
+
+	for (size_t i = 0; i < ARRAY_LENGTH(bad_i64); i++) {
+		TEST_ASSERT_EQUAL_INT_MESSAGE(
+			-1, parse_i64(str_view_cstr(bad_i64[i]), &s), bad_i64[i]);
+	}
+
+	TEST_ASSERT_EQUAL_INT(
+		0, parse_u64(str_view_cstr("18446744073709551615"), &u));
+	TEST_ASSERT_EQUAL_HEX64(UINT64_MAX, u);
+	TEST_ASSERT_EQUAL_INT(
+		0, parse_u64(str_view_cstr("+00000000000000000000000000042"), &u));
+	TEST_ASSERT_EQUAL_HEX64(42, u);
+	TEST_ASSERT_EQUAL_INT(
+		0, parse_i64(str_view_cstr("-9223372036854775808"), &s));
+	TEST_ASSERT_EQUAL_INT64(INT64_MIN, s);
+	TEST_ASSERT_EQUAL_INT(0, parse_u32(str_view_cstr("4294967295"), &u32v));
+	TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, u32v);
+	TEST_ASSERT_EQUAL_INT(-1, parse_u32(str_view_cstr("4294967296"), &u32v));
+	TEST_ASSERT_EQUAL_INT(0, parse_i32(str_view_cstr("-2147483648"), &s32));
+	TEST_ASSERT_EQUAL_INT32(INT32_MIN, s32);
+	TEST_ASSERT_EQUAL_INT(-1, parse_i32(str_view_cstr("2147483648"), &s32));
+
+	TEST_ASSERT_EQUAL_size_t(20, format_i64(INT64_MIN, text));
+	TEST_ASSERT_EQUAL_STRING("-9223372036854775808", text);
+	TEST_ASSERT_EQUAL_size_t(20, format_u64(UINT64_MAX, text));
+	TEST_ASSERT_EQUAL_STRING("18446744073709551615", text);
+}
+
+void test_parse_f64_random(void)
+{
+	char text[64];
+
+	for (size_t i = 0; i < RANDOM_VALUES; i++) {
+		size_t digits = 1 + next_random() % 25;
+		int exponent = (int)(next_random() % 700) - 350;
+		size_t len = 0;
+
+		if (next_random() & 1) {
+			text[len++] = '-';
+		}
+
+		for (size_t j = 0; j < digits; j++) {
+			text[len++] = (char)('0' + next_random() % 10);
+
+			if (j == 0 && (next_random() & 1)) {
+				text[len++] = '.';
+			}
+		}
+
+		(void)snprintf(text + len, sizeof(text) - len, "e%d", exponent);
+		assert_parses_like_libc(text);
+	}
+}
+
+/* Exact halfway points between neighboring doubles and numbers just off
+ * them, the inputs that need every digit to round */
+void test_parse_f64_halfway(void)
+{
+#if LDBL_MANT_DIG >= 64
+	static char text[1200];
+
+	for (size_t i = 0; i < RANDOM_VALUES / 20; i++) {
+		u64 bits = next_random() >> 1;
+		double value = from_bits(bits);
+		double next = from_bits(bits + 1);
+		long double half = 0;
+
+		if (isnan(value) || isnan(next) || isinf(next)) {
+			continue;
+		}
+
+		/* 54 bits, exact in a long double */
+		half = ((long double)value + (long double)next) / 2;
+		(void)snprintf(text, sizeof(text), "%.800Le", half);
+		assert_parses_like_libc(text);
+		(void)snprintf(text, sizeof(text), "%.*Le",
+			       (int)(16 + next_random() % 8), half);
+		assert_parses_like_libc(text);
+	}
+#else
+	TEST_IGNORE_MESSAGE("long double cannot hold halfway points");
+#endif
+}
+
+void test_parse_f64_edges(void)
+{
+	const char *good[] = { "0",
+			       "-0",
+			       "+1",
+			       ".5",
+			       "5.",
+			       "1.e5",
+			       "1E5",
+			       "0.1",
+			       "1e23",
+			       "9007199254740993",
+			       "4.9406564584124654e-324",
+			       "2.4703282292062327e-324",
+			       "2.4703282292062328e-324",
+			       "2.2250738585072011e-308",
+			       "2.2250738585072012e-308",
+			       "1.7976931348623157e308",
+			       "1.7976931348623158e308",
+			       "1.7976931348623159e308",
+			       "123456789012345678901234567890",
+			       "0.000000000000000000000000000000000000001",
+			       "00000000000000000000000000000001.5",
+			       "1e-99999999999",
+			       "1e99999999999",
+			       "inf",
+			       "-Infinity",
+			       "NaN" };
+	const char *bad[] = { "",   "-",  ".",	 "e5", "1e",  "1e+", "--1",
+			      "1 ", " 1", "1.2.3", "0x1p3", "infinit", "nan(1)" };
+	double value = 0;
+
+	for (size_t i = 0; i < ARRAY_LENGTH(good); i++) {
+		assert_parses_like_libc(good[i]);
+	}
+
+	for (size_t i = 0; i < ARRAY_LENGTH(bad); i++) {
+		TEST_ASSERT_EQUAL_INT_MESSAGE(
+			-1, parse_f64(str_view_cstr(bad[i]), &value), bad[i]);
+	}
+}
+
+void test_format_f64_random(void)
+{
+	for (size_t i = 0; i < RANDOM_VALUES / 4; i++) {
+		double value = from_bits(next_random());
+
+		if (!isnan(value)) {
+			assert_formats_shortest(value);
+		}
+	}
+
+	/* Subnormals, and the neighbors of every power of two */
+	for (u64 bits = 1; bits < 4096; bits++) {
+		assert_formats_shortest(from_bits(bits));
+		assert_formats_shortest(
+			from_bits(next_random() & ((1ULL << 52) - 1)));
+	}
+
+	for (u64 exponent = 1; exponent < 2047; exponent++) {
+		assert_formats_shortest(from_bits(exponent << 52));
+		assert_formats_shortest(from_bits((exponent << 52) + 1));
+		assert_formats_shortest(from_bits((exponent << 52) - 1));
+	}
+}
+
+void test_format_f64_notation(void)
+{
+	const double values[] = { 0.0,	  -0.0,	  1.0,	 100.0,	 0.1,	-123.456,
+				  1e20,	  1e21,	  1e-6,	 1e-7,	 1.5e300, 5e-324,
+				  DBL_MAX, 0.3,	  INFINITY, -INFINITY, NAN };
+	const char *expected[] = { "0",
+				   "-0",
+				   "1",
+				   "100",
+				   "0.1",
+				   "-123.456",
+				   "100000000000000000000",
+				   "1e+21",
+				   "0.000001",
+				   "1e-7",
+				   "1.5e+300",
+				   "5e-324",
+				   "1.7976931348623157e+308",
+				   "0.3",
+				   "inf",
+				   "-inf",
+				   "nan" };
+	char text[FORMAT_NUMBER_MAX];
+
+	for (size_t i = 0; i < ARRAY_LENGTH(values); i++) {
+		TEST_ASSERT_EQUAL_size_t(strlen(expected[i]),
+					 format_f64(values[i], text));
+		TEST_ASSERT_EQUAL_STRING(expected[i], text);
+	}
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_integers_exhaustive_16_bits);
+	RUN_TEST(test_integers_random);
+	RUN_TEST(test_integers_limits);
+	RUN_TEST(test_parse_f64_random);
+	RUN_TEST(test_parse_f64_halfway);
+	RUN_TEST(test_parse_f64_edges);
+	RUN_TEST(test_format_f64_random);
+	RUN_TEST(test_format_f64_notation);
+
+	return UNITY_END();
+}
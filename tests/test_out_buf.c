@@ -0,0 +1,138 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+static struct out_buf out;
+
+void setUp(void)
+{
+	out_buf_init(&out, 0);
+}
+
+void tearDown(void)
+{
+	out_buf_destroy(&out);
+}
+
+/* Contents of `out` as a string, for comparisons */
+static const char *text(void)
+{
+	out_buf_append_char(&out, '\0');
+	out.len--;
+	return out.data;
+}
+
+void test_out_buf_append(void)
+{
+	out_buf_append_cstr(&out, "key=");
+	out_buf_append_u64(&out, 18446744073709551615ULL);
+	out_buf_append_char(&out, ' ');
+	out_buf_append_i64(&out, INT64_MIN);
+	out_buf_append_char(&out, ' ');
+	out_buf_append_f64(&out, 0.1);
+	out_buf_append_char(&out, ' ');
+	out_buf_append_f64(&out, -1e300);
+	out_buf_append(&out, "", 0);
+	TEST_ASSERT_EQUAL_STRING(
+		"key=18446744073709551615 -9223372036854775808 0.1 -1e+300",
+		text());
+}
+
+void test_out_buf_append_hex(void)
+{
+	out_buf_append_hex(&out, 0, 0);
+	out_buf_append_char(&out, ' ');
+	out_buf_append_hex(&out, 0xabc, 0);
+	out_buf_append_char(&out, ' ');
+	out_buf_append_hex(&out, 0xabc, 8);
+	out_buf_append_char(&out, ' ');
+	out_buf_append_hex(&out, 0xfedcba9876543210ULL, 4);
+	out_buf_append_char(&out, ' ');
+	out_buf_append_hex(&out, 1, 20);
+	TEST_ASSERT_EQUAL_STRING(
+		"0 abc 00000abc fedcba9876543210 00000000000000000001", text());
+}
+
+void test_out_buf_printf(void)
+{
+	char expected[600];
+	char long_arg[500];
+
+	TEST_ASSERT_EQUAL_INT(6, out_buf_printf(&out, "%s=%03d", "ab", 7));
+	TEST_ASSERT_EQUAL_STRING("ab=007", text());
+
+	/* Longer than the free space, so formatted twice */
+	memset(long_arg, 'x', sizeof(long_arg) - 1);
+	long_arg[sizeof(long_arg) - 1] = '\0';
+	(void)snprintf(expected, sizeof(expected), "ab=007[%s] %.3f", long_arg,
+		       2.5);
+	TEST_ASSERT_EQUAL_INT(507,
+			      out_buf_printf(&out, "[%s] %.3f", long_arg, 2.5));
+	TEST_ASSERT_EQUAL_STRING(expected, text());
+}
+
+void test_out_buf_grows(void)
+{
+	for (u64 i = 0; i < 100000; i++) {
+		out_buf_append_u64(&out, i % 10);
+	}
+
+	TEST_ASSERT_EQUAL_size_t(100000, out.len);
+	TEST_ASSERT_TRUE(out.cap >= out.len);
+	TEST_ASSERT_EQUAL_CHAR('9', out.data[99999]);
+}
+
+void test_out_buf_flush(void)
+{
+	char path[] = "/tmp/test_out_buf_XXXXXX";
+	struct out_buf parts[3];
+	char read_back[64];
+	int fd = mkstemp(path);
+
+	TEST_ASSERT_TRUE(fd >= 0);
+
+	for (size_t i = 0; i < ARRAY_LENGTH(parts); i++) {
+		out_buf_init(&parts[i], 16);
+	}
+
+	out_buf_append_cstr(&parts[0], "header\n");
+	/* Empty buffers are skipped */
+	out_buf_printf(&parts[2], "body %d\n", 42);
+	TEST_ASSERT_EQUAL_INT(0, out_buf_flush(fd, parts, 3));
+
+	for (size_t i = 0; i < ARRAY_LENGTH(parts); i++) {
+		TEST_ASSERT_EQUAL_size_t(0, parts[i].len);
+	}
+
+	out_buf_append_cstr(&parts[1], "tail\n");
+	TEST_ASSERT_EQUAL_INT(0, out_buf_flush(fd, parts, 3));
+	TEST_ASSERT_EQUAL_INT(
+		(int)strlen("header\nbody 42\ntail\n") + 1,
+		(int)load_file(path, read_back));
+	TEST_ASSERT_EQUAL_STRING("header\nbody 42\ntail\n", read_back);
+
+	/* Nothing is lost on error */
+	(void)close(fd);
+	out_buf_append_cstr(&parts[0], "kept");
+	TEST_ASSERT_EQUAL_INT(-1, out_buf_flush(fd, parts, 3));
+	TEST_ASSERT_EQUAL_size_t(4, parts[0].len);
+
+	for (size_t i = 0; i < ARRAY_LENGTH(parts); i++) {
+		out_buf_destroy(&parts[i]);
+	}
+
+	(void)remove(path);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_out_buf_append);
+	RUN_TEST(test_out_buf_append_hex);
+	RUN_TEST(test_out_buf_printf);
+	RUN_TEST(test_out_buf_grows);
+	RUN_TEST(test_out_buf_flush);
+
+	return UNITY_END();
+}
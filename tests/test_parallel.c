@@ -0,0 +1,248 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define ITEMS 100003
+
+static struct thread_pool *pool;
+
+void setUp(void)
+{
+	pool = thread_pool_create(4);
+}
+
+void tearDown(void)
+{
+	thread_pool_destroy(pool);
+	pool = NULL;
+}
+
+static void mark(size_t begin, size_t end, void *ctx)
+{
+	unsigned char *seen = (unsigned char *)ctx;
+
+	for (size_t i = begin; i < end; i++) {
+		seen[i]++;
+	}
+}
+
+static void assert_each_seen_once(const unsigned char *seen, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		TEST_ASSERT_EQUAL_UINT8(1, seen[i]);
+	}
+}
+
+void test_parallel_for_covers_range_once(void)
+{
+	static unsigned char seen[ITEMS];
+	size_t grains[] = { 0, 1, 7, 4096, ITEMS, ITEMS * 2 };
+
+	for (size_t g = 0; g < ARRAY_LENGTH(grains); g++) {
+		memset(seen, 0, sizeof(seen));
+		parallel_for(pool, ITEMS, grains[g], mark, seen);
+		assert_each_seen_once(seen, ITEMS);
+	}
+}
+
+void test_parallel_for_without_pool(void)
+{
+	static unsigned char seen[ITEMS];
+
+	parallel_for(NULL, ITEMS, 0, mark, seen);
+	assert_each_seen_once(seen, ITEMS);
+	parallel_for(pool, 0, 0, mark, seen);
+	assert_each_seen_once(seen, ITEMS);
+}
+
+struct nested {
+	unsigned char seen[64][64];
+};
+
+static void nested_inner(size_t begin, size_t end, void *ctx)
+{
+	mark(begin, end, ctx);
+}
+
+static void nested_outer(size_t begin, size_t end, void *ctx)
+{
+	struct nested *nested = (struct nested *)ctx;
+
+	for (size_t i = begin; i < end; i++) {
+		parallel_for(pool, 64, 1, nested_inner, nested->seen[i]);
+	}
+}
+
+void test_parallel_for_nested(void)
+{
+	static struct nested nested;
+
+	parallel_for(pool, 64, 1, nested_outer, &nested);
+	assert_each_seen_once(&nested.seen[0][0], 64 * 64);
+}
+
+static void sum_map(size_t begin, size_t end, void *partial, void *ctx)
+{
+	const u64 *values = (const u64 *)ctx;
+	u64 *sum = (u64 *)partial;
+
+	for (size_t i = begin; i < end; i++) {
+		*sum += values[i];
+	}
+}
+
+static void sum_combine(void *dst, const void *src, void *ctx)
+{
+	(void)ctx;
+	*(u64 *)dst += *(const u64 *)src;
+}
+
+void test_parallel_reduce_sum(void)
+{
+	static u64 values[ITEMS];
+	u64 expected = 0;
+	u64 sum = 0;
+
+	for (size_t i = 0; i < ITEMS; i++) {
+		values[i] = i * 2654435761U;
+		expected += values[i];
+	}
+
+	parallel_reduce(pool, ITEMS, 0, &sum, sizeof(sum), sum_map,
+			sum_combine, values, 0);
+	TEST_ASSERT_EQUAL_UINT64(expected, sum);
+
+	sum = 0;
+	parallel_reduce(pool, ITEMS, 0, &sum, sizeof(sum), sum_map,
+			sum_combine, values, PARALLEL_DETERMINISTIC);
+	TEST_ASSERT_EQUAL_UINT64(expected, sum);
+
+	sum = 0;
+	parallel_reduce(NULL, ITEMS, 3, &sum, sizeof(sum), sum_map,
+			sum_combine, values, 0);
+	TEST_ASSERT_EQUAL_UINT64(expected, sum);
+}
+
+static void fsum_map(size_t begin, size_t end, void *partial, void *ctx)
+{
+	const double *values = (const double *)ctx;
+	double *sum = (double *)partial;
+
+	for (size_t i = begin; i < end; i++) {
+		*sum += values[i];
+	}
+}
+
+static void fsum_combine(void *dst, const void *src, void *ctx)
+{
+	(void)ctx;
+	*(double *)dst += *(const double *)src;
+}
+
+void test_parallel_reduce_deterministic(void)
+{
+	static double values[ITEMS];
+	double sums[4];
+	size_t threads[] = { 0, 1, 3, 8 };
+
+	for (size_t i = 0; i < ITEMS; i++) {
+		values[i] = 1.0 / (double)(i + 1) * ((i & 1) ? -1e9 : 1e-9);
+	}
+
+	for (size_t t = 0; t < ARRAY_LENGTH(threads); t++) {
+		struct thread_pool *p =
+			threads[t] == 0 ? NULL : thread_pool_create(threads[t]);
+
+		sums[t] = 0.0;
+		parallel_reduce(p, ITEMS, 0, &sums[t], sizeof(sums[t]),
+				fsum_map, fsum_combine, values,
+				PARALLEL_DETERMINISTIC);
+		thread_pool_destroy(p);
+	}
+
+	for (size_t t = 1; t < ARRAY_LENGTH(threads); t++) {
+		TEST_ASSERT(memcmp(&sums[0], &sums[t], sizeof(double)) == 0);
+	}
+}
+
+struct histogram {
+	u64 buckets[256];
+};
+
+static void histogram_map(size_t begin, size_t end, void *partial, void *ctx)
+{
+	const u64 *keys = (const u64 *)ctx;
+	struct histogram *h = (struct histogram *)partial;
+
+	for (size_t i = begin; i < end; i++) {
+		h->buckets[fnv1a_64_buf(&keys[i], sizeof(keys[i])) >> 56]++;
+	}
+}
+
+static void histogram_combine(void *dst, const void *src, void *ctx)
+{
+	struct histogram *d = (struct histogram *)dst;
+	const struct histogram *s = (const struct histogram *)src;
+
+	(void)ctx;
+
+	for (size_t i = 0; i < ARRAY_LENGTH(d->buckets); i++) {
+		d->buckets[i] += s->buckets[i];
+	}
+}
+
+void test_parallel_reduce_histogram(void)
+{
+	static u64 keys[ITEMS];
+	struct histogram expected = { { 0 } };
+	struct histogram h = { { 0 } };
+
+	for (size_t i = 0; i < ITEMS; i++) {
+		keys[i] = i;
+	}
+
+	histogram_map(0, ITEMS, &expected, keys);
+	parallel_reduce(pool, ITEMS, 0, &h, sizeof(h), histogram_map,
+			histogram_combine, keys, 0);
+	TEST_ASSERT_EQUAL_MEMORY(&expected, &h, sizeof(h));
+}
+
+static void count_task(void *arg)
+{
+	u64 *counters = (u64 *)arg;
+
+	counters[0]++;
+}
+
+void test_thread_pool_wait(void)
+{
+	/* One counter per task, so no two tasks race */
+	static u64 counters[1000];
+
+	for (size_t i = 0; i < ARRAY_LENGTH(counters); i++) {
+		thread_pool_submit(pool, count_task, &counters[i]);
+	}
+
+	thread_pool_wait(pool);
+
+	for (size_t i = 0; i < ARRAY_LENGTH(counters); i++) {
+		TEST_ASSERT_EQUAL_UINT64(1, counters[i]);
+	}
+
+	TEST_ASSERT_EQUAL_size_t(4, thread_pool_size(pool));
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_parallel_for_covers_range_once);
+	RUN_TEST(test_parallel_for_without_pool);
+	RUN_TEST(test_parallel_for_nested);
+	RUN_TEST(test_parallel_reduce_sum);
+	RUN_TEST(test_parallel_reduce_deterministic);
+	RUN_TEST(test_parallel_reduce_histogram);
+	RUN_TEST(test_thread_pool_wait);
+
+	return UNITY_END();
+}
@@ -0,0 +1,91 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define LOOP 1000000
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static u64 busy_loop(size_t n)
+{
+	volatile u64 sink = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		sink += i * i;
+	}
+
+	return sink;
+}
+
+void test_perf_region(void)
+{
+	struct perf_counters pc;
+	struct perf_sample small;
+	struct perf_sample large;
+	struct perf_sample total;
+
+	if (perf_counters_open(&pc) != 0) {
+		perf_counters_close(&pc);
+		TEST_IGNORE_MESSAGE("No performance counters available");
+	}
+
+	perf_counters_start(&pc);
+	(void)busy_loop(LOOP);
+	perf_counters_stop(&pc, &small);
+	perf_counters_start(&pc);
+	(void)busy_loop(10 * LOOP);
+	perf_counters_stop(&pc, &large);
+	perf_counters_read(&pc, &total);
+
+	TEST_ASSERT_NOT_EQUAL(0, small.available);
+	TEST_ASSERT_EQUAL_UINT(pc.available, total.available);
+
+	for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+		if ((small.available & large.available & 1U << i) == 0) {
+			continue;
+		}
+
+		TEST_ASSERT_TRUE(total.values[i] >= small.values[i]);
+		TEST_ASSERT_TRUE(total.values[i] >= large.values[i]);
+	}
+
+	/* A few instructions per iteration, at least, and more in the
+	 * longer loop. Misses may well be zero. */
+	if ((large.available & 1U << PERF_COUNTER_INSTRUCTIONS) != 0) {
+		TEST_ASSERT_TRUE(small.values[PERF_COUNTER_INSTRUCTIONS] >= LOOP);
+		TEST_ASSERT_TRUE(large.values[PERF_COUNTER_INSTRUCTIONS] >
+				 small.values[PERF_COUNTER_INSTRUCTIONS]);
+	}
+
+	if ((large.available & 1U << PERF_COUNTER_CYCLES) != 0) {
+		TEST_ASSERT_TRUE(large.values[PERF_COUNTER_CYCLES] >
+				 small.values[PERF_COUNTER_CYCLES]);
+	}
+
+	if ((large.available & 1U << PERF_COUNTER_TASK_CLOCK) != 0) {
+		TEST_ASSERT_TRUE(small.values[PERF_COUNTER_TASK_CLOCK] > 0);
+		TEST_ASSERT_TRUE(large.values[PERF_COUNTER_TASK_CLOCK] >
+				 small.values[PERF_COUNTER_TASK_CLOCK]);
+	}
+
+	perf_counters_close(&pc);
+	TEST_ASSERT_EQUAL_UINT(0, pc.available);
+	TEST_ASSERT_EQUAL_INT(-1, pc.fds[0]);
+	/* Safe to close twice */
+	perf_counters_close(&pc);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_perf_region);
+
+	return UNITY_END();
+}
@@ -0,0 +1,175 @@
+#define LAZ_PROFILE
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define ITEMS 64
+#define MAX_THREADS 16
+
+static char path[] = "/tmp/test_profile_XXXXXX";
+
+void setUp(void)
+{
+	int fd = 0;
+
+	strcpy(path, "/tmp/test_profile_XXXXXX");
+	fd = mkstemp(path);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+	(void)close(fd);
+}
+
+void tearDown(void)
+{
+	(void)remove(path);
+}
+
+static void profile_items(size_t begin, size_t end, void *ctx)
+{
+	(void)ctx;
+
+	for (size_t i = begin; i < end; i++) {
+		PROFILE_SCOPE("item");
+	}
+}
+
+/* Text of the string member `key` of `object`, unescaped into `out` */
+static const char *member(const struct json_doc *doc, size_t object,
+			  const char *key, char *out)
+{
+	size_t node = json_find(doc, object, key);
+	size_t len = 0;
+
+	if (node == JSON_NONE || doc->nodes[node].type != JSON_STRING) {
+		return "";
+	}
+
+	len = json_unescape(json_text(doc, node), out);
+	TEST_ASSERT_NOT_EQUAL(JSON_NONE, len);
+	out[len] = '\0';
+	return out;
+}
+
+void test_profile_trace(void)
+{
+	struct thread_pool *pool = thread_pool_create(4);
+	struct json_doc doc;
+	char *text = NULL;
+	long size = 0;
+	size_t events = 0;
+	size_t event = 0;
+	/* Open zones and last timestamp of each thread */
+	int depth[MAX_THREADS] = { 0 };
+	double last[MAX_THREADS] = { 0 };
+	size_t items = 0;
+	size_t workers = 0;
+	int main_named = 0;
+	int counted = 0;
+
+	PROFILE_THREAD_NAME("main \"test\"\n");
+
+	{
+		PROFILE_SCOPE("outer");
+
+		{
+			PROFILE_SCOPE("inner");
+		}
+
+		PROFILE_COUNTER("answer", 42);
+		parallel_for(pool, ITEMS, 1, profile_items, NULL);
+	}
+
+	/* Workers only stop recording once joined */
+	thread_pool_destroy(pool);
+	TEST_ASSERT_EQUAL_INT(0, profile_write(path));
+
+	size = load_file(path, NULL);
+	TEST_ASSERT_GREATER_THAN_INT(1, size);
+	text = (char *)malloc_try((size_t)size);
+	TEST_ASSERT_EQUAL_INT(size, load_file(path, text));
+	TEST_ASSERT_EQUAL_INT(0, json_parse(&doc, text, (size_t)size - 1));
+
+	events = json_find(&doc, 0, "traceEvents");
+	TEST_ASSERT_NOT_EQUAL(JSON_NONE, events);
+	TEST_ASSERT_EQUAL_UINT32(JSON_ARRAY, doc.nodes[events].type);
+
+	for (event = events + 1; event < doc.nodes[events].next;
+	     event = doc.nodes[event].next) {
+		char phase[8];
+		char name[64];
+		i64 tid = 0;
+		double ts = 0;
+
+		(void)member(&doc, event, "ph", phase);
+		(void)member(&doc, event, "name", name);
+		TEST_ASSERT_EQUAL_INT(0, json_i64(&doc, json_find(&doc, event,
+								  "tid"),
+						  &tid));
+		TEST_ASSERT_TRUE(tid > 0 && tid < MAX_THREADS);
+
+		if (strcmp(phase, "M") == 0) {
+			size_t args = json_find(&doc, event, "args");
+
+			(void)member(&doc, args, "name", name);
+			main_named += strcmp(name, "main \"test\"\n") == 0;
+			workers += strcmp(name, "worker") == 0;
+			continue;
+		}
+
+		TEST_ASSERT_EQUAL_INT(0, json_f64(&doc, json_find(&doc, event,
+								  "ts"),
+						  &ts));
+		TEST_ASSERT_TRUE(ts >= last[tid]);
+		last[tid] = ts;
+
+		if (strcmp(phase, "B") == 0) {
+			depth[tid]++;
+			items += strcmp(name, "item") == 0;
+		} else if (strcmp(phase, "E") == 0) {
+			TEST_ASSERT_GREATER_THAN_INT(0, depth[tid]);
+			depth[tid]--;
+		} else {
+			i64 value = 0;
+
+			TEST_ASSERT_EQUAL_STRING("C", phase);
+			TEST_ASSERT_EQUAL_STRING("answer", name);
+			TEST_ASSERT_EQUAL_INT(
+				0, json_i64(&doc,
+					    json_find(&doc,
+						      json_find(&doc, event,
+								"args"),
+						      "value"),
+					    &value));
+			TEST_ASSERT_EQUAL_INT64(42, value);
+			counted++;
+		}
+	}
+
+	for (size_t i = 0; i < MAX_THREADS; i++) {
+		TEST_ASSERT_EQUAL_INT(0, depth[i]);
+	}
+
+	TEST_ASSERT_EQUAL_size_t(ITEMS, items);
+	TEST_ASSERT_EQUAL_size_t(4, workers);
+	TEST_ASSERT_EQUAL_INT(1, main_named);
+	TEST_ASSERT_EQUAL_INT(1, counted);
+
+	json_destroy(&doc);
+	free(text);
+}
+
+void test_profile_write_failure(void)
+{
+	PROFILE_BEGIN("zone");
+	PROFILE_END();
+	TEST_ASSERT_EQUAL_INT(-1, profile_write("/nonexistent/trace.json"));
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_profile_trace);
+	RUN_TEST(test_profile_write_failure);
+
+	return UNITY_END();
+}
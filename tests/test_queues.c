@@ -0,0 +1,205 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#include <sched.h>
+
+#define ITEMS 200000
+#define THREADS 4
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_spsc_ring_full_and_empty(void)
+{
+	struct spsc_ring *ring = spsc_ring_create(5);
+	void *item = NULL;
+
+	TEST_ASSERT_EQUAL_size_t(8, spsc_ring_capacity(ring));
+	TEST_ASSERT_EQUAL_INT(-1, spsc_ring_pop(ring, &item));
+
+	for (uintptr_t i = 0; i < 8; i++) {
+		TEST_ASSERT_EQUAL_INT(0, spsc_ring_push(ring, (void *)i));
+	}
+
+	TEST_ASSERT_EQUAL_INT(-1, spsc_ring_push(ring, NULL));
+
+	for (uintptr_t i = 0; i < 8; i++) {
+		TEST_ASSERT_EQUAL_INT(0, spsc_ring_pop(ring, &item));
+		TEST_ASSERT_EQUAL_PTR((void *)i, item);
+	}
+
+	TEST_ASSERT_EQUAL_INT(-1, spsc_ring_pop(ring, &item));
+	spsc_ring_destroy(ring);
+}
+
+void test_spsc_ring_batches_wrap_around(void)
+{
+	struct spsc_ring *ring = spsc_ring_create(16);
+	void *in[12];
+	void *out[12];
+	uintptr_t next_in = 0;
+	uintptr_t next_out = 0;
+
+	for (size_t round = 0; round < 10; round++) {
+		size_t pushed = 0;
+		size_t popped = 0;
+
+		for (size_t i = 0; i < ARRAY_LENGTH(in); i++) {
+			in[i] = (void *)(next_in + i);
+		}
+
+		pushed = spsc_ring_push_n(ring, in, ARRAY_LENGTH(in));
+		next_in += pushed;
+		popped = spsc_ring_pop_n(ring, out, 7);
+
+		for (size_t i = 0; i < popped; i++) {
+			TEST_ASSERT_EQUAL_PTR((void *)next_out++, out[i]);
+		}
+	}
+
+	/* 12 in and 7 out per round fills the ring, which then ends each round
+	 * 7 short of full */
+	TEST_ASSERT_EQUAL_size_t(16 - 7, next_in - next_out);
+	spsc_ring_destroy(ring);
+}
+
+static void *spsc_producer(void *arg)
+{
+	struct spsc_ring *ring = (struct spsc_ring *)arg;
+
+	for (uintptr_t i = 1; i <= ITEMS; i++) {
+		while (spsc_ring_push(ring, (void *)i) != 0) {
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+void test_spsc_ring_threads_keep_order(void)
+{
+	struct spsc_ring *ring = spsc_ring_create(64);
+	pthread_t producer;
+	void *items[16];
+	uintptr_t expected = 1;
+
+	pthread_create(&producer, NULL, spsc_producer, ring);
+
+	while (expected <= ITEMS) {
+		size_t n = spsc_ring_pop_n(ring, items, ARRAY_LENGTH(items));
+
+		if (n == 0) {
+			sched_yield();
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			TEST_ASSERT_EQUAL_PTR((void *)expected++, items[i]);
+		}
+	}
+
+	pthread_join(producer, NULL);
+	spsc_ring_destroy(ring);
+}
+
+void test_mpmc_queue_full_and_empty(void)
+{
+	struct mpmc_queue *queue = mpmc_queue_create(1);
+	void *item = NULL;
+
+	TEST_ASSERT_EQUAL_size_t(2, mpmc_queue_capacity(queue));
+	TEST_ASSERT_EQUAL_INT(-1, mpmc_queue_pop(queue, &item));
+	TEST_ASSERT_EQUAL_INT(0, mpmc_queue_push(queue, (void *)1));
+	TEST_ASSERT_EQUAL_INT(0, mpmc_queue_push(queue, (void *)2));
+	TEST_ASSERT_EQUAL_INT(-1, mpmc_queue_push(queue, (void *)3));
+	TEST_ASSERT_EQUAL_INT(0, mpmc_queue_pop(queue, &item));
+	TEST_ASSERT_EQUAL_PTR((void *)1, item);
+	TEST_ASSERT_EQUAL_INT(0, mpmc_queue_push(queue, (void *)3));
+	TEST_ASSERT_EQUAL_INT(0, mpmc_queue_pop(queue, &item));
+	TEST_ASSERT_EQUAL_PTR((void *)2, item);
+	TEST_ASSERT_EQUAL_INT(0, mpmc_queue_pop(queue, &item));
+	TEST_ASSERT_EQUAL_PTR((void *)3, item);
+	TEST_ASSERT_EQUAL_INT(-1, mpmc_queue_pop(queue, &item));
+	mpmc_queue_destroy(queue);
+}
+
+struct mpmc_worker {
+	struct mpmc_queue *queue;
+	uintptr_t first;
+	unsigned char *seen;
+};
+
+static void *mpmc_producer(void *arg)
+{
+	struct mpmc_worker *w = (struct mpmc_worker *)arg;
+
+	for (uintptr_t i = w->first; i < w->first + ITEMS / THREADS; i++) {
+		while (mpmc_queue_push(w->queue, (void *)i) != 0) {
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+static void *mpmc_consumer(void *arg)
+{
+	struct mpmc_worker *w = (struct mpmc_worker *)arg;
+	void *item = NULL;
+
+	for (size_t i = 0; i < ITEMS / THREADS; i++) {
+		while (mpmc_queue_pop(w->queue, &item) != 0) {
+			sched_yield();
+		}
+
+		/* Each value is popped by exactly one consumer */
+		w->seen[(uintptr_t)item]++;
+	}
+
+	return NULL;
+}
+
+void test_mpmc_queue_threads_deliver_once(void)
+{
+	static unsigned char seen[ITEMS];
+	struct mpmc_worker workers[THREADS];
+	pthread_t ids[2 * THREADS];
+	struct mpmc_queue *queue = mpmc_queue_create(32);
+
+	for (size_t i = 0; i < THREADS; i++) {
+		workers[i].queue = queue;
+		workers[i].first = i * (ITEMS / THREADS);
+		workers[i].seen = seen;
+		pthread_create(&ids[i], NULL, mpmc_producer, &workers[i]);
+		pthread_create(&ids[THREADS + i], NULL, mpmc_consumer,
+			       &workers[i]);
+	}
+
+	for (size_t i = 0; i < 2 * THREADS; i++) {
+		pthread_join(ids[i], NULL);
+	}
+
+	for (size_t i = 0; i < ITEMS; i++) {
+		TEST_ASSERT_EQUAL_UINT8(1, seen[i]);
+	}
+
+	mpmc_queue_destroy(queue);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_spsc_ring_full_and_empty);
+	RUN_TEST(test_spsc_ring_batches_wrap_around);
+	RUN_TEST(test_spsc_ring_threads_keep_order);
+	RUN_TEST(test_mpmc_queue_full_and_empty);
+	RUN_TEST(test_mpmc_queue_threads_deliver_once);
+
+	return UNITY_END();
+}
@@ -0,0 +1,290 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+/* Micro-benchmarks checked against a baselines file. Each line of it is a
+ * benchmark name, its throughput in the unit the benchmark reports, and the
+ * fraction below that it may drop before failing. The first argument is the
+ * committed file, used when the second, the baselines of this host, does not
+ * exist. With LAZ_PERF_UPDATE set in the environment, the host file is
+ * written with the throughputs measured instead, keeping the tolerances. */
+
+#define HASH_BYTES (1 << 20)
+#define FILE_BYTES (16 << 20)
+#define ROUNDS 5
+/* Shortest time a round runs for, so that the clock resolution and the
+ * first cold iterations do not count */
+#define ROUND_NS 50000000ULL
+#define DEFAULT_TOLERANCE 0.3
+
+struct baseline {
+	char name[32];
+	double value;
+	double tolerance;
+	double measured;
+};
+
+static const char *baselines_path;
+static const char *host_path;
+static struct baseline baselines[16];
+static size_t baseline_count;
+static unsigned char *buf;
+static volatile u64 sink;
+
+static struct baseline *find_baseline(const char *name)
+{
+	for (size_t i = 0; i < baseline_count; i++) {
+		if (strcmp(baselines[i].name, name) == 0) {
+			return &baselines[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void read_baselines(void)
+{
+	FILE *file = fopen(host_path, "r");
+	char line[256];
+
+	if (file == NULL) {
+		file = fopen(baselines_path, "r");
+	}
+
+	if (file == NULL) {
+		return;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL &&
+	       baseline_count < ARRAY_LENGTH(baselines)) {
+		struct baseline *b = &baselines[baseline_count];
+
+		if (line[0] == '#') {
+			continue;
+		}
+
+		if (sscanf(line, "%31s %lf %lf", b->name, &b->value,
+			   &b->tolerance) == 3) {
+			baseline_count++;
+		}
+	}
+
+	(void)fclose(file);
+}
+
+#ifdef NDEBUG
+static void write_baselines(void)
+{
+	FILE *file = fopen(host_path, "w");
+
+	if (file == NULL) {
+		(void)errorf("Error: unable to write %s\n", host_path);
+		return;
+	}
+
+	(void)fprintf(file,
+		      "# Regenerate with LAZ_PERF_UPDATE=1 ctest -L perf. To\n"
+		      "# commit, copy over tests/perf_baselines.txt and lower\n"
+		      "# the values for slower machines as needed.\n"
+		      "# name throughput tolerance\n");
+
+	for (size_t i = 0; i < baseline_count; i++) {
+		(void)fprintf(file, "%-20s %12.2f %.2f\n", baselines[i].name,
+			      baselines[i].measured, baselines[i].tolerance);
+	}
+
+	(void)fclose(file);
+}
+#endif
+
+/* Best of ROUNDS rounds of `run`, which does one operation per call, in
+ * operations per second times `scale` */
+static double measure(void (*run)(size_t i), double scale)
+{
+	double best = 0;
+
+	for (int round = 0; round < ROUNDS; round++) {
+		u64 start = get_nanoseconds();
+		u64 elapsed = 0;
+		size_t ops = 0;
+
+		do {
+			run(ops++);
+			elapsed = get_nanoseconds() - start;
+		} while (elapsed < ROUND_NS);
+
+		best = MAX(best, (double)ops * scale * 1e9 / (double)elapsed);
+	}
+
+	return best;
+}
+
+/* Measures `run` and fails when it is slower than its baseline allows */
+static void check(const char *name, void (*run)(size_t i), double scale,
+		  const char *unit)
+{
+	struct baseline *b = NULL;
+	double measured = 0;
+	char message[160];
+
+#ifndef NDEBUG
+	TEST_IGNORE_MESSAGE("Baselines are for optimized builds");
+#endif
+	measured = measure(run, scale);
+	b = find_baseline(name);
+
+	if (b == NULL && baseline_count == ARRAY_LENGTH(baselines)) {
+		TEST_IGNORE_MESSAGE("No room for another baseline");
+	}
+
+	if (b == NULL) {
+		b = &baselines[baseline_count++];
+		(void)snprintf(b->name, sizeof(b->name), "%s", name);
+		b->tolerance = DEFAULT_TOLERANCE;
+	}
+
+	b->measured = measured;
+	(void)snprintf(message, sizeof(message), "%.2f %s, baseline %.2f",
+		       measured, unit, b->value);
+
+	if (getenv("LAZ_PERF_UPDATE") != NULL) {
+		TEST_PASS_MESSAGE(message);
+	}
+
+	if (b->value == 0) {
+		TEST_IGNORE_MESSAGE("No baseline");
+	}
+
+	if (measured < b->value * (1 - b->tolerance)) {
+		TEST_FAIL_MESSAGE(message);
+	}
+
+	TEST_PASS_MESSAGE(message);
+}
+
+void setUp(void)
+{
+}
+
+static char file_path[] = "/tmp/test_regress_XXXXXX";
+static char *file_contents;
+
+/* A failed check does not return to the test, so its file is removed here */
+void tearDown(void)
+{
+	if (file_contents != NULL) {
+		free(file_contents);
+		file_contents = NULL;
+		(void)remove(file_path);
+	}
+}
+
+static void run_fast_hash_64(size_t i)
+{
+	sink += fast_hash_64(buf, HASH_BYTES, i);
+}
+
+static void run_crc32c(size_t i)
+{
+	sink += crc32c_update((u32)i, buf, HASH_BYTES);
+}
+
+static void run_fnv1a_64(size_t i)
+{
+	(void)i;
+	sink += fnv1a_64_buf(buf, HASH_BYTES);
+}
+
+static void run_load_file(size_t i)
+{
+	(void)i;
+	TEST_ASSERT_EQUAL_INT(FILE_BYTES + 1,
+			      load_file(file_path, file_contents));
+	sink += (unsigned char)file_contents[i % FILE_BYTES];
+}
+
+/* A mix of sizes across the small and large bins of the allocator, with
+ * some blocks kept alive so that frees do not always undo the last
+ * allocation */
+static void run_alloc(size_t i)
+{
+	static void *live[64];
+	size_t slot = (i * 2654435761U >> 7) % ARRAY_LENGTH(live);
+	size_t size = (size_t)16 << (i % 10);
+
+	free(live[slot]);
+	live[slot] = malloc_try(size);
+	*(volatile char *)live[slot] = (char)i;
+	live[slot] = realloc_try(live[slot], size * 2);
+}
+
+void test_regress_fast_hash_64(void)
+{
+	check("fast_hash_64", run_fast_hash_64, HASH_BYTES / 1e6, "MB/s");
+}
+
+void test_regress_crc32c(void)
+{
+	check("crc32c", run_crc32c, HASH_BYTES / 1e6, "MB/s");
+}
+
+void test_regress_fnv1a_64(void)
+{
+	check("fnv1a_64", run_fnv1a_64, HASH_BYTES / 1e6, "MB/s");
+}
+
+void test_regress_load_file(void)
+{
+	int fd = mkstemp(file_path);
+	long written = 0;
+
+	TEST_ASSERT_TRUE(fd >= 0);
+	file_contents = (char *)malloc_try(FILE_BYTES + 1);
+	written = write(fd, buf, FILE_BYTES);
+	(void)close(fd);
+	TEST_ASSERT_EQUAL_INT(FILE_BYTES, written);
+	check("load_file", run_load_file, FILE_BYTES / 1e6, "MB/s");
+}
+
+void test_regress_alloc(void)
+{
+	/* Two allocations and a free per operation */
+	check("alloc", run_alloc, 1 / 1e6, "Mops/s");
+}
+
+int main(int argc, char **argv)
+{
+	int failures = 0;
+
+	if (argc != 3) {
+		panicf("Usage: %s BASELINES HOST_BASELINES\n", argv[0]);
+	}
+
+	baselines_path = argv[1];
+	host_path = argv[2];
+	read_baselines();
+	buf = (unsigned char *)malloc_try(FILE_BYTES);
+
+	for (size_t i = 0; i < FILE_BYTES; i++) {
+		buf[i] = (unsigned char)(i * 2654435761U >> 13);
+	}
+
+	UNITY_BEGIN();
+
+	RUN_TEST(test_regress_fast_hash_64);
+	RUN_TEST(test_regress_crc32c);
+	RUN_TEST(test_regress_fnv1a_64);
+	RUN_TEST(test_regress_load_file);
+	RUN_TEST(test_regress_alloc);
+
+	failures = UNITY_END();
+	free(buf);
+
+#ifdef NDEBUG
+	if (getenv("LAZ_PERF_UPDATE") != NULL) {
+		write_baselines();
+	}
+#endif
+
+	return failures;
+}
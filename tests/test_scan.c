@@ -0,0 +1,196 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define SIZE 1000
+
+static unsigned char buf[SIZE];
+
+void setUp(void)
+{
+	u64 state = 3;
+
+	/* Few distinct bytes, so every kernel finds matches */
+	for (size_t i = 0; i < SIZE; i++) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		buf[i] = (unsigned char)('a' + (state >> 59));
+	}
+}
+
+void tearDown(void)
+{
+}
+
+static size_t find_any(const unsigned char *p, size_t len, const char *set,
+		       size_t set_len)
+{
+	for (size_t i = 0; i < len; i++) {
+		if (memchr(set, p[i], set_len) != NULL) {
+			return i;
+		}
+	}
+
+	return len;
+}
+
+void test_scan_byte(void)
+{
+	for (size_t start = 0; start < 40; start++) {
+		for (size_t len = 0; start + len <= SIZE; len += 7) {
+			for (unsigned char b = 'a'; b <= 'z' + 6; b += 3) {
+				const unsigned char *hit =
+					(const unsigned char *)memchr(
+						buf + start, b, len);
+				size_t expected =
+					hit != NULL ? (size_t)(hit - buf - start) :
+						      len;
+
+				TEST_ASSERT_EQUAL_size_t(
+					expected, scan_byte(buf + start, len, b));
+			}
+		}
+	}
+}
+
+void test_scan_any(void)
+{
+	/* The last set spans more than 8 high nibbles */
+	const char *sets[] = { "z", "xy", "\n\r\t ,;", "abcdefghijklmnop",
+			       "qrstuvwxyz{|}~\x7f\x80\x81",
+			       "\x01\x11!1AQaq\x81\x91" };
+
+	TEST_ASSERT_EQUAL_size_t(SIZE, scan_any(buf, SIZE, "", 0));
+
+	for (size_t s = 0; s < ARRAY_LENGTH(sets); s++) {
+		size_t set_len = strlen(sets[s]);
+
+		for (size_t start = 0; start < 40; start++) {
+			for (size_t len = 0; start + len <= SIZE; len += 13) {
+				TEST_ASSERT_EQUAL_size_t(
+					find_any(buf + start, len, sets[s],
+						 set_len),
+					scan_any(buf + start, len, sets[s],
+						 set_len));
+			}
+		}
+	}
+}
+
+void test_count_byte(void)
+{
+	static unsigned char big[100000];
+	size_t expected = 0;
+
+	/* Long enough to overflow byte counters */
+	memset(big, '\n', sizeof(big));
+	TEST_ASSERT_EQUAL_size_t(sizeof(big), count_byte(big, sizeof(big), '\n'));
+
+	for (size_t len = 0; len <= SIZE; len++) {
+		TEST_ASSERT_EQUAL_size_t(expected, count_byte(buf, len, 'c'));
+		expected += len < SIZE && buf[len] == 'c';
+	}
+
+	for (size_t start = 1; start < 40; start++) {
+		TEST_ASSERT_EQUAL_size_t(count_byte(buf + start, 64, 'q'),
+					 count_byte(buf + start, 32, 'q') +
+						 count_byte(buf + start + 32,
+							    32, 'q'));
+	}
+}
+
+void test_scan_strlen(void)
+{
+	char *str = (char *)malloc_try(SIZE + 1);
+
+	for (size_t start = 0; start < 40; start++) {
+		for (size_t len = 0; start + len < SIZE; len += 5) {
+			memcpy(str + start, buf, len);
+			str[start + len] = '\0';
+			TEST_ASSERT_EQUAL_size_t(len, scan_strlen(str + start));
+		}
+	}
+
+	free(str);
+	TEST_ASSERT_EQUAL_HEX64(fnv1a_64_buf("foobar", 6), fnv1a_64_str("foobar"));
+	TEST_ASSERT_EQUAL_HEX32(fnv1a_32_buf("", 0), fnv1a_32_str(""));
+}
+
+void test_str_view(void)
+{
+	struct str_view a = str_view_cstr("key=value");
+
+	TEST_ASSERT_EQUAL_size_t(9, a.len);
+	TEST_ASSERT_TRUE(str_view_eq(str_view_from(a.data, 3),
+				     str_view_cstr("key")));
+	TEST_ASSERT_TRUE(str_view_eq_cstr(str_view_from(NULL, 0), ""));
+	TEST_ASSERT_FALSE(str_view_eq_cstr(a, "key=valu"));
+}
+
+void test_line_iter(void)
+{
+	const char *text = "one\r\n\ntwo\nthree\r";
+	const char *lines[] = { "one", "", "two", "three\r" };
+	struct line_iter iter;
+	struct str_view line;
+	size_t count = 0;
+
+	line_iter_init(&iter, text, strlen(text));
+
+	while (line_iter_next(&iter, &line)) {
+		TEST_ASSERT_LESS_THAN_size_t(ARRAY_LENGTH(lines), count);
+		TEST_ASSERT_TRUE(str_view_eq_cstr(line, lines[count]));
+		count++;
+	}
+
+	TEST_ASSERT_EQUAL_size_t(ARRAY_LENGTH(lines), count);
+
+	/* A trailing newline adds no line */
+	line_iter_init(&iter, "a\n", 2);
+	TEST_ASSERT_TRUE(line_iter_next(&iter, &line));
+	TEST_ASSERT_FALSE(line_iter_next(&iter, &line));
+	line_iter_init(&iter, "", 0);
+	TEST_ASSERT_FALSE(line_iter_next(&iter, &line));
+}
+
+void test_field_iter(void)
+{
+	const char *fields[] = { "", "a", "bc", "", "d", "" };
+	struct field_iter iter;
+	struct str_view field;
+	size_t count = 0;
+
+	TEST_ASSERT_EQUAL_INT(-1, field_iter_init(&iter, str_view_cstr("a"),
+						  ",", 0));
+	TEST_ASSERT_EQUAL_INT(0, field_iter_init(&iter,
+						 str_view_cstr(",a,bc\t\td,"),
+						 ",\t", 2));
+
+	while (field_iter_next(&iter, &field)) {
+		TEST_ASSERT_LESS_THAN_size_t(ARRAY_LENGTH(fields), count);
+		TEST_ASSERT_TRUE(str_view_eq_cstr(field, fields[count]));
+		count++;
+	}
+
+	TEST_ASSERT_EQUAL_size_t(ARRAY_LENGTH(fields), count);
+
+	/* An empty view still has one empty field */
+	field_iter_init(&iter, str_view_from("", 0), ",", 1);
+	TEST_ASSERT_TRUE(field_iter_next(&iter, &field));
+	TEST_ASSERT_EQUAL_size_t(0, field.len);
+	TEST_ASSERT_FALSE(field_iter_next(&iter, &field));
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_scan_byte);
+	RUN_TEST(test_scan_any);
+	RUN_TEST(test_count_byte);
+	RUN_TEST(test_scan_strlen);
+	RUN_TEST(test_str_view);
+	RUN_TEST(test_line_iter);
+	RUN_TEST(test_field_iter);
+
+	return UNITY_END();
+}
@@ -0,0 +1,154 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define KEYS 100000
+
+static u64 keys[KEYS];
+static u64 before[KEYS];
+
+void setUp(void)
+{
+	for (u64 i = 0; i < KEYS; i++) {
+		char key[32];
+
+		(void)snprintf(key, sizeof(key), "user:%llu",
+			       (unsigned long long)i);
+		keys[i] = fnv1a_64_str(key);
+	}
+}
+
+void tearDown(void)
+{
+}
+
+/* Each of `n` shards gets its share of keys within `slack` */
+static void assert_balanced(const u64 *shards, u64 n, double slack)
+{
+	u64 counts[64] = { 0 };
+
+	for (size_t i = 0; i < KEYS; i++) {
+		TEST_ASSERT_LESS_THAN_UINT64(64, shards[i]);
+		counts[shards[i]]++;
+	}
+
+	for (u64 s = 0; s < n; s++) {
+		TEST_ASSERT_UINT64_WITHIN((u64)(slack * KEYS / (double)n),
+					  KEYS / n, counts[s]);
+	}
+}
+
+void test_jump_hash_moves_few_keys(void)
+{
+	u64 shards[KEYS];
+
+	TEST_ASSERT_EQUAL_UINT32(0, jump_hash(keys[0], 1));
+	TEST_ASSERT_EQUAL_UINT32(0, jump_hash(keys[0], 0));
+
+	for (u32 n = 1; n < 32; n++) {
+		size_t moved = 0;
+
+		for (size_t i = 0; i < KEYS; i++) {
+			shards[i] = jump_hash(keys[i], n + 1);
+
+			if (n > 1 && shards[i] != before[i]) {
+				/* Keys only ever move to the new bucket */
+				TEST_ASSERT_EQUAL_UINT64(n, shards[i]);
+				moved++;
+			}
+
+			before[i] = shards[i];
+		}
+
+		if (n > 1) {
+			TEST_ASSERT_UINT64_WITHIN(KEYS / (n + 1) / 5,
+						  KEYS / (n + 1), moved);
+		}
+	}
+
+	assert_balanced(shards, 32, 0.1);
+}
+
+void test_rendezvous_hash(void)
+{
+	u64 nodes[16];
+	u64 shards[KEYS];
+
+	for (u64 i = 0; i < ARRAY_LENGTH(nodes); i++) {
+		nodes[i] = 1000 + i;
+	}
+
+	for (size_t i = 0; i < KEYS; i++) {
+		shards[i] = rendezvous_hash(keys[i], nodes, 16);
+	}
+
+	assert_balanced(shards, 16, 0.1);
+
+	/* Dropping the last node only moves its keys */
+	for (size_t i = 0; i < KEYS; i++) {
+		u64 shard = rendezvous_hash(keys[i], nodes, 15);
+
+		if (shards[i] != 15) {
+			TEST_ASSERT_EQUAL_UINT64(shards[i], shard);
+		}
+	}
+}
+
+static void lookup_all(const struct hash_ring *ring, u64 *shards)
+{
+	for (size_t i = 0; i < KEYS; i++) {
+		TEST_ASSERT_EQUAL_INT(0, hash_ring_lookup(ring, keys[i],
+							  &shards[i]));
+	}
+}
+
+void test_hash_ring(void)
+{
+	struct hash_ring *ring = hash_ring_create(0);
+	u64 shards[KEYS];
+	size_t moved = 0;
+
+	TEST_ASSERT_EQUAL_INT(-1, hash_ring_lookup(ring, keys[0], &shards[0]));
+
+	for (u64 node = 0; node < 8; node++) {
+		hash_ring_add(ring, node);
+	}
+
+	hash_ring_add(ring, 3);
+	TEST_ASSERT_EQUAL_size_t(8, hash_ring_size(ring));
+	lookup_all(ring, before);
+	assert_balanced(before, 8, 0.25);
+
+	/* A new node only takes keys, about 1/9 of them */
+	hash_ring_add(ring, 8);
+	lookup_all(ring, shards);
+
+	for (size_t i = 0; i < KEYS; i++) {
+		if (shards[i] != before[i]) {
+			TEST_ASSERT_EQUAL_UINT64(8, shards[i]);
+			moved++;
+		}
+	}
+
+	TEST_ASSERT_UINT64_WITHIN(KEYS / 9 / 3, KEYS / 9, moved);
+
+	/* Removing it restores the previous assignment */
+	hash_ring_remove(ring, 8);
+	hash_ring_remove(ring, 42);
+	TEST_ASSERT_EQUAL_size_t(8, hash_ring_size(ring));
+	lookup_all(ring, shards);
+	TEST_ASSERT_EQUAL_MEMORY(before, shards, sizeof(shards));
+
+	hash_ring_destroy(ring);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_jump_hash_moves_few_keys);
+	RUN_TEST(test_rendezvous_hash);
+	RUN_TEST(test_hash_ring);
+
+	return UNITY_END();
+}
@@ -0,0 +1,178 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define KEYS 2000
+
+/* Key i appears ZIPF / (i + 1) times */
+#define ZIPF 20000
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static u64 frequency(u64 key)
+{
+	return ZIPF / (key + 1);
+}
+
+void test_cms_bounds(void)
+{
+	struct cms *cms = cms_create(1000, 0);
+	size_t over_bound = 0;
+	u64 total = 0;
+
+	/* Interleaved so no key arrives in a single burst */
+	for (u64 round = 0; round < ZIPF; round++) {
+		for (u64 key = 0; key < KEYS && frequency(key) > round; key++) {
+			cms_add(cms, &key, sizeof(key), 1);
+			total++;
+		}
+	}
+
+	TEST_ASSERT_EQUAL_UINT64(total, cms_total(cms));
+
+	for (u64 key = 0; key < 2 * KEYS; key++) {
+		u64 truth = key < KEYS ? frequency(key) : 0;
+		u64 estimate = cms_estimate(cms, &key, sizeof(key));
+
+		TEST_ASSERT_GREATER_OR_EQUAL_UINT64(truth, estimate);
+		/* Width 1024, so e / 1024 of the total */
+		over_bound += estimate - truth > total * 272 / 102400;
+	}
+
+	/* Depth 4 fails the bound with probability e^-4 at most */
+	TEST_ASSERT_LESS_THAN_size_t(2 * KEYS / 50, over_bound);
+	TEST_ASSERT_EQUAL_UINT64(frequency(0), cms_estimate(cms, "\0\0\0\0\0\0\0",
+							     8));
+	cms_destroy(cms);
+}
+
+void test_cms_merge(void)
+{
+	struct cms *a = cms_create(256, 3);
+	struct cms *b = cms_create(256, 3);
+	struct cms *other = cms_create(512, 3);
+
+	for (u64 key = 0; key < KEYS; key++) {
+		cms_add_hash(key & 1 ? a : b, fnv1a_64_buf(&key, sizeof(key)),
+			     frequency(key));
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, cms_merge(a, b));
+	TEST_ASSERT_EQUAL_INT(-1, cms_merge(a, other));
+
+	for (u64 key = 0; key < KEYS; key++) {
+		TEST_ASSERT_GREATER_OR_EQUAL_UINT64(
+			frequency(key), cms_estimate(a, &key, sizeof(key)));
+	}
+
+	cms_destroy(other);
+	cms_destroy(b);
+	cms_destroy(a);
+}
+
+static void add_zipf(struct top_k *top, u64 first, u64 step)
+{
+	for (u64 round = 0; round < ZIPF; round++) {
+		for (u64 key = first; key < KEYS && frequency(key) > round;
+		     key += step) {
+			top_k_add(top, &key, sizeof(key), 1);
+		}
+	}
+}
+
+static void assert_top(const struct top_k *top, size_t expected)
+{
+	struct top_k_item items[16];
+	size_t n = top_k_list(top, items);
+
+	TEST_ASSERT_EQUAL_size_t(16, n);
+
+	for (size_t i = 0; i < expected; i++) {
+		u64 key = 0;
+
+		TEST_ASSERT_EQUAL_size_t(sizeof(key), items[i].len);
+		memcpy(&key, items[i].key, sizeof(key));
+		TEST_ASSERT_EQUAL_UINT64(i, key);
+		TEST_ASSERT_GREATER_OR_EQUAL_UINT64(frequency(i),
+						    items[i].count);
+		TEST_ASSERT_LESS_OR_EQUAL_UINT64(frequency(i),
+						 items[i].count - items[i].error);
+	}
+}
+
+void test_top_k_heavy_hitters(void)
+{
+	struct top_k *top = top_k_create(16);
+
+	add_zipf(top, 0, 1);
+	assert_top(top, 8);
+	top_k_destroy(top);
+}
+
+void test_top_k_merge(void)
+{
+	struct top_k *even = top_k_create(16);
+	struct top_k *odd = top_k_create(16);
+
+	add_zipf(even, 0, 2);
+	add_zipf(odd, 1, 2);
+	top_k_merge(even, odd);
+	assert_top(even, 8);
+	top_k_destroy(odd);
+	top_k_destroy(even);
+}
+
+void test_top_k_evictions(void)
+{
+	struct top_k *top = top_k_create(16);
+	struct top_k_item items[16];
+	u64 state = 7;
+	u64 sum = 0;
+	size_t n = 0;
+
+	for (size_t i = 0; i < 100000; i++) {
+		char key[64];
+
+		state = state * 6364136223846793005ULL + 1;
+		/* Long keys share a prefix and are stored truncated */
+		memset(key, 'k', sizeof(key));
+		key[sizeof(key) - 1] = (char)(state >> 58);
+		top_k_add(top, key, sizeof(key), 1);
+	}
+
+	n = top_k_list(top, items);
+	TEST_ASSERT_EQUAL_size_t(16, n);
+
+	/* Space-Saving counts always add up to the stream length, and keys
+	 * are tracked once */
+	for (size_t i = 0; i < n; i++) {
+		sum += items[i].count;
+		TEST_ASSERT_EQUAL_size_t(TOP_K_KEY_SIZE, items[i].len);
+
+		for (size_t j = 0; j < i; j++) {
+			TEST_ASSERT_TRUE(items[i].hash != items[j].hash);
+		}
+	}
+
+	TEST_ASSERT_EQUAL_UINT64(100000, sum);
+	top_k_destroy(top);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_cms_bounds);
+	RUN_TEST(test_cms_merge);
+	RUN_TEST(test_top_k_heavy_hitters);
+	RUN_TEST(test_top_k_merge);
+	RUN_TEST(test_top_k_evictions);
+
+	return UNITY_END();
+}
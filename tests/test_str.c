@@ -0,0 +1,170 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_str_inline(void)
+{
+	struct str s;
+	const char *key = "0123456789012345678901";
+
+	/* Small enough to pass around by value */
+	TEST_ASSERT_EQUAL_size_t(32, sizeof(struct str));
+
+	str_init_cstr(&s, "");
+	TEST_ASSERT_EQUAL_size_t(0, str_len(&s));
+	TEST_ASSERT_EQUAL_STRING("", str_data(&s));
+
+	str_append_cstr(&s, "key");
+	str_append_char(&s, '!');
+	TEST_ASSERT_EQUAL_STRING("key!", str_data(&s));
+	TEST_ASSERT_EQUAL_size_t(4, str_len(&s));
+	str_destroy(&s);
+
+	/* Exactly STR_INLINE_MAX bytes still fit */
+	str_init(&s, key, STR_INLINE_MAX);
+	TEST_ASSERT_EQUAL_size_t(STR_INLINE_MAX, str_capacity(&s));
+	TEST_ASSERT_EQUAL_STRING(key, str_data(&s));
+	str_append_char(&s, 'x');
+	TEST_ASSERT_TRUE(str_capacity(&s) > STR_INLINE_MAX);
+	TEST_ASSERT_EQUAL_size_t(STR_INLINE_MAX + 1, str_len(&s));
+	TEST_ASSERT_EQUAL_MEMORY(key, str_data(&s), STR_INLINE_MAX);
+	TEST_ASSERT_EQUAL_STRING("x", str_data(&s) + STR_INLINE_MAX);
+	str_destroy(&s);
+}
+
+void test_str_append_grows(void)
+{
+	struct str s;
+	size_t reallocations = 0;
+	size_t cap = 0;
+
+	str_init(&s, NULL, 0);
+
+	for (size_t i = 0; i < 10000; i++) {
+		str_append_char(&s, (char)('a' + i % 26));
+
+		if (str_capacity(&s) != cap) {
+			reallocations++;
+			cap = str_capacity(&s);
+		}
+	}
+
+	TEST_ASSERT_EQUAL_size_t(10000, str_len(&s));
+	TEST_ASSERT_TRUE(reallocations <= 10);
+
+	for (size_t i = 0; i < str_len(&s); i++) {
+		TEST_ASSERT_EQUAL_CHAR('a' + i % 26, str_data(&s)[i]);
+	}
+
+	TEST_ASSERT_EQUAL_CHAR('\0', str_data(&s)[str_len(&s)]);
+
+	/* Clearing keeps the buffer */
+	str_clear(&s);
+	TEST_ASSERT_EQUAL_size_t(0, str_len(&s));
+	TEST_ASSERT_EQUAL_size_t(cap, str_capacity(&s));
+	TEST_ASSERT_EQUAL_STRING("", str_data(&s));
+	str_destroy(&s);
+}
+
+void test_str_append_self(void)
+{
+	struct str s;
+
+	str_init_cstr(&s, "abcdefghijklmnopqrst");
+	str_append(&s, str_data(&s), str_len(&s));
+	TEST_ASSERT_EQUAL_STRING("abcdefghijklmnopqrstabcdefghijklmnopqrst",
+				 str_data(&s));
+	str_append(&s, str_data(&s) + 4, 3);
+	TEST_ASSERT_EQUAL_STRING(
+		"abcdefghijklmnopqrstabcdefghijklmnopqrstefg", str_data(&s));
+	str_destroy(&s);
+}
+
+void test_str_reserve(void)
+{
+	struct str s;
+	const char *before = NULL;
+
+	str_init_cstr(&s, "prefix");
+	str_reserve(&s, 1000);
+	TEST_ASSERT_TRUE(str_capacity(&s) >= 1000);
+	TEST_ASSERT_EQUAL_STRING("prefix", str_data(&s));
+	before = str_data(&s);
+
+	for (int i = 0; i < 99; i++) {
+		str_append_cstr(&s, "0123456789");
+	}
+
+	TEST_ASSERT_EQUAL_PTR(before, str_data(&s));
+	TEST_ASSERT_EQUAL_size_t(996, str_len(&s));
+	str_destroy(&s);
+}
+
+void test_str_hash_eq(void)
+{
+	struct str a;
+	struct str b;
+	struct str_view view;
+
+	str_init_cstr(&a, "a key");
+	str_init_cstr(&b, "a ");
+	str_append_cstr(&b, "key");
+	TEST_ASSERT_EQUAL_HEX64(fnv1a_64_str("a key"), str_hash(&a));
+	TEST_ASSERT_TRUE(str_eq(&a, &b));
+	TEST_ASSERT_EQUAL_HEX64(str_hash(&a), str_hash(&b));
+
+	/* Changes drop the cached hash */
+	str_append_char(&b, 's');
+	TEST_ASSERT_FALSE(str_eq(&a, &b));
+	TEST_ASSERT_EQUAL_HEX64(fnv1a_64_str("a keys"), str_hash(&b));
+	TEST_ASSERT_FALSE(str_eq(&a, &b));
+
+	/* Embedded nulls count */
+	str_destroy(&b);
+	str_init(&b, "a key\0", 6);
+	TEST_ASSERT_FALSE(str_eq(&a, &b));
+	view = str_as_view(&b);
+	TEST_ASSERT_EQUAL_size_t(6, view.len);
+	TEST_ASSERT_EQUAL_PTR(str_data(&b), view.data);
+
+	str_destroy(&a);
+	str_destroy(&b);
+}
+
+void test_str_move(void)
+{
+	struct str strings[2];
+	struct str moved;
+
+	str_init_cstr(&strings[0], "short");
+	str_init_cstr(&strings[1], "a string too long to be stored inline");
+	memcpy(&moved, &strings[0], sizeof(moved));
+	TEST_ASSERT_EQUAL_STRING("short", str_data(&moved));
+	moved = strings[1];
+	TEST_ASSERT_EQUAL_STRING("a string too long to be stored inline",
+				 str_data(&moved));
+	str_destroy(&strings[0]);
+	str_destroy(&moved);
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_str_inline);
+	RUN_TEST(test_str_append_grows);
+	RUN_TEST(test_str_append_self);
+	RUN_TEST(test_str_reserve);
+	RUN_TEST(test_str_hash_eq);
+	RUN_TEST(test_str_move);
+
+	return UNITY_END();
+}
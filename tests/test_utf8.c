@@ -0,0 +1,281 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#define RANDOM_BUFFERS 20000
+#define MAX_RANDOM_LEN 200
+
+static u64 state = 88172645463325252ULL;
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+static u64 next_random(void)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+/* Straight from the table in RFC 3629, to check the library against */
+static int reference_valid(const unsigned char *p, size_t len)
+{
+	size_t i = 0;
+
+	while (i < len) {
+		unsigned char c = p[i];
+		unsigned char low = 0x80;
+		unsigned char high = 0xbf;
+		size_t n = 0;
+
+		if (c < 0x80) {
+			i++;
+			continue;
+		} else if (c >= 0xc2 && c <= 0xdf) {
+			n = 2;
+		} else if (c >= 0xe0 && c <= 0xef) {
+			n = 3;
+			low = c == 0xe0 ? 0xa0 : 0x80;
+			high = c == 0xed ? 0x9f : 0xbf;
+		} else if (c >= 0xf0 && c <= 0xf4) {
+			n = 4;
+			low = c == 0xf0 ? 0x90 : 0x80;
+			high = c == 0xf4 ? 0x8f : 0xbf;
+		} else {
+			return 0;
+		}
+
+		if (len - i < n || p[i + 1] < low || p[i + 1] > high) {
+			return 0;
+		}
+
+		for (size_t k = 2; k < n; k++) {
+			if ((p[i + k] & 0xc0) != 0x80) {
+				return 0;
+			}
+		}
+
+		i += n;
+	}
+
+	return 1;
+}
+
+static void assert_validates(const unsigned char *p, size_t len)
+{
+	TEST_ASSERT_EQUAL_INT(reference_valid(p, len) ? 0 : -1,
+			      utf8_validate(p, len));
+}
+
+/* Every code point, encoded, checked, and transcoded both ways */
+static void test_code_points_exhaustive(void)
+{
+	for (u32 cp = 0; cp <= 0x10ffff; cp++) {
+		char utf8[4];
+		u32 utf32 = 0;
+		u16 utf16[2];
+		char back[4];
+		size_t len = 0;
+
+		if (cp >= 0xd800 && cp < 0xe000) {
+			TEST_ASSERT_EQUAL_size_t(UTF_INVALID,
+						 utf32_to_utf8(&cp, 1, utf8));
+			continue;
+		}
+
+		len = utf32_to_utf8(&cp, 1, utf8);
+		TEST_ASSERT_EQUAL_size_t(utf8_length_from_utf32(&cp, 1), len);
+		TEST_ASSERT_EQUAL_INT(0, utf8_validate(utf8, len));
+		TEST_ASSERT_EQUAL_size_t(1, utf8_to_utf32(utf8, len, &utf32));
+		TEST_ASSERT_EQUAL_HEX32(cp, utf32);
+		TEST_ASSERT_EQUAL_size_t(utf16_length_from_utf8(utf8, len),
+					 utf8_to_utf16(utf8, len, utf16));
+		TEST_ASSERT_EQUAL_size_t(
+			len, utf16_to_utf8(utf16, cp >= 0x10000 ? 2 : 1, back));
+		TEST_ASSERT_EQUAL_MEMORY(utf8, back, len);
+	}
+
+	for (u32 cp = 0x110000; cp < 0x110010; cp++) {
+		char utf8[4];
+
+		TEST_ASSERT_EQUAL_size_t(UTF_INVALID,
+					 utf32_to_utf8(&cp, 1, utf8));
+	}
+}
+
+/* Each byte triple starting with a lead byte, placed on both sides of
+ * every vector boundary by surrounding it with ASCII */
+static void test_sequences_exhaustive(void)
+{
+	unsigned char buf[72];
+
+	memset(buf, 'a', sizeof(buf));
+
+	for (u32 seq = 0xc00000; seq < 0x1000000; seq++) {
+		size_t at = 30 + seq % 4 + (seq >> 8 & 1) * 16;
+
+		buf[at] = (unsigned char)(seq >> 16);
+		buf[at + 1] = (unsigned char)(seq >> 8);
+		buf[at + 2] = (unsigned char)seq;
+		assert_validates(buf, sizeof(buf));
+		assert_validates(buf, at + 2);
+		assert_validates(buf + at, 3);
+		buf[at] = buf[at + 1] = buf[at + 2] = 'a';
+	}
+}
+
+static void test_invalid_examples(void)
+{
+	static const char *const invalid[] = {
+		"\xc0\x80",		/* Overlong NUL */
+		"\xc1\xbf",		/* Overlong two bytes */
+		"\xe0\x9f\xbf",		/* Overlong three bytes */
+		"\xf0\x8f\xbf\xbf",	/* Overlong four bytes */
+		"\xed\xa0\x80",		/* High surrogate */
+		"\xed\xbf\xbf",		/* Low surrogate */
+		"\xf4\x90\x80\x80",	/* Past U+10FFFF */
+		"\xf5\x80\x80\x80",	/* Lead past U+10FFFF */
+		"\xf8\x88\x80\x80\x80", /* Five bytes */
+		"\x80",			/* Stray continuation */
+		"\xc3",			/* Cut short */
+		"\xe2\x82",		/* Cut short */
+		"\xf0\x9f\x98",		/* Cut short */
+		"\xe2\x82\xac\xac",	/* One continuation too many */
+		"\xc3\x28",		/* Continuation missing */
+		"\xff",
+	};
+	char buf[100];
+
+	for (size_t i = 0; i < ARRAY_LENGTH(invalid); i++) {
+		size_t len = strlen(invalid[i]);
+		u16 utf16[100];
+		u32 utf32[100];
+
+		TEST_ASSERT_EQUAL_INT_MESSAGE(-1, utf8_validate(invalid[i], len),
+					      invalid[i]);
+		TEST_ASSERT_EQUAL_size_t(UTF_INVALID,
+					 utf8_to_utf16(invalid[i], len, utf16));
+		TEST_ASSERT_EQUAL_size_t(UTF_INVALID,
+					 utf8_to_utf32(invalid[i], len, utf32));
+
+		/* And in the middle and at the end of longer ASCII */
+		for (size_t at = 0; at + len <= sizeof(buf); at += 7) {
+			memset(buf, 'x', sizeof(buf));
+			memcpy(buf + at, invalid[i], len);
+			TEST_ASSERT_EQUAL_INT(-1, utf8_validate(buf, sizeof(buf)));
+			TEST_ASSERT_EQUAL_INT(-1, utf8_validate(buf, at + len));
+		}
+	}
+}
+
+static void test_invalid_utf16(void)
+{
+	static const u16 lone_high[] = { 'a', 0xd83d, 'b' };
+	static const u16 lone_low[] = { 'a', 0xde00 };
+	static const u16 swapped[] = { 0xde00, 0xd83d };
+	static const u16 last_high[] = { 'a', 0xd83d };
+	static const u16 pair[] = { 0xd83d, 0xde00 };
+	char out[16];
+
+	TEST_ASSERT_EQUAL_size_t(UTF_INVALID, utf16_to_utf8(lone_high, 3, out));
+	TEST_ASSERT_EQUAL_size_t(UTF_INVALID, utf16_to_utf8(lone_low, 2, out));
+	TEST_ASSERT_EQUAL_size_t(UTF_INVALID, utf16_to_utf8(swapped, 2, out));
+	TEST_ASSERT_EQUAL_size_t(UTF_INVALID, utf16_to_utf8(last_high, 2, out));
+	TEST_ASSERT_EQUAL_size_t(4, utf16_to_utf8(pair, 2, out));
+	TEST_ASSERT_EQUAL_MEMORY("\xf0\x9f\x98\x80", out, 4);
+	TEST_ASSERT_EQUAL_size_t(4, utf8_length_from_utf16(pair, 2));
+}
+
+/* Random code points of every length, with a byte changed in some, so
+ * errors land at every offset around the vector boundaries */
+static void test_random_buffers(void)
+{
+	unsigned char buf[MAX_RANDOM_LEN + 4];
+	u16 utf16[MAX_RANDOM_LEN + 4];
+	u32 utf32[MAX_RANDOM_LEN + 4];
+	char back[MAX_RANDOM_LEN + 4];
+
+	for (size_t r = 0; r < RANDOM_BUFFERS; r++) {
+		size_t target = 1 + next_random() % MAX_RANDOM_LEN;
+		size_t len = 0;
+		size_t units = 0;
+		u64 bits = 0;
+		int valid = 0;
+
+		while (len < target) {
+			u32 cp = 0;
+
+			bits = next_random();
+			cp = (u32)(bits >> 32);
+
+			/* Mostly ASCII, as text tends to be */
+			switch (bits % 5) {
+			case 0:
+			case 1:
+				cp %= 0x80;
+				break;
+			case 2:
+				cp %= 0x800;
+				break;
+			case 3:
+				cp %= 0x10000;
+				break;
+			default:
+				cp %= 0x110000;
+				break;
+			}
+
+			if (cp >= 0xd800 && cp < 0xe000) {
+				continue;
+			}
+
+			len += utf32_to_utf8(&cp, 1, (char *)buf + len);
+		}
+
+		TEST_ASSERT_EQUAL_INT(0, utf8_validate(buf, len));
+
+		units = utf8_to_utf16(buf, len, utf16);
+		TEST_ASSERT_EQUAL_size_t(utf16_length_from_utf8(buf, len),
+					 units);
+		TEST_ASSERT_EQUAL_size_t(utf8_length_from_utf16(utf16, units),
+					 len);
+		TEST_ASSERT_EQUAL_size_t(len, utf16_to_utf8(utf16, units, back));
+		TEST_ASSERT_EQUAL_MEMORY(buf, back, len);
+
+		units = utf8_to_utf32(buf, len, utf32);
+		TEST_ASSERT_EQUAL_size_t(utf32_length_from_utf8(buf, len),
+					 units);
+		TEST_ASSERT_EQUAL_size_t(utf8_length_from_utf32(utf32, units),
+					 len);
+		TEST_ASSERT_EQUAL_size_t(len, utf32_to_utf8(utf32, units, back));
+		TEST_ASSERT_EQUAL_MEMORY(buf, back, len);
+
+		bits = next_random();
+		buf[bits % len] = (unsigned char)(bits >> 32);
+		valid = reference_valid(buf, len);
+		assert_validates(buf, len);
+		TEST_ASSERT_EQUAL(valid,
+				  utf8_to_utf16(buf, len, utf16) != UTF_INVALID);
+		TEST_ASSERT_EQUAL(valid,
+				  utf8_to_utf32(buf, len, utf32) != UTF_INVALID);
+	}
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_code_points_exhaustive);
+	RUN_TEST(test_sequences_exhaustive);
+	RUN_TEST(test_invalid_examples);
+	RUN_TEST(test_invalid_utf16);
+	RUN_TEST(test_random_buffers);
+
+	return UNITY_END();
+}
@@ -0,0 +1,156 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+#include "unity/unity.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+static char dir[] = "/tmp/test_writer_XXXXXX";
+static char path[256];
+
+/* Entries of `dir` other than "." and "..", to catch temporary files left
+ * behind */
+static size_t dir_entries(void)
+{
+	DIR *d = opendir(dir);
+	struct dirent *entry = NULL;
+	size_t count = 0;
+
+	TEST_ASSERT_NOT_NULL(d);
+
+	while ((entry = readdir(d)) != NULL) {
+		count += strcmp(entry->d_name, ".") != 0 &&
+			 strcmp(entry->d_name, "..") != 0;
+	}
+
+	(void)closedir(d);
+	return count;
+}
+
+/* Contents of `path`, checked against `expected` */
+static void assert_contents(const void *expected, size_t len)
+{
+	char *contents = (char *)malloc_try(len + 1);
+
+	TEST_ASSERT_EQUAL_INT((long)len + 1, load_file(path, NULL));
+	TEST_ASSERT_EQUAL_INT((long)len + 1, load_file(path, contents));
+
+	if (len > 0) {
+		TEST_ASSERT_EQUAL_MEMORY(expected, contents, len);
+	}
+
+	free(contents);
+}
+
+void setUp(void)
+{
+	strcpy(dir, "/tmp/test_writer_XXXXXX");
+	TEST_ASSERT_NOT_NULL(mkdtemp(dir));
+	(void)snprintf(path, sizeof(path), "%s/out", dir);
+}
+
+void tearDown(void)
+{
+	(void)remove(path);
+	(void)remove(dir);
+}
+
+void test_file_writer_sizes(void)
+{
+	static unsigned char expected[300000];
+	struct file_writer w;
+	size_t written = 0;
+	size_t step = 0;
+
+	for (size_t i = 0; i < sizeof(expected); i++) {
+		expected[i] = (unsigned char)(i * 2654435761U >> 11);
+	}
+
+	/* Writes from one byte to several blocks, across block boundaries */
+	TEST_ASSERT_EQUAL_INT(0, file_writer_open(&w, path, 0, 4096, 0));
+
+	while (written < sizeof(expected)) {
+		size_t len = MIN(step * step + 1, sizeof(expected) - written);
+
+		TEST_ASSERT_EQUAL_INT(
+			0, file_writer_write(&w, expected + written, len));
+		written += len;
+		step++;
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, file_writer_close(&w));
+	assert_contents(expected, sizeof(expected));
+	TEST_ASSERT_EQUAL_size_t(1, dir_entries());
+}
+
+void test_file_writer_preallocate(void)
+{
+	struct file_writer w;
+	struct stat st;
+
+	/* A hint larger than the output neither pads the file nor keeps the
+	 * space it reserved */
+	TEST_ASSERT_EQUAL_INT(0, file_writer_open(&w, path, FILE_WRITER_ATOMIC,
+						  0, 64 << 20));
+	TEST_ASSERT_EQUAL_INT(0, file_writer_write(&w, "short", 5));
+	TEST_ASSERT_EQUAL_INT(0, file_writer_close(&w));
+	assert_contents("short", 5);
+	TEST_ASSERT_EQUAL_INT(0, stat(path, &st));
+	TEST_ASSERT_EQUAL_INT(0644, st.st_mode & 0777);
+	TEST_ASSERT_TRUE((u64)st.st_blocks * 512 < (1 << 20));
+}
+
+void test_file_writer_atomic(void)
+{
+	struct file_writer w;
+	struct stat st;
+
+	TEST_ASSERT_EQUAL_INT(0, save_file(path, "old", 3));
+	TEST_ASSERT_EQUAL_INT(0, chmod(path, 0600));
+
+	/* The target keeps its contents until the close */
+	TEST_ASSERT_EQUAL_INT(0, file_writer_open(&w, path, FILE_WRITER_ATOMIC,
+						  0, 0));
+	TEST_ASSERT_EQUAL_INT(0, file_writer_write(&w, "new contents", 12));
+	assert_contents("old", 3);
+	TEST_ASSERT_EQUAL_size_t(2, dir_entries());
+	TEST_ASSERT_EQUAL_INT(0, file_writer_close(&w));
+	assert_contents("new contents", 12);
+	TEST_ASSERT_EQUAL_size_t(1, dir_entries());
+	TEST_ASSERT_EQUAL_INT(0, stat(path, &st));
+	TEST_ASSERT_EQUAL_INT(0600, st.st_mode & 0777);
+
+	/* Aborting leaves the target alone and removes the temporary file */
+	TEST_ASSERT_EQUAL_INT(0, file_writer_open(&w, path, FILE_WRITER_ATOMIC,
+						  0, 0));
+	TEST_ASSERT_EQUAL_INT(0, file_writer_write(&w, "discarded", 9));
+	file_writer_abort(&w);
+	assert_contents("new contents", 12);
+	TEST_ASSERT_EQUAL_size_t(1, dir_entries());
+}
+
+void test_save_file(void)
+{
+	char missing[300];
+
+	TEST_ASSERT_EQUAL_INT(0, save_file(path, "", 0));
+	assert_contents("", 0);
+	TEST_ASSERT_EQUAL_INT(0, save_file(path, "replaced", 8));
+	assert_contents("replaced", 8);
+
+	(void)snprintf(missing, sizeof(missing), "%s/no/such/dir", dir);
+	TEST_ASSERT_EQUAL_INT(-1, save_file(missing, "x", 1));
+	TEST_ASSERT_EQUAL_size_t(1, dir_entries());
+}
+
+int main(void)
+{
+	UNITY_BEGIN();
+
+	RUN_TEST(test_file_writer_sizes);
+	RUN_TEST(test_file_writer_preallocate);
+	RUN_TEST(test_file_writer_atomic);
+	RUN_TEST(test_save_file);
+
+	return UNITY_END();
+}
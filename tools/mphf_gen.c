@@ -0,0 +1,193 @@
+#define LAZ_UTILS_IMPLEMENTATION
+#include "laz_utils.h"
+
+/* Writes a header holding a minimal perfect hash over the lines of a file,
+ * and a `<name>_lookup` function returning the position of a key among them,
+ * or -1 for other keys. Empty lines are skipped. */
+
+struct keys {
+	char *text;
+	const char **keys;
+	size_t *lens;
+	size_t count;
+};
+
+static int read_keys(const char *path, struct keys *k)
+{
+	long size = load_file(path, NULL);
+	struct line_iter iter;
+	struct str_view line;
+
+	if (size < 0) {
+		return -1;
+	}
+
+	k->text = (char *)malloc_try((size_t)size);
+
+	if (load_file(path, k->text) < 0) {
+		return -1;
+	}
+
+	/* At most one key per byte */
+	k->keys = (const char **)malloc_try((size_t)size * sizeof(*k->keys));
+	k->lens = (size_t *)malloc_try((size_t)size * sizeof(*k->lens));
+	/* Without the terminator */
+	line_iter_init(&iter, k->text, (size_t)size - 1);
+
+	while (line_iter_next(&iter, &line)) {
+		if (line.len > 0) {
+			k->keys[k->count] = line.data;
+			k->lens[k->count] = line.len;
+			k->count++;
+		}
+	}
+
+	return 0;
+}
+
+static void write_u32s(FILE *out, const char *name, const char *table,
+		       const u32 *values, size_t count)
+{
+	(void)fprintf(out, "static const u32 %s_%s[] = {", name, table);
+
+	/* Empty initializers are not C99 */
+	for (size_t i = 0; i < MAX(count, 1); i++) {
+		(void)fprintf(out, "%s%lu,", i % 8 == 0 ? "\n\t" : " ",
+			      count == 0 ? 0UL : (unsigned long)values[i]);
+	}
+
+	(void)fprintf(out, "\n};\n\n");
+}
+
+static void write_string(FILE *out, const char *s, size_t len)
+{
+	(void)fputc('"', out);
+
+	for (size_t i = 0; i < len; i++) {
+		unsigned char c = (unsigned char)s[i];
+
+		if (c == '"' || c == '\\') {
+			(void)fprintf(out, "\\%c", c);
+		} else if (c < 0x20 || c >= 0x7f || c == '?') {
+			/* Octal escapes cannot swallow the next character,
+			 * and escaping '?' avoids trigraphs */
+			(void)fprintf(out, "\\%03o", c);
+		} else {
+			(void)fputc(c, out);
+		}
+	}
+
+	(void)fputc('"', out);
+}
+
+static void write_header(FILE *out, const char *name, const char *source,
+			 const struct keys *k, const struct mphf *mphf)
+{
+	u32 *order = (u32 *)malloc_try(MAX(k->count, 1) * sizeof(*order));
+	u32 *lens = (u32 *)malloc_try(MAX(k->count, 1) * sizeof(*lens));
+	size_t *slots = (size_t *)malloc_try(MAX(k->count, 1) * sizeof(*slots));
+
+	for (size_t i = 0; i < k->count; i++) {
+		size_t slot = mphf_index(mphf, k->keys[i], k->lens[i]);
+
+		order[slot] = (u32)i;
+		lens[slot] = (u32)k->lens[i];
+		slots[slot] = i;
+	}
+
+	(void)fprintf(out,
+		      "/* Generated by mphf_gen from %s, do not edit */\n"
+		      "#pragma once\n\n#include \"laz_utils.h\"\n\n",
+		      source);
+	write_u32s(out, name, "pilots", mphf->pilots, mphf->bucket_count);
+	write_u32s(out, name, "remap", mphf->remap,
+		   mphf->table_size - mphf->count);
+	write_u32s(out, name, "order", order, k->count);
+	write_u32s(out, name, "lens", lens, k->count);
+
+	/* Keys by slot, so a lookup compares a single one */
+	(void)fprintf(out, "static const char *const %s_keys[] = {", name);
+
+	for (size_t i = 0; i < MAX(k->count, 1); i++) {
+		(void)fprintf(out, "\n\t");
+
+		if (k->count == 0) {
+			(void)fprintf(out, "\"\",");
+			continue;
+		}
+
+		write_string(out, k->keys[slots[i]], k->lens[slots[i]]);
+		(void)fprintf(out, ",");
+	}
+
+	(void)fprintf(out, "\n};\n\n");
+	(void)fprintf(out,
+		      "static const struct mphf %s_mphf = {\n"
+		      "\t%#llxULL, %zu, %zu, %zu, %s_pilots, %s_remap,\n"
+		      "};\n\n",
+		      name, (unsigned long long)mphf->seed, mphf->count,
+		      mphf->bucket_count, mphf->table_size, name, name);
+	(void)fprintf(out,
+		      "/* Position of `key` in %s, or -1 */\n"
+		      "static inline long %s_lookup(const char *key, size_t len)\n"
+		      "{\n"
+		      "\tsize_t slot = 0;\n\n"
+		      "\tif (%s_mphf.count == 0) {\n"
+		      "\t\treturn -1;\n"
+		      "\t}\n\n"
+		      "\tslot = mphf_index(&%s_mphf, key, len);\n\n"
+		      "\tif (%s_lens[slot] != len ||\n"
+		      "\t    memcmp(%s_keys[slot], key, len) != 0) {\n"
+		      "\t\treturn -1;\n"
+		      "\t}\n\n"
+		      "\treturn (long)%s_order[slot];\n"
+		      "}\n",
+		      source, name, name, name, name, name, name);
+
+	free(slots);
+	free(lens);
+	free(order);
+}
+
+int main(int argc, char **argv)
+{
+	struct keys k;
+	struct mphf mphf;
+	FILE *out = NULL;
+	const char *source = NULL;
+	int status = EXIT_SUCCESS;
+
+	if (argc != 4) {
+		(void)fprintf(stderr, "usage: %s name keys output\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	memset(&k, 0, sizeof(k));
+
+	if (read_keys(argv[2], &k) != 0 ||
+	    mphf_build(&mphf, k.keys, k.lens, k.count) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	out = fopen(argv[3], "w");
+
+	if (out == NULL) {
+		(void)errorf("Error: unable to write file %s\n", argv[3]);
+		return EXIT_FAILURE;
+	}
+
+	source = strrchr(argv[2], '/');
+	write_header(out, argv[1], source != NULL ? source + 1 : argv[2], &k,
+		     &mphf);
+
+	if (fclose(out) != 0) {
+		(void)errorf("Error: unable to write file %s\n", argv[3]);
+		status = EXIT_FAILURE;
+	}
+
+	mphf_destroy(&mphf);
+	free(k.keys);
+	free(k.lens);
+	free(k.text);
+	return status;
+}